@@ -0,0 +1,19 @@
+#pragma once
+
+// cosave_inspect is built without OBSE's prefix headers so it can be built on other platforms too. These stand in
+// for what CoSaveFormat.h and Compression.h need from them
+
+#include <cstdint>
+#include <cassert>
+
+typedef uint8_t		UInt8;
+typedef uint16_t	UInt16;
+typedef uint32_t	UInt32;
+typedef uint64_t	UInt64;
+typedef int8_t		SInt8;
+typedef int16_t		SInt16;
+typedef int32_t		SInt32;
+typedef int64_t		SInt64;
+
+#define MACRO_SWAP32(a)	((((a) & 0x000000FF) << 24) | (((a) & 0x0000FF00) << 8) | (((a) & 0x00FF0000) >> 8) | (((a) & 0xFF000000) >> 24))
+#define ASSERT(a)		assert(a)
@@ -0,0 +1,512 @@
+// cosave_inspect: lists what's in .obse co-saves and times reading and rewriting them
+//
+//	cosave_inspect [-v] [-n iterations] file.obse [file.obse ...]
+//		-v	list every chunk rather than a summary per chunk type
+//		-n	number of load/save round trips to time, default 10, 0 to skip
+//
+// Files are read with OBSE's own LoadBuffer and record readers, and written back with CoSaveBuilder and the array
+// record writer, so what's reported is what the game would load. samples/ has co-saves to try it on
+//
+// On Windows build cosave_inspect.vcxproj, elsewhere from this directory with e.g.
+//	g++ -std=c++11 -O2 -Wno-multichar -I.. -include Types.h main.cpp ../obse/CoSaveFormat.cpp ../obse/CoSaveRecords.cpp ../obse/Compression.cpp -o cosave_inspect
+
+#include "Types.h"
+#include "obse/CoSaveFormat.h"
+#include "obse/CoSaveRecords.h"
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <map>
+#include <chrono>
+
+using namespace Serialization;
+
+struct Chunk
+{
+	ChunkHeader		header;
+	const UInt8		* data;		// in CoSave::image
+};
+
+struct Plugin
+{
+	PluginHeader		header;
+	UInt32				storedLength;		// bytes in the file, differs from header.length if compressed
+	std::vector <Chunk>	chunks;
+};
+
+struct CoSave
+{
+	Header					header;
+	UInt32					fileSize;
+	LoadBuffer				image;			// version 1 layout
+	std::vector <Plugin>	plugins;
+};
+
+// array and string variables owned by one mod
+struct ModStats
+{
+	ModStats() : numArrays(0), numElements(0), arrayBytes(0), numStrings(0), stringBytes(0)
+	{
+		memset(elementTypes, 0, sizeof(elementTypes));
+	}
+
+	UInt32	numArrays;
+	UInt32	numElements;
+	UInt32	elementTypes[0x100];
+	UInt32	arrayBytes;			// ARVR record lengths
+	UInt32	numStrings;
+	UInt32	stringBytes;
+};
+
+// OBSE's records as loading decodes them. Strings point into the co-save's image
+struct Vars
+{
+	Vars() : numOldArrays(0), numBadRecords(0) { }
+
+	std::vector <SavedString>		modNames;		// from MODS
+	std::vector <SavedString>		strings;		// ARVT
+	std::vector <SavedArrayHeader>	arrays;
+	std::vector <UInt32>			elementEnds;	// per array, end of its elements
+	std::vector <UInt32>			recordLengths;	// per array
+	std::vector <SavedElement>		elements;
+	std::vector <SavedStringVar>	stringVars;
+	UInt32							numOldArrays;	// ARVR records older than v2
+	UInt32							numBadRecords;
+};
+
+static std::string TypeString(UInt32 type)
+{
+	char	buf[5];
+	for(UInt32 i = 0; i < 4; i++)
+	{
+		char	c = (type >> (24 - i * 8)) & 0xFF;
+		buf[i] = (c >= 0x20 && c < 0x7F) ? c : '?';
+	}
+
+	buf[4] = 0;
+	return buf;
+}
+
+static bool ReadFile(const char * path, std::vector <UInt8> & out)
+{
+	FILE	* file = fopen(path, "rb");
+	if(!file)
+		return false;
+
+	fseek(file, 0, SEEK_END);
+	long	size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	out.resize(size > 0 ? size : 0);
+	bool	bRead = out.empty() || fread(&out[0], 1, out.size(), file) == out.size();
+	fclose(file);
+
+	return bRead;
+}
+
+// takes ownership of data and walks it as HandleLoadGame does. Returns false with a reason in error if the file
+// can't be loaded
+static bool ParseCoSave(std::vector <UInt8> & data, CoSave & out, std::string & error)
+{
+	out.fileSize = data.size();
+	out.plugins.clear();
+
+	// the header is read back after compressed files are expanded, which leaves it saying version 1
+	UInt32	formatVersion = data.size() >= sizeof(Header) ? ((const Header *)&data[0])->formatVersion : Header::kVersion_Invalid;
+
+	std::vector <UInt32>	storedLengths;
+	if(!out.image.Assign(data, &storedLengths))
+	{
+		error = "compressed data is damaged";
+		return false;
+	}
+
+	if(out.image.ReadBuf(&out.header, sizeof(Header)) != sizeof(Header))
+	{
+		error = "file too short";
+		return false;
+	}
+
+	out.header.formatVersion = formatVersion;
+
+	if(out.header.signature != Header::kSignature)
+	{
+		error = "not a co-save";
+		return false;
+	}
+
+	if(out.header.formatVersion <= Header::kVersion_Invalid || out.header.formatVersion > Header::kVersion)
+	{
+		error = "unknown format version";
+		return false;
+	}
+
+	while(out.image.GetRemain() >= sizeof(PluginHeader))
+	{
+		Plugin	plugin;
+		out.image.ReadBuf(&plugin.header, sizeof(PluginHeader));
+		if(plugin.header.length > out.image.GetRemain())
+		{
+			error = "plugin block runs past the end of the file";
+			return false;
+		}
+
+		plugin.storedLength = out.plugins.size() < storedLengths.size() ? storedLengths[out.plugins.size()] : plugin.header.length;
+
+		UInt32	blockEnd = out.image.GetOffset() + plugin.header.length;
+		for(UInt32 i = 0; i < plugin.header.numChunks; i++)
+		{
+			Chunk	chunk;
+			if(blockEnd - out.image.GetOffset() < sizeof(ChunkHeader))
+			{
+				error = "chunk header runs past the end of its plugin block";
+				return false;
+			}
+
+			out.image.ReadBuf(&chunk.header, sizeof(ChunkHeader));
+			if(chunk.header.length > blockEnd - out.image.GetOffset() || !(chunk.data = out.image.ReadSpan(chunk.header.length)))
+			{
+				error = "chunk runs past the end of its plugin block";
+				return false;
+			}
+
+			plugin.chunks.push_back(chunk);
+		}
+
+		out.image.SetOffset(blockEnd);
+		out.plugins.push_back(plugin);
+	}
+
+	if(out.plugins.size() != out.header.numPlugins)
+	{
+		error = "plugin count doesn't match the header";
+		return false;
+	}
+
+	return true;
+}
+
+static const Plugin * FindObsePlugin(const CoSave & coSave)
+{
+	for(std::vector <Plugin>::const_iterator plugin = coSave.plugins.begin(); plugin != coSave.plugins.end(); ++plugin)
+		if(plugin->header.opcodeBase == kObseOpcodeBase)
+			return &*plugin;
+
+	return NULL;
+}
+
+// decodes OBSE's array and string variable records and the mod list
+static void DecodeVars(const Plugin & plugin, Vars & vars)
+{
+	for(std::vector <Chunk>::const_iterator chunk = plugin.chunks.begin(); chunk != plugin.chunks.end(); ++chunk)
+	{
+		RecordCursor	record(chunk->data, chunk->header.length);
+		bool			bDecoded = true;
+
+		switch(chunk->header.type)
+		{
+			case 'MODS':
+				bDecoded = ReadModList(record, vars.modNames);
+				break;
+
+			case 'STVR':
+				{
+					SavedStringVar	var;
+					bDecoded = ReadStringVarRecord(record, var);
+					if(bDecoded)
+						vars.stringVars.push_back(var);
+				}
+				break;
+
+			case 'ARVT':
+				bDecoded = ReadStringTable(record, vars.strings);
+				break;
+
+			case 'ARVR':
+				{
+					SavedArrayHeader	header;
+					bDecoded = ReadArrayHeader(record, chunk->header.version, header);
+					if(bDecoded)
+					{
+						bDecoded = ReadArrayElements(record, chunk->header.version, header, vars.strings, vars.elements);
+						vars.arrays.push_back(header);
+						vars.elementEnds.push_back(vars.elements.size());
+						vars.recordLengths.push_back(chunk->header.length);
+					}
+
+					if(chunk->header.version < 2)
+						vars.numOldArrays++;
+				}
+				break;
+		}
+
+		if(!bDecoded)
+			vars.numBadRecords++;
+	}
+}
+
+// rebuilds the version 1 image as HandleSaveGame would, array records are encoded again
+static void WriteCoSave(const CoSave & coSave, const Vars & vars, std::vector <UInt8> & out)
+{
+	// as in ArrayVarMap::Save, records first so the string table is complete
+	SaveStringTable			strings;
+	std::vector <UInt8>		records;
+	std::vector <UInt32>	recordEnds;
+	for(UInt32 i = 0; i < vars.arrays.size(); i++)
+	{
+		UInt32	start = i ? vars.elementEnds[i - 1] : 0;
+		WriteArrayRecord(records, vars.arrays[i], vars.elements.data() + start, vars.elementEnds[i] - start, strings);
+		recordEnds.push_back(records.size());
+	}
+
+	std::vector <UInt8>	table;
+	strings.Write(table);
+
+	CoSaveBuilder	builder;
+	Header			header = coSave.header;
+	header.formatVersion = Header::kVersion_Uncompressed;
+	builder.Begin(header);
+
+	for(std::vector <Plugin>::const_iterator plugin = coSave.plugins.begin(); plugin != coSave.plugins.end(); ++plugin)
+	{
+		bool	bObse = plugin->header.opcodeBase == kObseOpcodeBase;
+		UInt32	recordIdx = 0;
+
+		builder.BeginPlugin(plugin->header.opcodeBase);
+		for(std::vector <Chunk>::const_iterator chunk = plugin->chunks.begin(); chunk != plugin->chunks.end(); ++chunk)
+		{
+			if(bObse && chunk->header.type == 'ARVT')
+				continue;
+
+			// records that couldn't be decoded aren't loaded, so they aren't saved either
+			if(bObse && chunk->header.type == 'ARVR')
+			{
+				if(recordIdx < recordEnds.size())
+				{
+					UInt32	start = recordIdx ? recordEnds[recordIdx - 1] : 0;
+					builder.OpenRecord('ARVR', 2);
+					builder.WriteRecordData(records.data() + start, recordEnds[recordIdx] - start);
+					recordIdx++;
+				}
+
+				continue;
+			}
+
+			builder.OpenRecord(chunk->header.type, chunk->header.version);
+			builder.WriteRecordData(chunk->data, chunk->header.length);
+
+			if(bObse && chunk->header.type == 'ARVS')
+			{
+				builder.OpenRecord('ARVT', 2);
+				builder.WriteRecordData(table.data(), table.size());
+			}
+		}
+
+		builder.EndPlugin();
+	}
+
+	builder.Finish();
+	out.swap(builder.Image());
+}
+
+static void PrintCoSave(const char * path, const CoSave & coSave, bool bVerbose)
+{
+	printf("%s: %u bytes, format version %u, written by OBSE %u.%u, %u plugins\n", path, coSave.fileSize,
+		coSave.header.formatVersion, coSave.header.obseVersion, coSave.header.obseMinorVersion, coSave.header.numPlugins);
+
+	for(std::vector <Plugin>::const_iterator plugin = coSave.plugins.begin(); plugin != coSave.plugins.end(); ++plugin)
+	{
+		printf("  plugin %04X%s: %u chunks, %u bytes", plugin->header.opcodeBase, plugin->header.opcodeBase == kObseOpcodeBase ? " (OBSE)" : "",
+			plugin->header.numChunks, plugin->header.length);
+		if(plugin->storedLength != plugin->header.length)
+			printf(", %u stored", plugin->storedLength);
+		printf("\n");
+
+		if(bVerbose)
+		{
+			for(std::vector <Chunk>::const_iterator chunk = plugin->chunks.begin(); chunk != plugin->chunks.end(); ++chunk)
+				printf("    %s v%u  %u bytes\n", TypeString(chunk->header.type).c_str(), chunk->header.version, chunk->header.length);
+
+			continue;
+		}
+
+		// summary by type and version, in order of first appearance
+		std::vector <std::pair <UInt32, UInt32> >	order;
+		std::map <std::pair <UInt32, UInt32>, std::pair <UInt32, UInt32> >	totals;		// count, bytes
+		for(std::vector <Chunk>::const_iterator chunk = plugin->chunks.begin(); chunk != plugin->chunks.end(); ++chunk)
+		{
+			std::pair <UInt32, UInt32>	key(chunk->header.type, chunk->header.version);
+			std::pair <UInt32, UInt32>	& total = totals[key];
+			if(!total.first)
+				order.push_back(key);
+
+			total.first++;
+			total.second += chunk->header.length;
+		}
+
+		for(UInt32 i = 0; i < order.size(); i++)
+		{
+			const std::pair <UInt32, UInt32>	& total = totals[order[i]];
+			printf("    %s v%u  %6u chunks  %10u bytes\n", TypeString(order[i].first).c_str(), order[i].second, total.first, total.second);
+		}
+	}
+
+	const Plugin	* obse = FindObsePlugin(coSave);
+	if(!obse)
+		return;
+
+	Vars	vars;
+	DecodeVars(*obse, vars);
+
+	// per owning mod
+	std::map <UInt8, ModStats>	mods;
+	for(UInt32 i = 0; i < vars.arrays.size(); i++)
+	{
+		ModStats	& mod = mods[vars.arrays[i].modIndex];
+		mod.numArrays++;
+		mod.arrayBytes += vars.recordLengths[i];
+		for(UInt32 j = i ? vars.elementEnds[i - 1] : 0; j < vars.elementEnds[i]; j++)
+		{
+			mod.elementTypes[vars.elements[j].value.type]++;
+			mod.numElements++;
+		}
+	}
+
+	for(UInt32 i = 0; i < vars.stringVars.size(); i++)
+	{
+		ModStats	& mod = mods[vars.stringVars[i].modIndex];
+		mod.numStrings++;
+		mod.stringBytes += vars.stringVars[i].str.len;
+	}
+
+	printf("  variables by owning mod:\n");
+	printf("    %-40s %8s %10s %10s %8s %10s\n", "mod", "arrays", "elements", "bytes", "strings", "bytes");
+	for(std::map <UInt8, ModStats>::const_iterator iter = mods.begin(); iter != mods.end(); ++iter)
+	{
+		char	name[64];
+		if(iter->first < vars.modNames.size())
+			snprintf(name, sizeof(name), "%02X %.*s", iter->first, (int)vars.modNames[iter->first].len, vars.modNames[iter->first].data);
+		else
+			snprintf(name, sizeof(name), "%02X", iter->first);
+
+		const ModStats	& mod = iter->second;
+		printf("    %-40s %8u %10u %10u %8u %10u\n", name, mod.numArrays, mod.numElements, mod.arrayBytes, mod.numStrings, mod.stringBytes);
+		if(mod.numElements)
+		{
+			UInt32	numUnknown = mod.numElements - mod.elementTypes[kDataType_Invalid] - mod.elementTypes[kDataType_Numeric] -
+				mod.elementTypes[kDataType_Form] - mod.elementTypes[kDataType_String] - mod.elementTypes[kDataType_Array];
+
+			printf("    %-40s numbers %u, forms %u, strings %u, arrays %u, uninitialized %u", "", mod.elementTypes[kDataType_Numeric],
+				mod.elementTypes[kDataType_Form], mod.elementTypes[kDataType_String], mod.elementTypes[kDataType_Array],
+				mod.elementTypes[kDataType_Invalid]);
+			if(numUnknown)
+				printf(", unknown type %u", numUnknown);
+			printf("\n");
+		}
+	}
+
+	if(vars.strings.size())
+		printf("  %u strings in the array string table\n", (UInt32)vars.strings.size());
+	if(vars.numBadRecords)
+		printf("  %u records could not be decoded\n", vars.numBadRecords);
+}
+
+// times reading the file image into variables and writing it back out, as loading and saving the game do
+static void TimeRoundTrip(const std::vector <UInt8> & fileData, UInt32 iterations)
+{
+	typedef std::chrono::steady_clock	Clock;
+
+	double	loadSeconds = 0, saveSeconds = 0;
+	bool	bMatches = true;
+	UInt32	numOldArrays = 0, numBadRecords = 0;
+
+	for(UInt32 i = 0; i < iterations; i++)
+	{
+		std::vector <UInt8>	data(fileData);
+		CoSave				coSave;
+		std::string			error;
+		Vars				vars;
+
+		Clock::time_point	start = Clock::now();
+		if(!ParseCoSave(data, coSave, error))
+			return;
+		if(const Plugin * obse = FindObsePlugin(coSave))
+			DecodeVars(*obse, vars);
+		Clock::time_point	loaded = Clock::now();
+
+		std::vector <UInt8>	image;
+		WriteCoSave(coSave, vars, image);
+		bool	bMatch = image.size() == coSave.image.GetSize() && !memcmp(image.data(), coSave.image.GetData(), image.size());
+		if(coSave.header.formatVersion == Header::kVersion_Compressed)
+			CompressCoSaveImage(image);
+		Clock::time_point	saved = Clock::now();
+
+		loadSeconds += std::chrono::duration <double>(loaded - start).count();
+		saveSeconds += std::chrono::duration <double>(saved - loaded).count();
+		bMatches = bMatches && bMatch;
+		numOldArrays = vars.numOldArrays;
+		numBadRecords = vars.numBadRecords;
+	}
+
+	// older array records are saved as v2 and damaged ones are left out, so only an image without either has to match
+	const char	* result = bMatches ? "rewritten data matches" : "REWRITTEN DATA DIFFERS";
+	if(numBadRecords)
+		result = "damaged records not rewritten";
+	else if(numOldArrays)
+		result = "array records rewritten as v2";
+
+	double	megabytes = fileData.size() / (1024.0 * 1024.0);
+	printf("  round trip over %u iterations: load %.3f ms (%.1f MB/s), save %.3f ms (%.1f MB/s), %s\n", iterations,
+		loadSeconds * 1000 / iterations, megabytes * iterations / loadSeconds,
+		saveSeconds * 1000 / iterations, megabytes * iterations / saveSeconds, result);
+}
+
+int main(int argc, char ** argv)
+{
+	bool	bVerbose = false;
+	UInt32	iterations = 10;
+	int		numFiles = 0;
+	int		result = 0;
+
+	for(int i = 1; i < argc; i++)
+	{
+		if(!strcmp(argv[i], "-v"))
+			bVerbose = true;
+		else if(!strcmp(argv[i], "-n") && i + 1 < argc)
+			iterations = strtoul(argv[++i], NULL, 10);
+		else
+		{
+			numFiles++;
+
+			std::vector <UInt8>	data;
+			if(!ReadFile(argv[i], data))
+			{
+				fprintf(stderr, "%s: couldn't read file\n", argv[i]);
+				result = 1;
+				continue;
+			}
+
+			std::vector <UInt8>	fileData(data);
+			CoSave				coSave;
+			std::string			error;
+			if(!ParseCoSave(data, coSave, error))
+			{
+				fprintf(stderr, "%s: %s\n", argv[i], error.c_str());
+				result = 1;
+				continue;
+			}
+
+			PrintCoSave(argv[i], coSave, bVerbose);
+			if(iterations)
+				TimeRoundTrip(fileData, iterations);
+		}
+	}
+
+	if(!numFiles)
+	{
+		fprintf(stderr, "usage: cosave_inspect [-v] [-n iterations] file.obse [file.obse ...]\n");
+		return 1;
+	}
+
+	return result;
+}
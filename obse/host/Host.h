@@ -0,0 +1,75 @@
+#pragma once
+
+// The host benchmark and tests build pieces of OBSE that don't touch the game without OBSE's prefix headers, so they
+// can be built on other platforms too. These stand in for what those pieces need from the prefix headers and Windows
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+#include <cassert>
+#include <chrono>
+#include <mutex>
+#include <atomic>
+#include <string>
+
+typedef uint8_t		UInt8;
+typedef uint16_t	UInt16;
+typedef uint32_t	UInt32;
+typedef uint64_t	UInt64;
+typedef int8_t		SInt8;
+typedef int16_t		SInt16;
+typedef int32_t		SInt32;
+typedef int64_t		SInt64;
+
+#define OBLIVION		1
+#define OBSE_CORE		1
+
+#define MACRO_SWAP32(a)	((((a) & 0x000000FF) << 24) | (((a) & 0x0000FF00) << 8) | (((a) & 0x00FF0000) >> 8) | (((a) & 0xFF000000) >> 24))
+#define ASSERT(a)		assert(a)
+#define ASSERT_STR(a, b)	assert(a)
+#define STATIC_ASSERT(a)	static_assert(a, #a)
+
+#define _MESSAGE(...)	(printf(__VA_ARGS__), printf("\n"))
+#define _WARNING(...)	(printf(__VA_ARGS__), printf("\n"))
+#define _ERROR(...)		(printf(__VA_ARGS__), printf("\n"))
+
+#define _stricmp		strcasecmp
+
+// Win32
+typedef uint32_t	DWORD;
+typedef int32_t		LONG;
+
+union LARGE_INTEGER
+{
+	int64_t	QuadPart;
+};
+
+inline int QueryPerformanceFrequency(LARGE_INTEGER* freq)
+{
+	freq->QuadPart = std::chrono::steady_clock::period::den / std::chrono::steady_clock::period::num;
+	return 1;
+}
+
+inline int QueryPerformanceCounter(LARGE_INTEGER* counter)
+{
+	counter->QuadPart = std::chrono::steady_clock::now().time_since_epoch().count();
+	return 1;
+}
+
+inline LONG InterlockedIncrement(volatile LONG* value)	{ return __sync_add_and_fetch(value, 1); }
+inline LONG InterlockedDecrement(volatile LONG* value)	{ return __sync_sub_and_fetch(value, 1); }
+
+typedef std::recursive_mutex CRITICAL_SECTION;
+
+inline void InitializeCriticalSection(CRITICAL_SECTION*)		{ }
+inline void DeleteCriticalSection(CRITICAL_SECTION*)			{ }
+inline void EnterCriticalSection(CRITICAL_SECTION* cs)			{ cs->lock(); }
+inline void LeaveCriticalSection(CRITICAL_SECTION* cs)			{ cs->unlock(); }
+inline int TryEnterCriticalSection(CRITICAL_SECTION* cs)		{ return cs->try_lock(); }
+
+inline thread_local void* g_hostTls[64];
+
+inline void* TlsGetValue(DWORD index)					{ return g_hostTls[index % 64]; }
+inline int TlsSetValue(DWORD index, void* value)		{ g_hostTls[index % 64] = value; return 1; }
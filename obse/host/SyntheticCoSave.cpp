@@ -0,0 +1,362 @@
+#include "SyntheticCoSave.h"
+#include "obse/CoSaveRecords.h"
+#include "obse_common/obse_version.h"
+#include <deque>
+#include <random>
+#include <string>
+
+using namespace Serialization;
+
+namespace
+{
+
+class Generator
+{
+	const SyntheticCoSave&		m_params;
+	std::mt19937				m_rng;
+	CoSaveSink&					m_sink;
+	std::vector<std::string>	m_words;		// strings that turn up in many arrays, like keys and item names
+	std::deque<std::string>		m_unique;		// one-off strings, SavedStrings point into these
+
+public:
+	Generator(const SyntheticCoSave& params, CoSaveSink& sink) : m_params(params), m_rng(params.seed), m_sink(sink)
+	{
+		static const char* kWords[] =
+		{
+			"Sword", "Shield", "Helmet", "Gauntlets", "Greaves", "Boots", "Cuirass", "Ring", "Amulet", "Potion",
+			"Scroll", "Arrow", "Bow", "Staff", "Mace", "Axe",
+		};
+
+		for (const char* word : kWords) {
+			m_words.push_back(word);
+			m_words.push_back(std::string("Enchanted") + word);
+			m_words.push_back(std::string("Count") + word + "Owned");
+		}
+	}
+
+	UInt32 Random(UInt32 range) { return m_rng() % range; }
+
+	void Write()
+	{
+		Header header;
+		header.signature = Header::kSignature;
+		header.formatVersion = Header::kVersion_Uncompressed;
+		header.obseVersion = OBSE_VERSION_INTEGER;
+		header.obseMinorVersion = OBSE_VERSION_INTEGER_MINOR;
+		header.oblivionVersion = OBLIVION_VERSION_1_2_416;
+		header.numPlugins = 0;
+		m_sink.Begin(header);
+
+		m_sink.BeginPlugin(kObseOpcodeBase);
+		WriteModList();
+		WriteStringVars();
+		if (m_params.arrayVersion >= 2)
+			WriteArraysV2();
+		else
+			WriteArraysV1();
+		WriteGlobals();
+		m_sink.EndPlugin();
+
+		for (UInt32 i = 0; i < m_params.numPlugins; i++)
+			WritePlugin(0x2000 + i * 0x100);
+
+		m_sink.Finish();
+	}
+
+private:
+	void WriteRecord(UInt32 type, UInt32 version, const void* data, UInt32 length)
+	{
+		m_sink.OpenRecord(type, version);
+		m_sink.WriteRecordData(data, length);
+	}
+
+	template <typename T>
+	void WriteData(const T& val) { m_sink.WriteRecordData(&val, sizeof(T)); }
+
+	void WriteModList()
+	{
+		m_sink.OpenRecord('MODS', 0);
+		UInt8 numMods = m_params.numMods;
+		WriteData(numMods);
+		for (UInt32 i = 0; i < numMods; i++) {
+			std::string name = i ? "Mod" + std::to_string(i) + (i % 4 ? ".esp" : ".esm") : "Oblivion.esm";
+			UInt16 len = name.length();
+			WriteData(len);
+			m_sink.WriteRecordData(name.data(), len);
+		}
+	}
+
+	// as StringVarMap::Save writes them
+	void WriteStringVars()
+	{
+		m_sink.OpenRecord('STVS', 0);
+		UInt32 id = 0;
+		for (UInt32 i = 0; i < m_params.numStringVars; i++) {
+			id += 1 + (Random(8) == 0);
+			std::string str = Random(2) ? m_words[Random(m_words.size())] : "Message " + std::to_string(Random(100000));
+
+			m_sink.OpenRecord('STVR', 0);
+			UInt8 modIndex = Random(m_params.numMods);
+			UInt16 len = str.length();
+			WriteData(modIndex);
+			WriteData(id);
+			WriteData(len);
+			m_sink.WriteRecordData(str.data(), len);
+		}
+		m_sink.OpenRecord('STVE', 0);
+	}
+
+	SavedString Word()
+	{
+		const std::string& word = m_words[Random(m_words.size())];
+		SavedString str = { word.data(), (UInt32)word.length() };
+		return str;
+	}
+
+	SavedString Store(const std::string& str)
+	{
+		m_unique.push_back(str);
+		SavedString saved = { m_unique.back().data(), (UInt32)m_unique.back().length() };
+		return saved;
+	}
+
+	SavedString UniqueString() { return Store("Entry " + std::to_string(Random(1000000))); }
+
+	// mostly integers, as script values usually are
+	double Number()
+	{
+		switch (Random(8)) {
+			case 0:		return Random(4000) / 8.0;
+			case 1:		return -(double)Random(1000);
+			case 2:		return (double)m_rng();
+			default:	return Random(100);
+		}
+	}
+
+	// elements with a random type, uninitialized ones only in v2
+	void MakeValue(SavedValue& value, bool bCanBeInvalid, UInt32 numArrays)
+	{
+		value = SavedValue();
+		switch (Random(bCanBeInvalid ? 10 : 9)) {
+			case 0:
+			case 1:
+			case 2:
+				value.type = kDataType_Numeric;
+				value.num = Number();
+				break;
+			case 3:
+			case 4:
+				value.type = kDataType_Form;
+				value.formID = Random(m_params.numMods) << 24;
+				value.formID |= 0x10000 + Random(0x8000);
+				break;
+			case 5:
+			case 6:
+				value.type = kDataType_String;
+				value.str = Random(3) ? Word() : UniqueString();
+				break;
+			case 7:
+				value.type = kDataType_Array;
+				value.arrayID = 1 + Random(numArrays);
+				break;
+			case 8:
+				value.type = kDataType_Numeric;
+				value.num = 0;
+				break;
+			default:
+				value.type = kDataType_Invalid;
+				break;
+		}
+	}
+
+	struct Array
+	{
+		SavedArrayHeader			header;
+		std::vector<UInt8>			refs;
+		std::vector<SavedElement>	elements;
+	};
+
+	// a third each of arrays, maps and string maps. Some arrays end in padding left by ar_Resize
+	void MakeArray(ArrayID id, bool bCanBeInvalid, Array& arr)
+	{
+		UInt32 kind = Random(3);
+		arr.header.modIndex = Random(m_params.numMods);
+		arr.header.id = id;
+		arr.header.keyType = kind == 2 ? kDataType_String : kDataType_Numeric;
+		arr.header.bPacked = kind == 0;
+
+		arr.refs.assign(1, arr.header.modIndex);
+		for (UInt32 numRefs = Random(3); numRefs; numRefs--)
+			arr.refs.push_back(Random(m_params.numMods));
+		arr.header.numRefs = arr.refs.size();
+		arr.header.refs = &arr.refs[0];
+
+		UInt32 numElements = 1 + Random(m_params.numElements * 2);
+		arr.elements.resize(numElements);
+		double key = 0;
+		for (UInt32 i = 0; i < numElements; i++) {
+			SavedElement& elem = arr.elements[i];
+			elem.key = SavedValue();
+			if (kind == 2) {
+				// keys are unique in the array but not across arrays
+				elem.key.type = kDataType_String;
+				elem.key.str = Store(i < m_words.size() ? m_words[i] : "Key" + std::to_string(i));
+			}
+			else {
+				elem.key.type = kDataType_Numeric;
+				elem.key.num = kind == 0 ? i : (key += 1 + Random(20));
+			}
+			MakeValue(elem.value, bCanBeInvalid, m_params.numArrays);
+		}
+
+		if (kind == 0 && bCanBeInvalid && Random(4) == 0) {
+			for (UInt32 i = numElements - numElements / 3; i < numElements; i++)
+				arr.elements[i].value = SavedValue();
+		}
+	}
+
+	// as ArrayVarMap::Save writes them
+	void WriteArraysV2()
+	{
+		SaveStringTable strings;
+		std::vector<UInt8> records;
+		std::vector<UInt32> recordEnds;
+		Array arr;
+		ArrayID id = 0;
+		for (UInt32 i = 0; i < m_params.numArrays; i++) {
+			id += 1 + (Random(8) == 0);
+			MakeArray(id, true, arr);
+			WriteArrayRecord(records, arr.header, arr.elements.data(), arr.elements.size(), strings);
+			recordEnds.push_back(records.size());
+		}
+
+		m_sink.OpenRecord('ARVS', 2);
+
+		std::vector<UInt8> table;
+		strings.Write(table);
+		WriteRecord('ARVT', 2, table.data(), table.size());
+
+		UInt32 recordStart = 0;
+		for (UInt32 end : recordEnds) {
+			WriteRecord('ARVR', 2, &records[recordStart], end - recordStart);
+			recordStart = end;
+		}
+
+		m_sink.OpenRecord('ARVE', 2);
+	}
+
+	void WriteSerializedString(const SavedString& str)
+	{
+		UInt16 len = str.len;
+		WriteData(len);
+		m_sink.WriteRecordData(str.data, len);
+	}
+
+	void WriteValueV1(const SavedValue& value)
+	{
+		switch (value.type) {
+			case kDataType_Numeric:	WriteData(value.num); break;
+			case kDataType_String:	WriteSerializedString(value.str); break;
+			case kDataType_Array:	WriteData(value.arrayID); break;
+			case kDataType_Form:	WriteData(value.formID); break;
+		}
+	}
+
+	// the per-element layout OBSE used before v2, described in ArrayVar.h
+	void WriteArraysV1()
+	{
+		m_sink.OpenRecord('ARVS', 1);
+
+		Array arr;
+		ArrayID id = 0;
+		for (UInt32 i = 0; i < m_params.numArrays; i++) {
+			id += 1 + (Random(8) == 0);
+			MakeArray(id, false, arr);
+
+			m_sink.OpenRecord('ARVR', 1);
+			WriteData(arr.header.modIndex);
+			WriteData(arr.header.id);
+			WriteData(arr.header.keyType);
+			WriteData(arr.header.bPacked);
+			WriteData(arr.header.numRefs);
+			m_sink.WriteRecordData(arr.header.refs, arr.header.numRefs);
+
+			UInt32 numElements = arr.elements.size();
+			WriteData(numElements);
+			for (const SavedElement& elem : arr.elements) {
+				WriteValueV1(elem.key);
+				WriteData(elem.value.type);
+				WriteValueV1(elem.value);
+			}
+		}
+
+		m_sink.OpenRecord('ARVE', 1);
+	}
+
+	void WriteGlobals()
+	{
+		m_sink.OpenRecord('GLOB', 0);
+		UInt8 globId = 0;
+		double mvmtSpeedMod = 10.0;
+		WriteData(globId);
+		WriteData(mvmtSpeedMod);
+	}
+
+	// plugin data is a mix of structured records and noise
+	void WritePlugin(UInt32 opcodeBase)
+	{
+		m_sink.BeginPlugin(opcodeBase);
+		for (UInt32 written = 0; written < m_params.pluginBytes; ) {
+			std::vector<UInt8> data;
+			UInt32 numEntries = 1 + Random(64);
+			for (UInt32 i = 0; i < numEntries; i++) {
+				UInt32 formID = 0x01000000 | Random(0x1000);
+				float pos[3] = { (float)Random(100000), (float)Random(100000), (float)Random(2000) };
+				UInt32 noise = m_rng();
+				data.insert(data.end(), (const UInt8*)&formID, (const UInt8*)(&formID + 1));
+				data.insert(data.end(), (const UInt8*)pos, (const UInt8*)(pos + 3));
+				data.insert(data.end(), (const UInt8*)&noise, (const UInt8*)(&noise + 1));
+			}
+			WriteRecord('DATA', 1, data.data(), data.size());
+			written += data.size();
+		}
+		m_sink.EndPlugin();
+	}
+};
+
+class BuilderSink : public CoSaveSink
+{
+public:
+	CoSaveBuilder	builder;
+
+	virtual void	Begin(const Header& header)						{ builder.Begin(header); }
+	virtual void	BeginPlugin(UInt32 opcodeBase)					{ builder.BeginPlugin(opcodeBase); }
+	virtual void	OpenRecord(UInt32 type, UInt32 version)			{ builder.OpenRecord(type, version); }
+	virtual void	WriteRecordData(const void* data, UInt32 length)	{ builder.WriteRecordData(data, length); }
+	virtual void	EndPlugin()										{ builder.EndPlugin(); }
+	virtual void	Finish()										{ builder.Finish(); }
+};
+
+}
+
+void WriteSyntheticCoSave(const SyntheticCoSave& params, CoSaveSink& sink)
+{
+	Generator(params, sink).Write();
+}
+
+void BuildSyntheticCoSave(const SyntheticCoSave& params, std::vector<UInt8>& out)
+{
+	BuilderSink sink;
+	WriteSyntheticCoSave(params, sink);
+	out.swap(sink.builder.Image());
+}
+
+const SampleCoSave kSampleCoSaves[] =
+{
+	// mods, string vars, arrays, elements, array version, plugins, plugin bytes, seed
+	{ "arrays_v2.obse",		false,	{ 8, 40, 60, 12, 2, 1, 2000, 1 } },
+	{ "compressed.obse",	true,	{ 16, 200, 400, 20, 2, 2, 8000, 2 } },
+	{ "arrays_v1.obse",		false,	{ 8, 40, 60, 12, 1, 0, 0, 3 } },
+};
+
+const UInt32 kNumSampleCoSaves = sizeof(kSampleCoSaves) / sizeof(kSampleCoSaves[0]);
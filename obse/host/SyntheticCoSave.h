@@ -0,0 +1,51 @@
+#pragma once
+
+// builds co-saves laid out like the ones the game writes, from a seed, for the benchmark, the tests and the files in
+// cosave_inspect/samples. OBSE's block holds MODS, string vars, array vars and GLOB as Core_SaveCallback writes them;
+// other plugins get blocks of opaque data
+
+#include "obse/CoSaveFormat.h"
+#include <vector>
+
+struct SyntheticCoSave
+{
+	UInt32	numMods;			// in MODS, and owners of the variables
+	UInt32	numStringVars;
+	UInt32	numArrays;
+	UInt32	numElements;		// per array on average
+	UInt32	arrayVersion;		// ARVR version: 2 as saved now, 1 as saved before the compact encoding
+	UInt32	numPlugins;			// blocks for other plugins
+	UInt32	pluginBytes;		// per plugin block
+	UInt32	seed;
+};
+
+// builds the version 1 (uncompressed) image, CompressCoSaveImage() converts it to what the game saves with compression on
+void BuildSyntheticCoSave(const SyntheticCoSave& params, std::vector<UInt8>& out);
+
+// the calls a save makes on the co-save writer, in the order Serialization makes them
+class CoSaveSink
+{
+public:
+	virtual ~CoSaveSink() { }
+
+	virtual void	Begin(const Serialization::Header& header) = 0;
+	virtual void	BeginPlugin(UInt32 opcodeBase) = 0;
+	virtual void	OpenRecord(UInt32 type, UInt32 version) = 0;
+	virtual void	WriteRecordData(const void* data, UInt32 length) = 0;
+	virtual void	EndPlugin() = 0;
+	virtual void	Finish() = 0;
+};
+
+// makes the same calls BuildSyntheticCoSave() builds its image from
+void WriteSyntheticCoSave(const SyntheticCoSave& params, CoSaveSink& sink);
+
+// the co-saves in cosave_inspect/samples, written by make_samples
+struct SampleCoSave
+{
+	const char*		name;
+	bool			bCompressed;
+	SyntheticCoSave	params;
+};
+
+extern const SampleCoSave	kSampleCoSaves[];
+extern const UInt32			kNumSampleCoSaves;
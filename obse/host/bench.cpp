@@ -0,0 +1,1495 @@
+// bench: times pieces of OBSE that don't touch the game against the code they replaced
+//
+//	bench [-n iterations] [section...]
+//		-n	number of iterations per run, default 1000000
+//
+// sections:
+//	operators	resolving the rule for an operator and its operands, dispatch table vs. scanning the rules
+//	eventlist	looking up event list variables by ID, index vs. walking the list
+//	packedarray	packed array operations, vector storage vs. the std::map storage packed arrays used to have
+//	varmap		string/array var bookkeeping with 100k live vars, VarMap vs. the std::map based VarMap it replaced
+//	cosave		saving synthetic co-saves, unbuffered writes vs. building each plugin block in memory, and loading them
+//	compression	co-save compression ratio and speed, and what it adds to saving and loading
+//	eventcallbacks	dispatching events to 10 to 10k filtered handlers, filter index vs. walking every handler
+//
+// Built from this directory with e.g.
+//	g++ -std=c++17 -O2 -Wno-multichar -I.. -I../.. -include Host.h bench.cpp SyntheticCoSave.cpp ../obse/ScriptOperators.cpp
+//		../obse/CoSaveFormat.cpp ../obse/CoSaveRecords.cpp ../obse/Compression.cpp -o bench
+
+#include "Host.h"
+#include "obse/ScriptOperators.h"
+#include "obse/EventListVarIndex.h"
+#include "obse/EventCallbackList.h"
+#include "obse/VarMap.h"
+#include "obse/CoSaveRecords.h"
+#include "BaselineVarMap.h"
+#include "SyntheticCoSave.h"
+#include <algorithm>
+#include <list>
+#include <map>
+#include <random>
+#include <vector>
+
+using namespace Serialization;
+
+typedef std::chrono::steady_clock Clock;
+
+static double ElapsedNs(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+// keeps results alive so the optimizer can't drop the loops
+static volatile UInt32 s_sink;
+
+/*************************************************
+	operators
+*************************************************/
+
+// InitDispatchTable() skips rules without a handler, so every rule gets one
+static ScriptToken* Eval_Bench(OperatorType op, ScriptToken* lh, ScriptToken* rh, ExpressionEvaluator* context)
+{
+	return NULL;
+}
+
+#define OP_HANDLER(x) Eval_Bench
+#include "obse/OperatorRules.inc"
+#undef OP_HANDLER
+
+// element types by array and key, looked up the way g_ArrayMap.GetElementType() does
+typedef std::map<double, UInt8> BenchElements;
+static std::map<ArrayID, BenchElements> s_arrays;
+
+static UInt8 GetElementType(ArrayID arr, double key)
+{
+	std::map<ArrayID, BenchElements>::iterator arrIter = s_arrays.find(arr);
+	if (arrIter == s_arrays.end())
+		return kDataType_Invalid;
+	BenchElements::iterator elemIter = arrIter->second.find(key);
+	return elemIter != arrIter->second.end() ? elemIter->second : kDataType_Invalid;
+}
+
+// stands in for ScriptToken and ArrayElementToken: the same virtual CanConvertTo() the rule scan calls
+struct BenchOperand
+{
+	Token_Type	type;
+
+	BenchOperand(Token_Type _type) : type(_type) { }
+	virtual ~BenchOperand() { }
+	virtual bool CanConvertTo(Token_Type to) const { return CanConvertOperand(type, to); }
+};
+
+struct BenchElementOperand : public BenchOperand
+{
+	ArrayID	arr;
+	double	key;
+
+	BenchElementOperand(ArrayID _arr, double _key) : BenchOperand(kTokenType_ArrayElement), arr(_arr), key(_key) { }
+	virtual bool CanConvertTo(Token_Type to) const { return CanConvertElement(GetElementType(arr, key), to); }
+};
+
+struct BenchResult
+{
+	UInt8	rule;
+	bool	bSwapOrder;
+
+	bool operator==(const BenchResult& rhs) const { return rule == rhs.rule && bSwapOrder == rhs.bSwapOrder; }
+};
+
+// the loop Operator::Evaluate() ran for every operation before the dispatch table
+static BenchResult ScanRules(Operator* op, const BenchOperand* lhs, const BenchOperand* rhs)
+{
+	for (UInt32 i = 0; i < op->numRules; i++) {
+		OperationRule* rule = &op->rules[i];
+		if (!rule->eval)
+			continue;
+
+		if (op->IsUnary()) {
+			if (lhs->CanConvertTo(rule->lhs))
+				return { (UInt8)i, false };
+		}
+		else if (lhs->CanConvertTo(rule->lhs) && rhs->CanConvertTo(rule->rhs))
+			return { (UInt8)i, false };
+		else if (!rule->bAsymmetric && rhs->CanConvertTo(rule->lhs) && lhs->CanConvertTo(rule->rhs))
+			return { (UInt8)i, true };
+	}
+	return { OperatorDispatch::kRule_None, false };
+}
+
+// what Operator::Evaluate() does now, classifying the operands as GetOperandClass() does
+static UInt32 GetOperandClass(const BenchOperand* operand)
+{
+	if (operand->type == kTokenType_ArrayElement) {
+		const BenchElementOperand* element = static_cast<const BenchElementOperand*>(operand);
+		return kOperandClass_Element + GetElementType(element->arr, element->key);
+	}
+	return operand->type < kTokenType_Max ? (UInt32)operand->type : (UInt32)kOperandClass_None;
+}
+
+static BenchResult LookupRule(Operator* op, const BenchOperand* lhs, const BenchOperand* rhs)
+{
+	const OperatorDispatch& dispatch = OperatorDispatch::Get(op->type, GetOperandClass(lhs), op->IsUnary() ? 0 : GetOperandClass(rhs));
+	return { dispatch.rule, dispatch.bSwapOrder };
+}
+
+struct BenchOperation
+{
+	OperatorType		op;
+	const BenchOperand*	lhs;
+	const BenchOperand*	rhs;
+};
+
+template <typename Resolve>
+static double TimeOperations(const std::vector<BenchOperation>& operations, UInt32 iterations, Resolve resolve)
+{
+	UInt32 sum = 0;
+	Clock::time_point start = Clock::now();
+	for (UInt32 i = 0; i < iterations; i++) {
+		const BenchOperation& operation = operations[i % operations.size()];
+		BenchResult result = resolve(&s_operators[operation.op], operation.lhs, operation.rhs);
+		sum += result.rule + result.bSwapOrder;
+	}
+	s_sink = sum;
+	return ElapsedNs(start) / iterations;
+}
+
+static bool BenchOperations(const char* name, const std::vector<BenchOperation>& operations, UInt32 iterations)
+{
+	// both have to pick the same rule for every operation
+	bool ok = true;
+	for (const BenchOperation& operation : operations) {
+		Operator* op = &s_operators[operation.op];
+		if (!(ScanRules(op, operation.lhs, operation.rhs) == LookupRule(op, operation.lhs, operation.rhs))) {
+			printf("  %s: rules differ for '%s' (%u, %u)\n", name, op->symbol, operation.lhs->type, operation.rhs ? operation.rhs->type : 0);
+			ok = false;
+		}
+	}
+
+	double scanNs = TimeOperations(operations, iterations, ScanRules);
+	double tableNs = TimeOperations(operations, iterations, LookupRule);
+	printf("%-16s %3u operations %8.1f ns scan %8.1f ns table %6.1fx%s\n", name, (UInt32)operations.size(),
+		scanNs, tableNs, scanNs / tableNs, ok ? "" : "  MISMATCH");
+	return ok;
+}
+
+static bool BenchOperators(UInt32 iterations)
+{
+	OperatorDispatch::Init(s_operators);
+
+	s_arrays[1][0.0] = kDataType_Numeric;
+	s_arrays[1][1.0] = kDataType_String;
+	s_arrays[1][2.0] = kDataType_Form;
+	s_arrays[1][3.0] = kDataType_Array;
+	for (UInt32 i = 4; i < 64; i++)
+		s_arrays[1][i] = kDataType_Numeric;
+	for (ArrayID arr = 2; arr < 256; arr++)
+		s_arrays[arr][0.0] = kDataType_Numeric;
+
+	BenchOperand number(kTokenType_Number), numericVar(kTokenType_NumericVar), global(kTokenType_Global);
+	BenchOperand string(kTokenType_String), stringVar(kTokenType_StringVar), form(kTokenType_Form), refVar(kTokenType_RefVar);
+	BenchElementOperand numElem(1, 0.0), strElem(1, 1.0), formElem(1, 2.0), arrElem(1, 3.0);
+
+	static const OperatorType kArithmetic[] =
+	{
+		kOpType_Add, kOpType_Subtract, kOpType_Multiply, kOpType_Divide, kOpType_Modulo, kOpType_Exponent,
+		kOpType_Equals, kOpType_LessThan, kOpType_GreaterOrEqual, kOpType_LogicalAnd, kOpType_BitwiseOr,
+	};
+	const BenchOperand* numerics[] = { &number, &numericVar, &global };
+
+	std::vector<BenchOperation> arithmetic;
+	for (OperatorType op : kArithmetic) {
+		for (const BenchOperand* lhs : numerics) {
+			for (const BenchOperand* rhs : numerics)
+				arithmetic.push_back({ op, lhs, rhs });
+		}
+	}
+	arithmetic.push_back({ kOpType_Negation, &numericVar, NULL });
+	arithmetic.push_back({ kOpType_LogicalNot, &global, NULL });
+
+	std::vector<BenchOperation> strings =
+	{
+		{ kOpType_Add, &string, &stringVar },
+		{ kOpType_Add, &stringVar, &stringVar },
+		{ kOpType_Equals, &stringVar, &string },
+		{ kOpType_NotEqual, &string, &stringVar },
+		{ kOpType_LessThan, &stringVar, &string },
+		{ kOpType_PlusEquals, &stringVar, &string },
+		{ kOpType_ToString, &numericVar, NULL },
+		{ kOpType_ToString, &refVar, NULL },
+		{ kOpType_ToNumber, &stringVar, NULL },
+		{ kOpType_Equals, &form, &refVar },
+	};
+
+	std::vector<BenchOperation> elements =
+	{
+		{ kOpType_Add, &numElem, &number },
+		{ kOpType_Multiply, &numericVar, &numElem },
+		{ kOpType_Equals, &numElem, &numElem },
+		{ kOpType_Add, &strElem, &stringVar },
+		{ kOpType_Equals, &string, &strElem },
+		{ kOpType_Equals, &formElem, &refVar },
+		{ kOpType_Assignment, &numElem, &number },
+		{ kOpType_PlusEquals, &strElem, &string },
+		{ kOpType_ToString, &numElem, NULL },
+		{ kOpType_LeftBracket, &arrElem, &number },
+	};
+
+	bool ok = true;
+	printf("operators: resolving the rule for each operation, %u operations per run\n", iterations);
+	ok &= BenchOperations("arithmetic", arithmetic, iterations);
+	ok &= BenchOperations("string", strings, iterations);
+	ok &= BenchOperations("array element", elements, iterations);
+	return ok;
+}
+
+/*************************************************
+	eventlist
+*************************************************/
+
+// laid out like ScriptEventList's var list
+struct BenchEventList
+{
+	struct VarEntry;
+
+	struct Var
+	{
+		UInt32		id;
+		VarEntry	* nextEntry;
+		double		data;
+	};
+
+	struct VarEntry
+	{
+		Var			* var;
+		VarEntry	* next;
+	};
+
+	VarEntry	* m_vars;
+
+	enum { kMaxUnindexedVars = 8 };
+
+	std::vector<Var>		vars;
+	std::vector<VarEntry>	entries;
+
+	// variables are numbered from firstID, the game adds them to the front of the list as it reads them
+	void Fill(UInt32 numVars, UInt32 firstID)
+	{
+		vars.resize(numVars);
+		entries.resize(numVars);
+		m_vars = NULL;
+		for (UInt32 i = 0; i < numVars; i++) {
+			vars[i].id = firstID + i;
+			vars[i].data = i;
+			entries[i].var = &vars[i];
+			entries[i].next = m_vars;
+			m_vars = &entries[i];
+		}
+	}
+
+	// what ScriptEventList::GetVariable() did before the index
+	Var* Walk(UInt32 id)
+	{
+		for (VarEntry* entry = m_vars; entry; entry = entry->next)
+			if (entry->var && entry->var->id == id)
+				return entry->var;
+		return NULL;
+	}
+};
+
+typedef EventListVarIndexes<BenchEventList> BenchVarIndexes;
+
+// the index has to follow variables added at either end of the list, and a list destroyed and allocated again at
+// the same address must not return the variables the index saw before
+static bool CheckListChanges()
+{
+	BenchVarIndexes indexes;
+	BenchEventList list;
+	list.Fill(100, 1);
+	bool ok = indexes.Lookup(&list, 50) == list.Walk(50);
+	ok &= indexes.Lookup(&list, 500) == NULL;
+
+	// a variable added at the front
+	BenchEventList::Var headVar = { 500, NULL, 0 };
+	BenchEventList::VarEntry headEntry = { &headVar, list.m_vars };
+	list.m_vars = &headEntry;
+	ok &= indexes.Lookup(&list, 500) == &headVar;
+
+	// a variable linked after the last entry
+	BenchEventList::Var tailVar = { 600, NULL, 0 };
+	BenchEventList::VarEntry tailEntry = { &tailVar, NULL };
+	list.entries[0].next = &tailEntry;
+	ok &= indexes.Lookup(&list, 600) == &tailVar;
+
+	// destroyed, then allocated again with other variables
+	indexes.Remove(&list);
+	for (UInt32 i = 0; i < list.vars.size(); i++)
+		list.vars[i].id = 1000 + i;
+	list.m_vars = &list.entries.back();
+	list.entries[0].next = NULL;
+	ok &= indexes.Lookup(&list, 50) == NULL;
+	ok &= indexes.Lookup(&list, 1050) == list.Walk(1050);
+	ok &= indexes.Size() == 1;
+
+	if (!ok)
+		printf("  stale variable returned for a changed list\n");
+	return ok;
+}
+
+static bool BenchEventListSize(UInt32 numVars, UInt32 iterations)
+{
+	// a few hundred quest scripts, each with the same number of variables
+	const UInt32 kNumLists = 256;
+	std::vector<BenchEventList> lists(kNumLists);
+	for (BenchEventList& list : lists)
+		list.Fill(numVars, 1);
+
+	std::mt19937 rng(numVars);
+	std::vector<std::pair<UInt32, UInt32>> lookups(4096);
+	for (std::pair<UInt32, UInt32>& lookup : lookups)
+		lookup = std::make_pair(rng() % kNumLists, 1 + rng() % numVars);
+
+	BenchVarIndexes indexes;
+	bool ok = true;
+	for (const std::pair<UInt32, UInt32>& lookup : lookups) {
+		BenchEventList& list = lists[lookup.first];
+		ok &= indexes.Lookup(&list, lookup.second) == list.Walk(lookup.second);
+	}
+
+	UInt32 sum = 0;
+	Clock::time_point start = Clock::now();
+	for (UInt32 i = 0; i < iterations; i++) {
+		const std::pair<UInt32, UInt32>& lookup = lookups[i % lookups.size()];
+		sum += lists[lookup.first].Walk(lookup.second)->id;
+	}
+	double walkNs = ElapsedNs(start) / iterations;
+
+	start = Clock::now();
+	for (UInt32 i = 0; i < iterations; i++) {
+		const std::pair<UInt32, UInt32>& lookup = lookups[i % lookups.size()];
+		sum += indexes.Lookup(&lists[lookup.first], lookup.second)->id;
+	}
+	double indexNs = ElapsedNs(start) / iterations;
+	s_sink = sum;
+
+	printf("%6u vars %8.1f ns walk %8.1f ns index %6.1fx%s\n", numVars, walkNs, indexNs, walkNs / indexNs, ok ? "" : "  MISMATCH");
+	return ok;
+}
+
+static bool BenchEventLists(UInt32 iterations)
+{
+	printf("eventlist: random variable lookups across 256 lists, %u lookups per run\n", iterations);
+	bool ok = CheckListChanges();
+	for (UInt32 numVars : { 10, 25, 50, 100, 250, 500 })
+		ok &= BenchEventListSize(numVars, iterations);
+	return ok;
+}
+
+/*************************************************
+	packedarray
+*************************************************/
+
+// ArrayVar needs the game, so this runs the operations ArrayVar and ArrayVarMap perform on packed arrays over both
+// storage layouts with a stand-in for the 16 byte ArrayElement. Map keys are laid out like ArrayKey.
+struct BenchElement
+{
+	double	num;
+	UInt8	dataType;
+	UInt8	strLen;
+	ArrayID	owningArray;
+};
+
+struct BenchKey
+{
+	struct {
+		double		num;
+		std::string	str;
+	}		key;
+	UInt8	keyType;
+	UInt32	hash;
+
+	BenchKey(double num) : keyType(kDataType_Numeric), hash(0) { key.num = num; }
+
+	bool operator<(const BenchKey& rhs) const { return key.num < rhs.key.num; }
+};
+
+// packed arrays before: every key 0..n-1 in a std::map, shifting copies elements one key at a time
+class BenchMapStorage
+{
+	std::map<BenchKey, BenchElement>	m_elements;
+
+	void Set(UInt32 idx, const BenchElement& elem) { *Get(idx, true) = elem; }
+
+	// ArrayVar::Pack(), closes the hole EraseElements() left
+	void Pack()
+	{
+		double curIdx = 0;
+		for (std::map<BenchKey, BenchElement>::iterator iter = m_elements.begin(); iter != m_elements.end(); curIdx += 1) {
+			if (iter->first.key.num != curIdx) {
+				*Get(curIdx, true) = iter->second;
+				iter = m_elements.erase(iter);
+			}
+			else
+				++iter;
+		}
+	}
+
+public:
+	UInt32 Size() const { return m_elements.size(); }
+
+	BenchElement* Get(UInt32 idx, bool bCanCreateNew)
+	{
+		std::map<BenchKey, BenchElement>::iterator it = m_elements.find(BenchKey(idx));
+		if (it != m_elements.end())
+			return &it->second;
+		if (bCanCreateNew && idx <= Size())
+			return &m_elements[BenchKey(idx)];
+		return NULL;
+	}
+
+	// ArrayVarMap::Insert()
+	void Insert(UInt32 atIndex, const BenchElement& toInsert)
+	{
+		if (atIndex < Size()) {
+			for (SInt32 i = Size(); i >= (SInt32)atIndex; i--)
+				Set(i, i > 0 ? *Get(i - 1, false) : BenchElement());
+		}
+		Set(atIndex, toInsert);
+	}
+
+	// ArrayVarMap::EraseElements(), [lo, hi]
+	void Erase(UInt32 lo, UInt32 hi)
+	{
+		std::map<BenchKey, BenchElement>::iterator iter = m_elements.begin();
+		while (iter != m_elements.end() && iter->first.key.num < lo)
+			++iter;
+		while (iter != m_elements.end() && iter->first.key.num <= hi)
+			iter = m_elements.erase(iter);
+		Pack();
+	}
+};
+
+// packed arrays now: element i in slot i of a vector
+class BenchVectorStorage
+{
+	std::vector<BenchElement>	m_elements;
+
+public:
+	UInt32 Size() const { return m_elements.size(); }
+
+	BenchElement* Get(UInt32 idx, bool bCanCreateNew)
+	{
+		if (idx < Size())
+			return &m_elements[idx];
+		if (bCanCreateNew && idx == Size()) {
+			m_elements.insert(m_elements.end(), 1, BenchElement());
+			return &m_elements[idx];
+		}
+		return NULL;
+	}
+
+	void Insert(UInt32 atIndex, const BenchElement& toInsert)
+	{
+		m_elements.insert(m_elements.begin() + atIndex, 1, BenchElement());
+		m_elements[atIndex] = toInsert;
+	}
+
+	void Erase(UInt32 lo, UInt32 hi)
+	{
+		m_elements.erase(m_elements.begin() + lo, m_elements.begin() + hi + 1);
+	}
+};
+
+static BenchElement MakeElement(UInt32 i)
+{
+	BenchElement elem = BenchElement();
+	elem.num = i;
+	elem.dataType = kDataType_Numeric;
+	elem.owningArray = 1;
+	return elem;
+}
+
+template <typename Storage>
+static void Fill(Storage& storage, UInt32 size)
+{
+	for (UInt32 i = 0; i < size; i++)
+		*storage.Get(storage.Size(), true) = MakeElement(i);
+}
+
+// elements must end up in the same order either way
+template <typename Storage>
+static UInt64 Checksum(Storage& storage)
+{
+	UInt64 sum = storage.Size();
+	for (UInt32 i = 0; i < storage.Size(); i++)
+		sum = sum * 31 + (UInt64)storage.Get(i, false)->num;
+	return sum;
+}
+
+struct BenchArrayTimes
+{
+	double	append;		// ns per element
+	double	index;		// ns per lookup
+	double	insert;		// ns per insert at the front
+	double	erase;		// ns per erased range
+	UInt64	checksum;
+};
+
+template <typename Storage>
+static BenchArrayTimes TimeArray(UInt32 size, UInt32 iterations)
+{
+	BenchArrayTimes times;
+
+	// append: build arrays of size elements one element at a time
+	UInt32 numArrays = std::max<UInt32>(iterations / size / 4, 1);
+	Clock::time_point start = Clock::now();
+	for (UInt32 i = 0; i < numArrays; i++) {
+		Storage storage;
+		Fill(storage, size);
+		s_sink = storage.Size();
+	}
+	times.append = ElapsedNs(start) / (numArrays * size);
+
+	Storage storage;
+	Fill(storage, size);
+
+	std::mt19937 rng(size);
+	std::vector<UInt32> indexes(4096);
+	for (UInt32& idx : indexes)
+		idx = rng() % size;
+
+	double sum = 0;
+	start = Clock::now();
+	for (UInt32 i = 0; i < iterations; i++)
+		sum += storage.Get(indexes[i % indexes.size()], false)->num;
+	times.index = ElapsedNs(start) / iterations;
+	s_sink = (UInt32)sum;
+
+	// rounds of inserting at the front and erasing as many elements from the middle in one range, so the array
+	// stays at size elements. The old storage shifts every element on both, so the number of rounds comes down
+	// with the size of the array
+	UInt32 numInserts = std::min<UInt32>(std::max<UInt32>(size / 8, 1), 64);
+	UInt32 numRounds = std::max<UInt32>(iterations / size / numInserts, 1);
+	double insertNs = 0, eraseNs = 0;
+	for (UInt32 i = 0; i < numRounds; i++) {
+		start = Clock::now();
+		for (UInt32 j = 0; j < numInserts; j++)
+			storage.Insert(0, MakeElement(size + i * numInserts + j));
+		insertNs += ElapsedNs(start);
+
+		start = Clock::now();
+		storage.Erase(size / 4, size / 4 + numInserts - 1);
+		eraseNs += ElapsedNs(start);
+	}
+	times.insert = insertNs / (numRounds * numInserts);
+	times.erase = eraseNs / numRounds;
+
+	times.checksum = Checksum(storage);
+	return times;
+}
+
+static bool BenchArraySize(UInt32 size, UInt32 iterations)
+{
+	BenchArrayTimes map = TimeArray<BenchMapStorage>(size, iterations);
+	BenchArrayTimes vec = TimeArray<BenchVectorStorage>(size, iterations);
+	bool ok = map.checksum == vec.checksum;
+
+	printf("%6u elements%s\n", size, ok ? "" : "  MISMATCH");
+	printf("        %-16s %10.1f ns map %10.1f ns vector %8.1fx\n", "append", map.append, vec.append, map.append / vec.append);
+	printf("        %-16s %10.1f ns map %10.1f ns vector %8.1fx\n", "random index", map.index, vec.index, map.index / vec.index);
+	printf("        %-16s %10.1f ns map %10.1f ns vector %8.1fx\n", "insert at front", map.insert, vec.insert, map.insert / vec.insert);
+	printf("        %-16s %10.1f ns map %10.1f ns vector %8.1fx\n", "erase range", map.erase, vec.erase, map.erase / vec.erase);
+	return ok;
+}
+
+static bool BenchPackedArrays(UInt32 iterations)
+{
+	printf("packedarray: per operation on packed arrays, %u lookups per run\n", iterations);
+	bool ok = true;
+	for (UInt32 size : { 10, 100, 1000, 10000 })
+		ok &= BenchArraySize(size, iterations);
+	return ok;
+}
+
+/*************************************************
+	varmap
+*************************************************/
+
+// a string var, as StringVarMap stores them
+struct BenchVar
+{
+	std::string	data;
+	UInt32		owningModIndex;
+
+	BenchVar(const char* _data, UInt32 modIndex) : data(_data), owningModIndex(modIndex) { }
+};
+
+// Add() and Clean() as StringVarMap implements them on each map
+class BenchVarMap : public VarMap<BenchVar>
+{
+public:
+	UInt32 Add(const char* data, bool bTemp)
+	{
+		UInt32 varID = GetUnusedID();
+		BenchVar* var = new (AllocateVar()) BenchVar(data, 0);
+		if (bTemp)
+			InsertTemporary(varID, var);
+		else
+			Insert(varID, var);
+		return varID;
+	}
+
+	UInt32 NumLive()
+	{
+		CollectStats stats;
+		GetCollectStats(stats);
+		return stats.numLive;
+	}
+};
+
+class BenchBaselineVarMap : public BaselineVarMap<BenchVar>
+{
+public:
+	UInt32 Add(const char* data, bool bTemp)
+	{
+		UInt32 varID = GetUnusedID();
+		Insert(varID, new BenchVar(data, 0));
+		if (bTemp)
+			MarkTemporary(varID, true);
+		return varID;
+	}
+
+	void Clean()
+	{
+		while (m_state->tempVars.size())
+			Delete(*m_state->tempVars.begin());
+	}
+
+	UInt32 NumLive() { return m_state->vars.size(); }
+};
+
+struct BenchVarMapTimes
+{
+	double	create;		// ns per var
+	double	get;		// ns per lookup
+	double	temp;		// ns per temporary var, created and collected
+	double	reuse;		// ns per var deleted and replaced
+	UInt32	numLive;
+	UInt32	idHash;		// of the IDs handed out, which depend on the order freed IDs are reused in
+	bool	ok;
+};
+
+template <typename Map>
+static BenchVarMapTimes TimeVarMap(UInt32 numVars, UInt32 iterations)
+{
+	BenchVarMapTimes times;
+	Map map;
+	std::vector<UInt32> ids(numVars);
+
+	Clock::time_point start = Clock::now();
+	for (UInt32 i = 0; i < numVars; i++)
+		ids[i] = map.Add("live", false);
+	times.create = ElapsedNs(start) / numVars;
+
+	std::mt19937 rng(numVars);
+	std::vector<UInt32> lookups(4096);
+	for (UInt32& id : lookups)
+		id = ids[rng() % numVars];
+
+	UInt32 sum = 0;
+	start = Clock::now();
+	for (UInt32 i = 0; i < iterations; i++)
+		sum += map.Get(lookups[i % lookups.size()])->data.size();
+	times.get = ElapsedNs(start) / iterations;
+	s_sink = sum;
+	times.ok = sum == iterations * 4;
+
+	// a script loop creating temporary strings, collected at the end of each frame
+	const UInt32 kTempsPerFrame = 1000;
+	UInt32 numFrames = std::max<UInt32>(iterations / kTempsPerFrame / 4, 1);
+	start = Clock::now();
+	for (UInt32 frame = 0; frame < numFrames; frame++) {
+		for (UInt32 i = 0; i < kTempsPerFrame; i++)
+			map.Add("temp", true);
+		map.Clean();
+	}
+	times.temp = ElapsedNs(start) / (numFrames * kTempsPerFrame);
+
+	// delete live vars at random and create new ones in their place
+	UInt32 numReused = std::min<UInt32>(iterations / 4, numVars);
+	start = Clock::now();
+	for (UInt32 i = 0; i < numReused; i++) {
+		UInt32& id = ids[rng() % numVars];
+		map.Delete(id);
+		id = map.Add("live", false);
+	}
+	times.reuse = ElapsedNs(start) / numReused;
+
+	// several IDs freed before any is reused
+	times.idHash = 0;
+	for (UInt32 i = 0; i < 1000; i++) {
+		UInt32 slots[8];
+		for (UInt32 j = 0; j < 8; j++) {
+			slots[j] = (rng() % (numVars / 8)) * 8 + j;		// distinct
+			map.Delete(ids[slots[j]]);
+		}
+		for (UInt32 slot : slots) {
+			ids[slot] = map.Add("live", false);
+			times.idHash = times.idHash * 31 + ids[slot];
+		}
+	}
+
+	times.numLive = map.NumLive();
+	for (UInt32 id : ids)
+		times.ok &= map.Get(id) && map.Get(id)->data == "live";
+	return times;
+}
+
+static bool BenchVarMaps(UInt32 iterations)
+{
+	const UInt32 kNumVars = 100000;
+	BenchVarMapTimes baseline = TimeVarMap<BenchBaselineVarMap>(kNumVars, iterations);
+	BenchVarMapTimes current = TimeVarMap<BenchVarMap>(kNumVars, iterations);
+	bool ok = baseline.ok && current.ok && baseline.numLive == kNumVars && current.numLive == kNumVars;
+	ok &= baseline.idHash == current.idHash;		// both reuse the smallest free ID first
+
+	printf("varmap: %u live vars, %u lookups per run%s\n", kNumVars, iterations, ok ? "" : "  MISMATCH");
+	printf("        %-16s %10.1f ns std::map %10.1f ns table %8.1fx\n", "create", baseline.create, current.create, baseline.create / current.create);
+	printf("        %-16s %10.1f ns std::map %10.1f ns table %8.1fx\n", "random get", baseline.get, current.get, baseline.get / current.get);
+	printf("        %-16s %10.1f ns std::map %10.1f ns table %8.1fx\n", "temp + collect", baseline.temp, current.temp, baseline.temp / current.temp);
+	printf("        %-16s %10.1f ns std::map %10.1f ns table %8.1fx\n", "delete + reuse", baseline.reuse, current.reuse, baseline.reuse / current.reuse);
+	return ok;
+}
+
+/*************************************************
+	cosave
+*************************************************/
+
+// the calls a save made, replayed into each writer so they write the same thing
+class RecordedSave : public CoSaveSink
+{
+	enum
+	{
+		kCall_Begin,
+		kCall_BeginPlugin,
+		kCall_OpenRecord,
+		kCall_WriteRecordData,
+		kCall_EndPlugin,
+		kCall_Finish,
+	};
+
+	struct Call
+	{
+		UInt32	type;
+		UInt32	arg0;	// opcode base, record type or offset of the data
+		UInt32	arg1;	// record version or length of the data
+	};
+
+	std::vector<Call>	m_calls;
+	std::vector<UInt8>	m_data;
+	Header				m_header;
+
+	void Add(UInt32 type, UInt32 arg0 = 0, UInt32 arg1 = 0)
+	{
+		Call call = { type, arg0, arg1 };
+		m_calls.push_back(call);
+	}
+
+public:
+	virtual void	Begin(const Header& header)				{ m_header = header; Add(kCall_Begin); }
+	virtual void	BeginPlugin(UInt32 opcodeBase)			{ Add(kCall_BeginPlugin, opcodeBase); }
+	virtual void	OpenRecord(UInt32 type, UInt32 version)	{ Add(kCall_OpenRecord, type, version); }
+	virtual void	EndPlugin()								{ Add(kCall_EndPlugin); }
+	virtual void	Finish()								{ Add(kCall_Finish); }
+
+	virtual void WriteRecordData(const void* data, UInt32 length)
+	{
+		Add(kCall_WriteRecordData, m_data.size(), length);
+		m_data.insert(m_data.end(), (const UInt8*)data, (const UInt8*)data + length);
+	}
+
+	UInt32 NumWrites() const
+	{
+		UInt32 numWrites = 0;
+		for (const Call& call : m_calls)
+			numWrites += call.type == kCall_WriteRecordData;
+		return numWrites;
+	}
+
+	void Replay(CoSaveSink& sink) const
+	{
+		for (const Call& call : m_calls) {
+			switch (call.type) {
+				case kCall_Begin:			sink.Begin(m_header); break;
+				case kCall_BeginPlugin:		sink.BeginPlugin(call.arg0); break;
+				case kCall_OpenRecord:		sink.OpenRecord(call.arg0, call.arg1); break;
+				case kCall_WriteRecordData:	sink.WriteRecordData(&m_data[call.arg0], call.arg1); break;
+				case kCall_EndPlugin:		sink.EndPlugin(); break;
+				case kCall_Finish:			sink.Finish(); break;
+			}
+		}
+	}
+};
+
+// an unbuffered file, as IFileStream is: every read, write and seek is a call into the OS
+static FILE* OpenBenchFile()
+{
+	FILE* file = tmpfile();
+	if (file)
+		setvbuf(file, NULL, _IONBF, 0);
+	return file;
+}
+
+static long FileOffset(FILE* file) { return ftell(file); }
+
+// writes the way Serialization did before plugin blocks were buffered: WriteRecordData() went straight to the file
+// and each chunk and plugin header was patched by seeking back to it
+class UnbufferedCoSaveWriter : public CoSaveSink
+{
+	FILE*			m_file;
+	Header			m_header;
+	PluginHeader	m_pluginHeader;
+	ChunkHeader		m_chunkHeader;
+	long			m_pluginHeaderOffset;
+	long			m_chunkHeaderOffset;
+	bool			m_chunkOpen;
+
+	void FlushWriteChunk()
+	{
+		if (!m_chunkOpen)
+			return;
+
+		long curOffset = FileOffset(m_file);
+		m_chunkHeader.length = curOffset - m_chunkHeaderOffset - sizeof(m_chunkHeader);
+		fseek(m_file, m_chunkHeaderOffset, SEEK_SET);
+		fwrite(&m_chunkHeader, sizeof(m_chunkHeader), 1, m_file);
+		fseek(m_file, curOffset, SEEK_SET);
+
+		m_pluginHeader.length += m_chunkHeader.length + sizeof(m_chunkHeader);
+		m_chunkOpen = false;
+	}
+
+public:
+	UnbufferedCoSaveWriter(FILE* file) : m_file(file), m_chunkOpen(false) { }
+
+	virtual void Begin(const Header& header)
+	{
+		m_header = header;
+		m_header.numPlugins = 0;
+		fseek(m_file, sizeof(m_header), SEEK_SET);
+	}
+
+	virtual void BeginPlugin(UInt32 opcodeBase)
+	{
+		m_pluginHeader.opcodeBase = opcodeBase;
+		m_pluginHeader.numChunks = 0;
+		m_pluginHeader.length = 0;
+		m_chunkOpen = false;
+	}
+
+	virtual void OpenRecord(UInt32 type, UInt32 version)
+	{
+		if (!m_pluginHeader.numChunks) {
+			m_pluginHeaderOffset = FileOffset(m_file);
+			fseek(m_file, sizeof(m_pluginHeader), SEEK_CUR);
+		}
+
+		FlushWriteChunk();
+
+		m_chunkHeaderOffset = FileOffset(m_file);
+		fseek(m_file, sizeof(m_chunkHeader), SEEK_CUR);
+
+		m_pluginHeader.numChunks++;
+		m_chunkHeader.type = type;
+		m_chunkHeader.version = version;
+		m_chunkHeader.length = 0;
+		m_chunkOpen = true;
+	}
+
+	virtual void WriteRecordData(const void* data, UInt32 length)
+	{
+		fwrite(data, 1, length, m_file);
+	}
+
+	virtual void EndPlugin()
+	{
+		FlushWriteChunk();
+		if (m_pluginHeader.numChunks) {
+			long curOffset = FileOffset(m_file);
+			fseek(m_file, m_pluginHeaderOffset, SEEK_SET);
+			fwrite(&m_pluginHeader, sizeof(m_pluginHeader), 1, m_file);
+			fseek(m_file, curOffset, SEEK_SET);
+			m_header.numPlugins++;
+		}
+	}
+
+	virtual void Finish()
+	{
+		fseek(m_file, 0, SEEK_SET);
+		fwrite(&m_header, sizeof(m_header), 1, m_file);
+	}
+};
+
+// what Serialization does now: the image is built in memory and written with one call
+class BufferedCoSaveWriter : public CoSaveSink
+{
+	FILE*			m_file;
+	CoSaveBuilder	m_builder;
+
+public:
+	BufferedCoSaveWriter(FILE* file) : m_file(file) { }
+
+	virtual void	Begin(const Header& header)						{ m_builder.Begin(header); }
+	virtual void	BeginPlugin(UInt32 opcodeBase)					{ m_builder.BeginPlugin(opcodeBase); }
+	virtual void	OpenRecord(UInt32 type, UInt32 version)			{ m_builder.OpenRecord(type, version); }
+	virtual void	WriteRecordData(const void* data, UInt32 length)	{ m_builder.WriteRecordData(data, length); }
+	virtual void	EndPlugin()										{ m_builder.EndPlugin(); }
+
+	virtual void Finish()
+	{
+		m_builder.Finish();
+		fwrite(m_builder.Data(), 1, m_builder.Size(), m_file);
+		m_builder.Clear();
+	}
+};
+
+static bool ReadBenchFile(FILE* file, std::vector<UInt8>& out)
+{
+	fseek(file, 0, SEEK_END);
+	out.resize(FileOffset(file));
+	fseek(file, 0, SEEK_SET);
+	return out.empty() || fread(&out[0], 1, out.size(), file) == out.size();
+}
+
+struct BenchCoSaveContents
+{
+	UInt32	numPlugins;
+	UInt32	numStringVars;
+	UInt32	numArrays;
+	UInt32	numElements;
+	UInt32	numBadRecords;
+	bool	bArraysMatch;	// v2 array records encode back to the same bytes
+};
+
+// what a load does with the file: expand it, walk the plugin blocks and decode OBSE's records
+static bool LoadBenchCoSave(std::vector<UInt8>& file, BenchCoSaveContents& contents, bool bRewriteArrays)
+{
+	memset(&contents, 0, sizeof(contents));
+	contents.bArraysMatch = true;
+
+	LoadBuffer buffer;
+	if (!buffer.Assign(file))
+		return false;
+
+	Header header;
+	if (buffer.ReadBuf(&header, sizeof(header)) != sizeof(header))
+		return false;
+
+	std::vector<SavedString> strings;
+	std::vector<SavedElement> elements;
+	SaveStringTable table;
+	std::vector<UInt8> rewritten;
+	while (buffer.GetRemain() >= sizeof(PluginHeader)) {
+		PluginHeader plugin;
+		buffer.ReadBuf(&plugin, sizeof(plugin));
+		contents.numPlugins++;
+
+		for (UInt32 i = 0; i < plugin.numChunks; i++) {
+			ChunkHeader chunk;
+			const UInt8* data = NULL;
+			if (buffer.ReadBuf(&chunk, sizeof(chunk)) == sizeof(chunk))
+				data = buffer.ReadSpan(chunk.length);
+			if (!data)
+				return false;
+			if (plugin.opcodeBase != kObseOpcodeBase)
+				continue;
+
+			RecordCursor record(data, chunk.length);
+			SavedStringVar var;
+			SavedArrayHeader arrayHeader;
+			switch (chunk.type) {
+				case 'STVR':
+					contents.numBadRecords += !ReadStringVarRecord(record, var);
+					contents.numStringVars++;
+					break;
+				case 'ARVT':
+					contents.numBadRecords += !ReadStringTable(record, strings);
+					break;
+				case 'ARVR':
+					elements.clear();
+					if (!ReadArrayHeader(record, chunk.version, arrayHeader) ||
+						!ReadArrayElements(record, chunk.version, arrayHeader, strings, elements))
+						contents.numBadRecords++;
+					contents.numArrays++;
+					contents.numElements += elements.size();
+
+					if (bRewriteArrays && chunk.version >= 2) {
+						rewritten.clear();
+						WriteArrayRecord(rewritten, arrayHeader, elements.data(), elements.size(), table);
+						contents.bArraysMatch &= rewritten.size() == chunk.length && !memcmp(rewritten.data(), data, chunk.length);
+					}
+					break;
+			}
+		}
+	}
+
+	return contents.numPlugins == header.numPlugins && !buffer.GetRemain();
+}
+
+struct BenchCoSaveTimes
+{
+	double	unbufferedSave;		// ms per save
+	double	bufferedSave;
+	double	load;
+	UInt32	size;
+	bool	ok;
+};
+
+static BenchCoSaveTimes TimeCoSave(const SyntheticCoSave& params, UInt32 numRuns)
+{
+	BenchCoSaveTimes times = { 0, 0, 0, 0, false };
+	RecordedSave save;
+	WriteSyntheticCoSave(params, save);
+
+	std::vector<UInt8> expected;
+	BuildSyntheticCoSave(params, expected);
+	times.size = expected.size();
+
+	std::vector<UInt8> unbuffered, buffered;
+	times.ok = true;
+	for (UInt32 run = 0; run < numRuns; run++) {
+		FILE* file = OpenBenchFile();
+		if (!file)
+			return times;
+		UnbufferedCoSaveWriter unbufferedWriter(file);
+		Clock::time_point start = Clock::now();
+		save.Replay(unbufferedWriter);
+		times.unbufferedSave += ElapsedNs(start);
+		times.ok &= ReadBenchFile(file, unbuffered) && unbuffered == expected;
+		fclose(file);
+
+		file = OpenBenchFile();
+		if (!file)
+			return times;
+		BufferedCoSaveWriter bufferedWriter(file);
+		start = Clock::now();
+		save.Replay(bufferedWriter);
+		times.bufferedSave += ElapsedNs(start);
+
+		// loads read the whole file, then decode it from memory. Assign() takes the data, so it's checked in between
+		BenchCoSaveContents contents;
+		start = Clock::now();
+		bool bLoaded = ReadBenchFile(file, buffered);
+		times.load += ElapsedNs(start);
+		fclose(file);
+		times.ok &= buffered == expected;
+
+		start = Clock::now();
+		bLoaded = bLoaded && LoadBenchCoSave(buffered, contents, false);
+		times.load += ElapsedNs(start);
+
+		times.ok &= bLoaded && !contents.numBadRecords;
+		times.ok &= contents.numStringVars == params.numStringVars && contents.numArrays == params.numArrays;
+	}
+
+	// saving what was loaded gives the same array records
+	BenchCoSaveContents contents;
+	std::vector<UInt8> image = expected;
+	times.ok &= LoadBenchCoSave(image, contents, true) && contents.bArraysMatch;
+
+	times.unbufferedSave /= numRuns * 1000000.0;
+	times.bufferedSave /= numRuns * 1000000.0;
+	times.load /= numRuns * 1000000.0;
+	return times;
+}
+
+static bool BenchCoSaves(UInt32 iterations)
+{
+	struct Size
+	{
+		const char*		name;
+		SyntheticCoSave	params;
+	};
+	static const Size kSizes[] =
+	{
+		// mods, string vars, arrays, elements, array version, plugins, plugin bytes, seed
+		{ "small",		{ 8, 40, 60, 12, 2, 1, 2000, 1 } },
+		{ "large",		{ 64, 5000, 5000, 40, 2, 8, 1 << 18, 2 } },
+		{ "large v1",	{ 64, 5000, 5000, 40, 1, 8, 1 << 18, 2 } },	// arrays written an element at a time, as before v2
+	};
+
+	UInt32 numRuns = std::max<UInt32>(iterations / 250000, 1);
+	printf("cosave: saving synthetic co-saves unbuffered vs. a block at a time, then loading them, %u runs\n", numRuns);
+	bool ok = true;
+	for (const Size& size : kSizes) {
+		RecordedSave save;
+		WriteSyntheticCoSave(size.params, save);
+		BenchCoSaveTimes times = TimeCoSave(size.params, numRuns);
+		ok &= times.ok;
+
+		printf("%-10s %9u bytes, %7u record writes%s\n", size.name, times.size, save.NumWrites(), times.ok ? "" : "  MISMATCH");
+		printf("        %-16s %10.3f ms unbuffered %10.3f ms buffered %8.1fx\n", "save", times.unbufferedSave, times.bufferedSave,
+			times.unbufferedSave / times.bufferedSave);
+		printf("        %-16s %10.3f ms (%.1f MB/s)\n", "load", times.load, times.size / (times.load * 1000.0));
+	}
+	return ok;
+}
+
+/*************************************************
+	compression
+*************************************************/
+
+struct BenchCompressionTimes
+{
+	UInt32	rawSize;
+	UInt32	compressedSize;
+	double	compress;			// ms per image
+	double	decompress;
+	double	rawSave;			// ms to write the file, compressing it first if compressed
+	double	compressedSave;
+	double	rawLoad;			// ms to read, expand and decode the file
+	double	compressedLoad;
+	bool	ok;
+};
+
+static double WriteBenchImage(const std::vector<UInt8>& image, FILE* file)
+{
+	Clock::time_point start = Clock::now();
+	fwrite(image.data(), 1, image.size(), file);
+	return ElapsedNs(start);
+}
+
+// reads and loads the file as a load would, returns the time taken
+static double LoadBenchFile(FILE* file, const SyntheticCoSave& params, bool& ok)
+{
+	std::vector<UInt8> data;
+	BenchCoSaveContents contents;
+	Clock::time_point start = Clock::now();
+	bool bLoaded = ReadBenchFile(file, data) && LoadBenchCoSave(data, contents, false);
+	double elapsed = ElapsedNs(start);
+
+	ok &= bLoaded && !contents.numBadRecords && contents.numArrays == params.numArrays;
+	return elapsed;
+}
+
+static BenchCompressionTimes TimeCompression(const SyntheticCoSave& params, UInt32 numRuns)
+{
+	BenchCompressionTimes times;
+	memset(&times, 0, sizeof(times));
+	times.ok = true;
+
+	std::vector<UInt8> raw;
+	BuildSyntheticCoSave(params, raw);
+	times.rawSize = raw.size();
+
+	std::vector<UInt8> image;
+	for (UInt32 run = 0; run < numRuns; run++) {
+		image = raw;
+		Clock::time_point start = Clock::now();
+		CompressCoSaveImage(image);
+		times.compress += ElapsedNs(start);
+		times.compressedSize = image.size();
+
+		std::vector<UInt8> expanded = image;
+		start = Clock::now();
+		bool bExpanded = DecompressCoSaveImage(expanded);
+		times.decompress += ElapsedNs(start);
+		times.ok &= bExpanded && expanded == raw;
+
+		// saves write the image the builder made, compressing it first when compression is on
+		FILE* rawFile = OpenBenchFile();
+		FILE* compressedFile = OpenBenchFile();
+		if (!rawFile || !compressedFile) {
+			times.ok = false;
+			return times;
+		}
+		times.rawSave += WriteBenchImage(raw, rawFile);
+		times.compressedSave += WriteBenchImage(image, compressedFile);
+
+		times.rawLoad += LoadBenchFile(rawFile, params, times.ok);
+		times.compressedLoad += LoadBenchFile(compressedFile, params, times.ok);
+		fclose(rawFile);
+		fclose(compressedFile);
+	}
+
+	times.compressedSave += times.compress;
+	times.compress /= numRuns * 1000000.0;
+	times.decompress /= numRuns * 1000000.0;
+	times.rawSave /= numRuns * 1000000.0;
+	times.compressedSave /= numRuns * 1000000.0;
+	times.rawLoad /= numRuns * 1000000.0;
+	times.compressedLoad /= numRuns * 1000000.0;
+	return times;
+}
+
+static bool BenchCompression(UInt32 iterations)
+{
+	struct Size
+	{
+		const char*		name;
+		SyntheticCoSave	params;
+	};
+	static const Size kSizes[] =
+	{
+		// mods, string vars, arrays, elements, array version, plugins, plugin bytes, seed
+		{ "small",		{ 8, 40, 60, 12, 2, 1, 2000, 1 } },
+		{ "arrays",		{ 64, 5000, 5000, 40, 2, 0, 0, 2 } },
+		{ "arrays v1",	{ 64, 5000, 5000, 40, 1, 0, 0, 2 } },
+		{ "plugins",	{ 8, 40, 60, 12, 2, 16, 1 << 18, 3 } },
+		{ "large",		{ 64, 5000, 5000, 40, 2, 8, 1 << 18, 4 } },
+	};
+
+	// the files stay in the OS cache, so save and load times are the CPU cost. The break-even is the disk speed
+	// below which reading fewer bytes makes up for expanding them
+	UInt32 numRuns = std::max<UInt32>(iterations / 250000, 1);
+	printf("compression: co-save plugin blocks, uncompressed vs. LZ4, %u runs\n", numRuns);
+	bool ok = true;
+	for (const Size& size : kSizes) {
+		BenchCompressionTimes times = TimeCompression(size.params, numRuns);
+		ok &= times.ok;
+
+		printf("%-10s %9u bytes, %9u compressed, ratio %.2f%s\n", size.name, times.rawSize, times.compressedSize,
+			(double)times.rawSize / times.compressedSize, times.ok ? "" : "  MISMATCH");
+		printf("        %-16s %10.3f ms (%.1f MB/s)\n", "compress", times.compress, times.rawSize / (times.compress * 1000.0));
+		printf("        %-16s %10.3f ms (%.1f MB/s)\n", "decompress", times.decompress, times.rawSize / (times.decompress * 1000.0));
+		printf("        %-16s %10.3f ms raw %10.3f ms compressed\n", "save", times.rawSave, times.compressedSave);
+		printf("        %-16s %10.3f ms raw %10.3f ms compressed", "load", times.rawLoad, times.compressedLoad);
+
+		double extraLoad = times.compressedLoad - times.rawLoad;
+		if (extraLoad > 0 && times.compressedSize < times.rawSize)
+			printf(", break-even below %.1f MB/s\n", (times.rawSize - times.compressedSize) / (extraLoad * 1000.0));
+		else
+			printf("\n");
+	}
+	return ok;
+}
+
+/*************************************************
+	eventcallbacks
+*************************************************/
+
+// the filters and flags of an EventCallback
+struct BenchCallback
+{
+	void*	source;
+	void*	object;
+	UInt32	id;
+	UInt8	flags;
+
+	bool IsInUse() const { return flags & 2 ? true : false; }
+	bool IsRemoved() const { return flags & 1 ? true : false; }
+	void SetInUse(bool bSet) { flags = bSet ? flags | 2 : flags & ~2; }
+};
+
+struct BenchCallbackKeys
+{
+	static void* SourceArg(UInt32 eventID, void* arg0, void* arg1) { return arg0; }
+
+	static bool ObjectKey(UInt32 eventID, const BenchCallback& callback, void*& key)
+	{
+		key = callback.object;
+		return true;
+	}
+};
+
+typedef EventCallbackList<BenchCallback, BenchCallbackKeys> BenchCallbackList;
+
+// the filter check HandleEventForCallingObject runs on each callback
+static bool CallbackMatches(const BenchCallback& callback, void* arg0, void* arg1)
+{
+	return (!callback.source || callback.source == arg0) && (!callback.object || callback.object == arg1);
+}
+
+// a checksum of the callbacks an event runs, which depends on their order
+static UInt32 AddMatch(UInt32 sum, const BenchCallback& callback)
+{
+	return sum * 31 + callback.id;
+}
+
+// dispatch before the index, walking every callback of the event
+static UInt32 DispatchByWalk(std::list<BenchCallback>& callbacks, void* arg0, void* arg1)
+{
+	UInt32 sum = 0;
+	for (std::list<BenchCallback>::iterator iter = callbacks.begin(); iter != callbacks.end(); ++iter)
+		if (CallbackMatches(*iter, arg0, arg1))
+			sum = AddMatch(sum, *iter);
+	return sum;
+}
+
+// as HandleEventForCallingObject dispatches
+static UInt32 DispatchByIndex(BenchCallbackList& callbacks, void* arg0, void* arg1)
+{
+	UInt32 sum = 0;
+	callbacks.Dispatch(arg0, arg1,
+		[&](const BenchCallback& callback) { return CallbackMatches(callback, arg0, arg1); },
+		[&](BenchCallbackList::iterator iter) { sum = AddMatch(sum, *iter); return false; });
+	return sum;
+}
+
+// like OnHit or OnActivate handlers from many mods: most are filtered on a ref, some on a form, a few on nothing
+static void MakeCallbacks(UInt32 numCallbacks, std::mt19937& rng, const std::vector<void*>& refs, const std::vector<void*>& forms,
+	std::vector<BenchCallback>& out)
+{
+	out.resize(numCallbacks);
+	for (UInt32 i = 0; i < numCallbacks; i++) {
+		BenchCallback& callback = out[i];
+		callback.id = i + 1;
+		callback.source = NULL;
+		callback.object = NULL;
+		callback.flags = 0;
+
+		UInt32 kind = rng() % 20;
+		if (kind < 12)
+			callback.source = refs[rng() % refs.size()];
+		else if (kind < 18)
+			callback.object = forms[rng() % forms.size()];
+		else if (kind < 19) {
+			callback.source = refs[rng() % refs.size()];
+			callback.object = forms[rng() % forms.size()];
+		}
+	}
+}
+
+struct BenchCallbackTimes
+{
+	double	walk;		// ns per event
+	double	index;
+	double	numMatched;	// per event
+	bool	ok;
+};
+
+static BenchCallbackTimes TimeCallbacks(UInt32 numCallbacks, UInt32 iterations)
+{
+	BenchCallbackTimes times = { 0, 0, 0, true };
+	std::mt19937 rng(numCallbacks);
+
+	// fake forms, only their addresses are used
+	static char s_forms[4096];
+	std::vector<void*> refs, forms;
+	for (UInt32 i = 0; i < 2000; i++)
+		refs.push_back(&s_forms[i]);
+	for (UInt32 i = 2000; i < 2500; i++)
+		forms.push_back(&s_forms[i]);
+
+	std::vector<BenchCallback> made;
+	MakeCallbacks(numCallbacks, rng, refs, forms, made);
+
+	std::list<BenchCallback> walkList;
+	BenchCallbackList indexList(0);
+	for (const BenchCallback& callback : made) {
+		walkList.push_back(callback);
+		indexList.Add(callback);
+	}
+
+	// half the events come from refs that have handlers
+	std::vector<std::pair<void*, void*> > events(4096);
+	for (std::pair<void*, void*>& event : events) {
+		event.first = rng() % 2 ? made[rng() % made.size()].source : NULL;
+		if (!event.first)
+			event.first = refs[rng() % refs.size()];
+		event.second = forms[rng() % forms.size()];
+	}
+
+	UInt32 numEvents = std::max<UInt32>(iterations / std::max<UInt32>(numCallbacks / 10, 1), 1000);
+	UInt32 walkSum = 0, indexSum = 0, numMatched = 0;
+	Clock::time_point start = Clock::now();
+	for (UInt32 i = 0; i < numEvents; i++) {
+		const std::pair<void*, void*>& event = events[i % events.size()];
+		walkSum += DispatchByWalk(walkList, event.first, event.second);
+	}
+	times.walk = ElapsedNs(start) / numEvents;
+
+	start = Clock::now();
+	for (UInt32 i = 0; i < numEvents; i++) {
+		const std::pair<void*, void*>& event = events[i % events.size()];
+		indexSum += DispatchByIndex(indexList, event.first, event.second);
+	}
+	times.index = ElapsedNs(start) / numEvents;
+	s_sink = walkSum + indexSum;
+	times.ok = walkSum == indexSum;
+
+	for (const std::pair<void*, void*>& event : events)
+		for (const BenchCallback& callback : walkList)
+			numMatched += CallbackMatches(callback, event.first, event.second);
+	times.numMatched = (double)numMatched / events.size();
+
+	// removing callbacks keeps the buckets in step with the list
+	std::vector<bool> removed(numCallbacks + 1);
+	for (std::list<BenchCallback>::iterator iter = walkList.begin(); iter != walkList.end(); ) {
+		if (rng() % 2) {
+			removed[iter->id] = true;
+			iter = walkList.erase(iter);
+		}
+		else
+			++iter;
+	}
+	for (BenchCallbackList::iterator iter = indexList.begin(); iter != indexList.end(); ) {
+		if (removed[iter->id])
+			iter = indexList.Erase(iter);
+		else
+			++iter;
+	}
+	for (const std::pair<void*, void*>& event : events)
+		times.ok &= DispatchByWalk(walkList, event.first, event.second) == DispatchByIndex(indexList, event.first, event.second);
+
+	return times;
+}
+
+static bool BenchEventCallbacks(UInt32 iterations)
+{
+	printf("eventcallbacks: dispatching an event to filtered handlers, index vs. walking every handler\n");
+	bool ok = true;
+	for (UInt32 numCallbacks : { 10, 100, 1000, 10000 }) {
+		BenchCallbackTimes times = TimeCallbacks(numCallbacks, iterations);
+		ok &= times.ok;
+		printf("%6u callbacks, %.2f run per event%s\n", numCallbacks, times.numMatched, times.ok ? "" : "  MISMATCH");
+		printf("        %-16s %10.1f ns walk %10.1f ns index %8.1fx\n", "dispatch", times.walk, times.index, times.walk / times.index);
+	}
+	return ok;
+}
+
+int main(int argc, char** argv)
+{
+	UInt32 iterations = 1000000;
+	std::vector<std::string> sections;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-n") && i + 1 < argc)
+			iterations = strtoul(argv[++i], NULL, 0);
+		else if (argv[i][0] != '-')
+			sections.push_back(argv[i]);
+		else {
+			printf("usage: bench [-n iterations] [section...]\n");
+			return 1;
+		}
+	}
+	if (!iterations)
+		iterations = 1;
+
+	struct Section
+	{
+		const char*	name;
+		bool		(* run)(UInt32 iterations);
+	};
+	static const Section kSections[] =
+	{
+		{ "operators",	BenchOperators },
+		{ "eventlist",	BenchEventLists },
+		{ "packedarray",	BenchPackedArrays },
+		{ "varmap",		BenchVarMaps },
+		{ "cosave",		BenchCoSaves },
+		{ "compression",	BenchCompression },
+		{ "eventcallbacks",	BenchEventCallbacks },
+	};
+
+	bool ok = true;
+	bool first = true;
+	for (const Section& section : kSections) {
+		if (!sections.empty() && std::find(sections.begin(), sections.end(), section.name) == sections.end())
+			continue;
+		if (!first)
+			printf("\n");
+		first = false;
+		ok &= section.run(iterations);
+	}
+
+	return ok ? 0 : 1;
+}
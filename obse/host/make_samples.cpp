@@ -0,0 +1,34 @@
+// make_samples: writes the co-saves in cosave_inspect/samples
+//
+//	make_samples [directory]
+//		directory defaults to ../cosave_inspect/samples
+//
+// Built from this directory with e.g.
+//	g++ -std=c++17 -O2 -Wno-multichar -I.. -I../.. -include Host.h make_samples.cpp SyntheticCoSave.cpp ../obse/CoSaveFormat.cpp ../obse/CoSaveRecords.cpp ../obse/Compression.cpp -o make_samples
+
+#include "Host.h"
+#include "SyntheticCoSave.h"
+
+int main(int argc, char** argv)
+{
+	std::string dir = argc > 1 ? argv[1] : "../cosave_inspect/samples";
+
+	for (UInt32 i = 0; i < kNumSampleCoSaves; i++) {
+		const SampleCoSave& sample = kSampleCoSaves[i];
+		std::vector<UInt8> image;
+		BuildSyntheticCoSave(sample.params, image);
+		if (sample.bCompressed)
+			Serialization::CompressCoSaveImage(image);
+
+		std::string path = dir + "/" + sample.name;
+		FILE* file = fopen(path.c_str(), "wb");
+		if (!file || fwrite(image.data(), 1, image.size(), file) != image.size()) {
+			printf("couldn't write %s\n", path.c_str());
+			return 1;
+		}
+		fclose(file);
+		printf("%s: %u bytes\n", path.c_str(), (UInt32)image.size());
+	}
+
+	return 0;
+}
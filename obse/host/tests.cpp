@@ -0,0 +1,877 @@
+// tests: checks pieces of OBSE that don't touch the game
+//
+//	tests [samples directory]
+//		directory of the sample co-saves, default ../cosave_inspect/samples
+//
+// Built from this directory with e.g.
+//	g++ -std=c++17 -O2 -pthread -Wno-multichar -I.. -I../.. -include Host.h tests.cpp SyntheticCoSave.cpp ../obse/CoSaveFormat.cpp
+//		../obse/CoSaveRecords.cpp ../obse/CoSaveWriter.cpp ../obse/Compression.cpp -o tests
+
+#include "Host.h"
+#include "SyntheticCoSave.h"
+#include "obse/CoSaveRecords.h"
+#include "obse/CoSaveWriter.h"
+#include "obse/EventCallbackList.h"
+#include <condition_variable>
+#include <functional>
+#include <thread>
+#include <vector>
+
+using namespace Serialization;
+
+static UInt32 s_numChecks = 0;
+static UInt32 s_numFailed = 0;
+
+#define CHECK(a)	Check((a), #a, __FILE__, __LINE__)
+
+static void Check(bool passed, const char* expr, const char* file, int line)
+{
+	s_numChecks++;
+	if (!passed) {
+		s_numFailed++;
+		printf("%s(%d): failed: %s\n", file, line, expr);
+	}
+}
+
+static bool ReadFile(const std::string& path, std::vector<UInt8>& out)
+{
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file)
+		return false;
+
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	out.resize(size > 0 ? size : 0);
+	bool read = out.empty() || fread(&out[0], 1, out.size(), file) == out.size();
+	fclose(file);
+	return read;
+}
+
+static SavedValue Number(double num)
+{
+	SavedValue value = SavedValue();
+	value.type = kDataType_Numeric;
+	value.num = num;
+	return value;
+}
+
+static SavedValue String(const char* str)
+{
+	SavedValue value = SavedValue();
+	value.type = kDataType_String;
+	value.str.data = str;
+	value.str.len = strlen(str);
+	return value;
+}
+
+static SavedValue Untyped(UInt8 type)
+{
+	SavedValue value = SavedValue();
+	value.type = type;
+	return value;
+}
+
+static SavedArrayHeader MakeHeader(UInt8 keyType, bool bPacked, const std::vector<UInt8>& refs)
+{
+	SavedArrayHeader header;
+	header.modIndex = 1;
+	header.id = 42;
+	header.keyType = keyType;
+	header.bPacked = bPacked;
+	header.numRefs = refs.size();
+	header.refs = refs.data();
+	return header;
+}
+
+static bool SameValue(const SavedValue& lhs, const SavedValue& rhs)
+{
+	if (lhs.type != rhs.type)
+		return false;
+
+	switch (lhs.type) {
+		case kDataType_Numeric:	return !memcmp(&lhs.num, &rhs.num, sizeof(double));
+		case kDataType_Form:	return lhs.formID == rhs.formID;
+		case kDataType_Array:	return lhs.arrayID == rhs.arrayID;
+		case kDataType_String:	return lhs.str.len == rhs.str.len && !memcmp(lhs.str.data, rhs.str.data, lhs.str.len);
+		default:				return true;
+	}
+}
+
+// decodes the v2 record written for elements and checks it comes back the same
+static void CheckArrayRoundTrip(const SavedArrayHeader& header, const std::vector<SavedElement>& elements)
+{
+	SaveStringTable table;
+	std::vector<UInt8> record;
+	WriteArrayRecord(record, header, elements.data(), elements.size(), table);
+
+	std::vector<UInt8> tableRecord;
+	table.Write(tableRecord);
+	std::vector<SavedString> strings;
+	RecordCursor tableCursor(tableRecord.data(), tableRecord.size());
+	CHECK(ReadStringTable(tableCursor, strings));
+
+	RecordCursor cursor(record.data(), record.size());
+	SavedArrayHeader decoded;
+	std::vector<SavedElement> decodedElements;
+	CHECK(ReadArrayHeader(cursor, 2, decoded));
+	CHECK(ReadArrayElements(cursor, 2, decoded, strings, decodedElements));
+	CHECK(!cursor.Skip(1));
+
+	CHECK(decoded.modIndex == header.modIndex && decoded.id == header.id && decoded.keyType == header.keyType);
+	CHECK(decoded.bPacked == header.bPacked && decoded.numRefs == header.numRefs);
+	CHECK(!memcmp(decoded.refs, header.refs, header.numRefs));
+	CHECK(decodedElements.size() == elements.size());
+	for (UInt32 i = 0; i < elements.size() && i < decodedElements.size(); i++) {
+		CHECK(SameValue(decodedElements[i].key, elements[i].key));
+		CHECK(SameValue(decodedElements[i].value, elements[i].value));
+	}
+}
+
+// elements left uninitialized, e.g. by ar_Resize, are saved as a type run with no values
+static void TestUninitializedElements()
+{
+	std::vector<UInt8> refs = { 1, 3 };
+	std::vector<SavedElement> elements(8);
+	for (UInt32 i = 0; i < elements.size(); i++) {
+		elements[i].key = Number(i);
+		elements[i].value = Untyped(kDataType_Invalid);
+	}
+	elements[0].value = Number(1.5);
+	elements[3].value = String("middle");
+	elements[4].value = Number(-7);
+
+	CheckArrayRoundTrip(MakeHeader(kDataType_Numeric, true, refs), elements);
+	CheckArrayRoundTrip(MakeHeader(kDataType_Numeric, false, refs), elements);
+
+	// all uninitialized
+	for (SavedElement& elem : elements)
+		elem.value = Untyped(kDataType_Invalid);
+	CheckArrayRoundTrip(MakeHeader(kDataType_Numeric, true, refs), elements);
+
+	// string map
+	elements.resize(3);
+	elements[0].key = String("a");
+	elements[1].key = String("b");
+	elements[2].key = String("c");
+	elements[1].value = String("b");
+	CheckArrayRoundTrip(MakeHeader(kDataType_String, false, refs), elements);
+}
+
+// types a later version may add are read without a value and don't throw off the elements after them
+static void TestUnknownElementType()
+{
+	std::vector<UInt8> refs = { 1 };
+	std::vector<SavedElement> elements(3);
+	elements[0].key = Number(0);
+	elements[0].value = Number(10);
+	elements[1].key = Number(1);
+	elements[1].value = Untyped(9);
+	elements[2].key = Number(2);
+	elements[2].value = Number(30);
+	CheckArrayRoundTrip(MakeHeader(kDataType_Numeric, true, refs), elements);
+}
+
+static void TestDamagedArrayRecord()
+{
+	std::vector<UInt8> refs = { 1 };
+	std::vector<SavedElement> elements(4);
+	for (UInt32 i = 0; i < elements.size(); i++) {
+		elements[i].key = Number(i * 10);
+		elements[i].value = Number(1000000 + i);
+	}
+
+	SaveStringTable table;
+	std::vector<UInt8> record;
+	WriteArrayRecord(record, MakeHeader(kDataType_Numeric, false, refs), elements.data(), elements.size(), table);
+
+	// cut into the last value: the elements before it are returned
+	std::vector<SavedString> strings;
+	RecordCursor cursor(record.data(), record.size() - 1);
+	SavedArrayHeader header;
+	std::vector<SavedElement> decoded;
+	CHECK(ReadArrayHeader(cursor, 2, header));
+	CHECK(!ReadArrayElements(cursor, 2, header, strings, decoded));
+	CHECK(decoded.size() == 3);
+	CHECK(decoded.size() == 3 && decoded[2].key.num == 20 && decoded[2].value.num == 1000002);
+
+	// an element count the record can't hold is rejected without allocating, and what out held is kept
+	RecordCursor countCursor(record.data(), record.size());
+	CHECK(ReadArrayHeader(countCursor, 2, header));
+	std::vector<UInt8> forged(record.begin(), record.end() - countCursor.Remaining());
+	const UInt8 hugeCount[] = { 0xFF, 0xFF, 0xFF, 0xFF, 0x0F };
+	forged.insert(forged.end(), hugeCount, hugeCount + sizeof(hugeCount));
+	forged.insert(forged.end(), record.end() - countCursor.Remaining() + 1, record.end());
+	RecordCursor forgedCursor(forged.data(), forged.size());
+	CHECK(ReadArrayHeader(forgedCursor, 2, header));
+	CHECK(!ReadArrayElements(forgedCursor, 2, header, strings, decoded));
+	CHECK(decoded.size() == 3);
+
+	// cut into the header
+	RecordCursor headerCursor(record.data(), 5);
+	CHECK(!ReadArrayHeader(headerCursor, 2, header));
+
+	// string index past the end of the table
+	std::vector<SavedElement> stringElements(1);
+	stringElements[0].key = String("key");
+	stringElements[0].value = Number(1);
+	record.clear();
+	WriteArrayRecord(record, MakeHeader(kDataType_String, false, refs), stringElements.data(), 1, table);
+	RecordCursor stringCursor(record.data(), record.size());
+	decoded.clear();
+	CHECK(ReadArrayHeader(stringCursor, 2, header));
+	CHECK(!ReadArrayElements(stringCursor, 2, header, strings, decoded));
+	CHECK(decoded.empty());
+}
+
+template <typename T>
+static void Append(std::vector<UInt8>& out, const T& val)
+{
+	out.insert(out.end(), (const UInt8*)&val, (const UInt8*)(&val + 1));
+}
+
+// v0 records have no references and v1 strings are cut at the first null, as the loader always did
+static void TestOldArrayRecords()
+{
+	std::vector<UInt8> record;
+	Append(record, (UInt8)2);
+	Append(record, (ArrayID)7);
+	Append(record, (UInt8)kDataType_String);
+	Append(record, (UInt8)0);
+	Append(record, (UInt32)1);
+	Append(record, (UInt16)4);
+	record.insert(record.end(), { 'k', 'e', 'y', 0 });
+	Append(record, (UInt8)kDataType_String);
+	Append(record, (UInt16)5);
+	record.insert(record.end(), { 'a', 0, 'b', 'c', 'd' });
+
+	RecordCursor cursor(record.data(), record.size());
+	SavedArrayHeader header;
+	std::vector<SavedString> strings;
+	std::vector<SavedElement> elements;
+	CHECK(ReadArrayHeader(cursor, 0, header));
+	CHECK(header.modIndex == 2 && header.id == 7 && header.keyType == kDataType_String && !header.bPacked);
+	CHECK(header.refs == NULL && header.numRefs == 0);
+	CHECK(ReadArrayElements(cursor, 0, header, strings, elements));
+	CHECK(elements.size() == 1);
+	CHECK(elements.size() == 1 && elements[0].key.str.len == 3 && !memcmp(elements[0].key.str.data, "key", 3));
+	CHECK(elements.size() == 1 && elements[0].value.type == kDataType_String && elements[0].value.str.len == 1);
+}
+
+static void TestStringAndModRecords()
+{
+	std::vector<UInt8> record;
+	Append(record, (UInt8)3);
+	Append(record, (UInt32)0x1234);
+	Append(record, (UInt16)5);
+	record.insert(record.end(), { 'h', 'e', 'l', 'l', 'o' });
+
+	RecordCursor cursor(record.data(), record.size());
+	SavedStringVar var;
+	CHECK(ReadStringVarRecord(cursor, var));
+	CHECK(var.modIndex == 3 && var.id == 0x1234 && var.str.len == 5 && !memcmp(var.str.data, "hello", 5));
+
+	RecordCursor truncated(record.data(), record.size() - 1);
+	CHECK(!ReadStringVarRecord(truncated, var));
+
+	std::vector<UInt8> mods;
+	Append(mods, (UInt8)2);
+	Append(mods, (UInt16)12);
+	mods.insert(mods.end(), { 'O', 'b', 'l', 'i', 'v', 'i', 'o', 'n', '.', 'e', 's', 'm' });
+	Append(mods, (UInt16)5);
+	mods.insert(mods.end(), { 'A', '.', 'e', 's', 'p' });
+
+	std::vector<SavedString> names;
+	RecordCursor modCursor(mods.data(), mods.size());
+	CHECK(ReadModList(modCursor, names));
+	CHECK(names.size() == 2 && names[1].len == 5 && !memcmp(names[1].data, "A.esp", 5));
+}
+
+// plugins that write nothing get no block, and the header counts the ones that do
+static void TestBuilder()
+{
+	Header header = Header();
+	header.signature = Header::kSignature;
+	header.formatVersion = Header::kVersion_Uncompressed;
+
+	CoSaveBuilder builder;
+	builder.Begin(header);
+	builder.BeginPlugin(kObseOpcodeBase);
+	CHECK(!builder.WriteRecordData("x", 1));
+	builder.OpenRecord('TEST', 1);
+	CHECK(builder.WriteRecordData("abc", 3));
+	builder.OpenRecord('EMPT', 0);
+	CHECK(builder.EndPlugin());
+	UInt32 blockEnd = builder.Size();
+
+	builder.BeginPlugin(0x2000);
+	CHECK(!builder.EndPlugin());
+	CHECK(builder.Size() == blockEnd);
+
+	std::vector<UInt8> block(builder.Data() + sizeof(Header), builder.Data() + blockEnd);
+	builder.AppendPlugin(block.data(), block.size());
+	builder.Finish();
+
+	std::vector<UInt8> image = builder.Image();
+	LoadBuffer buffer;
+	CHECK(buffer.Assign(image));
+
+	Header readHeader;
+	CHECK(buffer.ReadBuf(&readHeader, sizeof(readHeader)) == sizeof(readHeader));
+	CHECK(readHeader.numPlugins == 2);
+
+	for (UInt32 i = 0; i < 2; i++) {
+		PluginHeader plugin;
+		ChunkHeader chunk;
+		CHECK(buffer.ReadBuf(&plugin, sizeof(plugin)) == sizeof(plugin));
+		CHECK(plugin.opcodeBase == kObseOpcodeBase && plugin.numChunks == 2);
+		CHECK(plugin.length == 2 * sizeof(ChunkHeader) + 3);
+		CHECK(buffer.ReadBuf(&chunk, sizeof(chunk)) == sizeof(chunk));
+		CHECK(chunk.type == 'TEST' && chunk.version == 1 && chunk.length == 3);
+		const UInt8* data = buffer.ReadSpan(3);
+		CHECK(data && !memcmp(data, "abc", 3));
+		CHECK(buffer.ReadBuf(&chunk, sizeof(chunk)) == sizeof(chunk));
+		CHECK(chunk.type == 'EMPT' && chunk.length == 0);
+	}
+	CHECK(!buffer.GetRemain());
+}
+
+static void TestDamagedCompressedImage()
+{
+	SyntheticCoSave params = { 4, 10, 20, 10, 2, 1, 1000, 7 };
+	std::vector<UInt8> image;
+	BuildSyntheticCoSave(params, image);
+	std::vector<UInt8> original = image;
+	CompressCoSaveImage(image);
+	CHECK(image.size() < original.size());
+
+	std::vector<UInt8> copy = image;
+	LoadBuffer buffer;
+	CHECK(buffer.Assign(copy));
+	CHECK(buffer.GetSize() == original.size() && !memcmp(buffer.GetData(), original.data(), original.size()));
+
+	// an expanded length no LZ4 block could have is rejected before anything is allocated for it
+	PluginHeader plugin;
+	UInt32 compressedLength;
+	memcpy(&plugin, &image[sizeof(Header)], sizeof(plugin));
+	memcpy(&compressedLength, &image[sizeof(Header) + sizeof(plugin)], sizeof(compressedLength));
+	CHECK(compressedLength != 0);
+	for (UInt32 length : { 0xFFFFFFF0u, compressedLength * 256 }) {
+		copy = image;
+		plugin.length = length;
+		memcpy(&copy[sizeof(Header)], &plugin, sizeof(plugin));
+		CHECK(!buffer.Assign(copy));
+		CHECK(!buffer.GetSize());
+	}
+
+	// cut off the end of the last block
+	image.resize(image.size() - 10);
+	CHECK(!buffer.Assign(image));
+	CHECK(!buffer.GetSize());
+}
+
+// walks the image as HandleLoadGame does, decodes OBSE's records and encodes its array records again
+static void CheckSampleRecords(const std::string& name, LoadBuffer& buffer, UInt32 arrayVersion)
+{
+	Header header;
+	CHECK(buffer.ReadBuf(&header, sizeof(header)) == sizeof(header));
+	CHECK(header.signature == Header::kSignature && header.formatVersion == Header::kVersion_Uncompressed);
+
+	UInt32 numPlugins = 0, numArrays = 0, numUninitialized = 0, numBad = 0;
+	while (buffer.GetRemain() >= sizeof(PluginHeader)) {
+		PluginHeader plugin;
+		buffer.ReadBuf(&plugin, sizeof(plugin));
+		numPlugins++;
+
+		std::vector<SavedString> strings;
+		std::vector<SavedElement> elements;
+		SaveStringTable table;
+		std::vector<UInt8> records, savedRecords;
+		for (UInt32 i = 0; i < plugin.numChunks; i++) {
+			ChunkHeader chunk;
+			buffer.ReadBuf(&chunk, sizeof(chunk));
+			const UInt8* data = buffer.ReadSpan(chunk.length);
+			CHECK(data != NULL);
+			if (plugin.opcodeBase != kObseOpcodeBase || !data)
+				continue;
+
+			RecordCursor record(data, chunk.length);
+			SavedStringVar var;
+			SavedArrayHeader arrayHeader;
+			switch (chunk.type) {
+				case 'MODS':	numBad += !ReadModList(record, strings); strings.clear(); break;
+				case 'STVR':	numBad += !ReadStringVarRecord(record, var); break;
+				case 'ARVT':	numBad += !ReadStringTable(record, strings); break;
+				case 'ARVR':
+					CHECK(chunk.version == arrayVersion);
+					elements.clear();
+					if (!ReadArrayHeader(record, chunk.version, arrayHeader) ||
+						!ReadArrayElements(record, chunk.version, arrayHeader, strings, elements))
+						numBad++;
+					for (const SavedElement& elem : elements)
+						numUninitialized += elem.value.type == kDataType_Invalid;
+					numArrays++;
+
+					if (chunk.version >= 2) {
+						savedRecords.insert(savedRecords.end(), data, data + chunk.length);
+						WriteArrayRecord(records, arrayHeader, elements.data(), elements.size(), table);
+					}
+					break;
+			}
+		}
+
+		// what ArrayVarMap::Save would write for what was loaded
+		CHECK(records == savedRecords);
+	}
+
+	CHECK(numPlugins == header.numPlugins);
+	CHECK(numArrays > 0);
+	CHECK(numBad == 0);
+	if (arrayVersion >= 2)
+		CHECK(numUninitialized > 0);
+	if (numBad)
+		printf("%s: %u records could not be decoded\n", name.c_str(), numBad);
+}
+
+// the checked in samples are what the generator builds, and load cleanly
+static void TestSamples(const std::string& dir)
+{
+	for (UInt32 i = 0; i < kNumSampleCoSaves; i++) {
+		const SampleCoSave& sample = kSampleCoSaves[i];
+		std::string path = dir + "/" + sample.name;
+		std::vector<UInt8> file;
+		CHECK(ReadFile(path, file));
+		if (file.empty()) {
+			printf("%s: couldn't read the sample\n", path.c_str());
+			continue;
+		}
+
+		std::vector<UInt8> image;
+		BuildSyntheticCoSave(sample.params, image);
+		std::vector<UInt8> uncompressed = image;
+		if (sample.bCompressed)
+			CompressCoSaveImage(image);
+		CHECK(file == image);
+
+		Header header;
+		memcpy(&header, file.data(), sizeof(header));
+		CHECK(header.formatVersion == (sample.bCompressed ? Header::kVersion_Compressed : Header::kVersion_Uncompressed));
+
+		LoadBuffer buffer;
+		CHECK(buffer.Assign(file));
+		CHECK(buffer.GetSize() == uncompressed.size() && !memcmp(buffer.GetData(), uncompressed.data(), uncompressed.size()));
+		CheckSampleRecords(path, buffer, sample.params.arrayVersion);
+	}
+}
+
+// CoSaveWriter's thread and files, on std::thread. SaveFile() can be held to keep a write in flight
+class FakeWriterDriver : public CoSaveWriterDriver
+{
+	std::mutex				m_lock;
+	std::condition_variable	m_changed;
+	std::thread				m_thread;
+	bool					m_bHeld;
+	UInt32					m_numHeld;		// SaveFile() calls waiting on Release()
+
+public:
+	struct File
+	{
+		std::string			path;
+		std::vector<UInt8>	data;
+	};
+
+	std::vector<File>	files;			// in the order they were written
+	UInt32				numThreads;
+	bool				bFailThread;
+	bool				bFailFile;
+
+	FakeWriterDriver() : m_bHeld(false), m_numHeld(0), numThreads(0), bFailThread(false), bFailFile(false) { }
+
+	virtual bool SaveFile(const char* path, const void* data, UInt32 length)
+	{
+		std::unique_lock<std::mutex> lock(m_lock);
+		m_numHeld++;
+		m_changed.notify_all();
+		m_changed.wait(lock, [this] { return !m_bHeld; });
+		m_numHeld--;
+
+		if (bFailFile)
+			return false;
+
+		File file;
+		file.path = path;
+		file.data.assign((const UInt8*)data, (const UInt8*)data + length);
+		files.push_back(file);
+		return true;
+	}
+
+	virtual bool StartThread(ThreadProc proc, void* param)
+	{
+		if (bFailThread)
+			return false;
+
+		numThreads++;
+		m_thread = std::thread(proc, param);
+		return true;
+	}
+
+	virtual void JoinThread()
+	{
+		m_thread.join();
+	}
+
+	void Hold()
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_bHeld = true;
+	}
+
+	void Release()
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_bHeld = false;
+		m_changed.notify_all();
+	}
+
+	// waits for a write to reach the file
+	void WaitUntilHeld()
+	{
+		std::unique_lock<std::mutex> lock(m_lock);
+		m_changed.wait(lock, [this] { return m_numHeld > 0; });
+	}
+
+	UInt32 NumFiles()
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		return files.size();
+	}
+};
+
+static void MakeWriterImage(UInt32 seed, std::vector<UInt8>& image)
+{
+	SyntheticCoSave params = { 4, 10, 20, 10, 2, 1, 1000, seed };
+	BuildSyntheticCoSave(params, image);
+}
+
+static void TestWriterSync()
+{
+	FakeWriterDriver driver;
+	CoSaveWriter writer(driver);
+	std::vector<UInt8> image, original;
+	MakeWriterImage(1, original);
+
+	image = original;
+	writer.Write("sync.obse", image, false, false);
+	CHECK(image.empty());
+	CHECK(!writer.IsWriting() && !driver.numThreads);
+	CHECK(driver.files.size() == 1);
+	CHECK(driver.files.size() == 1 && driver.files[0].path == "sync.obse" && driver.files[0].data == original);
+}
+
+// the game saves again, or loads, while the last co-save is still being flushed
+static void TestWriterSaveWhileFlushing()
+{
+	FakeWriterDriver driver;
+	CoSaveWriter writer(driver);
+	std::vector<UInt8> first, second, firstOriginal, secondOriginal;
+	MakeWriterImage(1, firstOriginal);
+	MakeWriterImage(2, secondOriginal);
+	first = firstOriginal;
+	second = secondOriginal;
+
+	driver.Hold();
+	writer.Write("first.obse", first, true, false);
+	CHECK(writer.IsWriting());
+	CHECK(first.empty());
+	driver.WaitUntilHeld();
+
+	// the second save has to wait for the first file
+	std::atomic<bool> bSecondWritten(false);
+	std::thread save([&] {
+		writer.Write("second.obse", second, true, true);
+		bSecondWritten = true;
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	CHECK(!bSecondWritten);
+	CHECK(!driver.NumFiles());
+
+	driver.Release();
+	save.join();
+	writer.Wait();
+	CHECK(!writer.IsWriting());
+	CHECK(driver.numThreads == 2);
+
+	CHECK(driver.files.size() == 2);
+	if (driver.files.size() == 2) {
+		CHECK(driver.files[0].path == "first.obse" && driver.files[0].data == firstOriginal);
+		CHECK(driver.files[1].path == "second.obse");
+
+		Header header;
+		memcpy(&header, driver.files[1].data.data(), sizeof(header));
+		CHECK(header.formatVersion == Header::kVersion_Compressed);
+		std::vector<UInt8> expanded = driver.files[1].data;
+		CHECK(DecompressCoSaveImage(expanded) && expanded == secondOriginal);
+	}
+
+	// a load waits for the write too
+	second = secondOriginal;
+	driver.Hold();
+	writer.Write("third.obse", second, true, false);
+	driver.WaitUntilHeld();
+	std::atomic<bool> bWaited(false);
+	std::thread load([&] {
+		writer.Wait();
+		bWaited = true;
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	CHECK(!bWaited);
+	driver.Release();
+	load.join();
+	CHECK(driver.NumFiles() == 3);
+}
+
+// no thread means writing before returning, and a failed write doesn't stop the next one
+static void TestWriterFailures()
+{
+	FakeWriterDriver driver;
+	CoSaveWriter writer(driver);
+	std::vector<UInt8> image, original;
+	MakeWriterImage(3, original);
+
+	driver.bFailThread = true;
+	image = original;
+	writer.Write("nothread.obse", image, true, false);
+	CHECK(!writer.IsWriting());
+	CHECK(driver.files.size() == 1 && driver.files[0].data == original);
+
+	driver.bFailThread = false;
+	driver.bFailFile = true;
+	image = original;
+	writer.Write("nofile.obse", image, true, false);
+	CHECK(!writer.Wait());
+	CHECK(driver.files.size() == 1);
+	CHECK(writer.Wait());
+
+	driver.bFailFile = false;
+	image = original;
+	writer.Write("after.obse", image, true, false);
+	CHECK(writer.Wait());
+	CHECK(driver.files.size() == 2 && driver.files[1].path == "after.obse" && driver.files[1].data == original);
+}
+
+// the parts of an EventCallback the list and a dispatch use
+struct TestCallback
+{
+	enum
+	{
+		kFlag_Removed	= 1 << 0,
+		kFlag_InUse		= 1 << 1,
+	};
+
+	void*	source;
+	void*	object;
+	UInt32	id;
+	UInt8	flags;
+
+	bool IsInUse() const { return flags & kFlag_InUse ? true : false; }
+	bool IsRemoved() const { return flags & kFlag_Removed ? true : false; }
+	void SetInUse(bool bSet) { flags = bSet ? flags | kFlag_InUse : flags & ~kFlag_InUse; }
+	void SetRemoved(bool bSet) { flags = bSet ? flags | kFlag_Removed : flags & ~kFlag_Removed; }
+};
+
+struct TestCallbackKeys
+{
+	static void* SourceArg(UInt32 eventID, void* arg0, void* arg1) { return arg0; }
+
+	static bool ObjectKey(UInt32 eventID, const TestCallback& callback, void*& key)
+	{
+		key = callback.object;
+		return true;
+	}
+};
+
+typedef EventCallbackList<TestCallback, TestCallbackKeys> TestCallbackList;
+
+static char s_testRefs[64];
+
+// numCallbacks handlers with no filters, numbered from 1, after numOthers filtered on a ref the tests never pass
+static void MakeTestCallbacks(TestCallbackList& list, UInt32 numCallbacks, UInt32 numOthers)
+{
+	for (UInt32 i = 0; i < numOthers; i++) {
+		TestCallback callback = { &s_testRefs[1], NULL, 1000 + i, 0 };
+		list.Add(callback);
+	}
+
+	for (UInt32 i = 1; i <= numCallbacks; i++) {
+		TestCallback callback = { NULL, NULL, i, 0 };
+		list.Add(callback);
+	}
+}
+
+// as RemoveHandler does: erased now unless a dispatch is using it
+static void RemoveTestCallback(TestCallbackList& list, UInt32 id)
+{
+	for (TestCallbackList::iterator iter = list.begin(); iter != list.end(); ) {
+		if (iter->id != id)
+			++iter;
+		else if (iter->IsInUse()) {
+			iter->SetRemoved(true);
+			++iter;
+		}
+		else
+			iter = list.Erase(iter);
+	}
+}
+
+// as HandleEventForCallingObject does, running handler for each callback whose filters match
+static void DispatchTest(TestCallbackList& list, void* arg0, const std::function<void (UInt32)>& handler)
+{
+	list.Dispatch(arg0, NULL,
+		[&](const TestCallback& callback) { return !callback.source || callback.source == arg0; },
+		[&](TestCallbackList::iterator iter) { handler(iter->id); return false; });
+}
+
+static bool HasTestCallback(TestCallbackList& list, UInt32 id)
+{
+	for (TestCallbackList::iterator iter = list.begin(); iter != list.end(); ++iter)
+		if (iter->id == id)
+			return true;
+	return false;
+}
+
+static bool AnyInUse(TestCallbackList& list)
+{
+	for (TestCallbackList::iterator iter = list.begin(); iter != list.end(); ++iter)
+		if (iter->IsInUse())
+			return true;
+	return false;
+}
+
+// run over lists small enough to be walked and large enough to go through the buckets
+static void TestHandlerRemovesItself(UInt32 numOthers)
+{
+	TestCallbackList list(0);
+	MakeTestCallbacks(list, 3, numOthers);
+
+	std::vector<UInt32> ran;
+	DispatchTest(list, &s_testRefs[0], [&](UInt32 id) {
+		ran.push_back(id);
+		if (id == 2) {
+			RemoveTestCallback(list, 2);
+			CHECK(HasTestCallback(list, 2));
+		}
+	});
+	CHECK(ran == std::vector<UInt32>({ 1, 2, 3 }));
+	CHECK(!HasTestCallback(list, 2) && !AnyInUse(list));
+
+	ran.clear();
+	DispatchTest(list, &s_testRefs[0], [&](UInt32 id) { ran.push_back(id); });
+	CHECK(ran == std::vector<UInt32>({ 1, 3 }));
+}
+
+static void TestHandlerRemovesAnother(UInt32 numOthers)
+{
+	TestCallbackList list(0);
+	MakeTestCallbacks(list, 3, numOthers);
+
+	std::vector<UInt32> ran;
+	DispatchTest(list, &s_testRefs[0], [&](UInt32 id) {
+		ran.push_back(id);
+		if (id == 1)
+			RemoveTestCallback(list, 3);
+	});
+	CHECK(ran == std::vector<UInt32>({ 1, 2 }));
+	CHECK(!HasTestCallback(list, 3) && HasTestCallback(list, 1) && !AnyInUse(list));
+}
+
+// a callback deferred to Tick() stays in use after the dispatch, so removing it only flags it
+static void TestDeferredHandler(UInt32 numOthers)
+{
+	TestCallbackList list(0);
+	MakeTestCallbacks(list, 3, numOthers);
+
+	list.Dispatch(&s_testRefs[0], NULL,
+		[&](const TestCallback& callback) { return !callback.source; },
+		[&](TestCallbackList::iterator iter) { return iter->id == 2; });
+	RemoveTestCallback(list, 2);
+	CHECK(HasTestCallback(list, 2));
+
+	UInt32 numInUse = 0;
+	for (TestCallbackList::iterator iter = list.begin(); iter != list.end(); ++iter)
+		numInUse += iter->IsInUse();
+	CHECK(numInUse == 1);
+}
+
+// a handler raising the same event: the inner dispatch must not erase what the outer one still holds, and the
+// outer one must carry on over its own candidates
+static void TestNestedDispatch(UInt32 numOthers)
+{
+	TestCallbackList list(0);
+	MakeTestCallbacks(list, 3, numOthers);
+
+	std::vector<UInt32> ran;
+	UInt32 depth = 0;
+	std::function<void (UInt32)> handler = [&](UInt32 id) {
+		ran.push_back(depth * 10 + id);
+		if (id != 1)
+			return;
+
+		if (depth == 0) {
+			depth++;
+			DispatchTest(list, &s_testRefs[0], handler);
+			depth--;
+			CHECK(AnyInUse(list));
+		}
+		else
+			RemoveTestCallback(list, 2);
+	};
+
+	DispatchTest(list, &s_testRefs[0], handler);
+	CHECK(ran == std::vector<UInt32>({ 1, 11, 13, 3 }));
+	CHECK(!HasTestCallback(list, 2) && !AnyInUse(list));
+
+	// a handler added by the inner dispatch isn't run by the outer one
+	ran.clear();
+	handler = [&](UInt32 id) {
+		ran.push_back(depth * 10 + id);
+		if (depth == 0 && id == 1) {
+			depth++;
+			DispatchTest(list, &s_testRefs[0], [&](UInt32 id) {
+				ran.push_back(depth * 10 + id);
+				if (id == 3) {
+					TestCallback callback = { NULL, NULL, 4, 0 };
+					list.Add(callback);
+				}
+			});
+			depth--;
+		}
+	};
+	DispatchTest(list, &s_testRefs[0], handler);
+	CHECK(ran == std::vector<UInt32>({ 1, 11, 13, 3 }));
+}
+
+int main(int argc, char** argv)
+{
+	std::string samples = argc > 1 ? argv[1] : "../cosave_inspect/samples";
+
+	TestUninitializedElements();
+	TestUnknownElementType();
+	TestDamagedArrayRecord();
+	TestOldArrayRecords();
+	TestStringAndModRecords();
+	TestBuilder();
+	TestDamagedCompressedImage();
+	TestSamples(samples);
+	TestWriterSync();
+	TestWriterSaveWhileFlushing();
+	TestWriterFailures();
+	for (UInt32 numOthers : { 0u, (UInt32)TestCallbackList::kMinIndexedCallbacks }) {
+		TestHandlerRemovesItself(numOthers);
+		TestHandlerRemovesAnother(numOthers);
+		TestDeferredHandler(numOthers);
+		TestNestedDispatch(numOthers);
+	}
+
+	printf("%u checks, %u failed\n", s_numChecks, s_numFailed);
+	return s_numFailed ? 1 : 0;
+}
@@ -2,6 +2,9 @@
 #include "ArrayVar.h"
 #include "GameForms.h"
 #include <algorithm>
+#include <cmath>
+#include "utility.h"
+#include "CoSaveRecords.h"
 
 #if OBLIVION
 #include "GameAPI.h"
@@ -17,10 +20,70 @@ ArrayVarMap g_ArrayMap;
 /////////////////
 
 ArrayElement::ArrayElement()
-	: m_dataType(kDataType_Invalid), m_owningArray(0)
+	: m_dataType(kDataType_Invalid), m_strLen(0), m_owningArray(0)
 {	
-	m_data.formID = 0;
-	m_data.str = "";
+	m_data.num = 0;
+}
+
+ArrayElement::ArrayElement(const ArrayElement& rhs)
+	: m_dataType(kDataType_Invalid), m_strLen(0), m_owningArray(0)
+{
+	*this = rhs;
+}
+
+ArrayElement::ArrayElement(ArrayElement&& rhs)
+	: m_data(rhs.m_data), m_dataType(rhs.m_dataType), m_strLen(rhs.m_strLen), m_owningArray(rhs.m_owningArray)
+{
+	// heap string now belongs to this element
+	rhs.m_dataType = kDataType_Invalid;
+	rhs.m_strLen = 0;
+	rhs.m_data.num = 0;
+}
+
+ArrayElement& ArrayElement::operator=(const ArrayElement& rhs)
+{
+	if (this != &rhs)
+	{
+		FreeString();
+		m_data = rhs.m_data;
+		m_dataType = rhs.m_dataType;
+		m_strLen = rhs.m_strLen;
+		m_owningArray = rhs.m_owningArray;
+
+		if (m_dataType == kDataType_String && m_strLen == kLongString)
+		{
+			m_data.longStr.data = new char[rhs.m_data.longStr.len + 1];
+			memcpy(m_data.longStr.data, rhs.m_data.longStr.data, rhs.m_data.longStr.len + 1);
+		}
+	}
+
+	return *this;
+}
+
+ArrayElement& ArrayElement::operator=(ArrayElement&& rhs)
+{
+	if (this != &rhs)
+	{
+		FreeString();
+		m_data = rhs.m_data;
+		m_dataType = rhs.m_dataType;
+		m_strLen = rhs.m_strLen;
+		m_owningArray = rhs.m_owningArray;
+
+		rhs.m_dataType = kDataType_Invalid;
+		rhs.m_strLen = 0;
+		rhs.m_data.num = 0;
+	}
+
+	return *this;
+}
+
+void ArrayElement::FreeString()
+{
+	if (m_dataType == kDataType_String && m_strLen == kLongString)
+		delete[] m_data.longStr.data;
+
+	m_strLen = 0;
 }
 
 bool ArrayElement::operator<(const ArrayElement& rhs) const
@@ -35,7 +98,7 @@ bool ArrayElement::operator<(const ArrayElement& rhs) const
 	}
 
 	if (DataType() == kDataType_String)
-		return (_stricmp(m_data.str.c_str(), rhs.m_data.str.c_str()) < 0);
+		return (_stricmp(StrData(), rhs.StrData()) < 0);
 	else if (DataType() == kDataType_Form)
 		return m_data.formID < rhs.m_data.formID;
 	else
@@ -50,7 +113,7 @@ bool ArrayElement::Equals(const ArrayElement& compareTo) const
 	switch (DataType())
 	{
 	case kDataType_String:
-		return (m_data.str.length() == compareTo.m_data.str.length()) ? !_stricmp(m_data.str.c_str(), compareTo.m_data.str.c_str()) : false;
+		return (StrLength() == compareTo.StrLength()) ? !_stricmp(StrData(), compareTo.StrData()) : false;
 	case kDataType_Form:
 		return m_data.formID == compareTo.m_data.formID;
 	default:
@@ -68,7 +131,7 @@ std::string ArrayElement::ToString() const
 		sprintf_s(buf, sizeof(buf), "%f", m_data.num);
 		return buf;
 	case kDataType_String:
-		return m_data.str;
+		return std::string(StrData(), StrLength());
 	case kDataType_Array:
 		sprintf_s(buf, sizeof(buf), "Array ID %.0f", m_data.num);
 		return buf;
@@ -121,12 +184,31 @@ bool ArrayElement::SetFormID(UInt32 refID)
 	return true;
 }
 
-bool ArrayElement::SetString(const std::string& str)
+bool ArrayElement::SetString(const char* str, UInt32 len)
 {
+	// build the new data before unsetting, str may point into this element
+	ElementData data;
+	UInt8 strLen;
+	if (len <= kMaxShortString)
+	{
+		memcpy(data.shortStr, str, len);
+		data.shortStr[len] = 0;
+		strLen = len;
+	}
+	else
+	{
+		data.longStr.data = new char[len + 1];
+		memcpy(data.longStr.data, str, len);
+		data.longStr.data[len] = 0;
+		data.longStr.len = len;
+		strLen = kLongString;
+	}
+
 	Unset();
 
 	m_dataType = kDataType_String;
-	m_data.str = str;
+	m_data = data;
+	m_strLen = strLen;
 	return true;
 }
 
@@ -156,13 +238,16 @@ bool ArrayElement::SetNumber(double num)
 
 bool ArrayElement::Set(const ArrayElement& elem)
 {
+	if (&elem == this)
+		return m_dataType != kDataType_Invalid;
+
 	Unset();
 
 	m_dataType = elem.DataType();
 	switch (m_dataType)
 	{
 	case kDataType_String:
-		SetString(elem.m_data.str);
+		SetString(elem.StrData(), elem.StrLength());
 		break;
 	case kDataType_Array:
 		SetArray(elem.m_data.num, g_ArrayMap.GetOwningModIndex(m_owningArray));
@@ -212,14 +297,20 @@ bool ArrayElement::GetAsString(std::string& out) const
 {
 	if (m_dataType != kDataType_String)
 		return false;
-	out = m_data.str;
+	out.assign(StrData(), StrLength());
 	return true;
 }
 
 void ArrayElement::Unset()
 {
+	// every setter comes through here
+	if (m_owningArray)
+		g_ArrayMap.MarkDirty(m_owningArray);
+
 	if (m_dataType == kDataType_Array)
 		g_ArrayMap.RemoveReference(&m_data.num, g_ArrayMap.GetOwningModIndex(m_owningArray));
+	else
+		FreeString();
 	
 	m_dataType = kDataType_Invalid;
 	m_data.num = 0;
@@ -229,7 +320,7 @@ void ArrayElement::Unset()
 // ArrayKey
 //////////////////////
 
-ArrayKey::ArrayKey() : keyType(kDataType_Invalid)
+ArrayKey::ArrayKey() : keyType(kDataType_Invalid), hash(0)
 {
 	key.num = 0;
 }
@@ -238,18 +329,21 @@ ArrayKey::ArrayKey(const std::string& _key)
 {
 	keyType = kDataType_String;
 	key.str = _key;
+	hash = StrHashCI(key.str.c_str());
 }
 
 ArrayKey::ArrayKey(const char* _key)
 {
 	keyType = kDataType_String;
 	key.str = _key;
+	hash = StrHashCI(key.str.c_str());
 }
 
 ArrayKey::ArrayKey(double _key)
 {
 	keyType = kDataType_Numeric;
 	key.num = _key;
+	hash = 0;
 }
 
 bool ArrayKey::operator<(const ArrayKey& rhs) const
@@ -312,13 +406,98 @@ ArrayVar::ArrayVar(UInt32 _keyType, bool _packed, UInt8 modIndex)
 ArrayVar::~ArrayVar()
 {
 	// erase all elements. Important because doing so decrements refCounts of arrays stored within this array
-	for (ArrayIterator iter = m_elements.begin(); iter != m_elements.end(); ++iter)
+	for (ArrayIterator iter = Begin(); iter != End(); ++iter)
+		iter.Element().Unset();
+}
+
+ArrayIterator ArrayVar::Begin()
+{
+	return ArrayIterator(this, m_elements.begin(), 0);
+}
+
+ArrayIterator ArrayVar::End()
+{
+	return ArrayIterator(this, m_elements.end(), m_packedElements.size());
+}
+
+void ArrayVar::BuildStringIndex()
+{
+	m_stringIndex.reserve(m_elements.size() * 2);
+	for (_ElementMap::iterator iter = m_elements.begin(); iter != m_elements.end(); ++iter)
+		m_stringIndex.emplace(&iter->first, iter);
+}
+
+ArrayIterator ArrayVar::Find(const ArrayKey& key)
+{
+	if (m_keyType == kDataType_String && key.KeyType() == kDataType_String && !m_bPacked)
 	{
-		ArrayKey key = iter->first;
-		ArrayElement* elem = Get(key, false);
-		if (elem)
-			elem->Unset();
+		if (!HasStringIndex() && m_elements.size() > kMinHashedKeys)
+			BuildStringIndex();
+
+		if (HasStringIndex())
+		{
+			_KeyIndex::iterator found = m_stringIndex.find(&key);
+			return ArrayIterator(this, found != m_stringIndex.end() ? found->second : m_elements.end(), 0);
+		}
 	}
+
+	if (!HasPackedStorage())
+		return ArrayIterator(this, m_elements.find(key), 0);
+
+	// keys of packed arrays are the integers [0, Size())
+	if (key.KeyType() != kDataType_Numeric)
+		return End();
+
+	double idx = key.Key().num;
+	if (idx >= 0 && idx < m_packedElements.size() && idx == (UInt32)idx)
+		return ArrayIterator(this, m_elements.end(), (UInt32)idx);
+
+	return End();
+}
+
+ArrayIterator ArrayVar::LowerBound(const ArrayKey& key)
+{
+	if (key.KeyType() != m_keyType)		// nothing compares >= a key of another type
+		return End();
+	else if (!HasPackedStorage())
+		return ArrayIterator(this, m_elements.lower_bound(key), 0);
+
+	double idx = key.Key().num;
+	if (!(idx > 0))
+		return Begin();
+	else if (idx >= m_packedElements.size())
+		return End();
+
+	return ArrayIterator(this, m_elements.end(), (UInt32)ceil(idx));
+}
+
+ArrayIterator ArrayVar::Erase(ArrayIterator first, ArrayIterator last)
+{
+	g_ArrayMap.MarkDirty(m_ID);
+
+	if (!HasPackedStorage())
+	{
+		if (HasStringIndex())
+		{
+			for (_ElementMap::iterator iter = first.m_mapIter; iter != last.m_mapIter; ++iter)
+				m_stringIndex.erase(&iter->first);
+		}
+
+		return ArrayIterator(this, m_elements.erase(first.m_mapIter, last.m_mapIter), 0);
+	}
+
+	m_packedElements.erase(m_packedElements.begin() + first.m_index, m_packedElements.begin() + last.m_index);
+	return first;
+}
+
+ArrayElement* ArrayVar::InsertUninitialized(UInt32 atIndex, UInt32 count)
+{
+	g_ArrayMap.MarkDirty(m_ID);
+
+	ArrayElement newElem;
+	newElem.m_owningArray = m_ID;
+	m_packedElements.insert(m_packedElements.begin() + atIndex, count, newElem);
+	return &m_packedElements[atIndex];
 }
 
 ArrayElement* ArrayVar::Get(ArrayKey key, bool bCanCreateNew)
@@ -333,19 +512,30 @@ ArrayElement* ArrayVar::Get(ArrayKey key, bool bCanCreateNew)
 		key.SetNumericKey(intIdx);
 	}
 
-	_ElementMap::iterator it = m_elements.find(key);
-	if (it != m_elements.end()) {
-		return &it->second;
+	ArrayIterator it = Find(key);
+	if (it != End()) {
+		return &it.Element();
 	}
 
 	if (bCanCreateNew)
 	{
 		if (key.KeyType() == KeyType())
 		{
-			if (!IsPacked() || (key.Key().num <= Size()))
+			if (HasPackedStorage())
+			{
+				// packed arrays can only grow by appending, any other missing key is out of range
+				if (key.Key().num == Size())
+					return InsertUninitialized(Size(), 1);
+			}
+			else if (!IsPacked() || (key.Key().num <= Size()))
 			{
 				// create a new, uninitialized element
-				ArrayElement* newElem = &m_elements[key];
+				g_ArrayMap.MarkDirty(m_ID);
+				_ElementMap::iterator newIter = m_elements.emplace(key, ArrayElement()).first;
+				if (HasStringIndex())
+					m_stringIndex.emplace(&newIter->first, newIter);
+
+				ArrayElement* newElem = &newIter->second;
 				newElem->m_owningArray = m_ID;
 				return newElem;
 			}
@@ -366,8 +556,10 @@ bool ArrayVar::SetElementNumber(const ArrayKey* key, double num)
 
 bool ArrayVar::SetElementString(const ArrayKey* key, const char* str)
 {
+	// str may point into an element of this array, which may move if the element is appended
+	std::string strCopy(str);
 	ArrayElement* elem = this->Get(*key, true);
-	if (!elem || !elem->SetString(str))
+	if (!elem || !elem->SetString(strCopy))
 		return false;
 
 	return true;
@@ -406,6 +598,9 @@ bool ArrayVar::GetElementString(const ArrayKey* key, std::string& out)
 
 UInt32 ArrayVar::GetUnusedIndex()
 {
+	if (HasPackedStorage())
+		return Size();
+
 	UInt32 id = 0;
 	while (m_elements.find(id) != m_elements.end())
 	{
@@ -422,19 +617,21 @@ void ArrayVar::Dump()
 	Console_Print("Refs: %d Owner %02X: %s", m_refs.size(), m_owningModIndex, owningModName);
 	_MESSAGE("Refs: %d Owner %02X: %s", m_refs.size(), m_owningModIndex, owningModName);
 
-	for (std::map<ArrayKey, ArrayElement>::iterator iter = m_elements.begin(); iter != m_elements.end(); ++iter)
+	for (ArrayIterator iter = Begin(); iter != End(); ++iter)
 	{
+		const ArrayKey key = iter.Key();
+		const ArrayElement& elem = iter.Element();
 		char numBuf[0x50] = { 0 };
 		std::string elementInfo("[ ");
 
 		switch (KeyType())
 		{
 		case kDataType_Numeric:
-			sprintf_s(numBuf, sizeof(numBuf), "%f", iter->first.Key().num);
+			sprintf_s(numBuf, sizeof(numBuf), "%f", key.Key().num);
 			elementInfo += numBuf;
 			break;
 		case kDataType_String:
-			elementInfo += iter->first.Key().str;
+			elementInfo += key.Key().str;
 			break;
 		default:
 			elementInfo += "?Unknown Key Type?";
@@ -442,24 +639,24 @@ void ArrayVar::Dump()
 
 		elementInfo += " ] : ";
 
-		switch (iter->second.m_dataType)
+		switch (elem.m_dataType)
 		{
 		case kDataType_Numeric:
-			sprintf_s(numBuf, sizeof(numBuf), "%f", iter->second.m_data.num);
+			sprintf_s(numBuf, sizeof(numBuf), "%f", elem.m_data.num);
 			elementInfo += numBuf;
 			break;
 		case kDataType_String:
-			elementInfo += iter->second.m_data.str;
+			elementInfo.append(elem.StrData(), elem.StrLength());
 			break;
 		case kDataType_Array:
 			elementInfo += "(Array ID #";
-			sprintf_s(numBuf, sizeof(numBuf), "%.0f", iter->second.m_data.num);
+			sprintf_s(numBuf, sizeof(numBuf), "%.0f", elem.m_data.num);
 			elementInfo += numBuf;
 			elementInfo += ")";
 			break;
 		case kDataType_Form:
 			{
-				UInt32 refID = iter->second.m_data.formID;
+				UInt32 refID = elem.m_data.formID;
 				sprintf_s(numBuf, sizeof(numBuf), "%08X", refID);
 				TESForm* form = LookupFormByID(refID);
 				if (form)
@@ -483,14 +680,15 @@ void ArrayVar::Dump()
 
 void ArrayVar::Pack()
 {
-	if (!IsPacked() || !Size())
+	// packed storage never has holes
+	if (!IsPacked() || HasPackedStorage() || !Size())
 		return;
 
 	// assume only one hole exists (i.e. we previously erased 0 or more contiguous elements)
 	// these are double but will always hold integer values for packed arrays
 	double curIdx = 0;		// last correct index
 
-	ArrayIterator iter;
+	_ElementMap::iterator iter;
 	for (iter = m_elements.begin(); iter != m_elements.end(); )
 	{
 		if (!(iter->first == curIdx))
@@ -498,9 +696,9 @@ void ArrayVar::Pack()
 			ArrayElement* elem = Get(ArrayKey(curIdx), true);
 			elem->Set(iter->second);
 			iter->second.Unset();
-			ArrayIterator toDelete = iter;
+			_ElementMap::iterator toDelete = iter;
 			++iter;
-			m_elements.erase(toDelete);
+			Erase(ArrayIterator(this, toDelete, 0), ArrayIterator(this, iter, 0));
 		}
 		else
 			++iter;
@@ -528,12 +726,10 @@ void ArrayVarMap::Erase(ArrayID toErase)
 	if (var)
 	{
 		// delete any arrays contained in array
-		for (ArrayIterator iter = var->m_elements.begin(); iter != var->m_elements.end(); ++iter)
+		for (ArrayIterator iter = var->Begin(); iter != var->End(); ++iter)
 		{
-			iter->second.Unset();
+			iter.Element().Unset();
 		}
-			
-		delete var;
 	}
 
 	Delete(toErase);
@@ -561,11 +757,10 @@ void ArrayVarMap::Add(ArrayVar* var, UInt32 varID, UInt32 numRefs, UInt8* refs)
 
 ArrayID	ArrayVarMap::Create(UInt32 keyType, bool bPacked, UInt8 modIndex)
 {
-	ArrayVar* newVar = new ArrayVar(keyType, bPacked, modIndex);
+	ArrayVar* newVar = new (AllocateVar()) ArrayVar(keyType, bPacked, modIndex);
 	ArrayID varID = GetUnusedID();
 	newVar->m_ID = varID;
-	VarMap::Insert(varID, newVar);
-	MarkTemporary(varID, true);		// queue for deletion until a reference to this array is made
+	InsertTemporary(varID, newVar);		// queue for deletion until a reference to this array is made
 	return varID;
 }
 
@@ -576,23 +771,23 @@ ArrayID ArrayVarMap::Copy(ArrayID from, UInt8 modIndex, bool bDeepCopy)
 		return 0;
 
 	ArrayID copyID = Create(src->KeyType(), src->IsPacked(), modIndex);
-	for (ArrayIterator iter = src->m_elements.begin(); iter != src->m_elements.end(); ++iter)
+	for (ArrayIterator iter = src->Begin(); iter != src->End(); ++iter)
 	{
-		if (iter->second.DataType() == kDataType_Array && bDeepCopy)
+		if (iter.Element().DataType() == kDataType_Array && bDeepCopy)
 		{
 			ArrayID innerID = 0;
 			ArrayID innerCopyID = 0;
-			if (iter->second.GetAsArray(&innerID))
+			if (iter.Element().GetAsArray(&innerID))
 				innerCopyID = Copy(innerID, modIndex, true);
 
-			if (!SetElementArray(copyID, iter->first, innerCopyID))
+			if (!SetElementArray(copyID, iter.Key(), innerCopyID))
 			{
 				DEBUG_PRINT("ArrayVarMap::Copy failed to make deep copy of inner array");
 			}
 		}
 		else
 		{
-			if (!SetElement(copyID, iter->first, iter->second))
+			if (!SetElement(copyID, iter.Key(), iter.Element()))
 			{
 				DEBUG_PRINT("ArrayVarMap::Copy failed to set element in copied array");
 			}
@@ -613,6 +808,7 @@ void ArrayVarMap::AddReference(ArrayID* ref, ArrayID toRef, UInt8 referringModIn
 	ArrayVar* arr = Get(toRef);
 	if (arr)
 	{
+		MarkDirty(toRef);
 		arr->m_refs.push_back(referringModIndex);	// record reference, increment refcount
 		*ref = toRef;								// store ref'ed ArrayID in reference
 		MarkTemporary(toRef, false);
@@ -624,6 +820,8 @@ void ArrayVarMap::RemoveReference(ArrayID* ref, UInt8 referringModIndex)
 	ArrayVar* var = Get(*ref);
 	if (var)
 	{
+		MarkDirty(*ref);
+
 		// decrement refcount
 		for (std::vector<UInt8>::iterator iter = var->m_refs.begin(); iter != var->m_refs.end(); ++iter)
 		{
@@ -667,7 +865,7 @@ ArrayID ArrayVarMap::MakeSlice(ArrayID src, const Slice* slice, UInt8 modIndex)
 	if (!srcVar)
 		return 0;
 	
-	std::map<ArrayKey, ArrayElement>::iterator start, end;
+	ArrayIterator start, end;
 	ArrayKey lo;
 	ArrayKey hi;
 
@@ -688,23 +886,19 @@ ArrayID ArrayVarMap::MakeSlice(ArrayID src, const Slice* slice, UInt8 modIndex)
 	ArrayID newID = Create(srcVar->KeyType(), srcVar->IsPacked(), modIndex);
 	bool bPacked = srcVar->IsPacked();
 
-	for (start = srcVar->m_elements.begin(); start != srcVar->m_elements.end(); ++start)
-	{
-		if (start->first >= lo)
-			break;
-	}
+	start = srcVar->LowerBound(lo);
 
 	UInt32 packedIndex = 0;
 
-	for (end = start; end != srcVar->m_elements.end(); ++end)
+	for (end = start; end != srcVar->End(); ++end)
 	{
-		if (end->first > hi)
+		if (end.Key() > hi)
 			break;
 
 		if (bPacked)
-			SetElement(newID, packedIndex++, end->second);
+			SetElement(newID, packedIndex++, end.Element());
 		else
-			SetElement(newID, end->first, end->second);
+			SetElement(newID, end.Key(), end.Element());
 	}
 
 	return newID;
@@ -739,12 +933,12 @@ ArrayID ArrayVarMap::GetKeys(ArrayID id, UInt8 modIndex)
 	UInt8 keysType = src->KeyType();
 	UInt32 curIdx = 0;
 
-	for (ArrayIterator iter = src->m_elements.begin(); iter != src->m_elements.end(); ++iter)
+	for (ArrayIterator iter = src->Begin(); iter != src->End(); ++iter)
 	{
 		if (keysType == kDataType_Numeric)
-			SetElementNumber(keyArrID, curIdx, iter->first.Key().num);
+			SetElementNumber(keyArrID, curIdx, iter.Key().Key().num);
 		else
-			SetElementString(keyArrID, curIdx, iter->first.Key().str);
+			SetElementString(keyArrID, curIdx, iter.Key().Key().str);
 		curIdx++;
 	}
 
@@ -757,7 +951,7 @@ bool ArrayVarMap::HasKey(ArrayID id, const ArrayKey& key)
 	if (!arr || arr->KeyType() != key.KeyType())
 		return false;
 
-	return (arr->m_elements.find(key) != arr->m_elements.end());
+	return (arr->Find(key) != arr->End());
 }
 
 bool ArrayVarMap::AsVector(ArrayID id, std::vector<const ArrayElement*> &vecOut)
@@ -782,8 +976,20 @@ bool ArrayVarMap::SetSize(ArrayID id, UInt32 newSize, const ArrayElement& padWit
 
 	if (arr->Size() < newSize)
 	{
-		for (UInt32 i = arr->Size(); i < newSize; i++)
-			SetElement(id, ArrayKey(i), padWith);
+		if (arr->HasPackedStorage())
+		{
+			// padWith may be an element of this array
+			ArrayElement pad = padWith;
+			UInt32 oldSize = arr->Size();
+			arr->InsertUninitialized(oldSize, newSize - oldSize);
+			for (UInt32 i = oldSize; i < newSize; i++)
+				arr->m_packedElements[i].Set(pad);
+		}
+		else
+		{
+			for (UInt32 i = arr->Size(); i < newSize; i++)
+				SetElement(id, ArrayKey(i), padWith);
+		}
 	}
 	else if (arr->Size() > newSize)
 		return EraseElements(id, ArrayKey(newSize), ArrayKey(arr->Size() - 1)) != -1;
@@ -797,6 +1003,14 @@ bool ArrayVarMap::Insert(ArrayID id, UInt32 atIndex, const ArrayElement& toInser
 	if (!arr || !arr->IsPacked() || atIndex > arr->Size())
 		return false;
 	
+	if (arr->HasPackedStorage())
+	{
+		// toInsert may be an element of this array
+		ArrayElement elem = toInsert;
+		arr->InsertUninitialized(atIndex, 1)->Set(elem);
+		return true;
+	}
+
 	if (atIndex < arr->Size())	
 	{
 		// shift higher elements up by one
@@ -818,6 +1032,17 @@ bool ArrayVarMap::Insert(ArrayID id, UInt32 atIndex, ArrayID rangeID)
 
 	UInt32 shiftDelta = src->Size();
 
+	if (dest->HasPackedStorage() && src->HasPackedStorage())
+	{
+		// copy first, src may be dest
+		std::vector<ArrayElement> range(src->m_packedElements);
+		ArrayElement* elems = dest->InsertUninitialized(atIndex, shiftDelta);
+		for (UInt32 i = 0; i < shiftDelta; i++)
+			elems[i].Set(range[i]);
+
+		return true;
+	}
+
 	// resize, pad with empty elements
 	SetSize(id, dest->Size() + shiftDelta, ArrayElement());
 
@@ -909,17 +1134,17 @@ ArrayID ArrayVarMap::Sort(ArrayID src, SortOrder order, SortType type, UInt8 mod
 	// restriction: all elements of src must be of the same type for default sort
 	// restriction not in effect for alpha sort (all values treated as strings) or custom sort (all values boxed as arrays)
 	std::vector<ArrayElement> vec;
-	ArrayIterator iter = srcVar->m_elements.begin();
-	UInt32 dataType = iter->second.DataType();
+	ArrayIterator iter = srcVar->Begin();
+	UInt32 dataType = iter.Element().DataType();
 	if (dataType == kDataType_Invalid || dataType == kDataType_Array)	// nonsensical to sort array of arrays
 		return result;
 
 	// copy elems to vec, verify all are of same type
-	for ( ; iter != srcVar->m_elements.end(); ++iter)
+	for ( ; iter != srcVar->End(); ++iter)
 	{
-		if (type == kSortType_Default && iter->second.DataType() != dataType)
+		if (type == kSortType_Default && iter.Element().DataType() != dataType)
 			return result;
-		vec.push_back(iter->second);
+		vec.push_back(iter.Element());
 	}
 
 	// let STL do the sort
@@ -951,20 +1176,22 @@ UInt32 ArrayVarMap::EraseElements(ArrayID id, const ArrayKey& lo, const ArrayKey
 		return -1;
 
 	// find first elem to erase
-	std::map<ArrayKey, ArrayElement>::iterator iter = var->m_elements.begin();
-	while (iter != var->m_elements.end() && iter->first < lo)
-		++iter;
+	ArrayIterator first = var->LowerBound(lo);
 
 	UInt32 numErased = 0;
 
-	// erase. if element is an arrayID, clean up that array
-	while (iter != var->m_elements.end() && iter->first <= hi)
+	// unset, if element is an arrayID this cleans up that array
+	ArrayIterator last = first;
+	while (last != var->End() && last.Key() <= hi)
 	{
-		iter->second.Unset();
-		iter = var->m_elements.erase(iter);
+		last.Element().Unset();
+		++last;
 		numErased++;
 	}
 
+	// erase, for packed arrays this also shifts higher elements down
+	var->Erase(first, last);
+
 	// if array is packed we must shift elements down
 	if (var->IsPacked())
 		var->Pack();
@@ -977,12 +1204,13 @@ UInt32 ArrayVarMap::EraseAllElements(ArrayID id)
 	UInt32 numErased = -1;
 	ArrayVar* var = Get(id);	
 	if (var) {
-		while (var->m_elements.begin() != var->m_elements.end())
+		for (ArrayIterator iter = var->Begin(); iter != var->End(); ++iter)
 		{
-			var->m_elements.begin()->second.Unset();
-			var->m_elements.erase(var->m_elements.begin());
+			iter.Element().Unset();
 			numErased++;
 		}
+
+		var->Erase(var->Begin(), var->End());
 	}
 
 	return numErased;
@@ -1081,7 +1309,7 @@ bool ArrayVarMap::GetElementCString(ArrayID id, const ArrayKey& key, const char*
 		ArrayElement* elem = arr->Get(key, false);
 		if (elem && elem->DataType() == kDataType_String)
 		{
-			*out = elem->m_data.str.c_str();
+			*out = elem->StrData();
 			return true;
 		}
 	}
@@ -1172,91 +1400,273 @@ void ArrayVarMap::DumpArray(ArrayID toDump)
 	}
 }
 
+//////////////////////////
+// serialization, records are encoded and decoded by CoSaveRecords
+/////////////////////////
+
+// describes an element for WriteArrayRecord(), strings point into the element
+static void GetSavedValue(const ArrayElement& elem, SavedValue& out)
+{
+	out.type = elem.m_dataType;
+	switch (elem.m_dataType)
+	{
+	case kDataType_Numeric:
+		out.num = elem.m_data.num;
+		break;
+	case kDataType_Array:
+		out.arrayID = (ArrayID)elem.m_data.num;
+		break;
+	case kDataType_String:
+		out.str.data = elem.StrData();
+		out.str.len = elem.StrLength();
+		break;
+	case kDataType_Form:
+		out.formID = elem.m_data.formID;
+		break;
+	case kDataType_Invalid:
+		// uninitialized, e.g. padding left by ar_Resize. Its type run is all that's needed to restore it
+		break;
+	default:
+		_MESSAGE("Error in ArrayVarMap::Save() - unhandled element type %d. Element not saved.", elem.m_dataType);
+	}
+}
+
 void ArrayVarMap::Save(OBSESerializationInterface* intfc)
 {
 	Clean();
 
-	intfc->OpenRecord('ARVS', kVersion);
+	// records are encoded first so the string table, which has to precede them, is complete
+	SaveStringTable strings;
+	std::vector<UInt8> records;
+	std::vector<UInt32> recordEnds;
+	std::vector<SavedElement> elements;
 
-	std::map<UInt32, ArrayVar*> & vars = m_state->vars;
-	for (std::map<UInt32, ArrayVar*>::iterator iter = vars.begin(); iter != vars.end(); ++iter)
+	for (Iterator iter(m_state); !iter.Done(); iter.Next())
 	{
-		if (IsTemporary(iter->first))
+		if (IsTemporary(iter.ID()))
 			continue;
 
-		intfc->OpenRecord('ARVR', kVersion);
-		intfc->WriteRecordData(&iter->second->m_owningModIndex, sizeof(UInt8));
-		intfc->WriteRecordData(&iter->first, sizeof(UInt32));
-		intfc->WriteRecordData(&iter->second->m_keyType, sizeof(UInt8));
-		intfc->WriteRecordData(&iter->second->m_bPacked, sizeof(bool));
-		
-		UInt32 numRefs = iter->second->m_refs.size();
-		intfc->WriteRecordData(&numRefs, sizeof(numRefs));
-		if (!numRefs)
-			_MESSAGE("ArrayVarMap::Save(): saving array with no references");
+		ArrayVar* arr = iter.Get();
 
-		for (UInt32 i = 0; i < numRefs; i++)
-			intfc->WriteRecordData(&iter->second->m_refs[i], sizeof(UInt8));
+		SavedArrayHeader header;
+		header.modIndex = arr->m_owningModIndex;
+		header.id = iter.ID();
+		header.keyType = arr->m_keyType;
+		header.bPacked = arr->m_bPacked;
+		header.numRefs = arr->m_refs.size();
+		header.refs = header.numRefs ? &arr->m_refs[0] : NULL;
 
-		UInt32 numElements = iter->second->Size();
-		intfc->WriteRecordData(&numElements, sizeof(UInt32));
+		if (!header.numRefs)
+			_MESSAGE("ArrayVarMap::Save(): saving array with no references");
 
-		UInt8 keyType = iter->second->m_keyType;
-		for (std::map<ArrayKey, ArrayElement>::iterator elems = iter->second->m_elements.begin();
-			elems != iter->second->m_elements.end(); ++elems)
+		elements.resize(arr->Size());
+		if (arr->HasPackedStorage())
 		{
-			ArrayType key = elems->first.Key();
-			if (keyType == kDataType_Numeric)
-				intfc->WriteRecordData(&key.num, sizeof(double));
-			else
+			for (UInt32 i = 0; i < elements.size(); i++)
 			{
-				UInt16 len = key.str.length();
-				intfc->WriteRecordData(&len, sizeof(len));
-				intfc->WriteRecordData(key.str.c_str(), key.str.length());
+				elements[i].key.type = kDataType_Numeric;
+				elements[i].key.num = i;
+				GetSavedValue(arr->m_packedElements[i], elements[i].value);
 			}
-
-			intfc->WriteRecordData(&elems->second.m_dataType, sizeof(UInt8));
-			switch (elems->second.m_dataType)
+		}
+		else
+		{
+			// the map is walked directly, ArrayIterator::Key() returns copies of the keys
+			UInt32 i = 0;
+			for (ArrayVar::_ElementMap::const_iterator elems = arr->m_elements.begin(); elems != arr->m_elements.end(); ++elems, ++i)
 			{
-			case kDataType_Numeric:
-				intfc->WriteRecordData(&elems->second.m_data.num, sizeof(double));
-				break;
-			case kDataType_String:
-				{
-					UInt16 len = elems->second.m_data.str.length();
-					intfc->WriteRecordData(&len, sizeof(len));
-					intfc->WriteRecordData(elems->second.m_data.str.c_str(), elems->second.m_data.str.length());
-					break;
-				}
-			case kDataType_Array:
+				const ArrayKey& key = elems->first;
+				elements[i].key.type = key.KeyType();
+				if (key.KeyType() == kDataType_Numeric)
+					elements[i].key.num = key.Key().num;
+				else
 				{
-					ArrayID id = elems->second.m_data.num;
-					intfc->WriteRecordData(&id, sizeof(id));
-					break;
+					elements[i].key.str.data = key.StrKey().data();
+					elements[i].key.str.len = key.StrKey().length();
 				}
-			case kDataType_Form:
-				intfc->WriteRecordData(&elems->second.m_data.formID, sizeof(UInt32));
-				break;
-			default:
-				_MESSAGE("Error in ArrayVarMap::Save() - unhandled element type %d. Element not saved.", elems->second.m_dataType);
+
+				GetSavedValue(elems->second, elements[i].value);
 			}
 		}
+
+		WriteArrayRecord(records, header, elements.size() ? &elements[0] : NULL, elements.size(), strings);
+		recordEnds.push_back(records.size());
+	}
+
+	intfc->OpenRecord('ARVS', kVersion);
+
+	std::vector<UInt8> table;
+	strings.Write(table);
+	intfc->WriteRecord('ARVT', kVersion, &table[0], table.size());
+
+	UInt32 recordStart = 0;
+	for (UInt32 i = 0; i < recordEnds.size(); i++)
+	{
+		intfc->WriteRecord('ARVR', kVersion, &records[recordStart], recordEnds[i] - recordStart);
+		recordStart = recordEnds[i];
 	}
 
 	intfc->OpenRecord('ARVE', kVersion);
 }
 
+// returns true if the mod owning an array is no longer loaded, otherwise fixes up modIndex
+static bool ResolveArrayOwner(OBSESerializationInterface* intfc, UInt8& modIndex)
+{
+	UInt32 tempRefID;
+	if (!intfc->ResolveRefID(modIndex << 24, &tempRefID))
+	{
+		// owning mod was removed, but there may be references to it from other mods
+		// assign ownership to the first mod which refers to it and is still loaded
+		// if no loaded mods refer to it, discard
+		_MESSAGE("Mod owning array was removed from load order; will attempt to assign ownership to a referring mod.");
+		modIndex = 0;  //index 0 by itself don't indicate an unloaded mod mod.
+		return true;
+	}
+
+	modIndex = (tempRefID >> 24);
+	return false;
+}
+
+// fix up mod indexes of references in place, discarding refs from unloaded mods
+static void ResolveArrayRefs(OBSESerializationInterface* intfc, ArrayID arrayID, UInt8& modIndex, bool& isUnloaded, UInt8* refs, UInt32& numRefs)
+{
+	UInt32 tempRefID = 0;
+	UInt32 refIdx = 0;
+	for (UInt32 i = 0; i < numRefs; i++) {
+		if (intfc->ResolveRefID(refs[i] << 24, &tempRefID)) {
+			if (isUnloaded) {
+				modIndex = tempRefID >> 24;
+				_MESSAGE("ArrayID %d was owned by an unloaded mod. Assigning ownership to mod #%d", arrayID, modIndex);
+				isUnloaded = false;
+			}
+			refs[refIdx++] = (tempRefID >> 24);
+		}
+	}
+
+	numRefs = refIdx;
+}
+
+static ArrayKey MakeArrayKey(const SavedValue& key)
+{
+	if (key.type == kDataType_Numeric)
+		return ArrayKey(key.num);
+
+	return ArrayKey(std::string(key.str.data, key.str.len));
+}
+
+void ArrayVarMap::LoadRecord(OBSESerializationInterface* intfc, UInt32 version, UInt32 length, const std::vector<SavedString>& strings,
+	std::vector<SavedElement>& elements, UInt32& lastIndexRead)
+{
+	RecordCursor record(intfc->ReadRecordSpan(length), length);
+
+	SavedArrayHeader header;
+	if (!ReadArrayHeader(record, version, header))
+	{
+		_MESSAGE("ArrayVarMap::Load() truncated array record");
+		return;
+	}
+
+	UInt8 modIndex = header.modIndex;
+	ArrayID arrayID = header.id;
+	bool isUnloaded = ResolveArrayOwner(intfc, modIndex);
+
+	// read refs, fix up mod indexes, discard refs from unloaded mods
+	std::vector<UInt8> refs;
+	if (header.refs)
+	{
+		refs.assign(header.refs, header.refs + header.numRefs);
+		UInt32 numRefs = refs.size();
+		if (numRefs)
+			ResolveArrayRefs(intfc, arrayID, modIndex, isUnloaded, &refs[0], numRefs);
+		refs.resize(numRefs);
+	}
+	else if (!isUnloaded)		// v0 arrays assumed to have only one reference (the owning mod)
+		refs.push_back(modIndex);
+
+	if (isUnloaded && !modIndex)
+	{
+		_MESSAGE("Array ID %d is referred to by no loaded mods. Discarding", arrayID);
+		return;
+	}
+
+	// record gaps between IDs for easy lookup later in GetUnusedID()
+	lastIndexRead++;
+	while (lastIndexRead < arrayID)
+	{
+		SetIDAvailable(lastIndexRead);
+		lastIndexRead++;
+	}
+
+	// create array and add to map
+	ArrayVar* newArr = new (AllocateVar()) ArrayVar(header.keyType, header.bPacked, modIndex);
+	Add(newArr, arrayID, refs.size(), refs.size() ? &refs[0] : NULL);
+
+	// a damaged record keeps the elements decoded before the damage
+	elements.clear();
+	bool bComplete = ReadArrayElements(record, version, header, strings, elements);
+
+	for (UInt32 i = 0; i < elements.size(); i++)
+	{
+		const SavedValue& value = elements[i].value;
+		if (version < 2 && (value.type == kDataType_Invalid || value.type > kDataType_Array))
+		{
+			_MESSAGE("Unknown element type %d encountered while loading array var, element discarded.", value.type);
+			continue;
+		}
+
+		// every saved element is created, even uninitialized ones, so packed arrays keep growing in step with their keys
+		ArrayElement* elem = newArr->Get(MakeArrayKey(elements[i].key), true);
+		if (!elem)
+		{
+			_MESSAGE("ArrayVarMap::Load() couldn't create element %d of array %d", i, arrayID);
+			return;
+		}
+
+		switch (value.type)
+		{
+		case kDataType_Numeric:
+			elem->SetNumber(value.num);
+			break;
+		case kDataType_String:
+			elem->SetString(value.str.data, value.str.len);
+			break;
+		case kDataType_Array:
+			// references were saved with the array, so don't add one here
+			elem->m_dataType = kDataType_Array;
+			elem->m_data.num = value.arrayID;
+			elem->m_owningArray = arrayID;
+			break;
+		case kDataType_Form:
+			{
+				UInt32 formID;
+				if (!intfc->ResolveRefID(value.formID, &formID))
+					formID = 0;
+
+				elem->SetFormID(formID);
+				break;
+			}
+		case kDataType_Invalid:
+			// no value was saved, the element stays uninitialized
+			break;
+		default:
+			_MESSAGE("Unknown element type %d encountered while loading array var, element left uninitialized.", value.type);
+			break;
+		}
+	}
+
+	if (!bComplete)
+		_MESSAGE("ArrayVarMap::Load() truncated array record");
+}
+
 void ArrayVarMap::Load(OBSESerializationInterface* intfc)
 {
 	_MESSAGE("Loading array variables");
 
 	Clean();		// clean up any vars queued for garbage collection
 
-	UInt32 type, length, version, arrayID, tempRefID, numElements;
-	UInt16 strLength;
-	UInt8 modIndex, keyType;
-	bool bPacked;
-	char buffer[kMaxMessageLength] = { 0 };
+	UInt32 type, length, version;
+	std::vector<SavedString> strings;		// v2 string table, points into the loaded co-save
+	std::vector<SavedElement> elements;
 
 	//Reset(intfc);
 	bool bContinue = true;
@@ -1270,163 +1680,16 @@ void ArrayVarMap::Load(OBSESerializationInterface* intfc)
 		case 'ARVE':			//end of block
 			bContinue = false;
 			break;
-		case 'ARVR':
+		case 'ARVT':
 			{
-				bool isUnloaded = false;
-				intfc->ReadRecordData(&modIndex, sizeof(modIndex));
-				if (!intfc->ResolveRefID(modIndex << 24, &tempRefID))
-				{
-					// owning mod was removed, but there may be references to it from other mods
-					// assign ownership to the first mod which refers to it and is still loaded
-					// if no loaded mods refer to it, discard
-					// we handle all of that below
-					_MESSAGE("Mod owning array was removed from load order; will attempt to assign ownership to a referring mod.");
-					modIndex = 0;  //index 0 by itself don't indicate an unloaded mod mod. 
-					isUnloaded = true;  
-				}
-				else
-					modIndex = (tempRefID >> 24);
-
-				intfc->ReadRecordData(&arrayID, sizeof(arrayID));
-				intfc->ReadRecordData(&keyType, sizeof(keyType));
-				intfc->ReadRecordData(&bPacked, sizeof(bPacked));
-
-				// read refs, fix up mod indexes, discard refs from unloaded mods
-				UInt32 numRefs = 0;		// # of references to this array
-				UInt8* refs = NULL;		// mod indexes of mods referring to this array
-
-				// reference-counting implemented in v1
-				if (version >= 1){
-					intfc->ReadRecordData(&numRefs, sizeof(numRefs));
-					if (numRefs){
-						refs = new UInt8[numRefs];
-						UInt32 tempRefID = 0;
-						UInt8 curModIndex = 0;
-						UInt32 refIdx = 0;
-						for (UInt32 i = 0; i < numRefs; i++) {
-							intfc->ReadRecordData(&curModIndex, sizeof(curModIndex));
-
-							if (intfc->ResolveRefID(curModIndex << 24, &tempRefID)) {
-								if (isUnloaded) {
-									modIndex = tempRefID >> 24;
-									_MESSAGE("ArrayID %d was owned by an unloaded mod. Assigning ownership to mod #%d", arrayID, modIndex);
-									isUnloaded = false;
-								}
-								refs[refIdx++] = (tempRefID >> 24);
-							}	
-						}
-
-						numRefs = refIdx;
-					}
-				}
-				else		// v0 arrays assumed to have only one reference (the owning mod)
-				{
-					if (!isUnloaded)		// owning mod is loaded
-					{
-						numRefs = 1;
-						refs = new UInt8[1];
-						refs[0] = modIndex;
-					}
-				}
-				
-				if (isUnloaded && !modIndex )
-				{
-					_MESSAGE("Array ID %d is referred to by no loaded mods. Discarding", arrayID);
-					delete[] refs;
-					continue;
-				}
-
-				// record gaps between IDs for easy lookup later in GetUnusedID()
-				lastIndexRead++;
-				while (lastIndexRead < arrayID)
-				{
-					SetIDAvailable(lastIndexRead);
-					lastIndexRead++;
-				}
-				
-				// create array and add to map
-				ArrayVar* newArr = new ArrayVar(keyType, bPacked, modIndex);
-				Add(newArr, arrayID, numRefs, refs);
-				delete[] refs;
-
-				// read the array elements			
-				intfc->ReadRecordData(&numElements, sizeof(numElements));
-				for (UInt32 i = 0; i < numElements; i++)
-				{
-					ArrayKey newKey;
-					if (keyType == kDataType_Numeric)
-					{
-						double num;
-						intfc->ReadRecordData(&num, sizeof(double));
-						newKey = num;
-					}
-					else
-					{
-						intfc->ReadRecordData(&strLength, sizeof(strLength));
-						intfc->ReadRecordData(buffer, strLength);
-						buffer[strLength] = 0;
-						newKey = std::string(buffer);
-					}
-
-					UInt8 elemType;
-					if (intfc->ReadRecordData(&elemType, sizeof(elemType)) == 0)
-					{
-						_MESSAGE("ArrayVarMap::Load() reading past end of file");
-						return;
-					}
-
-					switch (elemType)
-					{
-					case kDataType_Numeric:
-						{
-							double num;
-							intfc->ReadRecordData(&num, sizeof(num));
-							SetElementNumber(arrayID, newKey, num);
-							break;
-						}
-					case kDataType_String:
-						{
-							intfc->ReadRecordData(&strLength, sizeof(strLength));
-							intfc->ReadRecordData(buffer, strLength);
-							buffer[strLength] = 0;
-							SetElementString(arrayID, newKey, std::string(buffer));
-							break;
-						}
-					case kDataType_Array:
-						{
-							ArrayID id;
-							intfc->ReadRecordData(&id, sizeof(id));
-							if (newArr)
-							{
-								ArrayElement* elem = newArr->Get(newKey, true);
-								if (elem)
-								{
-									elem->m_dataType = kDataType_Array;
-									elem->m_data.num = id;
-									elem->m_owningArray = arrayID;
-								}
-							}
-
-							break;
-						}
-					case kDataType_Form:
-						{
-							UInt32 formID;
-							intfc->ReadRecordData(&formID, sizeof(formID));
-							if (!intfc->ResolveRefID(formID, &formID))
-								formID = 0;
-
-							SetElementFormID(arrayID, newKey, formID);
-							break;
-						}
-						break;
-					default:
-						_MESSAGE("Unknown element type %d encountered while loading array var, element discarded.", elemType);
-						break;
-					}
-				}
+				RecordCursor record(intfc->ReadRecordSpan(length), length);
+				if (!ReadStringTable(record, strings))
+					_MESSAGE("ArrayVarMap::Load() truncated string table");
 			}
 			break;
+		case 'ARVR':
+			LoadRecord(intfc, version, length, strings, elements, lastIndexRead);
+			break;
 		default:
 			_MESSAGE("Error loading array var map: unexpected chunk type %d", type);
 			break;
@@ -1440,9 +1703,9 @@ bool ArrayVarMap::GetFirstElement(ArrayID id, ArrayElement* outElem, ArrayKey* o
 	if (!var || !var->Size() || !outElem || !outKey)
 		return false;
 
-	std::map<ArrayKey, ArrayElement>::iterator iter = var->m_elements.begin();
-	*outKey = iter->first;
-	*outElem = iter->second;
+	ArrayIterator iter = var->Begin();
+	*outKey = iter.Key();
+	*outElem = iter.Element();
 	return true;
 }
 
@@ -1452,14 +1715,14 @@ bool ArrayVarMap::GetLastElement(ArrayID id, ArrayElement* outElem, ArrayKey* ou
 	if (!var || !var->Size() || !outElem || !outKey)
 		return false;
 
-	ArrayIterator iter = var->m_elements.end();
+	ArrayIterator iter = var->End();
 	if (var->Size() > 1)
 		--iter;
 	else		// only one element
-		iter= var->m_elements.begin();
+		iter= var->Begin();
 
-	*outKey = iter->first;
-	*outElem = iter->second;
+	*outKey = iter.Key();
+	*outElem = iter.Element();
 	return true;
 }
 
@@ -1469,16 +1732,16 @@ bool ArrayVarMap::GetNextElement(ArrayID id, ArrayKey* prevKey, ArrayElement* ou
 	if (!var || !var->Size() || !outElem || !outKey || !prevKey)
 		return false;
 
-	std::map<ArrayKey, ArrayElement>::iterator iter = var->m_elements.find(*prevKey);
-	if (iter != var->m_elements.end())
+	ArrayIterator iter = var->Find(*prevKey);
+	if (iter != var->End())
 	{
 		++iter;
-		if (iter != var->m_elements.end())
+		if (iter != var->End())
 		{
 			//var->m_cachedIterator = iter;
 
-			*outKey = iter->first;
-			*outElem = iter->second;
+			*outKey = iter.Key();
+			*outElem = iter.Element();
 			return true;
 		}
 	}
@@ -1492,12 +1755,12 @@ bool ArrayVarMap::GetPrevElement(ArrayID id, ArrayKey* prevKey, ArrayElement* ou
 	if (!var || !var->Size() || !outElem || !outKey || !prevKey)
 		return false;
 
-	ArrayIterator iter = var->m_elements.find(*prevKey);
-	if (iter != var->m_elements.end() && iter != var->m_elements.begin())
+	ArrayIterator iter = var->Find(*prevKey);
+	if (iter != var->End() && iter != var->Begin())
 	{
 		--iter;
-		*outKey = iter->first;
-		*outElem = iter->second;
+		*outKey = iter.Key();
+		*outElem = iter.Element();
 		return true;
 	}
 
@@ -1511,8 +1774,8 @@ ArrayKey ArrayVarMap::Find(ArrayID toSearch, const ArrayElement& toFind, const S
 	if (!var)
 		return foundIndex;
 
-	ArrayIterator start = var->m_elements.begin();
-	ArrayIterator end = var->m_elements.end();
+	ArrayIterator start = var->Begin();
+	ArrayIterator end = var->End();
 	if (range)
 	{
 		if ((range->bIsString && var->KeyType() != kDataType_String) || (!range->bIsString && var->KeyType() != kDataType_Numeric))
@@ -1523,20 +1786,19 @@ ArrayKey ArrayVarMap::Find(ArrayID toSearch, const ArrayElement& toFind, const S
 		ArrayKey hi;
 		range->GetArrayBounds(lo, hi);
 
-		while (start != var->m_elements.end() && start->first < lo)
-			++start;
+		start = var->LowerBound(lo);
 
 		end = start;
-		while (end != var->m_elements.end() && end->first <= hi)
+		while (end != var->End() && end.Key() <= hi)
 			++end;
 	}
 
 	// do the search
 	for (ArrayIterator iter = start; iter != end; ++iter)
 	{
-		if (iter->second.Equals(toFind))
+		if (iter.Element().Equals(toFind))
 		{
-			foundIndex = iter->first;
+			foundIndex = iter.Key();
 			break;
 		}
 	}
@@ -1559,20 +1821,6 @@ std::string ArrayVarMap::GetTypeString(ArrayID arr)
 	return result;
 }
 
-void ArrayVarMap::Clean()		// garbage collection: delete unreferenced arrays
-{
-	// ArrayVar destructor may queue more IDs for deletion if deleted array contains other arrays
-	// so on each pass through the loop we delete the first ID in the queue until none remain
-
-	if (m_state) {
-		while (m_state->tempVars.size())
-		{
-			UInt32 idToDelete = *(m_state->tempVars.begin());
-			Delete(idToDelete);
-		}
-	}
-}
-
 namespace PluginAPI
 {
 	bool ArrayAPI::SetElementFromAPI(UInt32 id, const ArrayKey& key, const OBSEArrayVarInterface::Element& elem)
@@ -1727,21 +1975,21 @@ namespace PluginAPI
 
 			if (size != -1) {
 				UInt32 i = 0;
-				for (ArrayIterator iter = var->m_elements.begin(); iter != var->m_elements.end(); ++iter) {
+				for (ArrayIterator iter = var->Begin(); iter != var->End(); ++iter) {
 					if (keys) {
 						switch (keyType) {
 							case kDataType_Numeric:
-								keys[i] = iter->first.Key().num;
+								keys[i] = iter.Key().Key().num;
 								break;
 							case kDataType_String:
 								{
-									keys[i] = OBSEArrayVarInterface::Element(iter->first.Key().str.c_str());
+									keys[i] = OBSEArrayVarInterface::Element(iter.Key().Key().str.c_str());
 									break;
 								}
 						}
 					}
 					
-					InternalElemToPluginElem(iter->second, elements[i]);
+					InternalElemToPluginElem(iter.Element(), elements[i]);
 					i++;
 				}
 
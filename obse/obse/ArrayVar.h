@@ -1,6 +1,7 @@
 #pragma once
 
-typedef UInt32 ArrayID;
+#include "ArrayVarTypes.h"
+
 class ArrayVar;
 class ArrayVarMap;
 struct Slice;
@@ -12,10 +13,12 @@ struct ScriptToken;
 
 #include "VarMap.h"
 #include "Serialization.h"
+#include "CoSaveRecords.h"
 #include "GameAPI.h"
 #include <map>
+#include <unordered_map>
 
-// OBSE array datatype, represented by std::map<ArrayKey, ArrayElement>
+// OBSE array datatype, represented by std::map<ArrayKey, ArrayElement>, or std::vector<ArrayElement> indexed by key for packed arrays
 // Data elements can be of mixed types (string, UInt32/formID, float)
 // Keys can be doubles or strings
 // Can optionally be treated as vector (i.e. removal of an element shifts upper elements down)
@@ -47,22 +50,36 @@ Key		::= { string || double }
 			...
 	ARVE - empty chunk indicating end of variables
 
+** v2 ** records are encoded compactly, keys and values in columns:
+VarInt	::= { UInt8 bytes[] } 7 bits per byte, low bits first, high bit set on all but the last byte
+Number	::= { VarInt (zigzag(int) << 1) || VarInt 1; double num }  integers are stored as varints
+
+	ARVS
+		ARVT - strings used by the arrays, each stored once
+			VarInt	numStrings
+			{ VarInt len; char data[len]; } [numStrings]
+		ARVR
+			UInt8	modIndex
+			UInt32	ID
+			UInt8	keyType
+			bool	packed
+			VarInt	numRefs
+			UInt8	refs[numRefs]
+			VarInt	numElements
+			keys	none for packed arrays (always 0 to numElements - 1), else Number or VarInt index into ARVT per element
+			VarInt	numTypeRuns
+			{ UInt8 elementType; VarInt count; } [numTypeRuns]
+			values	per element, Number || VarInt index into ARVT || VarInt arrayID || UInt32 formID
+		[ARVR]
+			...
+	ARVE
+
 As with string variables, array vars discarded on load if owning mod no longer present in modlist
 
 */
 
 //#if OBLIVION
 
-enum
-{
-	kDataType_Invalid,
-
-	kDataType_Numeric,
-	kDataType_Form,
-	kDataType_String,
-	kDataType_Array,
-};
-
 struct ArrayType {
 	union {
 		double		num;
@@ -72,23 +89,43 @@ struct ArrayType {
 	std::string		str;
 };
 
+// element data is tagged by m_dataType. Strings of up to kMaxShortString chars are stored inline, longer ones
+// in a heap buffer, so an element is 16 bytes regardless of type
 struct ArrayElement
 {
-//	ArrayElement(const ArrayElement& copyFrom);
-//	ArrayElement& operator=(const ArrayElement& rhs);
+	enum {
+		kMaxShortString	= 7,
+		kLongString		= 0xFF,		// m_strLen value for heap strings
+	};
 
 	friend class ArrayVar;
 	friend class ArrayVarMap;
 
-	ArrayType	m_data;
+	union ElementData {
+		double		num;
+		UInt32		formID;
+		char		shortStr[kMaxShortString + 1];
+		struct {
+			char	* data;
+			UInt32	len;
+		} longStr;
+	};
+
+	ElementData	m_data;
 	UInt8		m_dataType;
+	UInt8		m_strLen;		// length of inline strings, or kLongString
 	ArrayID		m_owningArray;
 
 	void  Unset();
+	void  FreeString();
 	std::string ToString() const;
 public:
 	UInt8 DataType() const { return m_dataType; }
 
+	// only valid for string elements, data is null-terminated
+	const char* StrData() const { return m_strLen == kLongString ? m_data.longStr.data : m_data.shortStr; }
+	UInt32 StrLength() const { return m_strLen == kLongString ? m_data.longStr.len : m_strLen; }
+
 	bool GetAsNumber(double* out) const;
 	bool GetAsString(std::string& out) const;
 	bool GetAsFormID(UInt32* out) const;
@@ -96,12 +133,20 @@ public:
 
 	bool SetForm(const TESForm* form);
 	bool SetFormID(UInt32 refID);
-	bool SetString(const std::string& str);
+	bool SetString(const std::string& str) { return SetString(str.c_str(), str.length()); }
+	bool SetString(const char* str, UInt32 len);
 	bool SetArray(ArrayID arr, UInt8 modIndex);	
 	bool SetNumber(double num);
 	bool Set(const ArrayElement& elem);
 
 	ArrayElement();
+	ArrayElement(const ArrayElement& rhs);
+	ArrayElement(ArrayElement&& rhs);
+	~ArrayElement() { FreeString(); }
+
+	// copies do not add array references, use Set() for that
+	ArrayElement& operator=(const ArrayElement& rhs);
+	ArrayElement& operator=(ArrayElement&& rhs);
 
 	static bool CompareAsString(const ArrayElement& lhs, const ArrayElement& rhs);
 
@@ -116,6 +161,7 @@ struct ArrayKey
 private:
 	ArrayType	key;
 	UInt8		keyType;
+	UInt32		hash;		// case-insensitive hash of string keys
 public:
 	ArrayKey();
 	ArrayKey(const std::string& _key);
@@ -123,7 +169,9 @@ public:
 	ArrayKey(const char* _key);
 
 	ArrayType	Key() const	{	return key;	}
+	const std::string&	StrKey() const	{ return key.str; }		// Key() without copying the string
 	UInt8		KeyType() const { return keyType; }
+	UInt32		Hash() const	{ return hash; }
 	void		SetNumericKey(double newVal)	{	keyType = kDataType_Numeric; key.num = newVal;	}
 	bool		IsValid() const { return keyType != kDataType_Invalid;	}
 
@@ -132,18 +180,57 @@ public:
 	bool operator>=(const ArrayKey& rhs) const { return !(*this < rhs);	}
 	bool operator>(const ArrayKey& rhs) const { return !(*this < rhs || *this == rhs); }
 	bool operator<=(const ArrayKey& rhs) const { return !(*this > rhs); }
+
+	// hashing consistent with the ordering of string keys, i.e. keys which compare equivalent hash the same
+	struct HashCI {
+		size_t operator()(const ArrayKey* k) const { return k->hash; }
+	};
+	struct EqualCI {
+		bool operator()(const ArrayKey* lhs, const ArrayKey* rhs) const { return !(*lhs < *rhs) && !(*rhs < *lhs); }
+	};
 };
 
-typedef std::map<ArrayKey, ArrayElement>::iterator ArrayIterator;
+// visits the elements of an ArrayVar in key order regardless of how the array stores them
+class ArrayIterator
+{
+	friend class ArrayVar;
+
+	typedef std::map<ArrayKey, ArrayElement>::iterator _MapIterator;
+
+	ArrayVar		* m_var;
+	_MapIterator	m_mapIter;
+	UInt32			m_index;		// packed arrays
+
+	ArrayIterator(ArrayVar* var, _MapIterator mapIter, UInt32 index) : m_var(var), m_mapIter(mapIter), m_index(index) { }
+public:
+	ArrayIterator() : m_var(NULL), m_index(0) { }
+
+	inline ArrayKey			Key() const;
+	inline ArrayElement&	Element() const;
+
+	inline ArrayIterator&	operator++();
+	inline ArrayIterator&	operator--();
+	inline bool				operator==(const ArrayIterator& rhs) const;
+	bool					operator!=(const ArrayIterator& rhs) const { return !(*this == rhs); }
+};
 
 class ArrayVar
 {
 	friend class ArrayVarMap;
+	friend class ArrayIterator;
 	friend class Matrix;
 	friend class PluginAPI::ArrayAPI;
 
 	typedef std::map<ArrayKey, ArrayElement> _ElementMap;
-	_ElementMap m_elements;
+	typedef std::vector<ArrayElement> _ElementVector;
+	typedef std::unordered_map<const ArrayKey*, _ElementMap::iterator, ArrayKey::HashCI, ArrayKey::EqualCI> _KeyIndex;
+
+	// string maps larger than this also index their keys by hash
+	enum { kMinHashedKeys = 16 };
+
+	_ElementMap			m_elements;			// maps and string maps
+	_ElementVector		m_packedElements;	// packed arrays, element i has key i
+	_KeyIndex			m_stringIndex;		// string maps, keys in m_elements by hash. Empty until the map grows past kMinHashedKeys
 	ArrayID				m_ID;
 	UInt8				m_owningModIndex;
 	UInt8				m_keyType;
@@ -154,6 +241,21 @@ class ArrayVar
 	explicit ArrayVar(UInt8 modIndex);
 	ArrayVar(UInt32 keyType, bool packed, UInt8 modIndex);
 
+	bool HasPackedStorage() const { return m_bPacked && m_keyType == kDataType_Numeric; }
+	bool HasStringIndex() const { return !m_stringIndex.empty(); }
+	void BuildStringIndex();
+
+	// iteration in key order
+	ArrayIterator Begin();
+	ArrayIterator End();
+	ArrayIterator Find(const ArrayKey& key);
+	ArrayIterator LowerBound(const ArrayKey& key);	// first element with key >= key
+
+	// removes [first, last) without unsetting them, packed arrays shift higher elements down. Returns the element following those erased
+	ArrayIterator Erase(ArrayIterator first, ArrayIterator last);
+
+	// packed arrays only: shifts elements at and above atIndex up by count and returns the first of the new, uninitialized elements
+	ArrayElement* InsertUninitialized(UInt32 atIndex, UInt32 count);
 
 public:
 	~ArrayVar();
@@ -171,15 +273,50 @@ public:
 	bool GetElementString(const ArrayKey* key, std::string& out);
 	UInt8 KeyType() const	{ return m_keyType; }
 	bool IsPacked() const	{ return m_bPacked; }
-	UInt32 Size() const		{ return m_elements.size(); }
+	UInt32 Size() const		{ return HasPackedStorage() ? m_packedElements.size() : m_elements.size(); }
 };
 
+ArrayKey ArrayIterator::Key() const
+{
+	return m_var->HasPackedStorage() ? ArrayKey((double)m_index) : m_mapIter->first;
+}
+
+ArrayElement& ArrayIterator::Element() const
+{
+	return m_var->HasPackedStorage() ? m_var->m_packedElements[m_index] : m_mapIter->second;
+}
+
+ArrayIterator& ArrayIterator::operator++()
+{
+	if (m_var->HasPackedStorage())
+		m_index++;
+	else
+		++m_mapIter;
+	return *this;
+}
+
+ArrayIterator& ArrayIterator::operator--()
+{
+	if (m_var->HasPackedStorage())
+		m_index--;
+	else
+		--m_mapIter;
+	return *this;
+}
+
+bool ArrayIterator::operator==(const ArrayIterator& rhs) const
+{
+	return m_var->HasPackedStorage() ? m_index == rhs.m_index : m_mapIter == rhs.m_mapIter;
+}
+
 class ArrayVarMap : public VarMap<ArrayVar>
 {
 	// this gets incremented whenever serialization format changes
-	static const UInt32 kVersion = 1;
+	static const UInt32 kVersion = 2;
 
 	void Add(ArrayVar* var, UInt32 varID, UInt32 numRefs, UInt8* refs);
+	void LoadRecord(OBSESerializationInterface* intfc, UInt32 version, UInt32 length, const std::vector<SavedString>& strings,
+		std::vector<SavedElement>& elements, UInt32& lastIndexRead);
 public:
 	enum SortOrder
 	{
@@ -196,7 +333,6 @@ public:
 
 	void Save(OBSESerializationInterface* intfc);
 	void Load(OBSESerializationInterface* intfc);
-	void Clean();
 
 	ArrayID	Create(UInt32 keyType, bool bPacked, UInt8 modIndex);
 	ArrayID CreateArray(UInt8 modIndex) { return Create(kDataType_Numeric, true, modIndex); }
@@ -0,0 +1,17 @@
+#pragma once
+
+// ArrayVar types needed by code that handles array data without the rest of ArrayVar.h, i.e. the operator
+// dispatch table and the co-save record readers
+
+typedef UInt32 ArrayID;
+
+// types of array keys and elements
+enum
+{
+	kDataType_Invalid,
+
+	kDataType_Numeric,
+	kDataType_Form,
+	kDataType_String,
+	kDataType_Array,
+};
@@ -0,0 +1,264 @@
+#include "CoSaveFormat.h"
+#include "Compression.h"
+
+namespace Serialization
+{
+
+static const UInt32	kMinCompressedBlock = 64;	// smaller plugin blocks aren't worth compressing
+static const UInt32	kMaxExpansion = 255;		// LZ4 can't expand data by more than this
+static const UInt32	kMaxBlockLength = 0x10000000;	// larger expanded blocks are taken as damage rather than allocated
+
+void CompressCoSaveImage(std::vector <UInt8> & image)
+{
+	if(image.size() < sizeof(Header))
+		return;
+
+	std::vector <UInt8>	result;
+	result.reserve(image.size() / 2);
+	result.insert(result.end(), image.begin(), image.begin() + sizeof(Header));
+	((Header *)&result[0])->formatVersion = Header::kVersion_Compressed;
+
+	std::vector <UInt8>	compressed;
+	UInt32	offset = sizeof(Header);
+	while(image.size() - offset >= sizeof(PluginHeader))
+	{
+		const PluginHeader	* plugin = (const PluginHeader *)&image[offset];
+		const UInt8			* data = &image[offset + sizeof(PluginHeader)];
+		UInt32				length = plugin->length;
+		ASSERT(length <= image.size() - offset - sizeof(PluginHeader));
+
+		UInt32	compressedLength = 0;
+		if(length >= kMinCompressedBlock)
+		{
+			compressed.resize(length);
+			compressedLength = Compression::Compress(data, length, &compressed[0], length - 1);	// only keep it if it's smaller
+		}
+
+		result.insert(result.end(), (const UInt8 *)plugin, (const UInt8 *)(plugin + 1));
+		result.insert(result.end(), (const UInt8 *)&compressedLength, (const UInt8 *)(&compressedLength + 1));
+		if(compressedLength)
+			result.insert(result.end(), compressed.begin(), compressed.begin() + compressedLength);
+		else
+			result.insert(result.end(), data, data + length);
+
+		offset += sizeof(PluginHeader) + length;
+	}
+
+	image.swap(result);
+}
+
+bool DecompressCoSaveImage(std::vector <UInt8> & image, std::vector <UInt32> * storedLengths)
+{
+	std::vector <UInt8>	result;
+	result.insert(result.end(), image.begin(), image.begin() + sizeof(Header));
+	((Header *)&result[0])->formatVersion = Header::kVersion_Uncompressed;
+
+	UInt32	offset = sizeof(Header);
+	while(image.size() - offset >= sizeof(PluginHeader) + sizeof(UInt32))
+	{
+		PluginHeader	plugin;
+		UInt32			compressedLength;
+		memcpy(&plugin, &image[offset], sizeof(plugin));
+		memcpy(&compressedLength, &image[offset + sizeof(plugin)], sizeof(compressedLength));
+		offset += sizeof(plugin) + sizeof(compressedLength);
+
+		UInt32	storedLength = compressedLength ? compressedLength : plugin.length;
+		if(storedLength > image.size() - offset)
+			return false;
+
+		// the expanded length is only checked when decompressing, so bound it before allocating
+		if(compressedLength && (plugin.length > kMaxBlockLength || plugin.length > (UInt64)compressedLength * kMaxExpansion))
+			return false;
+
+		if(storedLengths)
+			storedLengths->push_back(sizeof(compressedLength) + storedLength);
+
+		result.insert(result.end(), (const UInt8 *)&plugin, (const UInt8 *)(&plugin + 1));
+
+		UInt32	dataOffset = result.size();
+		if(compressedLength)
+		{
+			result.resize(dataOffset + plugin.length);
+			if(!Compression::Decompress(&image[offset], compressedLength, result.data() + dataOffset, plugin.length))
+				return false;
+		}
+		else
+			result.insert(result.end(), image.begin() + offset, image.begin() + offset + storedLength);
+
+		offset += storedLength;
+	}
+
+	image.swap(result);
+	return true;
+}
+
+//////////////////////////
+// LoadBuffer
+/////////////////////////
+
+bool LoadBuffer::Assign(std::vector <UInt8> & data, std::vector <UInt32> * storedLengths)
+{
+	m_data.swap(data);
+	m_offset = 0;
+
+	if(m_data.size() >= sizeof(Header) && ((Header *)&m_data[0])->formatVersion == Header::kVersion_Compressed)
+	{
+		if(!DecompressCoSaveImage(m_data, storedLengths))
+		{
+			m_data.clear();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void LoadBuffer::Close(void)
+{
+	std::vector <UInt8>().swap(m_data);
+	m_offset = 0;
+}
+
+UInt32 LoadBuffer::ReadBuf(void * buf, UInt32 length)
+{
+	if(length > GetRemain())
+		length = GetRemain();
+
+	if(length)
+	{
+		memcpy(buf, &m_data[m_offset], length);
+		m_offset += length;
+	}
+
+	return length;
+}
+
+const UInt8 * LoadBuffer::ReadSpan(UInt32 length)
+{
+	if(length > GetRemain())
+		return NULL;
+
+	const UInt8	* data = m_data.data() + m_offset;
+	m_offset += length;
+	return data;
+}
+
+//////////////////////////
+// CoSaveBuilder
+/////////////////////////
+
+CoSaveBuilder::CoSaveBuilder()
+:m_pluginHeaderOffset(0), m_chunkHeaderOffset(0), m_chunkOpen(false)
+{
+	memset(&m_header, 0, sizeof(m_header));
+	memset(&m_pluginHeader, 0, sizeof(m_pluginHeader));
+	memset(&m_chunkHeader, 0, sizeof(m_chunkHeader));
+}
+
+void CoSaveBuilder::Begin(const Header & header)
+{
+	m_header = header;
+	m_header.numPlugins = 0;
+	m_chunkOpen = false;
+
+	m_image.clear();
+	m_image.resize(sizeof(Header));
+}
+
+void CoSaveBuilder::BeginPlugin(UInt32 opcodeBase)
+{
+	m_pluginHeader.opcodeBase = opcodeBase;
+	m_pluginHeader.numChunks = 0;
+	m_pluginHeader.length = 0;
+	m_chunkOpen = false;
+}
+
+// patch the header of the open chunk
+void CoSaveBuilder::FlushChunk(void)
+{
+	if(!m_chunkOpen)
+		return;
+
+	UInt32	chunkSize = m_image.size() - m_chunkHeaderOffset - sizeof(m_chunkHeader);
+
+	ASSERT(chunkSize < 0x80000000);	// stupidity check
+
+	m_chunkHeader.length = chunkSize;
+
+	memcpy(&m_image[m_chunkHeaderOffset], &m_chunkHeader, sizeof(m_chunkHeader));
+
+	m_pluginHeader.length += chunkSize + sizeof(m_chunkHeader);
+
+	m_chunkOpen = false;
+}
+
+void CoSaveBuilder::OpenRecord(UInt32 type, UInt32 version)
+{
+	if(!m_pluginHeader.numChunks)
+	{
+		ASSERT(!m_chunkOpen);
+
+		// room for the plugin header, filled in once the plugin is done
+		m_pluginHeaderOffset = m_image.size();
+		m_image.resize(m_pluginHeaderOffset + sizeof(m_pluginHeader));
+	}
+
+	FlushChunk();
+
+	m_chunkHeaderOffset = m_image.size();
+	m_image.resize(m_chunkHeaderOffset + sizeof(m_chunkHeader));
+
+	m_pluginHeader.numChunks++;
+
+	m_chunkHeader.type = type;
+	m_chunkHeader.version = version;
+	m_chunkHeader.length = 0;
+
+	m_chunkOpen = true;
+}
+
+bool CoSaveBuilder::WriteRecordData(const void * buf, UInt32 length)
+{
+	if(!m_chunkOpen)
+		return false;
+
+	const UInt8	* data = (const UInt8 *)buf;
+	m_image.insert(m_image.end(), data, data + length);
+
+	return true;
+}
+
+bool CoSaveBuilder::EndPlugin(void)
+{
+	// flush the remaining chunk data
+	FlushChunk();
+
+	if(!m_pluginHeader.numChunks)
+		return false;
+
+	memcpy(&m_image[m_pluginHeaderOffset], &m_pluginHeader, sizeof(m_pluginHeader));
+	m_pluginHeader.numChunks = 0;
+	m_header.numPlugins++;
+
+	return true;
+}
+
+void CoSaveBuilder::AppendPlugin(const UInt8 * block, UInt32 length)
+{
+	m_image.insert(m_image.end(), block, block + length);
+	m_header.numPlugins++;
+}
+
+void CoSaveBuilder::Finish(void)
+{
+	memcpy(&m_image[0], &m_header, sizeof(m_header));
+}
+
+void CoSaveBuilder::Clear(void)
+{
+	m_image.clear();
+	m_pluginHeader.numChunks = 0;
+	m_chunkOpen = false;
+}
+
+}
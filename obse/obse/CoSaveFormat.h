@@ -0,0 +1,206 @@
+#pragma once
+
+// co-save file layout, shared with the cosave_inspect tool. Only needs the UInt types, MACRO_SWAP32 and ASSERT
+// from the includer so it can be built outside of OBSE
+
+#include <vector>
+#include <cstring>
+
+namespace Serialization
+{
+
+static const UInt32	kObseOpcodeBase = 0x1400;	// PluginHeader::opcodeBase of OBSE's own block
+
+//	general format:
+//	Header			header
+//		PluginHeader	plugin[header.numPlugins]
+//			ChunkHeader		chunk[plugin.numChunks]
+//				UInt8			data[chunk.length]
+//
+//	version 2 (compressed):
+//	Header			header
+//		PluginHeader	plugin[header.numPlugins]
+//		UInt32			compressedLength		0 if the block is stored uncompressed
+//			UInt8			data[compressedLength]	LZ4 block expanding to the chunks of version 1, plugin.length bytes
+
+struct Header
+{
+	enum
+	{
+		kSignature =		MACRO_SWAP32('OBSE'),	// endian-swapping so the order matches
+		kVersion_Uncompressed =	1,
+		kVersion_Compressed =	2,
+		kVersion =			kVersion_Compressed,	// newest version we can load
+
+		kVersion_Invalid =	0
+	};
+
+	UInt32	signature;
+	UInt32	formatVersion;
+	UInt16	obseVersion;
+	UInt16	obseMinorVersion;
+	UInt32	oblivionVersion;
+	UInt32	numPlugins;
+};
+
+struct PluginHeader
+{
+	UInt32	opcodeBase;
+	UInt32	numChunks;
+	UInt32	length;		// length of following data including ChunkHeader
+};
+
+struct ChunkHeader
+{
+	UInt32	type;
+	UInt32	version;
+	UInt32	length;
+};
+
+// converts a version 1 co-save image to version 2, compressing the plugin blocks that benefit from it
+void	CompressCoSaveImage(std::vector <UInt8> & image);
+
+// converts a version 2 co-save image back to version 1, returns false if it is damaged. storedLengths, if given,
+// receives the number of bytes each plugin block took in the compressed image
+bool	DecompressCoSaveImage(std::vector <UInt8> & image, std::vector <UInt32> * storedLengths = NULL);
+
+// co-save being loaded, held in memory and read from there
+class LoadBuffer
+{
+public:
+	LoadBuffer() : m_offset(0) { }
+
+	// takes the file's contents from data. Compressed co-saves are expanded up front so the rest of loading only
+	// sees version 1 layout; a damaged one is left empty, so the header can't be read, and false is returned
+	bool	Assign(std::vector <UInt8> & data, std::vector <UInt32> * storedLengths = NULL);
+	void	Close(void);
+
+	const UInt8 *	GetData(void) const	{ return m_data.data(); }
+	UInt32	GetSize(void) const			{ return m_data.size(); }
+	UInt32	GetOffset(void) const		{ return m_offset; }
+	UInt32	GetRemain(void) const		{ return m_data.size() - m_offset; }
+	void	SetOffset(UInt32 offset)	{ m_offset = offset < m_data.size() ? offset : m_data.size(); }
+	void	Skip(UInt32 length)			{ SetOffset(m_offset + (length < GetRemain() ? length : GetRemain())); }
+
+	// like IFileStream, a read past the end of the file copies what is left
+	UInt32	ReadBuf(void * buf, UInt32 length);
+
+	// returns a pointer to the next length bytes and skips them, or NULL if fewer remain
+	const UInt8 *	ReadSpan(UInt32 length);
+
+private:
+	std::vector <UInt8>	m_data;
+	UInt32				m_offset;
+};
+
+// builds a version 1 co-save image in memory, headers are patched in place once their plugin or chunk is done
+class CoSaveBuilder
+{
+public:
+	CoSaveBuilder();
+
+	// starts a new image. numPlugins is counted as plugins are added
+	void	Begin(const Header & header);
+
+	// records written until EndPlugin() go in a block for this plugin. Its header is only written with the first record
+	void	BeginPlugin(UInt32 opcodeBase);
+	void	OpenRecord(UInt32 type, UInt32 version);
+	bool	WriteRecordData(const void * buf, UInt32 length);	// false if no record is open
+	bool	EndPlugin(void);		// returns false if the plugin wrote nothing
+
+	// adds a finished block, PluginHeader and chunks, e.g. one kept from an earlier image
+	void	AppendPlugin(const UInt8 * block, UInt32 length);
+
+	// writes the file header, Image() is complete after this
+	void	Finish(void);
+	void	Clear(void);
+
+	UInt32					Size(void) const	{ return m_image.size(); }
+	const UInt8 *			Data(void) const	{ return m_image.data(); }
+	std::vector <UInt8> &	Image(void)			{ return m_image; }
+
+private:
+	void	FlushChunk(void);
+
+	std::vector <UInt8>	m_image;
+	Header				m_header;
+	PluginHeader		m_pluginHeader;
+	UInt32				m_pluginHeaderOffset;
+	ChunkHeader			m_chunkHeader;
+	UInt32				m_chunkHeaderOffset;
+	bool				m_chunkOpen;
+};
+
+}
+
+// reads from a record held in memory, every read fails once the end is reached
+class RecordCursor
+{
+	const UInt8	* m_data;
+	UInt32		m_remain;
+public:
+	RecordCursor(const void* data, UInt32 len) : m_data((const UInt8*)data), m_remain(data ? len : 0) { }
+
+	UInt32 Remaining() const { return m_remain; }
+
+	const UInt8* Skip(UInt32 len)
+	{
+		if (len > m_remain)
+		{
+			m_remain = 0;
+			return NULL;
+		}
+
+		const UInt8* data = m_data;
+		m_data += len;
+		m_remain -= len;
+		return data;
+	}
+
+	bool Read(void* out, UInt32 len)
+	{
+		const UInt8* data = Skip(len);
+		if (data)
+			memcpy(out, data, len);
+		return data != NULL;
+	}
+
+	bool ReadVarInt(UInt64& out)
+	{
+		out = 0;
+		for (UInt32 shift = 0; shift < 64 && m_remain; shift += 7)
+		{
+			UInt8 byte = *m_data++;
+			m_remain--;
+			out |= (UInt64)(byte & 0x7F) << shift;
+			if (!(byte & 0x80))
+				return true;
+		}
+
+		m_remain = 0;
+		return false;
+	}
+
+	bool ReadVarInt(UInt32& out)
+	{
+		UInt64 val;
+		if (!ReadVarInt(val) || val > 0xFFFFFFFF)
+			return false;
+
+		out = val;
+		return true;
+	}
+
+	bool ReadNumber(double& out)
+	{
+		UInt64 val;
+		if (!ReadVarInt(val))
+			return false;
+		else if (val & 1)
+			return Read(&out, sizeof(double));
+
+		UInt64 zigzag = val >> 1;
+		out = (double)(SInt64)((zigzag >> 1) ^ (0 - (zigzag & 1)));
+		return true;
+	}
+};
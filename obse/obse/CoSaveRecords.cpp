@@ -0,0 +1,335 @@
+#include "CoSaveRecords.h"
+
+//////////////////////////
+// reading
+/////////////////////////
+
+bool ReadStringTable(RecordCursor & record, std::vector <SavedString> & out)
+{
+	UInt32	numStrings;
+	if(!record.ReadVarInt(numStrings))
+		return false;
+
+	out.reserve(out.size() + numStrings);
+	for(UInt32 i = 0; i < numStrings; i++)
+	{
+		SavedString	str;
+		if(!record.ReadVarInt(str.len) || !(str.data = (const char *)record.Skip(str.len)))
+			return false;
+
+		out.push_back(str);
+	}
+
+	return true;
+}
+
+bool ReadArrayHeader(RecordCursor & record, UInt32 version, SavedArrayHeader & out)
+{
+	UInt8	bPacked;
+	if(!record.Read(&out.modIndex, sizeof(out.modIndex)) || !record.Read(&out.id, sizeof(out.id)) ||
+		!record.Read(&out.keyType, sizeof(out.keyType)) || !record.Read(&bPacked, sizeof(bPacked)))
+		return false;
+
+	out.bPacked = bPacked != 0;
+	out.numRefs = 0;
+	out.refs = NULL;
+
+	// reference counting was added in v1
+	if(version >= 2)
+		return record.ReadVarInt(out.numRefs) && (out.refs = record.Skip(out.numRefs)) != NULL;
+	else if(version == 1)
+		return record.Read(&out.numRefs, sizeof(out.numRefs)) && (out.refs = record.Skip(out.numRefs)) != NULL;
+
+	return true;
+}
+
+// String ::= { UInt16 len; char data[len]; }
+static bool ReadSerializedString(RecordCursor & record, SavedString & out)
+{
+	UInt16	len;
+	if(!record.Read(&len, sizeof(len)) || !(out.data = (const char *)record.Skip(len)))
+		return false;
+
+	out.len = strnlen(out.data, len);
+	return true;
+}
+
+static bool ReadTableString(RecordCursor & record, const std::vector <SavedString> & strings, SavedString & out)
+{
+	UInt32	strIdx;
+	if(!record.ReadVarInt(strIdx) || strIdx >= strings.size())
+		return false;
+
+	out = strings[strIdx];
+	return true;
+}
+
+static bool ReadElementsV1(RecordCursor & record, const SavedArrayHeader & header, std::vector <SavedElement> & out)
+{
+	UInt32	numElements;
+	if(!record.Read(&numElements, sizeof(numElements)))
+		return false;
+
+	for(UInt32 i = 0; i < numElements; i++)
+	{
+		SavedElement	elem = { };
+		elem.key.type = header.keyType == kDataType_Numeric ? kDataType_Numeric : kDataType_String;
+
+		bool	bKey = elem.key.type == kDataType_Numeric ? record.Read(&elem.key.num, sizeof(double)) : ReadSerializedString(record, elem.key.str);
+		if(!bKey || !record.Read(&elem.value.type, sizeof(elem.value.type)))
+			return false;
+
+		bool	bValue = true;
+		switch(elem.value.type)
+		{
+			case kDataType_Numeric:	bValue = record.Read(&elem.value.num, sizeof(double)); break;
+			case kDataType_String:	bValue = ReadSerializedString(record, elem.value.str); break;
+			case kDataType_Array:	bValue = record.Read(&elem.value.arrayID, sizeof(UInt32)); break;
+			case kDataType_Form:	bValue = record.Read(&elem.value.formID, sizeof(UInt32)); break;
+		}
+
+		if(!bValue)
+			return false;
+
+		out.push_back(elem);
+	}
+
+	return true;
+}
+
+static bool ReadElementsV2(RecordCursor & record, const SavedArrayHeader & header, const std::vector <SavedString> & strings,
+	std::vector <SavedElement> & out)
+{
+	UInt32	numElements;
+	if(!record.ReadVarInt(numElements))
+		return false;
+
+	// every key takes at least a byte, so a count the record can't hold is rejected before anything is allocated
+	if(header.HasKeys() && numElements > record.Remaining())
+		return false;
+
+	// decoded in place, on failure out keeps the elements whose values were read
+	UInt32	base = out.size();
+	out.resize(base + numElements);
+	SavedElement	* elements = numElements ? &out[base] : NULL;
+
+	// keys
+	for(UInt32 i = 0; i < numElements; i++)
+	{
+		SavedValue	& key = elements[i].key;
+		key.type = header.keyType == kDataType_Numeric ? kDataType_Numeric : kDataType_String;
+		if(!header.HasKeys())
+			key.num = i;
+		else if(!(key.type == kDataType_Numeric ? record.ReadNumber(key.num) : ReadTableString(record, strings, key.str)))
+		{
+			out.resize(base);
+			return false;
+		}
+	}
+
+	// element types
+	UInt32	numRuns, numTyped = 0;
+	if(!record.ReadVarInt(numRuns))
+	{
+		out.resize(base);
+		return false;
+	}
+
+	for(UInt32 i = 0; i < numRuns; i++)
+	{
+		UInt8	type;
+		UInt32	count;
+		if(!record.Read(&type, sizeof(type)) || !record.ReadVarInt(count) || count > numElements - numTyped)
+		{
+			out.resize(base);
+			return false;
+		}
+
+		for(UInt32 end = numTyped + count; numTyped < end; numTyped++)
+			elements[numTyped].value.type = type;
+	}
+
+	if(numTyped != numElements)
+	{
+		out.resize(base);
+		return false;
+	}
+
+	// values
+	for(UInt32 i = 0; i < numElements; i++)
+	{
+		SavedValue	& value = elements[i].value;
+		bool		bValue = true;
+		switch(value.type)
+		{
+			case kDataType_Numeric:	bValue = record.ReadNumber(value.num); break;
+			case kDataType_String:	bValue = ReadTableString(record, strings, value.str); break;
+			case kDataType_Array:	bValue = record.ReadVarInt(value.arrayID); break;
+			case kDataType_Form:	bValue = record.Read(&value.formID, sizeof(UInt32)); break;
+		}
+
+		if(!bValue)
+		{
+			out.resize(base + i);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool ReadArrayElements(RecordCursor & record, UInt32 version, const SavedArrayHeader & header,
+	const std::vector <SavedString> & strings, std::vector <SavedElement> & out)
+{
+	return version >= 2 ? ReadElementsV2(record, header, strings, out) : ReadElementsV1(record, header, out);
+}
+
+bool ReadStringVarRecord(RecordCursor & record, SavedStringVar & out)
+{
+	UInt16	len;
+	if(!record.Read(&out.modIndex, sizeof(out.modIndex)) || !record.Read(&out.id, sizeof(out.id)) || !record.Read(&len, sizeof(len)))
+		return false;
+
+	out.str.len = len;
+	return (out.str.data = (const char *)record.Skip(len)) != NULL;
+}
+
+bool ReadModList(RecordCursor & record, std::vector <SavedString> & out)
+{
+	UInt8	numMods;
+	if(!record.Read(&numMods, sizeof(numMods)))
+		return false;
+
+	for(UInt32 i = 0; i < numMods; i++)
+	{
+		UInt16		len;
+		SavedString	name;
+		if(!record.Read(&len, sizeof(len)) || !(name.data = (const char *)record.Skip(len)))
+			return false;
+
+		name.len = len;
+		out.push_back(name);
+	}
+
+	return true;
+}
+
+//////////////////////////
+// writing
+/////////////////////////
+
+static void WriteVarInt(std::vector <UInt8> & out, UInt64 val)
+{
+	while(val >= 0x80)
+	{
+		out.push_back((val & 0x7F) | 0x80);
+		val >>= 7;
+	}
+
+	out.push_back(val);
+}
+
+static void WriteBytes(std::vector <UInt8> & out, const void * data, UInt32 len)
+{
+	const UInt8	* bytes = (const UInt8 *)data;
+	out.insert(out.end(), bytes, bytes + len);
+}
+
+// integers are stored as a zigzag-encoded varint shifted left one bit, anything else as varint 1 followed by the double
+static void WriteNumber(std::vector <UInt8> & out, double num)
+{
+	static const double	kMaxExactInt = 9007199254740992.0;	// 2^53
+
+	if(num >= -kMaxExactInt && num <= kMaxExactInt)
+	{
+		SInt64	intVal = (SInt64)num;
+		double	roundTrip = (double)intVal;
+		if(!memcmp(&roundTrip, &num, sizeof(double)))		// rejects fractions and -0.0
+		{
+			UInt64	zigzag = ((UInt64)intVal << 1) ^ (UInt64)(intVal >> 63);
+			WriteVarInt(out, zigzag << 1);
+			return;
+		}
+	}
+
+	WriteVarInt(out, 1);
+	WriteBytes(out, &num, sizeof(double));
+}
+
+UInt32 SaveStringTable::Add(const char * data, UInt32 len)
+{
+	std::pair <std::unordered_map <std::string, UInt32>::iterator, bool>	result = m_indexes.emplace(std::string(data, len), m_strings.size());
+	if(result.second)
+		m_strings.push_back(&result.first->first);
+
+	return result.first->second;
+}
+
+void SaveStringTable::Write(std::vector <UInt8> & out) const
+{
+	WriteVarInt(out, m_strings.size());
+	for(UInt32 i = 0; i < m_strings.size(); i++)
+	{
+		WriteVarInt(out, m_strings[i]->length());
+		WriteBytes(out, m_strings[i]->data(), m_strings[i]->length());
+	}
+}
+
+void WriteArrayRecord(std::vector <UInt8> & out, const SavedArrayHeader & header, const SavedElement * elements, UInt32 numElements,
+	SaveStringTable & strings)
+{
+	out.push_back(header.modIndex);
+	WriteBytes(out, &header.id, sizeof(UInt32));
+	out.push_back(header.keyType);
+	out.push_back(header.bPacked);
+
+	WriteVarInt(out, header.numRefs);
+	if(header.numRefs)
+		WriteBytes(out, header.refs, header.numRefs);
+
+	WriteVarInt(out, numElements);
+
+	if(header.HasKeys())
+	{
+		for(UInt32 i = 0; i < numElements; i++)
+		{
+			const SavedValue	& key = elements[i].key;
+			if(key.type == kDataType_Numeric)
+				WriteNumber(out, key.num);
+			else
+				WriteVarInt(out, strings.Add(key.str.data, key.str.len));
+		}
+	}
+
+	// element types as runs
+	UInt32	numRuns = 0;
+	for(UInt32 i = 0; i < numElements; i++)
+		if(!i || elements[i].value.type != elements[i - 1].value.type)
+			numRuns++;
+
+	WriteVarInt(out, numRuns);
+	for(UInt32 i = 0; i < numElements; )
+	{
+		UInt8	type = elements[i].value.type;
+		UInt32	count = 1;
+		while(i + count < numElements && elements[i + count].value.type == type)
+			count++;
+
+		out.push_back(type);
+		WriteVarInt(out, count);
+		i += count;
+	}
+
+	// values
+	for(UInt32 i = 0; i < numElements; i++)
+	{
+		const SavedValue	& value = elements[i].value;
+		switch(value.type)
+		{
+			case kDataType_Numeric:	WriteNumber(out, value.num); break;
+			case kDataType_String:	WriteVarInt(out, strings.Add(value.str.data, value.str.len)); break;
+			case kDataType_Array:	WriteVarInt(out, value.arrayID); break;
+			case kDataType_Form:	WriteBytes(out, &value.formID, sizeof(UInt32)); break;
+		}
+	}
+}
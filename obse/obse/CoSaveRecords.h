@@ -0,0 +1,93 @@
+#pragma once
+
+// OBSE's own co-save records (array and string variables, the mod list) decoded from and encoded to memory. Shared
+// with the cosave_inspect tool, so like CoSaveFormat.h it only needs the UInt types from the includer. Record layouts
+// are described in ArrayVar.h
+
+#include "CoSaveFormat.h"
+#include "ArrayVarTypes.h"
+#include <string>
+#include <unordered_map>
+
+// string in a record or the ARVT string table, not null-terminated
+struct SavedString
+{
+	const char	* data;
+	UInt32		len;
+};
+
+// array key or element. Elements saved without a value (uninitialized ones, or a type this version doesn't know)
+// only have a type
+struct SavedValue
+{
+	UInt8		type;
+	union
+	{
+		double	num;
+		UInt32	formID;
+		ArrayID	arrayID;
+	};
+	SavedString	str;
+};
+
+struct SavedElement
+{
+	SavedValue	key;
+	SavedValue	value;
+};
+
+struct SavedArrayHeader
+{
+	UInt8		modIndex;
+	ArrayID		id;
+	UInt8		keyType;
+	bool		bPacked;
+	UInt32		numRefs;
+	const UInt8	* refs;		// mod indexes, NULL in v0 records which didn't store references
+
+	// packed arrays with numeric keys store no keys, they always run from 0
+	bool HasKeys() const { return !(bPacked && keyType == kDataType_Numeric); }
+};
+
+struct SavedStringVar
+{
+	UInt8		modIndex;
+	UInt32		id;
+	SavedString	str;
+};
+
+// ARVT, strings stay in the record. On failure out holds the strings read before the damage
+bool	ReadStringTable(RecordCursor & record, std::vector <SavedString> & out);
+
+// start of an ARVR record of any version, up to the elements
+bool	ReadArrayHeader(RecordCursor & record, UInt32 version, SavedArrayHeader & out);
+
+// rest of an ARVR record. Strings point into the record (v1) or the string table (v2). Strings in v1 records were
+// always cut at the first null on load, so they're returned that way. Returns false if the record is damaged, with
+// the elements decoded up to that point in out
+bool	ReadArrayElements(RecordCursor & record, UInt32 version, const SavedArrayHeader & header,
+			const std::vector <SavedString> & strings, std::vector <SavedElement> & out);
+
+// STVR
+bool	ReadStringVarRecord(RecordCursor & record, SavedStringVar & out);
+
+// MODS, names in load order
+bool	ReadModList(RecordCursor & record, std::vector <SavedString> & out);
+
+// strings used by the v2 array records, each stored once. Records are encoded first, then the table is written ahead of them
+class SaveStringTable
+{
+	std::unordered_map <std::string, UInt32>	m_indexes;
+	std::vector <const std::string *>			m_strings;
+public:
+	UInt32	Add(const char * data, UInt32 len);
+	UInt32	Size() const	{ return m_strings.size(); }
+
+	// ARVT
+	void	Write(std::vector <UInt8> & out) const;
+};
+
+// appends a v2 ARVR record. Values of types without a v2 encoding, including uninitialized elements, aren't written;
+// their type run is all that's needed to restore them
+void	WriteArrayRecord(std::vector <UInt8> & out, const SavedArrayHeader & header, const SavedElement * elements, UInt32 numElements,
+			SaveStringTable & strings);
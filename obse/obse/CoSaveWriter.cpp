@@ -0,0 +1,72 @@
+#include "CoSaveWriter.h"
+#include "CoSaveFormat.h"
+
+namespace Serialization
+{
+
+CoSaveWriter::CoSaveWriter(CoSaveWriterDriver & driver)
+:m_driver(driver), m_bWriting(false), m_bCompress(false), m_bFailed(false)
+{
+	//
+}
+
+void CoSaveWriter::Write(const std::string & path, std::vector <UInt8> & data, bool bAsync, bool bCompress)
+{
+	Wait();
+
+	m_path = path;
+	m_data.swap(data);
+	m_bCompress = bCompress;
+
+	if(bAsync)
+	{
+		if(m_driver.StartThread(ThreadProc, this))
+		{
+			m_bWriting = true;
+			return;
+		}
+
+		_WARNING("CoSaveWriter: couldn't start write thread, writing co-save synchronously");
+	}
+
+	WriteToDisk();
+	ReportFailure();
+}
+
+bool CoSaveWriter::Wait(void)
+{
+	if(!m_bWriting)
+		return true;
+
+	m_driver.JoinThread();
+	m_bWriting = false;
+	return ReportFailure();
+}
+
+void CoSaveWriter::ThreadProc(void * param)
+{
+	((CoSaveWriter *)param)->WriteToDisk();
+}
+
+void CoSaveWriter::WriteToDisk(void)
+{
+	if(m_bCompress)
+		CompressCoSaveImage(m_data);
+
+	// may be on the worker thread, where the log can't be written to
+	m_bFailed = !m_driver.SaveFile(m_path.c_str(), m_data.size() ? &m_data[0] : NULL, m_data.size());
+
+	std::vector <UInt8>().swap(m_data);
+}
+
+bool CoSaveWriter::ReportFailure(void)
+{
+	if(!m_bFailed)
+		return true;
+
+	_ERROR("CoSaveWriter: couldn't create save file (%s)", m_path.c_str());
+	m_bFailed = false;
+	return false;
+}
+
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+// writes finished co-saves to disk, optionally on a worker thread. The thread and the file are reached through
+// CoSaveWriterDriver, so this only needs the UInt types and the log macros from the includer and can be tested
+// outside of OBSE
+
+#include <string>
+#include <vector>
+
+namespace Serialization
+{
+
+// what CoSaveWriter needs from the OS. It runs at most one thread at a time
+class CoSaveWriterDriver
+{
+public:
+	typedef void	(* ThreadProc)(void * param);
+
+	virtual ~CoSaveWriterDriver() { }
+
+	// creates or replaces the file at path, returns false if it couldn't be created
+	virtual bool	SaveFile(const char * path, const void * data, UInt32 length) = 0;
+
+	// runs proc(param) on a new thread, returns false if the thread couldn't be started
+	virtual bool	StartThread(ThreadProc proc, void * param) = 0;
+
+	// blocks until the thread started by StartThread() has returned
+	virtual void	JoinThread(void) = 0;
+};
+
+class CoSaveWriter
+{
+public:
+	CoSaveWriter(CoSaveWriterDriver & driver);
+
+	// writes data to path and empties it, compressing it first if bCompress is set. A pending write is finished
+	// first. Returns once the write is done unless bAsync is set and the thread starts
+	void	Write(const std::string & path, std::vector <UInt8> & data, bool bAsync, bool bCompress);
+
+	// blocks until a pending write is finished and logs it if it failed, returning false. Not done on destruction,
+	// as that can happen under the loader lock
+	bool	Wait(void);
+
+	bool	IsWriting(void) const	{ return m_bWriting; }
+
+private:
+	static void	ThreadProc(void * param);
+	void		WriteToDisk(void);
+	bool		ReportFailure(void);	// on the calling thread
+
+	CoSaveWriterDriver	& m_driver;
+	bool				m_bWriting;		// a thread was started and hasn't been joined yet
+	std::string			m_path;
+	std::vector <UInt8>	m_data;
+	bool				m_bCompress;
+	bool				m_bFailed;		// set by the write, logged by the thread that started or waited for it
+};
+
+}
@@ -0,0 +1,219 @@
+#include "Compression.h"
+#include <cstring>
+
+namespace Compression
+{
+
+enum
+{
+	kMinMatch		= 4,
+	kLastLiterals	= 5,		// the last 5 bytes are always literals
+	kMatchLimit		= 12,		// the last match must start at least 12 bytes before the end
+	kMaxOffset		= 0xFFFF,
+	kHashBits		= 12,
+	kSkipShift		= 6,		// speeds up the search through data that doesn't compress
+};
+
+static inline UInt32 Read32(const UInt8 * p)
+{
+	UInt32	val;
+	memcpy(&val, p, sizeof(val));
+	return val;
+}
+
+static inline UInt32 Hash(UInt32 sequence)
+{
+	return (sequence * 2654435761U) >> (32 - kHashBits);
+}
+
+// writes a length continuation for a token nibble of 15
+static inline void WriteLength(UInt8 * & op, UInt32 len)
+{
+	while(len >= 255)
+	{
+		*op++ = 255;
+		len -= 255;
+	}
+
+	*op++ = len;
+}
+
+static inline bool ReadLength(const UInt8 * & ip, const UInt8 * end, UInt32 & len)
+{
+	UInt8	byte;
+	do
+	{
+		if(ip >= end)
+			return false;
+
+		byte = *ip++;
+		len += byte;
+	} while(byte == 255);
+
+	return true;
+}
+
+UInt32 CompressBound(UInt32 srcLen)
+{
+	return srcLen + srcLen / 255 + 16;
+}
+
+// writes one sequence, a match length of 0 with no offset ends the block
+static bool WriteSequence(UInt8 * & op, UInt8 * opEnd, const UInt8 * literals, UInt32 numLiterals, UInt32 offset, UInt32 matchLen, bool bLast)
+{
+	UInt32	required = 1 + numLiterals + numLiterals / 255 + 1 + (bLast ? 0 : 2 + matchLen / 255 + 1);
+	if(required > (UInt32)(opEnd - op))
+		return false;
+
+	UInt8	* token = op++;
+
+	if(numLiterals >= 15)
+	{
+		*token = 15 << 4;
+		WriteLength(op, numLiterals - 15);
+	}
+	else
+		*token = numLiterals << 4;
+
+	memcpy(op, literals, numLiterals);
+	op += numLiterals;
+
+	if(bLast)
+		return true;
+
+	*op++ = offset & 0xFF;
+	*op++ = offset >> 8;
+
+	matchLen -= kMinMatch;
+	if(matchLen >= 15)
+	{
+		*token |= 15;
+		WriteLength(op, matchLen - 15);
+	}
+	else
+		*token |= matchLen;
+
+	return true;
+}
+
+UInt32 Compress(const UInt8 * src, UInt32 srcLen, UInt8 * dst, UInt32 dstCapacity)
+{
+	UInt32	table[1 << kHashBits] = { 0 };		// offsets from src of the last position with each hash
+
+	const UInt8	* ip = src;
+	const UInt8	* anchor = src;
+	const UInt8	* end = src + srcLen;
+	UInt8		* op = dst;
+	UInt8		* opEnd = dst + dstCapacity;
+
+	if(srcLen >= kMatchLimit + 1)
+	{
+		const UInt8	* lastMatchStart = end - kMatchLimit;
+		const UInt8	* matchEndLimit = end - kLastLiterals;
+
+		while(ip <= lastMatchStart)
+		{
+			UInt32		sequence = Read32(ip);
+			UInt32		hash = Hash(sequence);
+			const UInt8	* ref = src + table[hash];
+			table[hash] = ip - src;
+
+			if(ref >= ip || ip - ref > kMaxOffset || Read32(ref) != sequence)
+			{
+				ip += 1 + ((ip - anchor) >> kSkipShift);
+				continue;
+			}
+
+			// extend the match backwards over literals, then forwards
+			while(ip > anchor && ref > src && ip[-1] == ref[-1])
+			{
+				ip--;
+				ref--;
+			}
+
+			const UInt8	* matchEnd = ip + kMinMatch;
+			const UInt8	* refEnd = ref + kMinMatch;
+			while(matchEnd < matchEndLimit && *matchEnd == *refEnd)
+			{
+				matchEnd++;
+				refEnd++;
+			}
+
+			if(!WriteSequence(op, opEnd, anchor, ip - anchor, ip - ref, matchEnd - ip, false))
+				return 0;
+
+			ip = anchor = matchEnd;
+
+			// positions inside the match would otherwise never be hashed
+			if(ip - 2 >= src && ip <= lastMatchStart)
+				table[Hash(Read32(ip - 2))] = ip - 2 - src;
+		}
+	}
+
+	if(!WriteSequence(op, opEnd, anchor, end - anchor, 0, 0, true))
+		return 0;
+
+	return op - dst;
+}
+
+bool Decompress(const UInt8 * src, UInt32 srcLen, UInt8 * dst, UInt32 dstLen)
+{
+	const UInt8	* ip = src;
+	const UInt8	* end = src + srcLen;
+	UInt8		* op = dst;
+	UInt8		* opEnd = dst + dstLen;
+
+	while(ip < end)
+	{
+		UInt8	token = *ip++;
+
+		UInt32	numLiterals = token >> 4;
+		if(numLiterals == 15 && !ReadLength(ip, end, numLiterals))
+			return false;
+
+		if(numLiterals > (UInt32)(end - ip) || numLiterals > (UInt32)(opEnd - op))
+			return false;
+
+		memcpy(op, ip, numLiterals);
+		op += numLiterals;
+		ip += numLiterals;
+
+		// the last sequence has no match
+		if(ip == end)
+			break;
+
+		if(end - ip < 2)
+			return false;
+
+		UInt32	offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+
+		if(!offset || offset > (UInt32)(op - dst))
+			return false;
+
+		UInt32	matchLen = token & 15;
+		if(matchLen == 15 && !ReadLength(ip, end, matchLen))
+			return false;
+
+		matchLen += kMinMatch;
+		if(matchLen > (UInt32)(opEnd - op))
+			return false;
+
+		const UInt8	* match = op - offset;
+		if(offset >= matchLen)
+		{
+			memcpy(op, match, matchLen);
+			op += matchLen;
+		}
+		else
+		{
+			// overlapping copy repeats the last offset bytes
+			while(matchLen--)
+				*op++ = *match++;
+		}
+	}
+
+	return op == opEnd;
+}
+
+}
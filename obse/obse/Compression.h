@@ -0,0 +1,16 @@
+#pragma once
+
+// LZ4 block format codec (see lz4_Block_format.md in the LZ4 distribution), used to compress co-save plugin blocks.
+// Output can be decoded by any LZ4 block decoder and vice versa
+
+namespace Compression
+{
+	// worst case size of compressed data for srcLen bytes of input
+	UInt32	CompressBound(UInt32 srcLen);
+
+	// returns the compressed size, or 0 if it doesn't fit in dstCapacity
+	UInt32	Compress(const UInt8 * src, UInt32 srcLen, UInt8 * dst, UInt32 dstCapacity);
+
+	// dstLen must be the exact decompressed size. Returns false if src is malformed
+	bool	Decompress(const UInt8 * src, UInt32 srcLen, UInt8 * dst, UInt32 dstLen);
+}
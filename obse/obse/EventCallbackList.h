@@ -0,0 +1,252 @@
+#pragma once
+
+#include <list>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+
+// Callbacks for one event in registration order. Each callback is also filed in a bucket keyed by its
+// source filter, or by its object filter if it has no source, so dispatch only visits the unfiltered
+// callbacks and the two buckets the event's args select. Iterators stay valid until Erase().
+//
+// Templated on the callback and on Keys so the host benchmark and tests can run it over fake callbacks. Callback
+// needs source and object filters and the InUse and Removed flags as EventCallback declares them; Keys supplies what
+// depends on the event:
+//	static void* SourceArg(UInt32 eventID, void* arg0, void* arg1)	the arg source filters are checked against
+//	static bool ObjectKey(UInt32 eventID, const Callback& callback, void*& key)
+//		the arg the object filter has to equal, false if the filter can match anything
+template <typename Callback, typename Keys>
+class EventCallbackList
+{
+public:
+	typedef typename std::list<Callback>::iterator iterator;
+
+	enum
+	{
+		kMinIndexedCallbacks = 32,		// below this, checking every callback is faster than the bucket lookups
+	};
+
+	EventCallbackList(UInt32 eventID) : m_eventID(eventID), m_nextOrder(0), m_depth(0) { }
+
+	iterator begin() { return m_callbacks.begin(); }
+	iterator end() { return m_callbacks.end(); }
+
+	void Add(const Callback& callback)
+	{
+		iterator iter = m_callbacks.insert(m_callbacks.end(), callback);
+		Entry entry = { m_nextOrder++, iter };
+
+		void* key;
+		BucketMap* map = MapFor(callback, key);
+		if (map)
+			(*map)[key].push_back(entry);
+		else
+			m_unfiltered.push_back(entry);
+	}
+
+	iterator Erase(iterator iter)
+	{
+		void* key;
+		BucketMap* map = MapFor(*iter, key);
+		typename BucketMap::iterator found;
+		Bucket* bucket = &m_unfiltered;
+		if (map) {
+			found = map->find(key);
+			bucket = &found->second;
+		}
+
+		for (typename Bucket::iterator entry = bucket->begin(); entry != bucket->end(); ++entry) {
+			if (entry->iter == iter) {
+				bucket->erase(entry);
+				break;
+			}
+		}
+
+		if (map && bucket->empty())
+			map->erase(found);
+
+		return m_callbacks.erase(iter);
+	}
+
+	// calls run(iter) for each callback matches(callback) accepts out of those an event with these args may run, in
+	// registration order. run returns true to leave the callback in use after the dispatch, for whoever runs it
+	// later to release. While run() is called the callback is flagged in use, so a handler removing it or another
+	// candidate only flags that one removed; it's erased once no dispatch or deferred run holds it any more.
+	// Callbacks added during the dispatch aren't run
+	template <typename Matches, typename Run>
+	void Dispatch(void* arg0, void* arg1, Matches matches, Run run)
+	{
+		if (m_callbacks.size() < kMinIndexedCallbacks)
+			DispatchWalk(matches, run);
+		else
+			DispatchIndexed(arg0, arg1, matches, run);
+	}
+
+	// appends the callbacks whose filters may match an event with these args, in registration order
+	void Collect(void* arg0, void* arg1, std::vector<iterator>& out)
+	{
+		const Bucket* buckets[3] = { &m_unfiltered, NULL, NULL };
+		typename BucketMap::iterator found = m_bySource.find(Keys::SourceArg(m_eventID, arg0, arg1));
+		if (found != m_bySource.end())
+			buckets[1] = &found->second;
+		found = m_byObject.find(arg1);
+		if (found != m_byObject.end())
+			buckets[2] = &found->second;
+
+		UInt32 numBuckets = 0;
+		const Bucket* last = NULL;
+		for (UInt32 i = 0; i < 3; i++) {
+			if (buckets[i] && !buckets[i]->empty()) {
+				last = buckets[i];
+				numBuckets++;
+			}
+		}
+
+		// each bucket is already in registration order, so merging is only needed when more than one contributes
+		if (numBuckets == 1) {
+			for (typename Bucket::const_iterator entry = last->begin(); entry != last->end(); ++entry)
+				out.push_back(entry->iter);
+			return;
+		}
+
+		std::vector<Entry> entries;
+		for (UInt32 i = 0; i < 3; i++)
+			if (buckets[i])
+				entries.insert(entries.end(), buckets[i]->begin(), buckets[i]->end());
+
+		std::sort(entries.begin(), entries.end());
+
+		for (typename std::vector<Entry>::iterator entry = entries.begin(); entry != entries.end(); ++entry)
+			out.push_back(entry->iter);
+	}
+
+private:
+	struct Entry
+	{
+		UInt32		order;
+		iterator	iter;
+
+		bool operator<(const Entry& rhs) const { return order < rhs.order; }
+	};
+
+	typedef std::vector<Entry>					Bucket;
+	typedef std::unordered_map<void*, Bucket>	BucketMap;
+
+	struct Scratch
+	{
+		std::vector<iterator>	candidates;
+		std::vector<UInt8>		wasInUse;
+	};
+
+	// only the callback being run and the last one are held, the last so the walk knows where the list ended
+	template <typename Matches, typename Run>
+	void DispatchWalk(Matches& matches, Run& run)
+	{
+		if (m_callbacks.empty())
+			return;
+
+		iterator last = --m_callbacks.end();
+		bool bLastHeld = false, bLastWasInUse = false;
+		for (iterator iter = m_callbacks.begin(); ; ) {
+			bool bLast = iter == last;
+			if (!iter->IsRemoved() && matches(*iter)) {
+				bool bWasInUse;
+				if (bLast && bLastHeld) {
+					bWasInUse = bLastWasInUse;
+					bLastHeld = false;
+				}
+				else {
+					bWasInUse = iter->IsInUse();
+					iter->SetInUse(true);
+					if (!bLast && !bLastHeld) {
+						bLastWasInUse = last->IsInUse();
+						last->SetInUse(true);
+						bLastHeld = true;
+					}
+				}
+
+				if (run(iter))
+					bWasInUse = true;
+
+				// held, so the handler couldn't have erased it
+				iterator next = iter;
+				++next;
+				Release(iter, bWasInUse);
+				iter = next;
+			}
+			else
+				++iter;
+
+			if (bLast)
+				break;
+		}
+
+		if (bLastHeld)
+			Release(last, bLastWasInUse);
+	}
+
+	// every candidate is held for the whole dispatch, as a handler may remove any of them. Their storage is reused,
+	// one set per nesting level
+	template <typename Matches, typename Run>
+	void DispatchIndexed(void* arg0, void* arg1, Matches& matches, Run& run)
+	{
+		UInt32 level = m_depth++;
+		if (level >= m_scratch.size())
+			m_scratch.resize(level + 1);
+
+		// indexed on each use, a nested dispatch may grow m_scratch
+		m_scratch[level].candidates.clear();
+		Collect(arg0, arg1, m_scratch[level].candidates);
+
+		UInt32 numCandidates = m_scratch[level].candidates.size();
+		m_scratch[level].wasInUse.resize(numCandidates);
+		for (UInt32 i = 0; i < numCandidates; i++) {
+			Scratch& scratch = m_scratch[level];
+			scratch.wasInUse[i] = scratch.candidates[i]->IsInUse();
+			scratch.candidates[i]->SetInUse(true);
+		}
+
+		for (UInt32 i = 0; i < numCandidates; i++) {
+			iterator iter = m_scratch[level].candidates[i];
+			if (!iter->IsRemoved() && matches(*iter) && run(iter))
+				m_scratch[level].wasInUse[i] = 1;
+		}
+
+		for (UInt32 i = 0; i < numCandidates; i++)
+			Release(m_scratch[level].candidates[i], m_scratch[level].wasInUse[i] != 0);
+
+		m_scratch[level].candidates.clear();
+		m_depth--;
+	}
+
+	// undoes a dispatch's in use flag, erasing the callback if it was removed and nothing else holds it
+	void Release(iterator iter, bool bWasInUse)
+	{
+		iter->SetInUse(bWasInUse);
+		if (!bWasInUse && iter->IsRemoved())
+			Erase(iter);
+	}
+
+	BucketMap* MapFor(const Callback& callback, void*& key)
+	{
+		if (callback.source) {
+			key = callback.source;
+			return &m_bySource;
+		}
+
+		if (callback.object && Keys::ObjectKey(m_eventID, callback, key))
+			return &m_byObject;
+
+		key = NULL;
+		return NULL;
+	}
+
+	std::list<Callback>		m_callbacks;
+	BucketMap				m_bySource;
+	BucketMap				m_byObject;
+	Bucket					m_unfiltered;
+	UInt32					m_eventID;
+	UInt32					m_nextOrder;
+	std::vector<Scratch>	m_scratch;		// by dispatch nesting level
+	UInt32					m_depth;
+};
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+#include "ThreadLocal.h"
+
+// Quest scripts in particular can declare hundreds of variables, so past the first few entries of the var list
+// ScriptEventList::GetVariable() goes through an index by variable ID. An index is dropped by Remove() when its list
+// is destroyed (see Hook_Script_Init), so while it exists its list and the list's entries are alive. The game adds
+// variables at the front of the list as it reads them, and an index is rebuilt when the head changes or an entry has
+// been linked after the last one it saw; otherwise a variable missing from it isn't in the list.
+//
+// Templated on the event list so the host benchmark can run it over fake lists; EventList needs Var, VarEntry,
+// m_vars and kMaxUnindexedVars as ScriptEventList declares them.
+template <typename EventList>
+class EventListVarIndexes
+{
+	typedef typename EventList::Var			Var;
+	typedef typename EventList::VarEntry	VarEntry;
+
+	struct VarIndex
+	{
+		VarEntry			* head;
+		VarEntry			* tail;
+		std::vector<Var*>	vars;		// by variable ID
+	};
+
+	std::unordered_map<EventList*, VarIndex>	m_indexes;
+	ICriticalSection							m_cs;
+
+	static void Build(EventList* eventList, VarIndex& index)
+	{
+		index.head = eventList->m_vars;
+		index.tail = NULL;
+		index.vars.clear();
+		for (VarEntry* entry = eventList->m_vars; entry; entry = entry->next) {
+			index.tail = entry;
+
+			Var* var = entry->var;
+			if (!var || var->id > kMaxVarID)
+				continue;
+
+			if (var->id >= index.vars.size())
+				index.vars.resize(var->id + 1, NULL);
+			if (!index.vars[var->id])		// first match wins, as with a linear search
+				index.vars[var->id] = var;
+		}
+	}
+
+	static bool HasChanged(EventList* eventList, const VarIndex& index)
+	{
+		return index.head != eventList->m_vars || (index.tail && index.tail->next);
+	}
+
+	static Var* Find(const VarIndex& index, UInt32 id)
+	{
+		return id < index.vars.size() ? index.vars[id] : NULL;
+	}
+
+public:
+	enum
+	{
+		kMaxVarID = 0xFFFF,
+		kMaxIndexes = 0x1000,		// bounds the indexes of lists destroyed without going through the hooked destructor
+	};
+
+	// walks the first kMaxUnindexedVars entries, then uses the index
+	Var* Lookup(EventList* eventList, UInt32 id)
+	{
+		UInt32 numVisited = 0;
+		for (VarEntry* entry = eventList->m_vars; entry && numVisited < EventList::kMaxUnindexedVars; entry = entry->next, numVisited++)
+			if (entry->var && entry->var->id == id)
+				return entry->var;
+
+		if (numVisited < EventList::kMaxUnindexedVars)
+			return NULL;
+
+		return Get(eventList, id);
+	}
+
+	Var* Get(EventList* eventList, UInt32 id)
+	{
+		if (id > kMaxVarID)
+			return NULL;
+
+		ScopedLock lock(m_cs);
+		typename std::unordered_map<EventList*, VarIndex>::iterator iter = m_indexes.find(eventList);
+		if (iter == m_indexes.end()) {
+			if (m_indexes.size() >= kMaxIndexes)
+				m_indexes.clear();
+
+			VarIndex& index = m_indexes[eventList];
+			Build(eventList, index);
+			return Find(index, id);
+		}
+
+		VarIndex& index = iter->second;
+		if (HasChanged(eventList, index))
+			Build(eventList, index);
+
+		return Find(index, id);
+	}
+
+	// called when eventList is destroyed
+	void Remove(EventList* eventList)
+	{
+		ScopedLock lock(m_cs);
+		m_indexes.erase(eventList);
+	}
+
+	void Clear()
+	{
+		ScopedLock lock(m_cs);
+		m_indexes.clear();
+	}
+
+	UInt32 Size()
+	{
+		ScopedLock lock(m_cs);
+		return m_indexes.size();
+	}
+};
@@ -1,6 +1,10 @@
 #include <list>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
 #include <stdarg.h>
 #include "EventManager.h"
+#include "EventCallbackList.h"
 #include "ArrayVar.h"
 #include "PluginAPI.h"
 #include "GameAPI.h"
@@ -14,6 +18,7 @@
 #include "GameOSDepend.h"
 #include "InventoryReference.h"
 #include "GameData.h"
+#include "utility.h"
 
 namespace EventManager {
 
@@ -1360,19 +1365,32 @@ UInt32 EventIDForMessage(UInt32 msgID)
 typedef std::vector<EventInfo*> EventInfoList;
 static EventInfoList s_eventInfos;
 
-UInt32 EventManager::EventIDForString(const char* eventStr)
+// event IDs by name, case-insensitive. Keys point at EventInfo::name, which lives as long as the EventInfo
+struct EventNameHashCI {
+	size_t operator()(const char* name) const { return StrHashCI(name); }
+};
+struct EventNameEqualCI {
+	bool operator()(const char* lhs, const char* rhs) const { return !_stricmp(lhs, rhs); }
+};
+typedef std::unordered_map<const char*, UInt32, EventNameHashCI, EventNameEqualCI> EventIDMap;
+static EventIDMap s_eventIDs;
+
+// all event infos are added through here so the name index stays in step with s_eventInfos
+static UInt32 AddEventInfo(EventInfo* info)
 {
-	std::string name(eventStr);
-	MakeLower(name);
-	eventStr = name.c_str();
-	UInt32 numEventInfos = s_eventInfos.size ();
-	for (UInt32 i = 0; i < numEventInfos; i++) {
-		if (!strcmp(eventStr, s_eventInfos[i]->name.c_str())) {
-			return i;
-		}
-	}
+	ScopedLock lock(s_criticalSection);
 
-	return kEventID_INVALID;
+	UInt32 id = s_eventInfos.size();
+	s_eventInfos.push_back(info);
+	// if the name is already taken, lookups keep returning the first event registered with it
+	s_eventIDs.emplace(info->name.c_str(), id);
+	return id;
+}
+
+UInt32 EventManager::EventIDForString(const char* eventStr)
+{
+	EventIDMap::iterator found = s_eventIDs.find(eventStr);
+	return found != s_eventIDs.end() ? found->second : kEventID_INVALID;
 }
 
 bool EventCallback::Equals(const EventCallback& rhs) const
@@ -1383,7 +1401,37 @@ bool EventCallback::Equals(const EventCallback& rhs) const
 		callingObj == rhs.callingObj);
 }
 
-typedef std::list<EventCallback>	CallbackList;
+// what CallbackList's buckets are keyed by for each event
+struct EventCallbackKeys
+{
+	// OnHealthDamage checks the source filter against the attacker
+	static void* SourceArg(UInt32 eventID, void* arg0, void* arg1)
+	{
+		return eventID == kEventID_OnHealthDamage ? arg1 : arg0;
+	}
+
+	static bool ObjectKey(UInt32 eventID, const EventCallback& callback, void*& key)
+	{
+		if (eventID != kEventID_OnMagicEffectHit) {
+			key = callback.object;
+			return true;
+		}
+
+		// OnMagicEffectHit passes the effect code, and a filter that isn't an effect setting matches anything
+		EffectSetting* setting = OBLIVION_CAST(callback.object, TESForm, EffectSetting);
+		if (!setting)
+			return false;
+
+		key = (void*)setting->effectCode;
+		return true;
+	}
+};
+
+class CallbackList : public EventCallbackList<EventCallback, EventCallbackKeys>
+{
+public:
+	CallbackList(UInt32 eventID) : EventCallbackList<EventCallback, EventCallbackKeys>(eventID) { }
+};
 
 bool RemoveHandler(UInt32 id, EventCallback& handler);
 bool RemoveHandler(UInt32 id, Script* fnScript);
@@ -1448,100 +1496,73 @@ std::list<DeferredCallback> s_deferredCallbacks;
 void __stdcall HandleEventForCallingObject(UInt32 id, TESObjectREFR* callingObj, void* arg0, void* arg1)
 {
 	ScopedLock lock(s_criticalSection);
-	bool ignoreNull = false;
 	EventInfo* eventInfo = s_eventInfos[id];
-	if (eventInfo->callbacks) {
-		for (CallbackList::iterator iter = eventInfo->callbacks->begin(); iter != eventInfo->callbacks->end(); ) {
-			if (iter->IsRemoved()) {
-				if (!iter->IsInUse()) {
-					iter = eventInfo->callbacks->erase(iter);
-				}
-				else {
-					++iter;
-				}
+	if (!eventInfo->callbacks)
+		return;
 
-				continue;
-			}
-			if (id == kEventID_EventKey || id == kEventID_EventControl) {
-				ignoreNull = true;
-				if (arg0 != iter->source || arg1 != iter->object) {
-					++iter;
-					continue;
-				}
+	// key and control handlers are run with both args even if they're null
+	bool ignoreNull = id == kEventID_EventKey || id == kEventID_EventControl;
+
+	// a handler may remove itself or another candidate, see EventCallbackList::Dispatch
+	eventInfo->callbacks->Dispatch(arg0, arg1,
+		[&](const EventCallback& callback) -> bool {
+			if (ignoreNull) {
+				return arg0 == callback.source && arg1 == callback.object;
 			}
-			else {
-				// Check filters
-				if (iter->source) {
-					// special-case - check the source filter against the second arg, the attacker
-					if (id == kEventID_OnHealthDamage) {
-						if ((TESObjectREFR*)arg1 != iter->source) {
-							++iter;
-							continue;
-						}
-					}
-					else if (!((TESObjectREFR*)arg0 == iter->source)) {
-						++iter;
-						continue;
+
+			// Check filters
+			if (callback.source) {
+				// special-case - check the source filter against the second arg, the attacker
+				if (id == kEventID_OnHealthDamage) {
+					if ((TESObjectREFR*)arg1 != callback.source) {
+						return false;
 					}
 				}
-
-				if (iter->callingObj && !(callingObj == iter->callingObj)) {
-					++iter;
-					continue;
+				else if (!((TESObjectREFR*)arg0 == callback.source)) {
+					return false;
 				}
+			}
 
-				if (iter->object) {
-					if (id == kEventID_OnMagicEffectHit) {
-						EffectSetting* setting = OBLIVION_CAST(iter->object, TESForm, EffectSetting);
-						if (setting && setting->effectCode != (UInt32)arg1) {
-							++iter;
-							continue;
-						}
-					}
-					else if (!(iter->object == (TESForm*)arg1)) {
-						++iter;
-						continue;
+			if (callback.callingObj && !(callingObj == callback.callingObj)) {
+				return false;
+			}
+
+			if (callback.object) {
+				if (id == kEventID_OnMagicEffectHit) {
+					EffectSetting* setting = OBLIVION_CAST(callback.object, TESForm, EffectSetting);
+					if (setting && setting->effectCode != (UInt32)arg1) {
+						return false;
 					}
 				}
+				else if (!(callback.object == (TESForm*)arg1)) {
+					return false;
+				}
 			}
+			return true;
+		},
+		[&](CallbackList::iterator iter) -> bool {
 			if (GetCurrentThreadId() != g_mainThreadID) {
 				// avoid potential issues with invoking handlers outside of main thread by deferring event handling
-				if (!iter->IsRemoved()) {
-					iter->SetInUse(true);
-					s_deferredCallbacks.push_back(DeferredCallback(iter, callingObj, arg0, arg1, eventInfo));
-					++iter;
-				}
+				// the callback stays in use until Tick() has invoked it
+				s_deferredCallbacks.push_back(DeferredCallback(iter, callingObj, arg0, arg1, eventInfo));
+				return true;
 			}
-			else {
-				// handle immediately
-				bool bWasInUse = iter->IsInUse();
-				iter->SetInUse(true);
-				s_eventStack.push(eventInfo->name);
-				if (iter->script) {
-					ScriptToken* result = UserFunctionManager::Call(EventHandlerCaller(iter->script, eventInfo, arg0, arg1, callingObj, ignoreNull));
-					// result is unused
-					delete result;
-				}
-				else {
-					iter->eventFunction(arg0,arg1, callingObj); //TODO there is no validation of parameters. Add it.
-					//TODO actually restructure this entire mess.
-				}
-
-				s_eventStack.pop();
-				iter->SetInUse(bWasInUse);
-
-				// it's possible the handler decided to remove itself, so take care of that, being careful
-				// not to remove a callback that is needed for deferred invocation
-				if (!bWasInUse && iter->IsRemoved()) {
-					iter = eventInfo->callbacks->erase(iter);
-				}
-				else {
-					++iter;
-				}
 
+			// handle immediately
+			s_eventStack.push(eventInfo->name);
+			if (iter->script) {
+				ScriptToken* result = UserFunctionManager::Call(EventHandlerCaller(iter->script, eventInfo, arg0, arg1, callingObj, ignoreNull));
+				// result is unused
+				delete result;
 			}
-		}
-	}
+			else {
+				iter->eventFunction(arg0,arg1, callingObj); //TODO there is no validation of parameters. Add it.
+				//TODO actually restructure this entire mess.
+			}
+
+			s_eventStack.pop();
+			return false;
+		});
 }
 
 void __stdcall HandleEvent(UInt32 id, void * arg0, void * arg1)
@@ -1569,8 +1590,7 @@ bool SetHandler(const char* eventName, EventCallback& handler)
 	if (kEventID_INVALID == id)
 	{
 		// have to assume registering for a user-defined event which has not been used before this point
-		id = s_eventInfos.size();
-		s_eventInfos.push_back (new EventInfo (eventName, kEventParams_OneArray, 1));
+		id = AddEventInfo (new EventInfo (eventName, kEventParams_OneArray, 1));
 	}
 
 	if (id < s_eventInfos.size()) {
@@ -1587,7 +1607,7 @@ bool SetHandler(const char* eventName, EventCallback& handler)
 		}
 
 		if (!info->callbacks) {
-			info->callbacks = new CallbackList();
+			info->callbacks = new CallbackList(id);
 		}
 		else {
 			// if an existing handler matches this one exactly, don't duplicate it
@@ -1599,7 +1619,7 @@ bool SetHandler(const char* eventName, EventCallback& handler)
 				}
 			}
 		}
-		info->callbacks->push_back(handler);
+		info->callbacks->Add(handler);
 		return true;
 	}
 	else {
@@ -1656,7 +1676,7 @@ bool RemoveHandler(const char* id, EventCallback& handler)
 						++iter;
 					}
 					else {
-						iter = callbacks->erase(iter);
+						iter = callbacks->Erase(iter);
 					}
 
 					bRemovedAtLeastOne = true;
@@ -1809,10 +1829,8 @@ void Tick()
 
 	// handle deferred events, Verify used or not used?
 	if (s_deferredCallbacks.size()) {
-		std::list< std::list<DeferredCallback>::iterator > s_removedCallbacks;
-
-		std::list<DeferredCallback>::iterator iter = s_deferredCallbacks.begin();
-		while (iter != s_deferredCallbacks.end()) {
+		std::list<DeferredCallback>::iterator iter;
+		for (iter = s_deferredCallbacks.begin(); iter != s_deferredCallbacks.end(); ++iter) {
 			if (!iter->iterator->IsRemoved()) {
 				s_eventStack.push(iter->eventInfo->name);
 				if (iter->iterator->script) {
@@ -1825,21 +1843,23 @@ void Tick()
 					iter->iterator->eventFunction(iter->arg0, iter->arg1, iter->callingObj); //TODO param validation
 				}
 				s_eventStack.pop();
+			}
+		}
 
+		// release the handlers and get rid of any removed while queued or during processing above
+		// a handler may have been deferred more than once, only its first entry releases it
+		std::vector<DeferredCallback*> removedCallbacks;
+		for (iter = s_deferredCallbacks.begin(); iter != s_deferredCallbacks.end(); ++iter) {
+			if (iter->iterator->IsInUse()) {
+				iter->iterator->SetInUse(false);
 				if (iter->iterator->IsRemoved()) {
-					s_removedCallbacks.push_back(iter);
-					++iter;
-				}
-				else {
-					iter = s_deferredCallbacks.erase(iter);
+					removedCallbacks.push_back(&*iter);
 				}
 			}
 		}
 
-		// get rid of any handlers removed during processing above
-		while (s_removedCallbacks.size()) {
-			(*s_removedCallbacks.begin())->eventInfo->callbacks->erase(iter->iterator);
-			s_removedCallbacks.pop_front();
+		for (UInt32 i = 0; i < removedCallbacks.size(); i++) {
+			removedCallbacks[i]->eventInfo->callbacks->Erase(removedCallbacks[i]->iterator);
 		}
 
 		s_deferredCallbacks.clear();
@@ -1874,7 +1894,7 @@ void Tick()
 
 void Init()
 {
-#define EVENT_INFO(name, params, hookInstaller) s_eventInfos.push_back (new EventInfo (name, params, params ? sizeof(params) : 0, hookInstaller));
+#define EVENT_INFO(name, params, hookInstaller) AddEventInfo (new EventInfo (name, params, params ? sizeof(params) : 0, hookInstaller));
 
 	EVENT_INFO("onhit", kEventParams_GameEvent, &s_MainEventHook)
 	EVENT_INFO("onhitwith", kEventParams_GameEvent, &s_MainEventHook)
@@ -1982,7 +2002,7 @@ namespace PluginAPI {
 	bool RegisterEventNative(PluginEventInfo* info) {
 		if (EventManager::s_eventInfos.empty()) return false;
 		EventManager::EventInfo* event = new EventManager::EventInfo(info->name, info->paramTypes, info->numParams, &info->installer);
-		EventManager::s_eventInfos.push_back(event);
+		EventManager::AddEventInfo(event);
 		return true;
 	}
 }
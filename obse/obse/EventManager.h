@@ -135,6 +135,8 @@ namespace EventManager
 
 	typedef void (*EventHookInstaller)();
 
+	class CallbackList;
+
 	struct EventInfo
 	{
 		EventInfo(std::string const& name_, UInt8* params_, UInt8 nParams_, EventHookInstaller* installer_)
@@ -155,7 +157,7 @@ namespace EventManager
 		std::string					name;			// must be lowercase
 		UInt8* paramTypes;
 		UInt8						numParams;
-		std::list<EventCallback>* callbacks;
+		CallbackList* callbacks;
 		EventHookInstaller* installHook;			// if a hook is needed for this event type, this will be non-null. 
 													// install it once and then set *installHook to NULL. Allows multiple events
 													// to use the same hook, installing it only once.
@@ -157,12 +157,8 @@ double ExpressionEvaluator::ReadFloat()
 std::string ExpressionEvaluator::ReadString()
 {
 	UInt16 len = Read16();
-	char* buf = new char[len + 1];
-	memcpy(buf, m_data, len);
-	buf[len] = 0;
-	std::string str = buf;
+	std::string str(reinterpret_cast<const char*>(m_data), len);
 	m_data += len;
-	delete buf;
 	return str;
 }
 
@@ -644,15 +640,67 @@ bool ExpressionEvaluator::ConvertDefaultArg(ScriptToken* arg, ParamInfo* info, b
 }
 
 
+// Operand stack for Evaluate(). Expressions rarely hold more than a few operands at once, so the
+// storage lives on the stack and only spills to the heap for unusually deep expressions.
+class OperandStack
+{
+	enum { kInlineCapacity = 32 };
+
+	ScriptToken*				m_inline[kInlineCapacity];
+	std::vector<ScriptToken*>	m_overflow;
+	UInt32						m_size;
+
+public:
+	OperandStack() : m_size(0) { }
+
+	UInt32 size() const { return m_size; }
+
+	void push(ScriptToken* token)
+	{
+		if (m_size < kInlineCapacity)
+			m_inline[m_size] = token;
+		else
+			m_overflow.push_back(token);
+		m_size++;
+	}
+
+	ScriptToken* top() const
+	{
+		return m_size <= kInlineCapacity ? m_inline[m_size - 1] : m_overflow.back();
+	}
+
+	void pop()
+	{
+		if (m_size > kInlineCapacity)
+			m_overflow.pop_back();
+		m_size--;
+	}
+};
+
 ScriptToken* ExpressionEvaluator::Evaluate()
 {
-	std::stack<ScriptToken*> operands;
+	OperandStack operands;
+
+	UInt8* exprData = m_data;
+	std::shared_ptr<const DecodedExpression> decoded = DecodedExpressionCache::Get(script, exprData);
+	const DecodedToken* decodedToken = NULL;
+	UInt32 tokenIdx = 0;
 
 	UInt16 argLen = Read16();
 	UInt8* endData = m_data + argLen - sizeof(UInt16);
 	while (m_data < endData)
 	{
-		ScriptToken* curToken = ScriptToken::Read(this);
+		ScriptToken* curToken;
+		if (decoded)
+		{
+			// decoded tokens are in data order, keeping m_data in step lets commands read their args as usual
+			decodedToken = &decoded->tokens[tokenIdx++];
+			m_data = exprData + decodedToken->nextOffset;
+			curToken = ScriptToken::Read(*decodedToken, this);
+		}
+		else
+			curToken = ScriptToken::Read(this);
+
 		if (!curToken)
 			break;
 
@@ -669,7 +717,7 @@ ScriptToken* ExpressionEvaluator::Evaluate()
 			}
 
 			TESObjectREFR* callingObj = m_thisObj;
-			Script::RefVariable* callingRef = script->GetVariable(curToken->GetRefIndex());
+			Script::RefVariable* callingRef = decoded ? decodedToken->refVar : script->GetVariable(curToken->GetRefIndex());
 			if (callingRef)
 			{
 				callingRef->Resolve(eventList);
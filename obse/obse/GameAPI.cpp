@@ -12,11 +12,14 @@
 #if OBSE_CORE
 #include "Hooks_Script.h"
 #include "ScriptUtils.h"
+#include "ThreadLocal.h"
+#include "EventListVarIndex.h"
 #endif
 
 #include <float.h>
 #include <cctype>
 #include <set>
+#include <unordered_map>
 
 /***
  *	opcodes
@@ -69,13 +72,29 @@ UInt32 ScriptEventList::ResetAllVariables()
 	return numVars;
 }
 
+#if OBSE_CORE
+
+static EventListVarIndexes<ScriptEventList> s_varIndexes;
+
+void ScriptEventList::ClearVariableIndexes()
+{
+	s_varIndexes.Clear();
+}
+
+#endif
+
 ScriptEventList::Var * ScriptEventList::GetVariable(UInt32 id)
 {
+#if OBSE_CORE
+	// short lists and the first few variables are faster to find by walking the list
+	return s_varIndexes.Lookup(this, id);
+#else
 	for(VarEntry * entry = m_vars; entry; entry = entry->next)
 		if(entry->var && entry->var->id == id)
 			return entry->var;
 
 	return NULL;
+#endif
 }
 
 ScriptEventList* EventListFromForm(TESForm* form)
@@ -96,6 +115,9 @@ ScriptEventList* EventListFromForm(TESForm* form)
 
 void ScriptEventList::Destructor()
 {
+#if OBSE_CORE
+	s_varIndexes.Remove(this);
+#endif
 	ThisStdCall(0x004FB4E0, this);
 
 }
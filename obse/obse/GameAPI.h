@@ -126,11 +126,15 @@ struct ScriptEventList
 	VarEntry	* m_vars;						// 0C
 	ScriptEffectInfo	* m_scriptEffectInfo;	// 10
 
+	enum { kMaxUnindexedVars = 8 };	// GetVariable() uses an index for variables further down the list
+
 	void	Dump(void);
 	Var *	GetVariable(UInt32 id);
 	UInt32	ResetAllVariables();
 
 	void	Destructor();
+
+	static void	ClearVariableIndexes();		// called on new game and load, which destroy all event lists
 };
 
 ScriptEventList* EventListFromForm(TESForm* form);
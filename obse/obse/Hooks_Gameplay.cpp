@@ -227,11 +227,26 @@ static void HandleNewGameHook(void)
 	// (previously returned true on new game only if user started new game immediately after launching Oblivion)
 	g_gameLoaded = 1;
 
+	ScriptEventList::ClearVariableIndexes();
 	Serialization::HandleNewGame();
 }
 
 DWORD g_mainThreadID = 0;
 
+// logs a map's collection stats when its temporary vars first outlast the per-frame budget, not on every frame after
+template <class Var>
+static void CollectTempVars(VarMap<Var>& map, const char* name, bool& bBehind)
+{
+	map.Collect(TempVarCollectMaxVars, TempVarCollectMaxMicroseconds);
+
+	typename VarMap<Var>::CollectStats stats;
+	map.GetCollectStats(stats);
+	if (stats.numTemp && !bBehind)
+		map.LogCollectStats(name);
+
+	bBehind = stats.numTemp != 0;
+}
+
 static void HandleMainLoopHook(void)
 {
 	static bool s_recordedMainThreadID = false;
@@ -244,9 +259,10 @@ static void HandleMainLoopHook(void)
 	// Hook_Memory_CheckAllocs(); not currently used
 	// DoDeferredEnable(); not currently used
 
-	// clean up any temp arrays/strings
-	g_ArrayMap.Clean();
-	g_StringMap.Clean();
+	// clean up temp arrays/strings, anything over the per-frame budget is left for the next frame
+	static bool s_arraysBehind = false, s_stringsBehind = false;
+	CollectTempVars(g_ArrayMap, "array vars over collection budget", s_arraysBehind);
+	CollectTempVars(g_StringMap, "string vars over collection budget", s_stringsBehind);
 
 	// delete any refs queued for deletion by DeleteReference command
 	// ###TODO: make this a Task
@@ -799,6 +815,9 @@ void __stdcall SendQuitGameMessage(QuitGameMessage msg)
 
 	PluginManager::Dispatch_Message(0, msgToSend, NULL, 0, NULL);
 	EventManager::HandleOBSEMessage(msgToSend, NULL);
+
+	// don't let the process exit in the middle of writing a co-save
+	Serialization::WaitForPendingSave();
 }
 
 static __declspec(naked) void ExitGameFromIngameMenuHook(void)
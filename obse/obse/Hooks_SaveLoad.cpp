@@ -139,6 +139,7 @@ static void __stdcall DoLoadGameHook(BSFile * file)
 
 	_MESSAGE("DoLoadGameHook: %s", file->m_path);
 
+	ScriptEventList::ClearVariableIndexes();
 	Serialization::HandleLoadGame(file->m_path);
 }
 
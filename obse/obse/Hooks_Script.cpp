@@ -35,6 +35,8 @@ char s_ExpressionParserAltBuffer[0x500] = {0};
 	static const UInt32 kExtractArgsReadNumArgsPatchAddr = 0x004FAE9A;	// movzx edx, word ptr (num args)
 	static const UInt32 kExtractArgsNoArgsPatchAddr = 0x004FAEBA;			// jle kExtractArgsEndProcAddr (if num args == 0)
 
+	static const UInt32 kScriptEventListDestructorAddr = 0x004FB4E0;
+
 	static const UInt32 kScriptRunner_RunHookAddr = 0x0051737F;
 	static const UInt32 kScriptRunner_RunRetnAddr = kScriptRunner_RunHookAddr + 5;
 	static const UInt32 kScriptRunner_RunCallAddr = 0x005792E0;			// overwritten call
@@ -126,10 +128,45 @@ static __declspec(naked) void ExpressionParserBufferOverflowHook_2(void)
 	}
 }
 
+// ScriptEventList::Destructor() drops the list's variable index before calling the game's destructor
+static void __fastcall ScriptEventListDestructorHook(ScriptEventList* eventList, UInt32 edx)
+{
+	eventList->Destructor();
+}
+
+// the game destroys event lists from many places, so every call to the destructor in its code is redirected
+static void HookEventListDestructorCalls()
+{
+	UInt8* module = (UInt8*)GetModuleHandle(NULL);
+	IMAGE_NT_HEADERS* ntHeaders = (IMAGE_NT_HEADERS*)(module + ((IMAGE_DOS_HEADER*)module)->e_lfanew);
+	IMAGE_SECTION_HEADER* section = IMAGE_FIRST_SECTION(ntHeaders);
+
+	UInt32 numPatched = 0;
+	for (UInt32 i = 0; i < ntHeaders->FileHeader.NumberOfSections; i++, section++) {
+		if (!(section->Characteristics & IMAGE_SCN_CNT_CODE) || section->Misc.VirtualSize < 5)
+			continue;
+
+		UInt32 start = (UInt32)module + section->VirtualAddress;
+		UInt32 end = start + section->Misc.VirtualSize - 5;
+		for (UInt32 addr = start; addr <= end; addr++) {
+			// call rel32
+			if (*(UInt8*)addr == 0xE8 && addr + 5 + *(SInt32*)(addr + 1) == kScriptEventListDestructorAddr) {
+				WriteRelCall(addr, (UInt32)&ScriptEventListDestructorHook);
+				numPatched++;
+			}
+		}
+	}
+
+	_MESSAGE("hooked %d calls to the ScriptEventList destructor", numPatched);
+}
+
 void Hook_Script_Init()
 {
 	WriteRelJump(ExtractStringPatchAddr, (UInt32)&ExtractStringHook);
 
+	// variable indexes have to be dropped when their event lists are destroyed, see EventListVarIndex.h
+	HookEventListDestructorCalls();
+
 	// patch the "apple bug"
 	// game caches information about the most recently retrieved RefVariable for the current executing script
 	// if same refIdx requested twice in a row returns previously returned ref without
@@ -4,6 +4,7 @@
 #include "ArrayVar.h"
 #include "GameData.h"
 #include "common/IFileStream.h"
+#include "CoSaveRecords.h"
 #include <algorithm>
 #include <string>
 #include "Script.h"
@@ -27,22 +28,23 @@ void SaveModList(OBSESerializationInterface* obse)
 static UInt8	s_preloadModRefIDs[0xFF];
 static UInt8	s_numPreloadMods = 0;
 
-bool ReadModListFromCoSave(OBSESerializationInterface * intfc)
+bool ReadModListFromCoSave(OBSESerializationInterface * intfc, UInt32 length)
 {
 	_MESSAGE("Reading mod list from co-save");
 
-	char name[0x104] = { 0 };
-	UInt16 nameLen = 0;
+	RecordCursor record(intfc->ReadRecordSpan(length), length);
+	std::vector<SavedString> names;
+	bool bRead = ReadModList(record, names);
+	if (!bRead)
+		_MESSAGE("ReadModListFromCoSave: truncated mod list");
 
-	intfc->ReadRecordData(&s_numPreloadMods, sizeof(s_numPreloadMods));
+	std::string name;
+	s_numPreloadMods = names.size();
 	for (UInt32 i = 0; i < s_numPreloadMods; i++) {
-		intfc->ReadRecordData(&nameLen, sizeof(nameLen));
-		intfc->ReadRecordData(&name, nameLen);
-		name[nameLen] = 0;
-
-		s_preloadModRefIDs[i] = (*g_dataHandler)->GetModIndex(name);
+		name.assign(names[i].data, names[i].len);
+		s_preloadModRefIDs[i] = (*g_dataHandler)->GetModIndex(name.c_str());
 	}
-	return true;
+	return bRead;
 }
 
 bool ReadModListFromSaveGame(const char* path)
@@ -169,6 +171,9 @@ void Core_SaveCallback(void * reserved)
 	g_StringMap.Save(&g_OBSESerializationInterface);
 	g_ArrayMap.Save(&g_OBSESerializationInterface);
 	SaveGlobals (&g_OBSESerializationInterface);
+
+	g_StringMap.LogCollectStats("string vars saved");
+	g_ArrayMap.LogCollectStats("array vars saved");
 }
 
 void Core_LoadCallback(void * reserved)
@@ -186,6 +191,7 @@ void Core_LoadCallback(void * reserved)
 		case 'STVR':
 		case 'STVE':
 		case 'ARVS':
+		case 'ARVT':
 		case 'ARVR':
 		case 'ARVE':
 		case 'MODS':	
@@ -200,6 +206,26 @@ void Core_LoadCallback(void * reserved)
 	}
 }
 
+// changes whenever Core_SaveCallback would write something different. The mod list can't change while the game runs
+UInt32 Core_GenerationCallback(void)
+{
+	static double	s_mvmtSpeedMod = 0.0;
+	static double	s_effMod = 0.0;
+	static UInt32	s_globalsGeneration = 0;
+
+	double mvmtSpeedMod = GetPersistentPlayerMovementSpeedModifier ();
+	double effMod = GetPersistentPlayerSpellEffectivenessModifier ();
+	if (mvmtSpeedMod != s_mvmtSpeedMod || effMod != s_effMod)
+	{
+		s_mvmtSpeedMod = mvmtSpeedMod;
+		s_effMod = effMod;
+		s_globalsGeneration++;
+	}
+
+	// each only ever increases, so the sum changes if any of them do
+	return g_StringMap.GetGeneration() + g_ArrayMap.GetGeneration() + s_globalsGeneration;
+}
+
 void Core_NewGameCallback(void * reserved)
 {
 	ResetGlobals ();
@@ -237,7 +263,7 @@ void Core_PreloadCallback(void * reserved)
 		switch (type) {
 			case 'MODS':
 				// as of 0019 mod list stored in co-save
-				ReadModListFromCoSave(intfc);
+				ReadModListFromCoSave(intfc, length);
 				break;
 			case 'STVS':
 				if (!s_numPreloadMods) {
@@ -268,4 +294,5 @@ void Init_CoreSerialization_Callbacks()
 	Serialization::InternalSetLoadCallback(0, Core_LoadCallback);
 	Serialization::InternalSetNewGameCallback(0, Core_NewGameCallback);
 	Serialization::InternalSetPreloadCallback(0, Core_PreloadCallback);
+	Serialization::InternalSetGenerationCallback(0, Core_GenerationCallback);
 }
@@ -49,7 +49,7 @@ void ArrayIterLoop::UpdateIterator(const ArrayElement* elem)
 	switch (elem->DataType())
 	{
 	case kDataType_String:
-		g_ArrayMap.SetElementString(m_iterID, val, elem->m_data.str);
+		g_ArrayMap.SetElementString(m_iterID, val, std::string(elem->StrData(), elem->StrLength()));
 		break;
 	case kDataType_Numeric:
 		g_ArrayMap.SetElementNumber(m_iterID, val, elem->m_data.num);
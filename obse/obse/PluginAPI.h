@@ -549,12 +549,14 @@ struct OBSEScriptInterface
 
 struct OBSESerializationInterface
 {
+	// plugins check version before calling functions added after 1, earlier OBSE builds don't have their slots
 	enum
 	{
-		kVersion = 1,
+		kVersion = 2,	// 2 added ReadRecordSpan and SetGenerationCallback
 	};
 
 	typedef void (* EventCallback)(void * reserved);
+	typedef UInt32 (* GenerationCallback)(void);
 
 	UInt32	version;
 	void	(* SetSaveCallback)(PluginHandle plugin, EventCallback callback);
@@ -580,6 +582,18 @@ struct OBSESerializationInterface
 	// added v0021
 	// functions the same as GetNextRecordInfo except it doesn't flush the current chunk
 	bool	(* PeekNextRecordInfo)(UInt32 * type, UInt32 * version, UInt32 * length);
+
+	// added after v0022.7, kVersion == 2. Only call it if version >= 2
+	// returns a pointer to the next length bytes of the current record and skips past them, or NULL if
+	// the record has fewer than length bytes left. Avoids a copy when reading large records; the data is
+	// only valid until the load callback returns
+	const void *	(* ReadRecordSpan)(UInt32 length);
+
+	// added after v0022.7, kVersion == 2. Only call it if version >= 2
+	// the callback returns a counter which the plugin changes whenever the data written by its save callback
+	// would change. While it matches the value from the last save in this session, the block written by that
+	// save is written again without calling the save callback
+	void	(* SetGenerationCallback)(PluginHandle plugin, GenerationCallback callback);
 };
 
 
@@ -2,6 +2,9 @@
 #include "GameForms.h"
 #include "GameObjects.h"
 #include "CommandTable.h"
+#if OBLIVION
+#include "ScriptTokens.h"
+#endif
 
 UInt32 GetDeclaredVariableType(const char* varName, const char* scriptText)
 {
@@ -91,6 +94,7 @@ void Script::Constructor(void)
 
 void Script::StaticDestructor(void)
 {
+	DecodedExpressionCache::Invalidate(this);
 	ThisStdCall(0x004FC980, this);
 }
 
@@ -101,6 +105,7 @@ void Script::SetText(const char * buf)
 
 bool Script::CompileAndRun(void * unk0, UInt32 unk1, void * unk2)
 {	
+	DecodedExpressionCache::Invalidate(this);
 	return ThisStdCall(0x004FBF00, this, unk0, unk1, unk2) ? true : false;
 }
 
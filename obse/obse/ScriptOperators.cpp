@@ -0,0 +1,237 @@
+#include "ScriptOperators.h"
+
+// Rules for converting from one operand type to another
+Token_Type kConversions_Number[] =
+{
+	kTokenType_Boolean,
+};
+
+Token_Type kConversions_Boolean[] =
+{
+	kTokenType_Number,
+};
+
+Token_Type kConversions_Command[] =
+{
+#if !OBLIVION
+	kTokenType_Ambiguous,
+#endif
+
+	kTokenType_Number,
+	kTokenType_Form,
+	kTokenType_Boolean,
+};
+
+Token_Type kConversions_Ref[] =
+{
+	kTokenType_Form,
+	kTokenType_Boolean,
+};
+
+Token_Type kConversions_Global[] =
+{
+	kTokenType_Number,
+	kTokenType_Boolean,
+};
+
+Token_Type kConversions_Form[] =
+{
+	kTokenType_Boolean,
+};
+
+Token_Type kConversions_NumericVar[] =
+{
+	kTokenType_Number,
+	kTokenType_Boolean,
+	kTokenType_Variable,
+};
+
+Token_Type kConversions_ArrayElement[] =
+{
+#if !OBLIVION
+	kTokenType_Ambiguous,
+#endif
+
+	kTokenType_Number,
+	kTokenType_Form,
+	kTokenType_String,
+	kTokenType_Array,
+	kTokenType_Boolean,
+};
+
+Token_Type kConversions_RefVar[] =
+{
+	kTokenType_Form,
+	kTokenType_Boolean,
+	kTokenType_Variable,
+};
+
+Token_Type kConversions_StringVar[] =
+{
+	kTokenType_String,
+	kTokenType_Variable,
+	kTokenType_Boolean,
+};
+
+Token_Type kConversions_ArrayVar[] =
+{
+	kTokenType_Array,
+	kTokenType_Variable,
+	kTokenType_Boolean,
+};
+
+Token_Type kConversions_Array[] =
+{
+	kTokenType_Boolean,			// true if arrayID != 0, false if 0
+};
+
+Token_Type kConversions_AssignableString[] =
+{
+	kTokenType_String,
+};
+
+// just an array of the types to which a given token type can be converted
+struct Operand
+{
+	Token_Type	* rules;
+	UInt8		numRules;
+};
+
+// Operand definitions
+#define OPERAND(x) kConversions_ ## x, sizeof(kConversions_ ## x) / sizeof(Token_Type)
+
+static Operand s_operands[] =
+{
+	{	OPERAND(Number)		},
+	{	OPERAND(Boolean)	},
+	{	NULL,	0			},	// string has no conversions
+	{	OPERAND(Form)		},
+	{	OPERAND(Ref)		},
+	{	OPERAND(Global)		},
+	{	OPERAND(Array)		},
+	{	OPERAND(ArrayElement)	},
+	{	NULL,	0			},	// slice
+	{	OPERAND(Command)	},
+	{	NULL,	0			},	// variable
+	{	OPERAND(NumericVar)	},
+	{	OPERAND(RefVar)		},
+	{	OPERAND(StringVar)	},
+	{	OPERAND(ArrayVar)	},
+	{	NULL,	0			},  // operator
+	{	NULL,	0			},	// ambiguous
+	{	NULL,	0			},	// forEachContext
+	{	NULL,	0			},	// numeric placeholders, used only in bytecode
+	{	NULL,	0			},
+	{	NULL,	0			},
+	{	NULL,	0			},	// pair
+	{	OPERAND(AssignableString)	},
+};
+
+STATIC_ASSERT(sizeof(s_operands) / sizeof(Operand) == kTokenType_Max);
+
+bool CanConvertOperand(Token_Type from, Token_Type to)
+{
+	if (from == to)
+		return true;
+	else if (from >= kTokenType_Invalid || to >= kTokenType_Invalid)
+		return false;
+
+	Operand* op = &s_operands[from];
+	for (UInt32 i = 0; i < op->numRules; i++)
+	{
+		if (op->rules[i] == to)
+			return true;
+	}
+
+	return false;
+}
+
+// Operator
+Token_Type Operator::GetResult(Token_Type lhs, Token_Type rhs)
+{
+	for (UInt32 i = 0; i < numRules; i++)
+	{
+		OperationRule* rule = &rules[i];
+		if (CanConvertOperand(lhs, rule->lhs) && CanConvertOperand(rhs, rule->rhs))
+			return rule->result;
+		else if (!rule->bAsymmetric && CanConvertOperand(lhs, rule->rhs) && CanConvertOperand(rhs, rule->lhs))
+			return rule->result;
+	}
+
+	return kTokenType_Invalid;
+}
+
+bool CanConvertElement(UInt8 elemType, Token_Type to)
+{
+	if (to == kTokenType_ArrayElement)
+		return true;
+	else if (elemType == kDataType_Invalid)
+		return false;
+
+	switch (to)
+	{
+	case kTokenType_Boolean:
+		return elemType == kDataType_Form || elemType == kDataType_Numeric;
+	case kTokenType_String:
+		return elemType == kDataType_String;
+	case kTokenType_Number:
+		return elemType == kDataType_Numeric;
+	case kTokenType_Array:
+		return elemType == kDataType_Array;
+	case kTokenType_Form:
+		return elemType == kDataType_Form;
+	}
+
+	return false;
+}
+
+#if OBLIVION
+
+// [operator][lhs class][rhs class]
+OperatorDispatch OperatorDispatch::s_table[kOpType_Max][kOperandClass_Max][kOperandClass_Max];
+
+static bool OperandClassCanConvertTo(UInt32 operandClass, Token_Type to)
+{
+	if (operandClass >= kOperandClass_Element)
+		return CanConvertElement(operandClass - kOperandClass_Element, to);
+	return CanConvertOperand((Token_Type)operandClass, to);
+}
+
+void OperatorDispatch::Init(Operator* operators)
+{
+	for (UInt32 opType = 0; opType < kOpType_Max; opType++) {
+		Operator* op = &operators[opType];
+		for (UInt32 lhs = 0; lhs < kOperandClass_Max; lhs++) {
+			for (UInt32 rhs = 0; rhs < kOperandClass_Max; rhs++) {
+				OperatorDispatch& dispatch = s_table[opType][lhs][rhs];
+				dispatch.rule = OperatorDispatch::kRule_None;
+				dispatch.bSwapOrder = false;
+
+				// same matching as the rule loop in Evaluate()
+				for (UInt32 i = 0; i < op->numRules; i++) {
+					OperationRule* rule = &op->rules[i];
+					if (!rule->eval)
+						continue;
+
+					if (op->IsUnary()) {
+						if (OperandClassCanConvertTo(lhs, rule->lhs)) {
+							dispatch.rule = i;
+							break;
+						}
+					}
+					else if (OperandClassCanConvertTo(lhs, rule->lhs) && OperandClassCanConvertTo(rhs, rule->rhs)) {
+						dispatch.rule = i;
+						break;
+					}
+					else if (!rule->bAsymmetric && OperandClassCanConvertTo(rhs, rule->lhs) && OperandClassCanConvertTo(lhs, rule->rhs)) {
+						dispatch.rule = i;
+						dispatch.bSwapOrder = true;
+						break;
+					}
+				}
+			}
+		}
+	}
+}
+
+#endif
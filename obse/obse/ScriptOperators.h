@@ -0,0 +1,178 @@
+#pragma once
+
+#include "ArrayVarTypes.h"
+
+// Operator and operand types of OBSE expressions and the rules for converting between them. Kept out of
+// ScriptTokens.h so the rule tables and the operator dispatch table don't depend on the game
+
+struct ScriptToken;
+class ExpressionEvaluator;
+
+enum OperatorType : UInt8
+{
+	kOpType_Min		= 0,
+
+	kOpType_Assignment	= 0,
+	kOpType_LogicalOr,
+	kOpType_LogicalAnd,
+	kOpType_Slice,
+	kOpType_Equals,
+	kOpType_NotEqual,
+	kOpType_GreaterThan,
+	kOpType_LessThan,
+	kOpType_GreaterOrEqual,
+	kOpType_LessOrEqual,
+	kOpType_BitwiseOr,
+	kOpType_BitwiseAnd,
+	kOpType_LeftShift,
+	kOpType_RightShift,
+	kOpType_Add,
+	kOpType_Subtract,
+	kOpType_Multiply,
+	kOpType_Divide,
+	kOpType_Modulo,
+	kOpType_Exponent,
+	kOpType_Negation,
+	kOpType_LogicalNot,
+	kOpType_LeftParen,
+	kOpType_RightParen,
+	kOpType_LeftBracket,
+	kOpType_RightBracket,
+	kOpType_In,				// '<-'
+	kOpType_ToString,		// '$'
+	kOpType_PlusEquals,
+	kOpType_TimesEquals,
+	kOpType_DividedEquals,
+	kOpType_ExponentEquals,
+	kOpType_MinusEquals,
+	kOpType_ToNumber,		// '#'
+	kOpType_Dereference,	// unary '*'
+	kOpType_MemberAccess,	// stringmap->string, shortcut for stringmap["string"]
+	kOpType_MakePair,		// 'a::b', e.g. for defining key-value pairs for map structures
+	kOpType_Box,			// unary; wraps a value in a single-element array
+
+	kOpType_Max
+};
+
+enum Token_Type : UInt8
+{
+	kTokenType_Number	= 0,
+	kTokenType_Boolean,
+	kTokenType_String,
+	kTokenType_Form,
+	kTokenType_Ref,
+	kTokenType_Global,
+	kTokenType_Array,
+	kTokenType_ArrayElement,
+	kTokenType_Slice,
+	kTokenType_Command,
+	kTokenType_Variable,
+	kTokenType_NumericVar,
+	kTokenType_RefVar,
+	kTokenType_StringVar,
+	kTokenType_ArrayVar,
+	kTokenType_Ambiguous,
+	kTokenType_Operator,
+	kTokenType_ForEachContext,
+
+	// numeric literals can optionally be encoded as one of the following
+	// all are converted to _Number on evaluation
+	kTokenType_Byte,
+	kTokenType_Short,		// 2 bytes
+	kTokenType_Int,			// 4 bytes
+
+	kTokenType_Pair,
+	kTokenType_AssignableString,
+
+	kTokenType_Invalid,
+	kTokenType_Max = kTokenType_Invalid,
+
+	// sigil value, returned when an empty expression is parsed
+	kTokenType_Empty = kTokenType_Max + 1,
+};
+
+typedef ScriptToken* (* Op_Eval)(OperatorType op, ScriptToken* lh, ScriptToken* rh, ExpressionEvaluator* context);
+
+struct OperationRule
+{
+	Token_Type	lhs;
+	Token_Type	rhs;
+	Token_Type	result;
+	Op_Eval		eval;
+	bool		bAsymmetric;	// does order matter? e.g. var := constant legal, constant := var illegal
+};
+
+struct Operator
+{
+	UInt8			precedence;
+	char			symbol[3];
+	UInt8			numOperands;
+	OperatorType	type;
+	UInt8			numRules;
+	OperationRule	* rules;
+
+	bool Precedes(Operator* op) {
+		if (!IsRightAssociative())
+			return op->precedence <= precedence;
+		else
+			return op->precedence < precedence;
+	}
+	bool IsRightAssociative()	{ return type == kOpType_Assignment || IsUnary() || (type >= kOpType_PlusEquals && type <= kOpType_MinusEquals);	}
+	bool IsUnary()	{ return numOperands == 1;	}
+	bool IsBinary() { return numOperands == 2;	}
+	bool IsOpenBracket() { return (type == kOpType_LeftParen || type == kOpType_LeftBracket); }
+	bool IsClosingBracket() { return (type == kOpType_RightParen || type == kOpType_RightBracket); }
+	bool IsBracket() { return (IsOpenBracket() || IsClosingBracket()); }
+	char GetMatchedBracket() {
+		switch (type) {
+			case kOpType_LeftBracket :	return ']';
+			case kOpType_RightBracket : return '[';
+			case kOpType_LeftParen:		return ')';
+			case kOpType_RightParen:	return '(';
+			default: return 0;
+		}
+	}
+	bool ExpectsStringLiteral() { return type == kOpType_MemberAccess; }
+
+	Token_Type GetResult(Token_Type lhs, Token_Type rhs);	// at compile-time determine type resulting from operation
+	ScriptToken* Evaluate(ScriptToken* lhs, ScriptToken* rhs, ExpressionEvaluator* context);	// at run-time, operate on the operands and return result
+
+#if OBLIVION
+	static void InitDispatchTable();	// resolves the rule for every operator/operand combination up front, call once at startup
+#endif
+};
+
+bool CanConvertOperand(Token_Type from, Token_Type to);	// don't use directly at run-time, use ScriptToken::CanConvertTo() instead
+bool CanConvertElement(UInt8 elemType, Token_Type to);		// conversion rules for an array element of type kDataType_XXX
+
+#if OBLIVION
+
+// Operands are classified by token type, except array elements, which convert according to the type of the
+// element they refer to and so get one class per element data type.
+enum
+{
+	kOperandClass_Element = kTokenType_Max,
+	kOperandClass_Max = kOperandClass_Element + kDataType_Array + 1,
+
+	kOperandClass_None = 0xFF		// resolved through CanConvertTo() instead
+};
+
+// the rule Operator::Evaluate() uses for an operator and pair of operand classes, resolved once at startup
+struct OperatorDispatch
+{
+	UInt8	rule;		// index into Operator::rules, kRule_None if no rule matches
+	bool	bSwapOrder;
+
+	enum { kRule_None = 0xFF };
+
+	// fills in the table from each operator's rules, operators is indexed by OperatorType
+	static void Init(Operator* operators);
+
+	// unary operators only use rhs class 0
+	static const OperatorDispatch& Get(OperatorType op, UInt32 lhsClass, UInt32 rhsClass) { return s_table[op][lhsClass][rhsClass]; }
+
+private:
+	static OperatorDispatch	s_table[kOpType_Max][kOperandClass_Max][kOperandClass_Max];
+};
+
+#endif
@@ -1,6 +1,12 @@
 #include "ScriptTokens.h"
 #include "ScriptUtils.h"
 
+#if OBLIVION
+#include "SmallObjectsAllocator.h"
+#include "MemoryPool.cpp"
+#include "ThreadLocal.h"
+#endif
+
 #ifdef DBG_EXPR_LEAKS
 	SInt32 TOKEN_COUNT = 0;
 	SInt32 EXPECTED_TOKEN_COUNT = 0;
@@ -16,6 +22,35 @@ ScriptToken::~ScriptToken()
 #endif
 }
 
+#if OBLIVION
+
+// big enough for the token types created while evaluating expressions, anything larger goes to the heap
+union ScriptTokenSlot
+{
+	UInt8	token[sizeof(ScriptToken)];
+	UInt8	element[sizeof(ArrayElementToken)];
+	double	align;
+};
+
+static SmallObjectsAllocator::LockBasedAllocator<ScriptTokenSlot, 256> s_tokenAllocator;
+
+void* ScriptToken::operator new(size_t size)
+{
+	if (size <= sizeof(ScriptTokenSlot))
+		return s_tokenAllocator.Allocate();
+	return ::operator new(size);
+}
+
+void ScriptToken::operator delete(void* p, size_t size)
+{
+	if (size <= sizeof(ScriptTokenSlot))
+		s_tokenAllocator.Free(p);
+	else
+		::operator delete(p);
+}
+
+#endif
+
 /*************************************
 
 	ScriptToken constructors
@@ -711,6 +746,290 @@ Token_Type ScriptToken::ReadFrom(ExpressionEvaluator* context)
 	return type;
 }
 
+ScriptToken* ScriptToken::Read(const DecodedToken& decoded, ExpressionEvaluator* context)
+{
+	ScriptToken* newToken = new ScriptToken();
+	if (newToken->ReadFrom(decoded, context) != kTokenType_Invalid)
+		return newToken;
+
+	delete newToken;
+	return NULL;
+}
+
+Token_Type ScriptToken::ReadFrom(const DecodedToken& decoded, ExpressionEvaluator* context)
+{
+	type = decoded.type;
+	variableType = decoded.variableType;
+	refIdx = decoded.refIdx;
+
+	switch (decoded.typeCode)
+	{
+	case 'B':
+	case 'b':
+	case 'I':
+	case 'i':
+	case 'L':
+	case 'l':
+	case 'Z':
+		value.num = decoded.num;
+		break;
+	case 'S':
+		value.str = decoded.str;
+		break;
+	case 'R':
+		value.refVar = decoded.refVar;
+		value.refVar->Resolve(context->eventList);
+		value.formID = value.refVar->form ? value.refVar->form->refID : 0;
+		break;
+	case 'G':
+		decoded.refVar->Resolve(context->eventList);
+		value.global = OBLIVION_CAST(decoded.refVar->form, TESForm, TESGlobal);
+		if (!value.global) {
+			context->Error("Failed to resolve global %X", refIdx);
+			type = kTokenType_Invalid;
+		}
+		break;
+	case 'X':
+		value.cmd = decoded.cmd;
+		break;
+	case 'V':
+		{
+			ScriptEventList* eventList = context->eventList;
+			if (decoded.refVar)
+			{
+				decoded.refVar->Resolve(context->eventList);
+				if (decoded.refVar->form)
+					eventList = EventListFromForm(decoded.refVar->form);
+			}
+
+			value.var = NULL;
+			if (eventList)
+				value.var = eventList->GetVariable(decoded.varIdx);
+
+			if (!value.var) {
+				context->Error("Failed to resolve variable %X", decoded.varIdx);
+				type = kTokenType_Invalid;
+			}
+			break;
+		}
+	default:
+		value.op = decoded.op;
+	}
+
+	return type;
+}
+
+// mirrors ReadFrom(), any token which would fail to read makes the whole expression undecodable so that
+// evaluating it takes the usual path and reports the error
+DecodedExpression::DecodedExpression(Script* script, const UInt8* exprData) : bGood(false)
+{
+	UInt16 argLen = *((UInt16*)exprData);
+	const UInt8* data = exprData + sizeof(UInt16);
+	const UInt8* endData = exprData + argLen;
+	bytes.assign(exprData, endData);
+
+	while (data < endData)
+	{
+		DecodedToken decoded;
+		decoded.typeCode = *data++;
+		decoded.type = kTokenType_Invalid;
+		decoded.variableType = Script::eVarType_Invalid;
+		decoded.refIdx = 0;
+		decoded.varIdx = 0;
+		decoded.refVar = NULL;
+		decoded.num = 0;
+
+		switch (decoded.typeCode)
+		{
+		case 'B':
+		case 'b':
+			decoded.type = kTokenType_Number;
+			decoded.num = *data;
+			data += sizeof(UInt8);
+			break;
+		case 'I':
+		case 'i':
+			decoded.type = kTokenType_Number;
+			decoded.num = *((UInt16*)data);
+			data += sizeof(UInt16);
+			break;
+		case 'L':
+		case 'l':
+			decoded.type = kTokenType_Number;
+			decoded.num = *((UInt32*)data);
+			data += sizeof(UInt32);
+			break;
+		case 'Z':
+			decoded.type = kTokenType_Number;
+			decoded.num = *((double*)data);
+			data += sizeof(double);
+			break;
+		case 'S':
+			{
+				decoded.type = kTokenType_String;
+				UInt16 len = *((UInt16*)data);
+				data += sizeof(UInt16);
+				decoded.str = std::string(reinterpret_cast<const char*>(data), len);
+				data += len;
+				break;
+			}
+		case 'R':
+		case 'G':
+			decoded.type = decoded.typeCode == 'R' ? kTokenType_Form : kTokenType_Global;
+			decoded.refIdx = *((UInt16*)data);
+			data += sizeof(UInt16);
+			decoded.refVar = script->GetVariable(decoded.refIdx);
+			if (!decoded.refVar)
+				return;
+			break;
+		case 'X':
+			{
+				decoded.type = kTokenType_Command;
+				decoded.refIdx = *((UInt16*)data);
+				data += sizeof(UInt16);
+				decoded.cmd = g_scriptCommands.GetByOpcode(*((UInt16*)data));
+				data += sizeof(UInt16);
+				if (!decoded.cmd)
+					return;
+
+				decoded.refVar = script->GetVariable(decoded.refIdx);
+
+				// command args follow, Evaluate() reads them from the script data
+				decoded.nextOffset = data - exprData;
+				data += *((UInt16*)data);
+				tokens.push_back(decoded);
+				continue;
+			}
+		case 'V':
+			{
+				decoded.variableType = *data++;
+				switch (decoded.variableType)
+				{
+				case Script::eVarType_Array:
+					decoded.type = kTokenType_ArrayVar;
+					break;
+				case Script::eVarType_Integer:
+				case Script::eVarType_Float:
+					decoded.type = kTokenType_NumericVar;
+					break;
+				case Script::eVarType_Ref:
+					decoded.type = kTokenType_RefVar;
+					break;
+				case Script::eVarType_String:
+					decoded.type = kTokenType_StringVar;
+					break;
+				default:
+					return;
+				}
+
+				decoded.refIdx = *((UInt16*)data);
+				data += sizeof(UInt16);
+				if (decoded.refIdx)
+					decoded.refVar = script->GetVariable(decoded.refIdx);
+
+				decoded.varIdx = *((UInt16*)data);
+				data += sizeof(UInt16);
+				break;
+			}
+		default:
+			if (decoded.typeCode >= kOpType_Max)
+				return;
+
+			decoded.type = kTokenType_Operator;
+			decoded.op = &s_operators[decoded.typeCode];
+		}
+
+		decoded.nextOffset = data - exprData;
+		tokens.push_back(decoded);
+	}
+
+	bGood = data == endData;
+}
+
+// scripts passed to Invalidate() by any thread, in order. s_invalidatedScripts[0] was invalidation number
+// s_firstInvalidation, older ones are dropped once the list gets long and a cache that missed them starts over
+static ICriticalSection		s_invalidationLock;
+static std::vector<Script*>	s_invalidatedScripts;
+static UInt32				s_firstInvalidation = 0;
+static volatile LONG		s_numInvalidations = 0;
+
+enum { kMaxInvalidatedScripts = 1024 };
+
+DecodedExpressionCache::DecodedExpressionCache() : m_numInvalidations(s_numInvalidations)
+{
+	//
+}
+
+void DecodedExpressionCache::ApplyInvalidations()
+{
+	ScopedLock lock(s_invalidationLock);
+
+	if (m_numInvalidations < s_firstInvalidation)
+		m_scripts.clear();
+	else
+	{
+		for (UInt32 i = m_numInvalidations - s_firstInvalidation; i < s_invalidatedScripts.size(); i++)
+			m_scripts.erase(s_invalidatedScripts[i]);
+	}
+
+	m_numInvalidations = s_firstInvalidation + s_invalidatedScripts.size();
+}
+
+DecodedExpressionCache* DecodedExpressionCache::GetSingleton()
+{
+	ThreadLocalData& data = ThreadLocalData::Get();
+	if (!data.decodedExpressionCache) {
+		data.decodedExpressionCache = new DecodedExpressionCache();
+	}
+
+	return data.decodedExpressionCache;
+}
+
+std::shared_ptr<const DecodedExpression> DecodedExpressionCache::Get(Script* script, const UInt8* exprData)
+{
+	const UInt8* scriptData = script ? (const UInt8*)script->data : NULL;
+	if (!scriptData || exprData < scriptData || exprData + sizeof(UInt16) > scriptData + script->info.dataLength)
+		return nullptr;
+
+	UInt16 argLen = *((UInt16*)exprData);
+	if (argLen <= sizeof(UInt16) || exprData + argLen > scriptData + script->info.dataLength)
+		return nullptr;
+
+	DecodedExpressionCache* cache = GetSingleton();
+	if (cache->m_numInvalidations != (UInt32)s_numInvalidations)
+		cache->ApplyInvalidations();
+
+	ScriptEntry& entry = cache->m_scripts[script];
+	if (entry.data != script->data || entry.dataLength != script->info.dataLength || entry.firstRef != script->refList.var)
+	{
+		entry.expressions.clear();
+		entry.data = script->data;
+		entry.dataLength = script->info.dataLength;
+		entry.firstRef = script->refList.var;
+	}
+
+	std::shared_ptr<const DecodedExpression>& expr = entry.expressions[exprData - scriptData];
+	if (!expr || expr->bytes.size() != argLen || memcmp(&expr->bytes[0], exprData, argLen))
+		expr = std::make_shared<DecodedExpression>(script, exprData);
+
+	return expr->bGood ? expr : nullptr;
+}
+
+void DecodedExpressionCache::Invalidate(Script* script)
+{
+	ScopedLock lock(s_invalidationLock);
+
+	if (s_invalidatedScripts.size() >= kMaxInvalidatedScripts)
+	{
+		UInt32 numDropped = s_invalidatedScripts.size() / 2;
+		s_invalidatedScripts.erase(s_invalidatedScripts.begin(), s_invalidatedScripts.begin() + numDropped);
+		s_firstInvalidation += numDropped;
+	}
+
+	s_invalidatedScripts.push_back(script);
+	InterlockedIncrement(&s_numInvalidations);
+}
+
 #endif
 
 // compiling typecodes to printable chars just makes verifying parser output much easier
@@ -846,25 +1165,7 @@ bool ArrayElementToken::CanConvertTo(Token_Type to) const
 	else if (to == kTokenType_ArrayElement)
 		return true;
 
-	UInt8 elemType = g_ArrayMap.GetElementType(GetOwningArrayID(), key);
-	if (elemType == kDataType_Invalid)
-		return false;
-
-	switch (to)
-	{
-	case kTokenType_Boolean:
-		return elemType == kDataType_Form || elemType == kDataType_Numeric;
-	case kTokenType_String:
-		return elemType == kDataType_String;
-	case kTokenType_Number:
-		return elemType == kDataType_Numeric;
-	case kTokenType_Array:
-		return elemType == kDataType_Array;
-	case kTokenType_Form:
-		return elemType == kDataType_Form;
-	}
-
-	return false;
+	return CanConvertElement(g_ArrayMap.GetElementType(GetOwningArrayID(), key), to);
 }
 
 double ArrayElementToken::GetNumber() const
@@ -924,167 +1225,6 @@ ArrayID ArrayElementToken::GetArray() const
 
 #endif
 
-// Rules for converting from one operand type to another
-Token_Type kConversions_Number[] =
-{
-	kTokenType_Boolean,
-};
-
-Token_Type kConversions_Boolean[] =
-{
-	kTokenType_Number,
-};
-
-Token_Type kConversions_Command[] =
-{
-#if !OBLIVION
-	kTokenType_Ambiguous,
-#endif
-
-	kTokenType_Number,
-	kTokenType_Form,
-	kTokenType_Boolean,
-};
-
-Token_Type kConversions_Ref[] =
-{
-	kTokenType_Form,
-	kTokenType_Boolean,
-};
-
-Token_Type kConversions_Global[] =
-{
-	kTokenType_Number,
-	kTokenType_Boolean,
-};
-
-Token_Type kConversions_Form[] =
-{
-	kTokenType_Boolean,
-};
-
-Token_Type kConversions_NumericVar[] =
-{
-	kTokenType_Number,
-	kTokenType_Boolean,
-	kTokenType_Variable,
-};
-
-Token_Type kConversions_ArrayElement[] =
-{
-#if !OBLIVION
-	kTokenType_Ambiguous,
-#endif
-
-	kTokenType_Number,
-	kTokenType_Form,
-	kTokenType_String,
-	kTokenType_Array,
-	kTokenType_Boolean,
-};
-
-Token_Type kConversions_RefVar[] =
-{
-	kTokenType_Form,
-	kTokenType_Boolean,
-	kTokenType_Variable,
-};
-
-Token_Type kConversions_StringVar[] =
-{
-	kTokenType_String,
-	kTokenType_Variable,
-	kTokenType_Boolean,
-};
-
-Token_Type kConversions_ArrayVar[] =
-{
-	kTokenType_Array,
-	kTokenType_Variable,
-	kTokenType_Boolean,
-};
-
-Token_Type kConversions_Array[] =
-{
-	kTokenType_Boolean,			// true if arrayID != 0, false if 0
-};
-
-Token_Type kConversions_AssignableString[] =
-{
-	kTokenType_String,
-};
-
-// just an array of the types to which a given token type can be converted
-struct Operand
-{
-	Token_Type	* rules;
-	UInt8		numRules;
-};
-
-// Operand definitions
-#define OPERAND(x) kConversions_ ## x, SIZEOF_ARRAY(kConversions_ ## x, Token_Type)
-
-static Operand s_operands[] =
-{
-	{	OPERAND(Number)		},
-	{	OPERAND(Boolean)	},
-	{	NULL,	0			},	// string has no conversions
-	{	OPERAND(Form)		},
-	{	OPERAND(Ref)		},
-	{	OPERAND(Global)		},
-	{	OPERAND(Array)		},
-	{	OPERAND(ArrayElement)	},
-	{	NULL,	0			},	// slice
-	{	OPERAND(Command)	},
-	{	NULL,	0			},	// variable
-	{	OPERAND(NumericVar)	},
-	{	OPERAND(RefVar)		},
-	{	OPERAND(StringVar)	},
-	{	OPERAND(ArrayVar)	},
-	{	NULL,	0			},  // operator
-	{	NULL,	0			},	// ambiguous
-	{	NULL,	0			},	// forEachContext
-	{	NULL,	0			},	// numeric placeholders, used only in bytecode
-	{	NULL,	0			},
-	{	NULL,	0			},
-	{	NULL,	0			},	// pair
-	{	OPERAND(AssignableString)	},
-};
-
-STATIC_ASSERT(SIZEOF_ARRAY(s_operands, Operand) == kTokenType_Max);
-
-bool CanConvertOperand(Token_Type from, Token_Type to)
-{
-	if (from == to)
-		return true;
-	else if (from >= kTokenType_Invalid || to >= kTokenType_Invalid)
-		return false;
-
-	Operand* op = &s_operands[from];
-	for (UInt32 i = 0; i < op->numRules; i++)
-	{
-		if (op->rules[i] == to)
-			return true;
-	}
-
-	return false;
-}
-
-// Operator
-Token_Type Operator::GetResult(Token_Type lhs, Token_Type rhs)
-{
-	for (UInt32 i = 0; i < numRules; i++)
-	{
-		OperationRule* rule = &rules[i];
-		if (CanConvertOperand(lhs, rule->lhs) && CanConvertOperand(rhs, rule->rhs))
-			return rule->result;
-		else if (!rule->bAsymmetric && CanConvertOperand(lhs, rule->rhs) && CanConvertOperand(rhs, rule->lhs))
-			return rule->result;
-	}
-
-	return kTokenType_Invalid;
-}
-
 #if OBLIVION
 
 void Slice::GetArrayBounds(ArrayKey& lo, ArrayKey& hi) const
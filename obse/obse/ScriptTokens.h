@@ -11,10 +11,13 @@ extern SInt32 FUNCTION_CONTEXT_COUNT;
 #include "CommandTable.h"
 #include "GameForms.h"
 #include "ArrayVar.h"
+#include "ScriptOperators.h"
 
 #if OBLIVION
 #include "StringVar.h"
 #include "GameAPI.h"
+#include <memory>
+#include <unordered_map>
 
 #endif
 
@@ -24,89 +27,7 @@ struct ArrayElementToken;
 struct ForEachContext;
 class ExpressionEvaluator;
 struct ScriptToken;
-
-enum OperatorType : UInt8
-{
-	kOpType_Min		= 0,
-
-	kOpType_Assignment	= 0,
-	kOpType_LogicalOr,
-	kOpType_LogicalAnd,
-	kOpType_Slice,
-	kOpType_Equals,
-	kOpType_NotEqual,
-	kOpType_GreaterThan,
-	kOpType_LessThan,
-	kOpType_GreaterOrEqual,
-	kOpType_LessOrEqual,
-	kOpType_BitwiseOr,
-	kOpType_BitwiseAnd,
-	kOpType_LeftShift,
-	kOpType_RightShift,
-	kOpType_Add,
-	kOpType_Subtract,
-	kOpType_Multiply,
-	kOpType_Divide,
-	kOpType_Modulo,
-	kOpType_Exponent,
-	kOpType_Negation,
-	kOpType_LogicalNot,
-	kOpType_LeftParen,
-	kOpType_RightParen,
-	kOpType_LeftBracket,
-	kOpType_RightBracket,
-	kOpType_In,				// '<-'
-	kOpType_ToString,		// '$'
-	kOpType_PlusEquals,
-	kOpType_TimesEquals,
-	kOpType_DividedEquals,
-	kOpType_ExponentEquals,
-	kOpType_MinusEquals,
-	kOpType_ToNumber,		// '#'
-	kOpType_Dereference,	// unary '*'
-	kOpType_MemberAccess,	// stringmap->string, shortcut for stringmap["string"]
-	kOpType_MakePair,		// 'a::b', e.g. for defining key-value pairs for map structures
-	kOpType_Box,			// unary; wraps a value in a single-element array
-
-	kOpType_Max
-};
-
-enum Token_Type : UInt8
-{
-	kTokenType_Number	= 0,
-	kTokenType_Boolean,
-	kTokenType_String,
-	kTokenType_Form,
-	kTokenType_Ref,
-	kTokenType_Global,
-	kTokenType_Array,
-	kTokenType_ArrayElement,
-	kTokenType_Slice,
-	kTokenType_Command,
-	kTokenType_Variable,
-	kTokenType_NumericVar,
-	kTokenType_RefVar,
-	kTokenType_StringVar,
-	kTokenType_ArrayVar,
-	kTokenType_Ambiguous,
-	kTokenType_Operator,
-	kTokenType_ForEachContext,
-
-	// numeric literals can optionally be encoded as one of the following
-	// all are converted to _Number on evaluation
-	kTokenType_Byte,
-	kTokenType_Short,		// 2 bytes
-	kTokenType_Int,			// 4 bytes
-
-	kTokenType_Pair,
-	kTokenType_AssignableString,
-
-	kTokenType_Invalid,
-	kTokenType_Max = kTokenType_Invalid,
-
-	// sigil value, returned when an empty expression is parsed
-	kTokenType_Empty = kTokenType_Max + 1,
-};
+struct DecodedToken;
 
 struct Slice		// a range used for indexing into a string or array, expressed as arr[a:b]
 {
@@ -192,9 +113,19 @@ protected:
 #endif
 
 	Token_Type	ReadFrom(ExpressionEvaluator* context);	// reconstitute param from compiled data, return the type
+#if OBLIVION
+	Token_Type	ReadFrom(const DecodedToken& decoded, ExpressionEvaluator* context);	// as above from pre-decoded data, binds only what depends on the event list
+#endif
 public:
 	virtual	~ScriptToken();
 
+#if OBLIVION
+	// tokens are created and destroyed for every operand of every expression evaluated, so the
+	// common token types are served from a pool rather than the heap
+	static void* operator new(size_t size);
+	static void operator delete(void* p, size_t size);
+#endif
+
 	virtual const char	*			GetString() const;
 	virtual UInt32					GetFormID() const;
 	virtual TESForm*				GetTESForm() const;
@@ -237,6 +168,9 @@ public:
 	double					GetNumericRepresentation(bool bFromHex);	// attempts to convert string to number
 
 	static ScriptToken* Read(ExpressionEvaluator* context);
+#if OBLIVION
+	static ScriptToken* Read(const DecodedToken& decoded, ExpressionEvaluator* context);
+#endif
 
 	static ScriptToken* Create(bool boolean)													{ return new ScriptToken(boolean); }
 	static ScriptToken* Create(double num)														{ return new ScriptToken(num);	}
@@ -328,53 +262,63 @@ struct AssignableStringArrayElementToken : public AssignableStringToken
 	virtual bool Assign(const char* str);
 };
 
-#endif
-
-typedef ScriptToken* (* Op_Eval)(OperatorType op, ScriptToken* lh, ScriptToken* rh, ExpressionEvaluator* context);
+// A token as compiled in script data with everything that doesn't depend on the executing event list
+// already resolved: literals converted, operators, commands and ref variables looked up.
+struct DecodedToken
+{
+	UInt8					typeCode;		// as compiled
+	Token_Type				type;			// type ReadFrom() assigns for the code
+	UInt8					variableType;
+	UInt16					refIdx;
+	UInt16					varIdx;
+	UInt16					nextOffset;		// offset from start of expression to data following the token
+	Script::RefVariable		* refVar;		// refIdx resolved against the script's ref list, if any
+	union {
+		double				num;
+		Operator			* op;
+		CommandInfo			* cmd;
+	};
+	std::string				str;
+};
 
-struct OperationRule
+struct DecodedExpression
 {
-	Token_Type	lhs;
-	Token_Type	rhs;
-	Token_Type	result;
-	Op_Eval		eval;
-	bool		bAsymmetric;	// does order matter? e.g. var := constant legal, constant := var illegal
+	std::vector<UInt8>			bytes;		// compiled bytes the tokens were decoded from, including command args
+	std::vector<DecodedToken>	tokens;
+	bool						bGood;		// false if the expression could not be decoded, evaluate from script data instead
+
+	DecodedExpression(Script* script, const UInt8* exprData);
 };
 
-struct Operator
+// Per-thread cache of decoded expressions, keyed by script and offset into the script's data. A script's
+// entries are discarded when its data, data length or ref list changes (i.e. the script was recompiled),
+// and each expression is checked against the compiled bytes it was decoded from before use.
+// Invalidate() may be called from any thread, every thread's cache drops the script before its next lookup.
+class DecodedExpressionCache
 {
-	UInt8			precedence;
-	char			symbol[3];
-	UInt8			numOperands;
-	OperatorType	type;
-	UInt8			numRules;
-	OperationRule	* rules;
-
-	bool Precedes(Operator* op) {
-		if (!IsRightAssociative())
-			return op->precedence <= precedence;
-		else
-			return op->precedence < precedence;
-	}
-	bool IsRightAssociative()	{ return type == kOpType_Assignment || IsUnary() || (type >= kOpType_PlusEquals && type <= kOpType_MinusEquals);	}
-	bool IsUnary()	{ return numOperands == 1;	}
-	bool IsBinary() { return numOperands == 2;	}
-	bool IsOpenBracket() { return (type == kOpType_LeftParen || type == kOpType_LeftBracket); }
-	bool IsClosingBracket() { return (type == kOpType_RightParen || type == kOpType_RightBracket); }
-	bool IsBracket() { return (IsOpenBracket() || IsClosingBracket()); }
-	char GetMatchedBracket() {
-		switch (type) {
-			case kOpType_LeftBracket :	return ']';
-			case kOpType_RightBracket : return '[';
-			case kOpType_LeftParen:		return ')';
-			case kOpType_RightParen:	return '(';
-			default: return 0;
-		}
-	}
-	bool ExpectsStringLiteral() { return type == kOpType_MemberAccess; }
-
-	Token_Type GetResult(Token_Type lhs, Token_Type rhs);	// at compile-time determine type resulting from operation
-	ScriptToken* Evaluate(ScriptToken* lhs, ScriptToken* rhs, ExpressionEvaluator* context);	// at run-time, operate on the operands and return result
+	struct ScriptEntry
+	{
+		void					* data;
+		UInt32					dataLength;
+		Script::RefVariable		* firstRef;
+		std::unordered_map<UInt32, std::shared_ptr<const DecodedExpression>>	expressions;
+
+		ScriptEntry() : data(NULL), dataLength(0), firstRef(NULL) { }
+	};
+
+	std::unordered_map<Script*, ScriptEntry>	m_scripts;
+	UInt32										m_numInvalidations;	// how many invalidations have been applied to m_scripts
+
+	DecodedExpressionCache();
+
+	void ApplyInvalidations();
+
+	static DecodedExpressionCache* GetSingleton();
+public:
+	// returns NULL if exprData is not in the script's data or the expression can't be decoded
+	static std::shared_ptr<const DecodedExpression> Get(Script* script, const UInt8* exprData);
+	static void Invalidate(Script* script);
 };
 
-bool CanConvertOperand(Token_Type from, Token_Type to);	// don't use directly at run-time, use ScriptToken::CanConvertTo() instead
+#endif
+
@@ -1079,374 +1079,7 @@ ScriptToken* Eval_Pair(OperatorType op, ScriptToken* lh, ScriptToken* rh, Expres
 #define OP_HANDLER(x) NULL
 #endif
 
-// Operator Rules
-OperationRule kOpRule_Comparison[] =
-{
-#if !OBLIVION
-	{	kTokenType_Ambiguous, kTokenType_Ambiguous, kTokenType_Boolean, NULL	},
-	{	kTokenType_Ambiguous, kTokenType_Number, kTokenType_Boolean, NULL	},
-	{	kTokenType_Ambiguous, kTokenType_String, kTokenType_Boolean, NULL	},
-#endif
-	{	kTokenType_Number, kTokenType_Number, kTokenType_Boolean, OP_HANDLER(Eval_Comp_Number_Number)	},
-	{	kTokenType_String, kTokenType_String, kTokenType_Boolean, OP_HANDLER(Eval_Comp_String_String)	},
-};
-
-OperationRule kOpRule_Equality[] =
-{
-#if !OBLIVION
-	{	kTokenType_Ambiguous, kTokenType_Ambiguous, kTokenType_Boolean	},
-	{	kTokenType_Ambiguous, kTokenType_Number, kTokenType_Boolean	},
-	{	kTokenType_Ambiguous, kTokenType_Form, kTokenType_Boolean	},
-	{	kTokenType_Ambiguous, kTokenType_String, kTokenType_Boolean	},
-#endif
-	{	kTokenType_Number, kTokenType_Number, kTokenType_Boolean, OP_HANDLER(Eval_Eq_Number)	},
-	{	kTokenType_String, kTokenType_String, kTokenType_Boolean, OP_HANDLER(Eval_Eq_String)	},
-	{	kTokenType_Form, kTokenType_Form, kTokenType_Boolean, OP_HANDLER(Eval_Eq_Form)	},
-	{	kTokenType_Form, kTokenType_Number, kTokenType_Boolean, OP_HANDLER(Eval_Eq_Form_Number)	},
-	{	kTokenType_Array, kTokenType_Array, kTokenType_Boolean, OP_HANDLER(Eval_Eq_Array)	}
-};
-
-OperationRule kOpRule_Logical[] =
-{
-#if !OBLIVION
-	{	kTokenType_Ambiguous, kTokenType_Ambiguous, kTokenType_Boolean	},
-	{	kTokenType_Ambiguous, kTokenType_Boolean, kTokenType_Boolean	},
-#endif
-	{	kTokenType_Boolean, kTokenType_Boolean, kTokenType_Boolean, OP_HANDLER(Eval_Logical)	},
-};
-
-OperationRule kOpRule_Addition[] =
-{
-#if !OBLIVION
-	{	kTokenType_Ambiguous, kTokenType_Ambiguous, kTokenType_Ambiguous	},
-	{	kTokenType_Ambiguous, kTokenType_Number, kTokenType_Number	},
-	{	kTokenType_Ambiguous, kTokenType_String, kTokenType_String	},
-#endif
-	{	kTokenType_Number, kTokenType_Number, kTokenType_Number, OP_HANDLER(Eval_Add_Number)	},
-	{	kTokenType_String, kTokenType_String, kTokenType_String, OP_HANDLER(Eval_Add_String)	},
-};
-
-OperationRule kOpRule_Arithmetic[] =
-{
-#if !OBLIVION
-	{	kTokenType_Ambiguous, kTokenType_Ambiguous, kTokenType_Number },
-	{	kTokenType_Number, kTokenType_Ambiguous, kTokenType_Number },
-#endif
-	{	kTokenType_Number, kTokenType_Number, kTokenType_Number, OP_HANDLER(Eval_Arithmetic)	}
-};
-
-OperationRule kOpRule_Multiply[] =
-{
-#if !OBLIVION
-	{	kTokenType_Ambiguous,	kTokenType_Ambiguous,	kTokenType_Ambiguous	},
-	{	kTokenType_String,		kTokenType_Ambiguous,	kTokenType_String	},
-	{	kTokenType_Number,		kTokenType_Ambiguous,	kTokenType_Ambiguous	},
-#endif
-	{	kTokenType_Number,		kTokenType_Number,		kTokenType_Number,	OP_HANDLER(Eval_Arithmetic)	},
-	{	kTokenType_String,		kTokenType_Number,		kTokenType_String,	OP_HANDLER(Eval_Multiply_String_Number)	},
-};
-
-OperationRule kOpRule_Integer[] =
-{
-#if !OBLIVION
-	{	kTokenType_Ambiguous, kTokenType_Ambiguous, kTokenType_Number	},
-	{	kTokenType_Number, kTokenType_Ambiguous, kTokenType_Number	},
-#endif
-	{	kTokenType_Number, kTokenType_Number, kTokenType_Number, OP_HANDLER(Eval_Integer)	},
-};
-
-OperationRule kOpRule_Assignment[] =
-{
-#if !OBLIVION
-	{	kTokenType_Ambiguous,	kTokenType_Ambiguous,	kTokenType_Ambiguous, NULL, true	},
-	{	kTokenType_Ambiguous,	kTokenType_String,		kTokenType_String,		NULL, true	},
-	{	kTokenType_Ambiguous,	kTokenType_Number,		kTokenType_Number,		NULL, true	},
-	{	kTokenType_Ambiguous,	kTokenType_Array,		kTokenType_Array,		NULL, true	},
-	{	kTokenType_Ambiguous,	kTokenType_Form,		kTokenType_Form,		NULL, true	},
-
-	{	kTokenType_NumericVar,	kTokenType_Ambiguous,	kTokenType_Number,	NULL, true	},
-	{	kTokenType_RefVar,		kTokenType_Ambiguous,	kTokenType_Form,	NULL, true	},
-	{	kTokenType_StringVar,	kTokenType_Ambiguous,	kTokenType_String,	NULL, true	},
-	{	kTokenType_ArrayVar,	kTokenType_Ambiguous,	kTokenType_Array,	NULL, true	},
-	{	kTokenType_ArrayElement,	kTokenType_Ambiguous,	kTokenType_Ambiguous,	NULL, true },
-#endif
-	{	kTokenType_AssignableString, kTokenType_String, kTokenType_String, OP_HANDLER(Eval_Assign_AssignableString), true },
-	{	kTokenType_NumericVar, kTokenType_Number, kTokenType_Number, OP_HANDLER(Eval_Assign_Numeric), true	},
-	{	kTokenType_StringVar,	kTokenType_String, kTokenType_String, OP_HANDLER(Eval_Assign_String), true	},
-	{	kTokenType_RefVar, kTokenType_Form, kTokenType_Form, OP_HANDLER(Eval_Assign_Form), true	},
-	{	kTokenType_RefVar,		kTokenType_Number,	kTokenType_Form, OP_HANDLER(Eval_Assign_Form_Number), true },
-	{	kTokenType_Global,	kTokenType_Number,	kTokenType_Number, OP_HANDLER(Eval_Assign_Global), true	},
-	{	kTokenType_ArrayVar, kTokenType_Array, kTokenType_Array, OP_HANDLER(Eval_Assign_Array), true },
-	{	kTokenType_ArrayElement,	kTokenType_Number, kTokenType_Number, OP_HANDLER(Eval_Assign_Elem_Number), true	},
-	{	kTokenType_ArrayElement,	kTokenType_String,	kTokenType_String, OP_HANDLER(Eval_Assign_Elem_String), true	},
-	{	kTokenType_ArrayElement,	kTokenType_Form,	kTokenType_Form, OP_HANDLER(Eval_Assign_Elem_Form), true	},
-	{	kTokenType_ArrayElement, kTokenType_Array, kTokenType_Array, OP_HANDLER(Eval_Assign_Elem_Array), true	}
-};
-
-OperationRule kOpRule_PlusEquals[] =
-{
-#if !OBLIVION
-	{	kTokenType_NumericVar,	kTokenType_Ambiguous,	kTokenType_Number,	NULL,	true	},
-	{	kTokenType_StringVar,	kTokenType_Ambiguous,	kTokenType_String,	NULL,	true	},
-	{	kTokenType_ArrayElement,kTokenType_Ambiguous,	kTokenType_Ambiguous,	NULL,	true	},
-	{	kTokenType_Global,		kTokenType_Ambiguous,	kTokenType_Number,	NULL,	true	},
-	{	kTokenType_Ambiguous,	kTokenType_Ambiguous,	kTokenType_Ambiguous,	NULL,	false	},
-	{	kTokenType_Ambiguous,	kTokenType_Number,		kTokenType_Number,		NULL,	true	},
-	{	kTokenType_Ambiguous,	kTokenType_String,		kTokenType_String,		NULL,	true	},
-#endif
-	{	kTokenType_NumericVar,	kTokenType_Number,		kTokenType_Number,	OP_HANDLER(Eval_PlusEquals_Number),	true	},
-	{	kTokenType_ArrayElement,kTokenType_Number,		kTokenType_Number,	OP_HANDLER(Eval_PlusEquals_Elem_Number),	true	},
-	{	kTokenType_StringVar,	kTokenType_String,		kTokenType_String,	OP_HANDLER(Eval_PlusEquals_String),	true	},
-	{	kTokenType_ArrayElement,kTokenType_String,		kTokenType_String,	OP_HANDLER(Eval_PlusEquals_Elem_String),	true	},
-	{	kTokenType_Global,		kTokenType_Number,		kTokenType_Number,	OP_HANDLER(Eval_PlusEquals_Global),	true	},
-};
-
-OperationRule kOpRule_MinusEquals[] =
-{
-#if !OBLIVION
-	{	kTokenType_NumericVar,	kTokenType_Ambiguous,	kTokenType_Number,	NULL,	true	},
-	{	kTokenType_ArrayElement,kTokenType_Ambiguous,	kTokenType_Number,	NULL,	true	},
-	{	kTokenType_Global,		kTokenType_Ambiguous,	kTokenType_Number,	NULL,	true	},
-	{	kTokenType_Ambiguous,	kTokenType_Ambiguous,	kTokenType_Number,	NULL,	false	},
-	{	kTokenType_Ambiguous,	kTokenType_Number,		kTokenType_Number,		NULL,	true	},
-#endif
-	{	kTokenType_NumericVar,	kTokenType_Number,		kTokenType_Number,	OP_HANDLER(Eval_MinusEquals_Number),	true	},
-	{	kTokenType_ArrayElement,kTokenType_Number,		kTokenType_Number,	OP_HANDLER(Eval_MinusEquals_Elem_Number),	true	},
-	{	kTokenType_Global,		kTokenType_Number,		kTokenType_Number,	OP_HANDLER(Eval_MinusEquals_Global),	true	},
-};
-
-OperationRule kOpRule_TimesEquals[] =
-{
-#if !OBLIVION
-	{	kTokenType_NumericVar,	kTokenType_Ambiguous,	kTokenType_Number,	NULL,	true	},
-	{	kTokenType_ArrayElement,kTokenType_Ambiguous,	kTokenType_Number,	NULL,	true	},
-	{	kTokenType_Global,		kTokenType_Ambiguous,	kTokenType_Number,	NULL,	true	},
-	{	kTokenType_Ambiguous,	kTokenType_Ambiguous,	kTokenType_Number,	NULL,	false	},
-	{	kTokenType_Ambiguous,	kTokenType_Number,		kTokenType_Number,		NULL,	true	},
-#endif
-	{	kTokenType_NumericVar,	kTokenType_Number,		kTokenType_Number,	OP_HANDLER(Eval_TimesEquals),	true	},
-	{	kTokenType_ArrayElement,kTokenType_Number,		kTokenType_Number,	OP_HANDLER(Eval_TimesEquals_Elem),	true	},
-	{	kTokenType_Global,		kTokenType_Number,		kTokenType_Number,	OP_HANDLER(Eval_TimesEquals_Global),	true	},
-};
-
-OperationRule kOpRule_DividedEquals[] =
-{
-#if !OBLIVION
-	{	kTokenType_NumericVar,	kTokenType_Ambiguous,	kTokenType_Number,	NULL,	true	},
-	{	kTokenType_ArrayElement,kTokenType_Ambiguous,	kTokenType_Number,	NULL,	true	},
-	{	kTokenType_Global,		kTokenType_Ambiguous,	kTokenType_Number,	NULL,	true	},
-	{	kTokenType_Ambiguous,	kTokenType_Ambiguous,	kTokenType_Number,	NULL,	false	},
-	{	kTokenType_Ambiguous,	kTokenType_Number,		kTokenType_Number,		NULL,	true	},
-#endif
-	{	kTokenType_NumericVar,	kTokenType_Number,		kTokenType_Number,	OP_HANDLER(Eval_DividedEquals),	true	},
-	{	kTokenType_ArrayElement,kTokenType_Number,		kTokenType_Number,	OP_HANDLER(Eval_DividedEquals_Elem),	true	},
-	{	kTokenType_Global,		kTokenType_Number,		kTokenType_Number,	OP_HANDLER(Eval_DividedEquals_Global),	true	},
-};
-
-OperationRule kOpRule_ExponentEquals[] =
-{
-#if !OBLIVION
-	{	kTokenType_NumericVar,	kTokenType_Ambiguous,	kTokenType_Number,	NULL,	true	},
-	{	kTokenType_ArrayElement,kTokenType_Ambiguous,	kTokenType_Number,	NULL,	true	},
-	{	kTokenType_Global,		kTokenType_Ambiguous,	kTokenType_Number,	NULL,	true	},
-	{	kTokenType_Ambiguous,	kTokenType_Ambiguous,	kTokenType_Number,	NULL,	false	},
-	{	kTokenType_Ambiguous,	kTokenType_Number,		kTokenType_Number,		NULL,	true	},
-#endif
-	{	kTokenType_NumericVar,	kTokenType_Number,		kTokenType_Number,	OP_HANDLER(Eval_ExponentEquals),	true	},
-	{	kTokenType_ArrayElement,kTokenType_Number,		kTokenType_Number,	OP_HANDLER(Eval_ExponentEquals_Elem),	true	},
-	{	kTokenType_Global,		kTokenType_Number,		kTokenType_Number,	OP_HANDLER(Eval_ExponentEquals_Global),	true	},
-};
-
-OperationRule kOpRule_Negation[] =
-{
-#if !OBLIVION
-	{	kTokenType_Ambiguous, kTokenType_Invalid, kTokenType_Number, NULL, true	},
-#endif
-	{	kTokenType_Number, kTokenType_Invalid, kTokenType_Number, OP_HANDLER(Eval_Negation), true	},
-};
-
-OperationRule kOpRule_LogicalNot[] =
-{
-#if !OBLIVION
-	{	kTokenType_Ambiguous, kTokenType_Invalid, kTokenType_Boolean, NULL, true },
-#endif
-	{	kTokenType_Boolean, kTokenType_Invalid, kTokenType_Boolean, OP_HANDLER(Eval_LogicalNot), true },
-};
-
-OperationRule kOpRule_LeftBracket[] =
-{
-#if !OBLIVION
-	{	kTokenType_Array, kTokenType_Ambiguous, kTokenType_ArrayElement, NULL, true	},
-	{	kTokenType_String, kTokenType_Ambiguous, kTokenType_String, NULL, true	},
-	{	kTokenType_Ambiguous, kTokenType_String, kTokenType_ArrayElement, NULL, true	},
-	{	kTokenType_Ambiguous, kTokenType_Number, kTokenType_Ambiguous, NULL, true	},
-	{	kTokenType_Ambiguous, kTokenType_Ambiguous, kTokenType_Ambiguous, NULL, true	},
-	{	kTokenType_Ambiguous, kTokenType_Slice, kTokenType_Ambiguous, NULL, true	},
-#endif
-	{	kTokenType_Array, kTokenType_Number, kTokenType_ArrayElement, OP_HANDLER(Eval_Subscript_Array_Number), true	},
-	{	kTokenType_Array, kTokenType_String, kTokenType_ArrayElement, OP_HANDLER(Eval_Subscript_Array_String), true	},
-	{	kTokenType_ArrayElement, kTokenType_Number, kTokenType_AssignableString, OP_HANDLER(Eval_Subscript_Elem_Number), true },
-	{	kTokenType_StringVar,	kTokenType_Number,	kTokenType_AssignableString, OP_HANDLER(Eval_Subscript_StringVar_Number), true },
-	{	kTokenType_ArrayElement, kTokenType_Slice, kTokenType_AssignableString, OP_HANDLER(Eval_Subscript_Elem_Slice), true },
-	{	kTokenType_StringVar,	kTokenType_Slice,	kTokenType_AssignableString, OP_HANDLER(Eval_Subscript_StringVar_Slice), true },
-	{	kTokenType_String, kTokenType_Number, kTokenType_String, OP_HANDLER(Eval_Subscript_String), true	},
-	{	kTokenType_Array, kTokenType_Slice, kTokenType_Array, OP_HANDLER(Eval_Subscript_Array_Slice), true	},
-	{	kTokenType_String, kTokenType_Slice, kTokenType_String, OP_HANDLER(Eval_Subscript_String_Slice), true	}
-};
-
-OperationRule kOpRule_MemberAccess[] =
-{
-#if !OBLIVION
-	{	kTokenType_Array, kTokenType_Ambiguous, kTokenType_ArrayElement, NULL, true },
-	{	kTokenType_Ambiguous, kTokenType_String, kTokenType_ArrayElement, NULL, true },
-	{	kTokenType_Ambiguous, kTokenType_Ambiguous, kTokenType_ArrayElement, NULL, true },
-#endif
-	{	kTokenType_Array, kTokenType_String, kTokenType_ArrayElement, OP_HANDLER(Eval_MemberAccess), true }
-};
-
-OperationRule kOpRule_Slice[] =
-{
-#if !OBLIVION
-	{	kTokenType_Ambiguous, kTokenType_Ambiguous, kTokenType_Slice	},
-	{	kTokenType_Ambiguous, kTokenType_Number, kTokenType_Slice	},
-	{	kTokenType_Ambiguous, kTokenType_String, kTokenType_Slice	},
-#endif
-	{	kTokenType_String, kTokenType_String, kTokenType_Slice, OP_HANDLER(Eval_Slice_String)	},
-	{	kTokenType_Number, kTokenType_Number, kTokenType_Slice, OP_HANDLER(Eval_Slice_Number)	},
-};
-
-OperationRule kOpRule_In[] =
-{
-#if !OBLIVION
-	{	kTokenType_ArrayVar,	kTokenType_Ambiguous,	kTokenType_ForEachContext,	NULL,	true	},
-#endif
-	{	kTokenType_ArrayVar,	kTokenType_Array,		kTokenType_ForEachContext,	OP_HANDLER(Eval_In), true },
-	{	kTokenType_StringVar,	kTokenType_String,		kTokenType_ForEachContext,	OP_HANDLER(Eval_In), true },
-	{	kTokenType_RefVar,		kTokenType_Form,		kTokenType_ForEachContext,	OP_HANDLER(Eval_In), true },
-};
-
-OperationRule kOpRule_ToString[] =
-{
-#if !OBLIVION
-	{	kTokenType_Ambiguous,	kTokenType_Invalid,		kTokenType_String,			NULL,	true	},
-#endif
-	{	kTokenType_String,		kTokenType_Invalid,		kTokenType_String,		OP_HANDLER(Eval_ToString_String),	true	},
-	{	kTokenType_Number,		kTokenType_Invalid,		kTokenType_String,		OP_HANDLER(Eval_ToString_Number),	true	},
-	{	kTokenType_Form,		kTokenType_Invalid,		kTokenType_String,		OP_HANDLER(Eval_ToString_Form),		true	},
-	{	kTokenType_Array,		kTokenType_Invalid,		kTokenType_String,		OP_HANDLER(Eval_ToString_Array),	true	},
-};
-
-OperationRule kOpRule_ToNumber[] =
-{
-#if !OBLIVION
-	{	kTokenType_Ambiguous,	kTokenType_Invalid,		kTokenType_Number,			NULL,	true	},
-#endif
-	{	kTokenType_String,		kTokenType_Invalid,		kTokenType_Number,			OP_HANDLER(Eval_ToNumber),	true	},
-	{	kTokenType_Number,		kTokenType_Invalid,		kTokenType_Number,			OP_HANDLER(Eval_ToNumber),	true	},
-};
-
-OperationRule kOpRule_Dereference[] =
-{
-#if !OBLIVION
-	{	kTokenType_Ambiguous, kTokenType_Invalid, kTokenType_ArrayElement, NULL, true	},
-#endif
-	{	kTokenType_Array, kTokenType_Invalid, kTokenType_ArrayElement, OP_HANDLER(Eval_Dereference), true	},
-};
-
-OperationRule kOpRule_Box[] =
-{
-#if !OBLIVION
-	{	kTokenType_Ambiguous, kTokenType_Invalid, kTokenType_Array, NULL, true	},
-#endif
-
-	{	kTokenType_Number,	kTokenType_Invalid,	kTokenType_Array,	OP_HANDLER(Eval_Box_Number),	true	},
-	{	kTokenType_String,	kTokenType_Invalid,	kTokenType_Array,	OP_HANDLER(Eval_Box_String),	true	},
-	{	kTokenType_Form,	kTokenType_Invalid,	kTokenType_Array,	OP_HANDLER(Eval_Box_Form),		true	},
-	{	kTokenType_Array,	kTokenType_Invalid,	kTokenType_Array,	OP_HANDLER(Eval_Box_Array),		true	},
-};
-
-OperationRule kOpRule_MakePair[] =
-{
-#if !OBLIVION
-	{	kTokenType_String,	kTokenType_Ambiguous,	kTokenType_Pair,	NULL,	true	},
-	{	kTokenType_Number,	kTokenType_Ambiguous,	kTokenType_Pair,	NULL,	true	},
-	{	kTokenType_Ambiguous,	kTokenType_Number,	kTokenType_Pair,	NULL,	true	},
-	{	kTokenType_Ambiguous,	kTokenType_String,	kTokenType_Pair,	NULL,	true	},
-	{	kTokenType_Ambiguous,	kTokenType_Array,	kTokenType_Pair,	NULL,	true	},
-	{	kTokenType_Ambiguous,	kTokenType_Form,	kTokenType_Pair,	NULL,	true	},
-	{	kTokenType_Ambiguous,	kTokenType_Ambiguous,	kTokenType_Pair,	NULL,	true	},
-#endif
-	{	kTokenType_String, kTokenType_Number,	kTokenType_Pair,	OP_HANDLER(Eval_Pair),	true	},
-	{	kTokenType_String, kTokenType_String,	kTokenType_Pair,	OP_HANDLER(Eval_Pair),	true	},
-	{	kTokenType_String, kTokenType_Form,		kTokenType_Pair,	OP_HANDLER(Eval_Pair),	true	},
-	{	kTokenType_String, kTokenType_Array,	kTokenType_Pair,	OP_HANDLER(Eval_Pair),	true	},
-	{	kTokenType_Number, kTokenType_Number,	kTokenType_Pair,	OP_HANDLER(Eval_Pair),	true	},
-	{	kTokenType_Number, kTokenType_String,	kTokenType_Pair,	OP_HANDLER(Eval_Pair),	true	},
-	{	kTokenType_Number, kTokenType_Form,		kTokenType_Pair,	OP_HANDLER(Eval_Pair),	true	},
-	{	kTokenType_Number, kTokenType_Array,	kTokenType_Pair,	OP_HANDLER(Eval_Pair),	true	},
-};
-
-// Operator definitions
-#define OP_RULES(x) SIZEOF_ARRAY(kOpRule_ ## x, OperationRule), kOpRule_ ## x
-
-Operator s_operators[] =
-{
-	{	2,	":=",	2,	kOpType_Assignment, OP_RULES(Assignment)	},
-	{	5,	"||",	2,	kOpType_LogicalOr,	OP_RULES(Logical)		},
-	{	7,	"&&",	2,	kOpType_LogicalAnd, OP_RULES(Logical)		},
-
-	{	9,	":",	2,	kOpType_Slice,		OP_RULES(Slice)			},
-	{	13,	"==",	2,	kOpType_Equals,		OP_RULES(Equality)		},
-	{	13,	"!=",	2,	kOpType_NotEqual,	OP_RULES(Equality)		},
-
-	{	15,	">",	2,	kOpType_GreaterThan,OP_RULES(Comparison)	},
-	{	15,	"<",	2,	kOpType_LessThan,	OP_RULES(Comparison)	},
-	{	15,	">=",	2,	kOpType_GreaterOrEqual,	OP_RULES(Comparison)	},
-	{	15,	"<=",	2,	kOpType_LessOrEqual,	OP_RULES(Comparison)	},
-
-	{	16,	"|",	2,	kOpType_BitwiseOr,	OP_RULES(Integer)		},		// ** higher precedence than in C++
-	{	17,	"&",	2,	kOpType_BitwiseAnd,	OP_RULES(Integer)		},
-
-	{	18,	"<<",	2,	kOpType_LeftShift,	OP_RULES(Integer)		},
-	{	18,	">>",	2,	kOpType_RightShift,	OP_RULES(Integer)		},
-
-	{	19,	"+",	2,	kOpType_Add,		OP_RULES(Addition)		},
-	{	19,	"-",	2,	kOpType_Subtract,	OP_RULES(Arithmetic)	},
-
-	{	21,	"*",	2,	kOpType_Multiply,	OP_RULES(Multiply)		},
-	{	21,	"/",	2,	kOpType_Divide,		OP_RULES(Arithmetic)	},
-	{	21,	"%",	2,	kOpType_Modulo,		OP_RULES(Integer)		},
-
-	{	23,	"^",	2,	kOpType_Exponent,	OP_RULES(Arithmetic)	},		// exponentiation
-	{	25,	"-",	1,	kOpType_Negation,	OP_RULES(Negation)		},		// unary minus in compiled script
-
-	{	27, "!",	1,	kOpType_LogicalNot,	OP_RULES(LogicalNot)	},
-
-	{	80,	"(",	0,	kOpType_LeftParen,	0,	NULL				},
-	{	80,	")",	0,	kOpType_RightParen,	0,	NULL				},
-
-	{	90, "[",	2,	kOpType_LeftBracket,	OP_RULES(LeftBracket)	},		// functions both as paren and operator
-	{	90,	"]",	0,	kOpType_RightBracket,	0,	NULL				},		// functions only as paren
-
-	{	2,	"<-",	2,	kOpType_In,			OP_RULES(In)			},			// 'foreach iter <- arr'
-	{	25,	"$",	1,	kOpType_ToString,	OP_RULES(ToString)		},			// converts operand to string
-
-	{	2,	"+=",	2,	kOpType_PlusEquals,	OP_RULES(PlusEquals)	},
-	{	2,	"*=",	2,	kOpType_TimesEquals,	OP_RULES(TimesEquals)	},
-	{	2,	"/=",	2,	kOpType_DividedEquals,	OP_RULES(DividedEquals)	},
-	{	2,	"^=",	2,	kOpType_ExponentEquals,	OP_RULES(ExponentEquals)	},
-	{	2,	"-=",	2,	kOpType_MinusEquals,	OP_RULES(MinusEquals)	},
-
-	{	25,	"#",	1,	kOpType_ToNumber,		OP_RULES(ToNumber)	},
-
-	{	25, "*",	1,	kOpType_Dereference,	OP_RULES(Dereference)	},
-
-	{	90,	"->",	2,	kOpType_MemberAccess,	OP_RULES(MemberAccess)	},
-	{	3,	"::",	2,	kOpType_MakePair,		OP_RULES(MakePair)	},
-	{	25,	"&",	1,	kOpType_Box,			OP_RULES(Box)	},
-};
-
-STATIC_ASSERT(SIZEOF_ARRAY(s_operators, Operator) == kOpType_Max);
+#include "OperatorRules.inc"
 
 const char* OpTypeToSymbol(OperatorType op)
 {
@@ -2858,8 +2491,24 @@ void ShowRuntimeError(Script* script, const char* fmt, ...)
 
 
 
+static UInt32 GetOperandClass(ScriptToken* token)
+{
+	Token_Type type = token->Type();
+	if (type == kTokenType_ArrayElement) {
+		UInt8 elemType = g_ArrayMap.GetElementType(token->GetOwningArrayID(), *token->GetArrayKey());
+		return kOperandClass_Element + elemType;
+	}
+	return type < kTokenType_Max ? type : kOperandClass_None;
+}
+
+void Operator::InitDispatchTable()
+{
+	OperatorDispatch::Init(s_operators);
+}
+
 //	Pop required operand(s)
-//	loop through OperationRules until a match is found
+//	look up the OperationRule for the operand classes in the dispatch table built by InitDispatchTable()
+//	if the operands can't be classified, loop through OperationRules until a match is found
 //	check operand(s)->CanConvertTo() for rule types (also swap them and test if !asymmetric)
 //	if can convert --> pass to rule handler, return result :: else, continue loop
 //	if no matching rule return null
@@ -2871,29 +2520,43 @@ ScriptToken* Operator::Evaluate(ScriptToken* lhs, ScriptToken* rhs, ExpressionEv
 		return NULL;
 	}
 
-	for (UInt32 i = 0; i < numRules; i++)
+	UInt32 lhsClass = GetOperandClass(lhs);
+	UInt32 rhsClass = IsUnary() ? 0 : GetOperandClass(rhs);
+	if (lhsClass != kOperandClass_None && rhsClass != kOperandClass_None)
 	{
-		bool bRuleMatches = false;
-		bool bSwapOrder = false;
-		OperationRule* rule = &rules[i];
-		if (!rule->eval)
-			continue;
-
-		if (IsUnary() && lhs->CanConvertTo(rule->lhs))
-			bRuleMatches = true;
-		else
+		const OperatorDispatch& dispatch = OperatorDispatch::Get(type, lhsClass, rhsClass);
+		if (dispatch.rule != OperatorDispatch::kRule_None)
+		{
+			OperationRule* rule = &rules[dispatch.rule];
+			return dispatch.bSwapOrder ? rule->eval(type, rhs, lhs, context) : rule->eval(type, lhs, rhs, context);
+		}
+	}
+	else
+	{
+		for (UInt32 i = 0; i < numRules; i++)
 		{
-			if (lhs->CanConvertTo(rule->lhs) && rhs->CanConvertTo(rule->rhs))
+			bool bRuleMatches = false;
+			bool bSwapOrder = false;
+			OperationRule* rule = &rules[i];
+			if (!rule->eval)
+				continue;
+
+			if (IsUnary() && lhs->CanConvertTo(rule->lhs))
 				bRuleMatches = true;
-			else if (!rule->bAsymmetric && rhs->CanConvertTo(rule->lhs) && lhs->CanConvertTo(rule->rhs))
+			else
 			{
-				bSwapOrder = true;
-				bRuleMatches = true;
+				if (lhs->CanConvertTo(rule->lhs) && rhs->CanConvertTo(rule->rhs))
+					bRuleMatches = true;
+				else if (!rule->bAsymmetric && rhs->CanConvertTo(rule->lhs) && lhs->CanConvertTo(rule->rhs))
+				{
+					bSwapOrder = true;
+					bRuleMatches = true;
+				}
 			}
-		}
 
-		if (bRuleMatches)
-			return bSwapOrder ? rule->eval(type, rhs, lhs, context) : rule->eval(type, lhs, rhs, context);
+			if (bRuleMatches)
+				return bSwapOrder ? rule->eval(type, rhs, lhs, context) : rule->eval(type, lhs, rhs, context);
+		}
 	}
 //TODO rely errors
 // 	   //TODO require proper methods.
@@ -6,76 +6,127 @@
 #include <vector>
 #include "EventManager.h"
 #include <obse_common/obse_version.h>
+#include "Settings.h"
+#include "CoSaveFormat.h"
+#include "CoSaveWriter.h"
 
 // ### TODO: only create save file when something has registered a handler
 
 namespace Serialization
 {
 
-static UInt32	kObseOpcodeBase = 0x1400;
+// CoSaveWriter's thread and file, on Win32
+class Win32CoSaveWriterDriver : public CoSaveWriterDriver
+{
+public:
+	Win32CoSaveWriterDriver() : m_thread(NULL), m_proc(NULL), m_param(NULL) { }
 
-// file format internals
+	virtual bool SaveFile(const char * path, const void * data, UInt32 length)
+	{
+		IFileStream	file;
+		if(!file.Create(path))
+			return false;
 
-//	general format:
-//	Header			header
-//		PluginHeader	plugin[header.numPlugins]
-//			ChunkHeader		chunk[plugin.numChunks]
-//				UInt8			data[chunk.length]
+		if(length)
+			file.WriteBuf(data, length);
+		file.Close();
 
-struct Header
-{
-	enum
+		return true;
+	}
+
+	virtual bool StartThread(ThreadProc proc, void * param)
 	{
-		kSignature =		MACRO_SWAP32('OBSE'),	// endian-swapping so the order matches
-		kVersion =			1,
-
-		kVersion_Invalid =	0
-	};
-
-	UInt32	signature;
-	UInt32	formatVersion;
-	UInt16	obseVersion;
-	UInt16	obseMinorVersion;
-	UInt32	oblivionVersion;
-	UInt32	numPlugins;
-};
+		m_proc = proc;
+		m_param = param;
+		m_thread = CreateThread(NULL, 0, Run, this, 0, NULL);
 
-struct PluginHeader
-{
-	UInt32	opcodeBase;
-	UInt32	numChunks;
-	UInt32	length;		// length of following data including ChunkHeader
-};
+		return m_thread != NULL;
+	}
 
-struct ChunkHeader
-{
-	UInt32	type;
-	UInt32	version;
-	UInt32	length;
+	virtual void JoinThread(void)
+	{
+		if(m_thread)
+		{
+			WaitForSingleObject(m_thread, INFINITE);
+			CloseHandle(m_thread);
+			m_thread = NULL;
+		}
+	}
+
+private:
+	static DWORD WINAPI Run(void * param)
+	{
+		Win32CoSaveWriterDriver	* driver = (Win32CoSaveWriterDriver *)param;
+		driver->m_proc(driver->m_param);
+		return 0;
+	}
+
+	HANDLE		m_thread;
+	ThreadProc	m_proc;
+	void		* m_param;
 };
 
 // locals
 
-IFileStream	s_currentFile;
+Win32CoSaveWriterDriver	s_coSaveWriterDriver;
+CoSaveWriter	s_coSaveWriter(s_coSaveWriterDriver);
+LoadBuffer		s_loadBuffer;		// co-save being read
+CoSaveBuilder	s_coSaveBuilder;	// co-save being written, handed to s_coSaveWriter once complete
 
 typedef std::vector <PluginCallbacks>	PluginCallbackList;
 PluginCallbackList	s_pluginCallbacks;
 
 PluginHandle	s_currentPlugin = 0;
 
-Header			s_fileHeader = { 0 };
-
-UInt64			s_pluginHeaderOffset = 0;
+// block and chunk being read when loading
 PluginHeader	s_pluginHeader = { 0 };
 
 bool			s_chunkOpen = false;
-UInt64			s_chunkHeaderOffset = 0;
 ChunkHeader		s_chunkHeader = { 0 };
 
+// block written by the last save for a plugin with a generation callback, written again while the generation matches
+struct SavedBlock
+{
+	SavedBlock() : bValid(false), generation(0) { }
+
+	bool				bValid;
+	UInt32				generation;
+	std::vector <UInt8>	data;		// PluginHeader and chunks, empty if the plugin wrote nothing
+};
+
+typedef std::vector <SavedBlock>	SavedBlockList;
+SavedBlockList	s_savedBlocks;		// indexed by plugin handle
+
 bool			s_preloading = false;		// if true, we are reading co-save *before* savegame begins to load
 
 // utilities
 
+// reads the co-save into s_loadBuffer with a single read, returns false if the file can't be opened
+static bool OpenLoadBuffer(const char * path)
+{
+	IFileStream	file;
+	if(!file.Open(path))
+		return false;
+
+	// a damaged one is left empty, so the header can't be read and HandleLoadGame fails the load
+	try
+	{
+		std::vector <UInt8>	data((UInt32)file.GetLength());
+		if(data.size())
+			file.ReadBuf(&data[0], data.size());
+
+		if(!s_loadBuffer.Assign(data))
+			_ERROR("LoadBuffer: compressed co-save is damaged (%s)", path);
+	}
+	catch(...)
+	{
+		_ERROR("LoadBuffer: exception reading co-save (%s)", path);
+		s_loadBuffer.Close();
+	}
+
+	return true;
+}
+
 // change *.ess -> *.obse
 static std::string ConvertSaveFileName(std::string name)
 {
@@ -142,6 +193,14 @@ void SetPreloadCallback(PluginHandle plugin, OBSESerializationInterface::EventCa
 	InternalSetPreloadCallback(plugin, callback);
 }
 
+void SetGenerationCallback(PluginHandle plugin, OBSESerializationInterface::GenerationCallback callback)
+{
+	ASSERT(plugin);
+	ASSERT(plugin <= g_pluginManager.GetNumPlugins());
+
+	InternalSetGenerationCallback(plugin, callback);
+}
+
 void InternalSetSaveCallback(PluginHandle plugin, OBSESerializationInterface::EventCallback callback)
 {
 	if(plugin >= s_pluginCallbacks.size())
@@ -174,67 +233,31 @@ void InternalSetPreloadCallback(PluginHandle plugin, OBSESerializationInterface:
 	s_pluginCallbacks[plugin].preload = callback;
 }
 
-bool WriteRecord(UInt32 type, UInt32 version, const void * buf, UInt32 length)
+void InternalSetGenerationCallback(PluginHandle plugin, OBSESerializationInterface::GenerationCallback callback)
 {
-	if(!OpenRecord(type, version)) return false;
+	if(plugin >= s_pluginCallbacks.size())
+		s_pluginCallbacks.resize(plugin + 1);
 
-	return WriteRecordData(buf, length);
+	s_pluginCallbacks[plugin].generation = callback;
 }
 
-// flush a chunk header to the file if one is currently open
-static void FlushWriteChunk(void)
+bool WriteRecord(UInt32 type, UInt32 version, const void * buf, UInt32 length)
 {
-	if(!s_chunkOpen)
-		return;
-
-	UInt64	curOffset = s_currentFile.GetOffset();
-	UInt64	chunkSize = curOffset - s_chunkHeaderOffset - sizeof(s_chunkHeader);
-
-	ASSERT(chunkSize < 0x80000000);	// stupidity check
-
-	s_chunkHeader.length = (UInt32)chunkSize;
-
-	s_currentFile.SetOffset(s_chunkHeaderOffset);
-	s_currentFile.WriteBuf(&s_chunkHeader, sizeof(s_chunkHeader));
-
-	s_currentFile.SetOffset(curOffset);
-
-	s_pluginHeader.length += chunkSize + sizeof(s_chunkHeader);
+	if(!OpenRecord(type, version)) return false;
 
-	s_chunkOpen = false;
+	return WriteRecordData(buf, length);
 }
 
 bool OpenRecord(UInt32 type, UInt32 version)
 {
-	if(!s_pluginHeader.numChunks)
-	{
-		ASSERT(!s_chunkOpen);
-
-		s_pluginHeaderOffset = s_currentFile.GetOffset();
-		s_currentFile.Skip(sizeof(s_pluginHeader));
-	}
-
-	FlushWriteChunk();
-
-	s_chunkHeaderOffset = s_currentFile.GetOffset();
-	s_currentFile.Skip(sizeof(s_chunkHeader));
-
-	s_pluginHeader.numChunks++;
-
-	s_chunkHeader.type = type;
-	s_chunkHeader.version = version;
-	s_chunkHeader.length = 0;
-
-	s_chunkOpen = true;
+	s_coSaveBuilder.OpenRecord(type, version);
 
 	return true;
 }
 
 bool WriteRecordData(const void * buf, UInt32 length)
 {
-	s_currentFile.WriteBuf(buf, length);
-
-	return true;
+	return s_coSaveBuilder.WriteRecordData(buf, length);
 }
 
 static void FlushReadRecord(void)
@@ -244,7 +267,7 @@ static void FlushReadRecord(void)
 		if(s_chunkHeader.length)
 		{
 			// _WARNING("plugin didn't finish reading chunk");
-			s_currentFile.Skip(s_chunkHeader.length);
+			s_loadBuffer.Skip(s_chunkHeader.length);
 		}
 
 		s_chunkOpen = false;
@@ -260,7 +283,7 @@ bool GetNextRecordInfo(UInt32 * type, UInt32 * version, UInt32 * length)
 
 	s_pluginHeader.numChunks--;
 
-	s_currentFile.ReadBuf(&s_chunkHeader, sizeof(s_chunkHeader));
+	s_loadBuffer.ReadBuf(&s_chunkHeader, sizeof(s_chunkHeader));
 
 	*type =		s_chunkHeader.type;
 	*version =	s_chunkHeader.version;
@@ -276,11 +299,11 @@ bool PeekNextRecordInfo( UInt32 * type, UInt32 * version, UInt32 * length )
 	if(!s_pluginHeader.numChunks)
 		return false;
 
-	SInt64 currentOffset = s_currentFile.GetOffset();
+	UInt32 currentOffset = s_loadBuffer.GetOffset();
 	ChunkHeader buffer = {0};
 
-	s_currentFile.ReadBuf(&buffer, sizeof(buffer));
-	s_currentFile.SetOffset(currentOffset);
+	s_loadBuffer.ReadBuf(&buffer, sizeof(buffer));
+	s_loadBuffer.SetOffset(currentOffset);
 
 	*type =		buffer.type;
 	*version =	buffer.version;
@@ -296,13 +319,27 @@ UInt32 ReadRecordData(void * buf, UInt32 length)
 	if(length > s_chunkHeader.length)
 		length = s_chunkHeader.length;
 
-	s_currentFile.ReadBuf(buf, length);
+	length = s_loadBuffer.ReadBuf(buf, length);
 
 	s_chunkHeader.length -= length;
 
 	return length;
 }
 
+const void * ReadRecordSpan(UInt32 length)
+{
+	ASSERT(s_chunkOpen);
+
+	if(length > s_chunkHeader.length)
+		return NULL;
+
+	const void	* data = s_loadBuffer.ReadSpan(length);
+	if(data)
+		s_chunkHeader.length -= length;
+
+	return data;
+}
+
 bool ResolveRefID(UInt32 refID, UInt32 * outRefID)
 {
 	UInt8	modID = refID >> 24;
@@ -344,6 +381,41 @@ bool ResolveRefID(UInt32 refID, UInt32 * outRefID)
 	return true;
 }
 
+// saved blocks only hold for the game they were saved from
+static void InvalidateSavedBlocks(void)
+{
+	for(SavedBlockList::iterator iter = s_savedBlocks.begin(); iter != s_savedBlocks.end(); ++iter)
+	{
+		iter->bValid = false;
+		std::vector <UInt8>().swap(iter->data);
+	}
+}
+
+// appends the plugin's block from the last save if its data hasn't changed since, returns false if it has to be saved
+static bool ReuseSavedBlock(PluginHandle plugin, UInt32 generation)
+{
+	if(plugin >= s_savedBlocks.size() || !s_savedBlocks[plugin].bValid || s_savedBlocks[plugin].generation != generation)
+		return false;
+
+	const std::vector <UInt8>	& data = s_savedBlocks[plugin].data;
+	if(data.size())
+		s_coSaveBuilder.AppendPlugin(&data[0], data.size());
+
+	return true;
+}
+
+// keeps a copy of the block the plugin just wrote, starting at blockOffset in the image being built
+static void StoreSavedBlock(PluginHandle plugin, UInt32 generation, UInt32 blockOffset)
+{
+	if(plugin >= s_savedBlocks.size())
+		s_savedBlocks.resize(plugin + 1);
+
+	SavedBlock	& block = s_savedBlocks[plugin];
+	block.bValid = true;
+	block.generation = generation;
+	block.data.assign(s_coSaveBuilder.Data() + blockOffset, s_coSaveBuilder.Data() + s_coSaveBuilder.Size());
+}
+
 // internal event handlers
 void HandleSaveGame(const char * path)
 {
@@ -364,23 +436,21 @@ void HandleSaveGame(const char * path)
 	else
 #endif
 	{
-		if(!s_currentFile.Create(savePath.c_str()))
-		{
-			_ERROR("HandleSaveGame: couldn't create save file (%s)", savePath.c_str());
-			return;
-		}
+		bool	bSucceeded = false;
+		UInt32	numReused = 0;
 
 		try
 		{
 			// init header
-			s_fileHeader.signature =		Header::kSignature;
-			s_fileHeader.formatVersion =	Header::kVersion;
-			s_fileHeader.obseVersion =		OBSE_VERSION_INTEGER;
-			s_fileHeader.obseMinorVersion =	OBSE_VERSION_INTEGER_MINOR;
-			s_fileHeader.oblivionVersion =  OBLIVION_VERSION_1_2_416;
-			s_fileHeader.numPlugins =		0;
+			Header	header;
+			header.signature =			Header::kSignature;
+			header.formatVersion =		Header::kVersion_Uncompressed;	// CoSaveWriter converts to compressed if enabled
+			header.obseVersion =		OBSE_VERSION_INTEGER;
+			header.obseMinorVersion =	OBSE_VERSION_INTEGER_MINOR;
+			header.oblivionVersion =	OBLIVION_VERSION_1_2_416;
+			header.numPlugins =			0;
 
-			s_currentFile.Skip(sizeof(s_fileHeader));
+			s_coSaveBuilder.Begin(header);
 
 			// iterate through plugins
 			for(UInt32 i = 0; i < s_pluginCallbacks.size(); i++)
@@ -390,48 +460,56 @@ void HandleSaveGame(const char * path)
 					// set up header info
 					s_currentPlugin = i;
 
-					s_pluginHeader.opcodeBase = i ? g_pluginManager.GetBaseOpcode(i - 1) : kObseOpcodeBase;
-					s_pluginHeader.numChunks = 0;
-					s_pluginHeader.length = 0;
-
-					if(!s_pluginHeader.opcodeBase)
+					UInt32	opcodeBase = i ? g_pluginManager.GetBaseOpcode(i - 1) : kObseOpcodeBase;
+					if(!opcodeBase)
 					{
 						_ERROR("HandleSaveGame: plugin with default opcode base registered for serialization");
 						continue;
 					}
 
-					s_chunkOpen = false;
-
-					// call the plugin
-					s_pluginCallbacks[i].save(NULL);
-
-					// flush the remaining chunk data
-					FlushWriteChunk();
-
-					if(s_pluginHeader.numChunks)
+					OBSESerializationInterface::GenerationCallback	generation = IncrementalCoSave ? s_pluginCallbacks[i].generation : NULL;
+					if(generation && ReuseSavedBlock(i, generation()))
 					{
-						UInt64	curOffset = s_currentFile.GetOffset();
+						numReused++;
+						continue;
+					}
 
-						s_currentFile.SetOffset(s_pluginHeaderOffset);
-						s_currentFile.WriteBuf(&s_pluginHeader, sizeof(s_pluginHeader));
+					UInt32	blockOffset = s_coSaveBuilder.Size();
 
-						s_currentFile.SetOffset(curOffset);
+					// call the plugin
+					s_coSaveBuilder.BeginPlugin(opcodeBase);
+					s_pluginCallbacks[i].save(NULL);
+					s_coSaveBuilder.EndPlugin();
 
-						s_fileHeader.numPlugins++;
-					}
+					// saving may change the generation (e.g. by deleting temporary vars), so it's read afterwards
+					if(generation)
+						StoreSavedBlock(i, generation(), blockOffset);
 				}
 			}
 
+			if(numReused)
+				_MESSAGE("reused %d unchanged plugin blocks", numReused);
+
 			// write header
-			s_currentFile.SetOffset(0);
-			s_currentFile.WriteBuf(&s_fileHeader, sizeof(s_fileHeader));
+			s_coSaveBuilder.Finish();
+			bSucceeded = true;
 		}
 		catch(...)
 		{
 			_ERROR("HandleSaveGame: exception during save");
 		}
 
-		s_currentFile.Close();
+		if(bSucceeded)
+			s_coSaveWriter.Write(savePath, s_coSaveBuilder.Image(), AsyncCoSave, CompressCoSave);
+		else
+		{
+			// don't leave an older co-save around to be loaded with this save
+			s_coSaveWriter.Wait();
+			DeleteFile(savePath.c_str());
+			InvalidateSavedBlocks();
+		}
+
+		s_coSaveBuilder.Clear();
 	}
 }
 
@@ -467,7 +545,13 @@ void HandleLoadGame(const char * path, OBSESerializationInterface::EventCallback
 
 	_MESSAGE("loading from %s", savePath.c_str());
 
-	if(!s_currentFile.Open(savePath.c_str()))
+	// the co-save may still be being written
+	s_coSaveWriter.Wait();
+
+	// blocks read from a co-save aren't kept for reuse, refIDs in them are in the load order the game was saved with
+	InvalidateSavedBlocks();
+
+	if(!OpenLoadBuffer(savePath.c_str()))
 	{
 		_MESSAGE("HandleLoadGame: couldn't open file (%s), probably doesn't exist", savePath.c_str());
 		if (!s_preloading) {
@@ -481,8 +565,19 @@ void HandleLoadGame(const char * path, OBSESerializationInterface::EventCallback
 		try
 		{
 			Header	header;
+			memset(&header, 0, sizeof(header));
+
+			if(s_loadBuffer.ReadBuf(&header, sizeof(header)) != sizeof(header))
+			{
+				_ERROR("HandleLoadGame: co-save is truncated or damaged");
+
+				// same as an exception during load, don't keep the previous game's data around
+				if (!s_preloading) {
+					HandleNewGame();
+				}
 
-			s_currentFile.ReadBuf(&header, sizeof(header));
+				goto done;
+			}
 
 			if(header.signature != Header::kSignature)
 			{
@@ -510,11 +605,11 @@ void HandleLoadGame(const char * path, OBSESerializationInterface::EventCallback
 			
 			OBSESerializationInterface::EventCallback curCallback = NULL;
 			// iterate through plugin data chunks
-			while(s_currentFile.GetRemain() >= sizeof(PluginHeader))
+			while(s_loadBuffer.GetRemain() >= sizeof(PluginHeader))
 			{
-				s_currentFile.ReadBuf(&s_pluginHeader, sizeof(s_pluginHeader));
+				s_loadBuffer.ReadBuf(&s_pluginHeader, sizeof(s_pluginHeader));
 
-				UInt64	pluginChunkStart = s_currentFile.GetOffset();
+				UInt64	pluginChunkStart = s_loadBuffer.GetOffset();
 
 				// find the corresponding plugin
 				UInt32	pluginIdx = (s_pluginHeader.opcodeBase == kObseOpcodeBase) ? 0 : g_pluginManager.LookupHandleFromBaseOpcode(s_pluginHeader.opcodeBase);
@@ -533,7 +628,7 @@ void HandleLoadGame(const char * path, OBSESerializationInterface::EventCallback
 						// ### wtf?
 						_WARNING("plugin %s has data in save file but no handler", g_pluginManager.GetPluginNameFromHandle(pluginIdx));
 
-						s_currentFile.Skip(s_pluginHeader.length);
+						s_loadBuffer.Skip(s_pluginHeader.length);
 					}
 				}
 				else
@@ -541,11 +636,11 @@ void HandleLoadGame(const char * path, OBSESerializationInterface::EventCallback
 					// ### TODO: save the data temporarily?
 					_WARNING("data in save file for plugin, but plugin isn't loaded");
 
-					s_currentFile.Skip(s_pluginHeader.length);
+					s_loadBuffer.Skip(s_pluginHeader.length);
 				}
 
 				UInt64	expectedOffset = pluginChunkStart + s_pluginHeader.length;
-				if(s_currentFile.GetOffset() != expectedOffset)
+				if(s_loadBuffer.GetOffset() != expectedOffset)
 				{
 					const char* pluginName = "UNKNOWN";
 					if (pluginIdx == 0) 
@@ -557,8 +652,8 @@ void HandleLoadGame(const char * path, OBSESerializationInterface::EventCallback
 							pluginName = pluginInfo->name;
 					}
 
-					_WARNING("plugin \"%s\" did not read all of its data (at %016I64X expected %016I64X)", pluginName, s_currentFile.GetOffset(), expectedOffset);
-					s_currentFile.SetOffset(expectedOffset);
+					_WARNING("plugin \"%s\" did not read all of its data (at %016I64X expected %016I64X)", pluginName, (UInt64)s_loadBuffer.GetOffset(), expectedOffset);
+					s_loadBuffer.SetOffset((UInt32)expectedOffset);
 				}
 			}
 
@@ -586,7 +681,7 @@ void HandleLoadGame(const char * path, OBSESerializationInterface::EventCallback
 	}
 
 done:
-	s_currentFile.Close();
+	s_loadBuffer.Close();
 }
 
 void HandleDeleteGame(const char * path)
@@ -595,6 +690,7 @@ void HandleDeleteGame(const char * path)
 
 	_MESSAGE("deleting %s", savePath.c_str());
 
+	s_coSaveWriter.Wait();
 	DeleteFile(savePath.c_str());
 }
 
@@ -605,12 +701,20 @@ void HandleRenameGame(const char * oldPath, const char * newPath)
 
 	_MESSAGE("renaming %s -> %s", oldSavePath.c_str(), newSavePath.c_str());
 
+	s_coSaveWriter.Wait();
 	DeleteFile(newSavePath.c_str());
 	rename(oldSavePath.c_str(), newSavePath.c_str());
 }
 
+void WaitForPendingSave(void)
+{
+	s_coSaveWriter.Wait();
+}
+
 void HandleNewGame(void)
 {
+	InvalidateSavedBlocks();
+
 	// iterate through plugins
 	for(UInt32 i = 0; i < s_pluginCallbacks.size(); i++)
 	{
@@ -642,4 +746,8 @@ OBSESerializationInterface	g_OBSESerializationInterface =
 	Serialization::SetPreloadCallback,
 
 	Serialization::PeekNextRecordInfo,
+
+	Serialization::ReadRecordSpan,
+
+	Serialization::SetGenerationCallback,
 };
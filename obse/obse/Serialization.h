@@ -10,12 +10,13 @@ namespace Serialization
 struct PluginCallbacks
 {
 	PluginCallbacks()
-		:save(NULL), load(NULL), newGame(NULL), preload(NULL) { }
+		:save(NULL), load(NULL), newGame(NULL), preload(NULL), generation(NULL) { }
 
 	OBSESerializationInterface::EventCallback	save;
 	OBSESerializationInterface::EventCallback	load;
 	OBSESerializationInterface::EventCallback	newGame;
 	OBSESerializationInterface::EventCallback	preload;
+	OBSESerializationInterface::GenerationCallback	generation;
 	
 	bool	hadData;
 };
@@ -25,6 +26,7 @@ void	SetSaveCallback(PluginHandle plugin, OBSESerializationInterface::EventCallb
 void	SetLoadCallback(PluginHandle plugin, OBSESerializationInterface::EventCallback callback);
 void	SetNewGameCallback(PluginHandle plugin, OBSESerializationInterface::EventCallback callback);
 void	SetPreloadCallback(PluginHandle plugin, OBSESerializationInterface::EventCallback callback);
+void	SetGenerationCallback(PluginHandle plugin, OBSESerializationInterface::GenerationCallback callback);
 
 bool	WriteRecord(UInt32 type, UInt32 version, const void * buf, UInt32 length);
 bool	OpenRecord(UInt32 type, UInt32 version);
@@ -33,6 +35,7 @@ bool	WriteRecordData(const void * buf, UInt32 length);
 bool	GetNextRecordInfo(UInt32 * type, UInt32 * version, UInt32 * length);
 bool	PeekNextRecordInfo(UInt32 * type, UInt32 * version, UInt32 * length);
 UInt32	ReadRecordData(void * buf, UInt32 length);
+const void *	ReadRecordSpan(UInt32 length);
 
 bool	ResolveRefID(UInt32 refID, UInt32 * outRefID);
 
@@ -45,8 +48,12 @@ void	HandleNewGame(void);
 void	HandlePreloadGame(const char* path);
 void	HandlePostLoadGame(bool bLoadSucceeded);
 
+// blocks until a co-save being written in the background is on disk
+void	WaitForPendingSave(void);
+
 void	InternalSetSaveCallback(PluginHandle plugin, OBSESerializationInterface::EventCallback callback);
 void	InternalSetLoadCallback(PluginHandle plugin, OBSESerializationInterface::EventCallback callback);
 void	InternalSetNewGameCallback(PluginHandle plugin, OBSESerializationInterface::EventCallback callback);
 void	InternalSetPreloadCallback(PluginHandle plugin, OBSESerializationInterface::EventCallback callback);
+void	InternalSetGenerationCallback(PluginHandle plugin, OBSESerializationInterface::GenerationCallback callback);
 }
@@ -9,6 +9,11 @@ bool FreeRef;
 bool NoisyTestExpr;
 bool PreventCrashOnMapMarkerLoadSave;
 bool IR_WriteAllRef;
+UInt32 TempVarCollectMaxVars;
+UInt32 TempVarCollectMaxMicroseconds;
+bool AsyncCoSave;
+bool CompressCoSave;
+bool IncrementalCoSave;
 
 bool InitializeSettings() {
 	std::string	runtimePath = GetOblivionDirectory();
@@ -28,5 +33,10 @@ bool InitializeSettings() {
 	NoisyTestExpr = GetPrivateProfileInt(INI_SECTION_RUNTIME, "bTestExprComplainsOnError", 0, s_configPath.c_str());
 	PreventCrashOnMapMarkerLoadSave = GetPrivateProfileInt(INI_SECTION_RUNTIME, "bPreventCrashOnMapMarkerLoad", 1, s_configPath.c_str());
 	IR_WriteAllRef = GetPrivateProfileInt(INI_SECTION_RUNTIME, "bWriteAllRefInventoryReference", 1, s_configPath.c_str());
+	TempVarCollectMaxVars = GetPrivateProfileInt(INI_SECTION_RUNTIME, "iTempVarCollectMaxVars", 2048, s_configPath.c_str());
+	TempVarCollectMaxMicroseconds = GetPrivateProfileInt(INI_SECTION_RUNTIME, "iTempVarCollectMaxMicroseconds", 2000, s_configPath.c_str());
+	AsyncCoSave = GetPrivateProfileInt(INI_SECTION_RUNTIME, "bAsyncCoSave", 0, s_configPath.c_str());
+	CompressCoSave = GetPrivateProfileInt(INI_SECTION_RUNTIME, "bCompressCoSave", 0, s_configPath.c_str());
+	IncrementalCoSave = GetPrivateProfileInt(INI_SECTION_RUNTIME, "bIncrementalCoSave", 0, s_configPath.c_str());
     return true;
 }
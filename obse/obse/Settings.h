@@ -19,5 +19,10 @@ extern bool FreeRef;
 extern bool NoisyTestExpr;
 extern bool PreventCrashOnMapMarkerLoadSave;
 extern bool IR_WriteAllRef;
+extern UInt32 TempVarCollectMaxVars;			// per-frame budget for deleting temporary arrays/strings, 0 for no limit
+extern UInt32 TempVarCollectMaxMicroseconds;
+extern bool AsyncCoSave;		// write the co-save file on a worker thread once its data has been collected
+extern bool CompressCoSave;		// LZ4-compress each plugin block of the co-save, older builds can't read compressed co-saves
+extern bool IncrementalCoSave;	// reuse co-save blocks of plugins whose data hasn't changed since the last save
 
 bool InitializeSettings();
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include "Hooks_Script.h"
 #include "ScriptUtils.h"
 #include "GameData.h"
+#include "CoSaveRecords.h"
 
 StringVar::StringVar(const char* in_data, UInt32 in_refID)
 {
@@ -20,6 +21,7 @@ const char* StringVar::GetCString()
 
 void StringVar::Set(const char* newString)
 {
+	g_StringMap.MarkDirty();
 	data = std::string(newString);
 }
 
@@ -50,6 +52,7 @@ SInt32 StringVar::Compare(char* rhs, bool caseSensitive)
 
 void StringVar::Insert(const char* subString, UInt32 insertionPos)
 {
+	g_StringMap.MarkDirty();
 	if (insertionPos < GetLength())
 		data.insert(insertionPos, subString);
 	else if (insertionPos == GetLength())
@@ -126,6 +129,8 @@ UInt32 StringVar::Replace(char* toReplace, const char* replaceWith, UInt32 start
 	else if (numChars + startPos > GetLength())
 		numChars = GetLength() - startPos;
 
+	g_StringMap.MarkDirty();
+
 	UInt32 numReplaced = 0;
 	UInt32 replacementLen = strlen(replaceWith);
 	UInt32 toReplaceLen = strlen(toReplace);
@@ -180,6 +185,7 @@ UInt32 StringVar::Replace(char* toReplace, const char* replaceWith, UInt32 start
 
 void StringVar::Erase(UInt32 startPos, UInt32 numChars)
 {
+	g_StringMap.MarkDirty();
 	if (numChars + startPos >= GetLength())
 		numChars = GetLength() - startPos;
 
@@ -234,21 +240,20 @@ void StringVarMap::Save(OBSESerializationInterface* intfc)
 
 	intfc->OpenRecord('STVS', 0);
 
-	for (std::map<UInt32, StringVar*>::iterator iter = m_state->vars.begin();
-			iter != m_state->vars.end();
-			iter++)
+	for (Iterator iter(m_state); !iter.Done(); iter.Next())
 	{
-		if (IsTemporary(iter->first))	// don't save temp strings
+		UInt32 stringID = iter.ID();
+		if (IsTemporary(stringID))	// don't save temp strings
 			continue;
 
 		intfc->OpenRecord('STVR', 0);
-		UInt8 modIndex = iter->second->GetOwningModIndex();
+		UInt8 modIndex = iter.Get()->GetOwningModIndex();
 
 		intfc->WriteRecordData(&modIndex, sizeof(UInt8));
-		intfc->WriteRecordData(&iter->first, sizeof(UInt32));
-		UInt16 len = iter->second->GetLength();
+		intfc->WriteRecordData(&stringID, sizeof(UInt32));
+		UInt16 len = iter.Get()->GetLength();
 		intfc->WriteRecordData(&len, sizeof(len));
-		intfc->WriteRecordData(iter->second->GetCString(), len);
+		intfc->WriteRecordData(iter.Get()->GetCString(), len);
 	}
 
 	intfc->OpenRecord('STVE', 0);
@@ -257,10 +262,9 @@ void StringVarMap::Save(OBSESerializationInterface* intfc)
 void StringVarMap::Load(OBSESerializationInterface* intfc)
 {
 	_MESSAGE("Loading strings");
-	UInt32 type, length, version, stringID, tempRefID;
-	UInt16 strLength;
+	UInt32 type, length, version, tempRefID;
 	UInt8 modIndex;
-	char buffer[kMaxMessageLength] = { 0 };
+	std::string str;
 
 	Clean();
 
@@ -288,22 +292,27 @@ void StringVarMap::Load(OBSESerializationInterface* intfc)
 
 			break;
 		case 'STVR':
-			intfc->ReadRecordData(&modIndex, sizeof(modIndex));
-			if (!intfc->ResolveRefID(modIndex << 24, &tempRefID))
 			{
-				// owning mod is no longer loaded so discard
-				continue;
-			}
-			else
-				modIndex = tempRefID >> 24;
+				RecordCursor record(intfc->ReadRecordSpan(length), length);
+				SavedStringVar saved;
+				if (!ReadStringVarRecord(record, saved))
+				{
+					_MESSAGE("StringVarMap::Load() truncated string record");
+					continue;
+				}
 
-			intfc->ReadRecordData(&stringID, sizeof(stringID));
-			intfc->ReadRecordData(&strLength, sizeof(strLength));
-			
-			intfc->ReadRecordData(buffer, strLength);
-			buffer[strLength] = 0;
+				if (!intfc->ResolveRefID(saved.modIndex << 24, &tempRefID))
+				{
+					// owning mod is no longer loaded so discard
+					continue;
+				}
+				else
+					modIndex = tempRefID >> 24;
 
-			Insert(stringID, new StringVar(buffer, tempRefID));
+				// strings were always cut at the first null on load
+				str.assign(saved.str.data, strnlen(saved.str.data, saved.str.len));
+				Insert(saved.id, new (AllocateVar()) StringVar(str.c_str(), tempRefID));
+			}
 			modVarCounts[modIndex] += 1;
 			if (modVarCounts[modIndex] == varCountThreshold) {
 				exceededMods.insert(modIndex);
@@ -320,9 +329,11 @@ void StringVarMap::Load(OBSESerializationInterface* intfc)
 UInt32	StringVarMap::Add(UInt8 varModIndex, const char* data, bool bTemp)
 {
 	UInt32 varID = GetUnusedID();
-	Insert(varID, new StringVar(data, varModIndex << 24));
+	StringVar* var = new (AllocateVar()) StringVar(data, varModIndex << 24);
 	if (bTemp)
-		MarkTemporary(varID, true);
+		InsertTemporary(varID, var);
+	else
+		Insert(varID, var);
 
 	return varID;
 }
@@ -375,17 +386,6 @@ bool AssignToStringVar(ParamInfo * paramInfo, void * arg1, TESObjectREFR * thisO
 	return true;
 }
 
-void StringVarMap::Clean()		// clean up any temporary vars
-{
-	if (m_state) {
-		while (m_state->tempVars.size())
-		{
-			UInt32 idToDelete = *(m_state->tempVars.begin());
-			Delete(idToDelete);
-		}
-	}
-}
-
 namespace PluginAPI
 {
 	const char* GetString(UInt32 stringID)
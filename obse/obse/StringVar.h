@@ -55,7 +55,6 @@ class StringVarMap : public VarMap<StringVar>
 public:
 	void Save(OBSESerializationInterface* intfc);
 	void Load(OBSESerializationInterface* intfc);
-	void Clean();
 
 	UInt32 Add(UInt8 varModIndex, const char* data, bool bTemp = false);
 };
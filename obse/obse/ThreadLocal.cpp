@@ -2,6 +2,7 @@
 #include "obse_common/SafeWrite.h"
 #include "FunctionScripts.h"
 #include "Loops.h"
+#include "ScriptTokens.h"
 
 static const UInt32 kBackgroundLoaderThreadHookAddr = 0x0047CF3E;
 
@@ -24,6 +25,10 @@ void __stdcall HandleThreadExit()
 			delete data->loopManager;
 		}
 
+		if (data->decodedExpressionCache) {
+			delete data->decodedExpressionCache;
+		}
+
 		// free memory allocated for this thread's data
 		delete data;
 	}
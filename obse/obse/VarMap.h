@@ -1,94 +1,158 @@
 #pragma once
 
 #include <map>
-#include <set>
-#include "Serialization.h"
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <new>
+
+struct OBSESerializationInterface;
 
 // simple template class used to support OBSE custom data types (strings, arrays, etc)
 
-template <class Var>
-class VarMap
+// fixed-size allocator for vars. Memory is carved out of slabs of kSlotsPerSlab vars and freed slots are
+// reused, slabs are only released when the allocator is destroyed
+template <class T>
+class VarSlab
 {
-protected:
-	typedef std::map<UInt32, Var*>	_VarMap;
-	typedef std::set<UInt32>		_VarIDs;
+	struct FreeSlot {
+		FreeSlot	* next;
+	};
 
-	class VarCache {
-		// if desired this can be replaced with an impl that caches more than one var without changing client code
-		UInt32		varID;
-		Var			* var;
+	enum {
+		kAlign			= alignof(T) > alignof(FreeSlot) ? alignof(T) : alignof(FreeSlot),
+		kSlotSize		= ((sizeof(T) > sizeof(FreeSlot) ? sizeof(T) : sizeof(FreeSlot)) + kAlign - 1) / kAlign * kAlign,
+		kSlotsPerSlab	= 256,
+	};
 
-	public:
-		VarCache() : varID(0), var(NULL) { }
+	std::vector<UInt8*>	m_slabs;
+	FreeSlot			* m_free;
 
-		~VarCache() {
-			Reset();
+	void Grow()
+	{
+		UInt8* slab = (UInt8*)::operator new(kSlotSize * kSlotsPerSlab);
+		m_slabs.push_back(slab);
+		for (UInt32 i = kSlotsPerSlab; i > 0; i--)
+		{
+			FreeSlot* slot = (FreeSlot*)(slab + (i - 1) * kSlotSize);
+			slot->next = m_free;
+			m_free = slot;
 		}
+	}
 
-		void Insert(UInt32 id, Var* v) {
-			varID = id;
-			var = v;
-		}
+public:
+	VarSlab() : m_free(NULL) { }
 
-		// clear all cached vars (only one in current impl)
-		void Reset() {
-			varID = 0;
-			var = NULL;
-		}
+	~VarSlab()
+	{
+		for (UInt32 i = 0; i < m_slabs.size(); i++)
+			::operator delete(m_slabs[i]);
+	}
 
-		void Remove(UInt32 id) {
-			if (id == varID) {
-				Reset();
-			}
-		}
+	void* Allocate()
+	{
+		if (!m_free)
+			Grow();
 
-		Var* Get(UInt32 id) {
-			return (varID == id) ? var : NULL;
-		}
+		FreeSlot* slot = m_free;
+		m_free = slot->next;
+		return slot;
+	}
+
+	void Free(void* p)
+	{
+		FreeSlot* slot = (FreeSlot*)p;
+		slot->next = m_free;
+		m_free = slot;
+	}
+};
+
+template <class Var>
+class VarMap
+{
+protected:
+	typedef VarSlab<Var>			_VarSlab;
+
+	struct Slot {
+		Var		* var;
+		UInt32	tempIndex : 31;		// 1-based position in tempVars, 0 if not temporary
+		UInt32	bAvailable : 1;		// ID is on the free list
+
+		Slot() : var(NULL), tempIndex(0), bAvailable(0) { }
+	};
+
+	typedef std::vector<Slot>		_SlotTable;
+	typedef std::map<UInt32, Slot>	_SlotMap;
+	typedef std::vector<UInt32>		_VarIDs;
+
+	enum {
+		kMaxTableID = 0x100000,		// larger IDs (only expected from damaged saves) are kept in a map
 	};
 
 	struct	State {
-		_VarMap		vars;
-		_VarIDs		tempVars;		// set of IDs of unreferenced vars, makes for easy cleanup
-		_VarIDs		availableVars;	// IDs < greatest used ID available as IDs for new vars
-		VarCache	cache;
+		_SlotTable	slots;			// indexed by ID
+		_SlotMap	largeSlots;		// IDs >= kMaxTableID
+		_VarIDs		tempVars;		// IDs of unreferenced vars, makes for easy cleanup
+		_VarIDs		availableVars;	// IDs < greatest used ID available as IDs for new vars, a min-heap so the smallest is reused first
+		UInt32		nextID;			// IDs from here on are unused
+		UInt32		numLive;
+		_VarSlab	* slab;
+
+		State(_VarSlab* _slab) : nextID(1), numLive(0), slab(_slab) { }
 
 		~State() {
 			Reset();
 		}
 
-		UInt32	GetUnusedID()
+		Slot* GetSlot(UInt32 varID, bool bCreate)
 		{
-			UInt32 id = 1;
-
-			if (availableVars.size())
+			if (varID < kMaxTableID)
 			{
-				id = *availableVars.begin();
-				availableVars.erase(id);
+				if (varID >= slots.size())
+				{
+					if (!bCreate)
+						return NULL;
+					slots.resize(varID + 1);
+				}
+				return &slots[varID];
 			}
-			else if (vars.size())
+
+			typename _SlotMap::iterator iter = largeSlots.find(varID);
+			if (iter != largeSlots.end())
+				return &iter->second;
+
+			return bCreate ? &largeSlots[varID] : NULL;
+		}
+
+		UInt32	GetUnusedID()
+		{
+			while (availableVars.size())
 			{
-				typename _VarMap::iterator iter = vars.end();
-				--iter;
-				id = iter->first + 1;
+				std::pop_heap(availableVars.begin(), availableVars.end(), std::greater<UInt32>());
+				UInt32 id = availableVars.back();
+				availableVars.pop_back();
+
+				// IDs marked available while loading may have been taken by an explicit Insert() since
+				Slot* slot = GetSlot(id, false);
+				if (slot)
+				{
+					slot->bAvailable = 0;
+					if (!slot->var)
+						return id;
+				}
 			}
 
-			return id;
+			return nextID;
 		}
 
 		Var*	Get(UInt32 varID)
 		{
-			if (varID != 0) {
-				Var* var = cache.Get(varID);
-				if (var) {
-					return var;
-				}
-
-				typename _VarMap::iterator it = vars.find(varID);
-				if (it != vars.end())  {
-					cache.Insert(varID, it->second);
-					return it->second;
-				}
+			if (varID != 0 && varID < slots.size())
+				return slots[varID].var;
+			else if (varID >= kMaxTableID)
+			{
+				Slot* slot = GetSlot(varID, false);
+				return slot ? slot->var : NULL;
 			}
 
 			return NULL;
@@ -101,64 +165,164 @@ protected:
 
 		void Insert(UInt32 varID, Var* var)
 		{
-			vars[varID] = var;
+			if (!varID)
+				return;
+
+			Slot* slot = GetSlot(varID, true);
+			if (!slot->var && var)
+				numLive++;
+			slot->var = var;
+			if (varID >= nextID)
+				nextID = varID + 1;
 		}
 
 		void	Delete(UInt32 varID)
 		{
-			Var* var = Get(varID);
+			Slot* slot = GetSlot(varID, false);
+			if (!slot)
+				return;
+
+			// finish with the slot first, destroying the var may mark other vars temporary and grow the table
+			Var* var = slot->var;
+			slot->var = NULL;
+			MarkTemporary(varID, false);
+
+			// the newest ID is handed out again without going through the heap, temporary vars are collected newest first
+			if (varID == nextID - 1 && !slot->bAvailable)
+				nextID--;
+			else
+				SetIDAvailable(varID);
+
 			if (var)
 			{
-				cache.Remove(varID);
-
-				delete var;
-				vars.erase(varID);
+				numLive--;
+				DestroyVar(var);
 			}
-			tempVars.erase(varID);
-			SetIDAvailable(varID);
+		}
+
+		void DestroyVar(Var* var)
+		{
+			var->~Var();
+			slab->Free(var);
 		}
 
 		void Reset()
 		{
-			cache.Reset();
-			typename _VarMap::iterator itEnd = vars.end();
-			typename _VarMap::iterator iter = vars.begin();
-			typename _VarMap::iterator toErase = iter;
-			while (iter != itEnd)
+			// clear each slot before destroying its var so destructors can't look up destroyed vars
+			for (UInt32 i = 0; i < slots.size(); i++)
 			{
-				delete iter->second;
-				toErase = iter;
-				++iter;
-				vars.erase(toErase);
+				Var* var = slots[i].var;
+				slots[i].var = NULL;
+				if (var)
+					DestroyVar(var);
 			}
 
-			vars.clear();
+			for (typename _SlotMap::iterator iter = largeSlots.begin(); iter != largeSlots.end(); ++iter)
+			{
+				Var* var = iter->second.var;
+				iter->second.var = NULL;
+				if (var)
+					DestroyVar(var);
+			}
+
+			slots.clear();
+			largeSlots.clear();
 			tempVars.clear();
 			availableVars.clear();
+			nextID = 1;
+			numLive = 0;
 		}
 
 		void	MarkTemporary(UInt32 varID, bool bTemporary)
 		{
 			if (bTemporary)
-				tempVars.insert(varID);
+			{
+				Slot* slot = GetSlot(varID, true);
+				if (!slot->tempIndex)
+				{
+					tempVars.push_back(varID);
+					slot->tempIndex = tempVars.size();
+				}
+			}
 			else
-				tempVars.erase(varID);
+			{
+				Slot* slot = GetSlot(varID, false);
+				if (slot && slot->tempIndex)
+				{
+					// move the last temp ID into the vacated position
+					UInt32 lastID = tempVars.back();
+					tempVars[slot->tempIndex - 1] = lastID;
+					GetSlot(lastID, false)->tempIndex = slot->tempIndex;
+					tempVars.pop_back();
+					slot->tempIndex = 0;
+				}
+			}
 		}
 
 		bool IsTemporary(UInt32 varID)
 		{
-			return (tempVars.find(varID) != tempVars.end()) ? true : false;
+			Slot* slot = GetSlot(varID, false);
+			return (slot && slot->tempIndex) ? true : false;
 		}
 
 		void SetIDAvailable(UInt32 id) {
 			if (id) {
-				availableVars.insert(id);
+				Slot* slot = GetSlot(id, true);
+				if (!slot->bAvailable) {
+					slot->bAvailable = 1;
+					availableVars.push_back(id);
+					std::push_heap(availableVars.begin(), availableVars.end(), std::greater<UInt32>());
+				}
 			}
 		}
+
+		// visits vars in ascending ID order
+		class Iterator
+		{
+			State							* m_state;
+			UInt32							m_index;
+			typename _SlotMap::iterator		m_mapIter;
+
+			void SkipEmpty()
+			{
+				while (m_index < m_state->slots.size() && !m_state->slots[m_index].var)
+					m_index++;
+
+				if (m_index >= m_state->slots.size())
+				{
+					while (m_mapIter != m_state->largeSlots.end() && !m_mapIter->second.var)
+						++m_mapIter;
+				}
+			}
+
+		public:
+			Iterator(State* state) : m_state(state), m_index(0), m_mapIter(state->largeSlots.begin()) { SkipEmpty(); }
+
+			bool	Done() const	{ return m_index >= m_state->slots.size() && m_mapIter == m_state->largeSlots.end(); }
+			UInt32	ID() const		{ return m_index < m_state->slots.size() ? m_index : m_mapIter->first; }
+			Var*	Get() const		{ return m_index < m_state->slots.size() ? m_state->slots[m_index].var : m_mapIter->second.var; }
+
+			void Next()
+			{
+				if (m_index < m_state->slots.size())
+					m_index++;
+				else
+					++m_mapIter;
+
+				SkipEmpty();
+			}
+		};
 	};
 
+	typedef typename State::Iterator	Iterator;
+
+	_VarSlab	m_slab;				// storage for vars of both states
 	State	* m_state;				// currently loaded vars
 	State	* m_backupState;		// previously loaded vars, used as restore point in the event a saved game fails to load
+	UInt32	m_totalFreed;
+	UInt32	m_lastFreed;
+	UInt32	m_lastMicroseconds;
+	UInt32	m_generation;			// changes whenever the saved vars change, temporary vars aren't saved
 
 	UInt32	GetUnusedID()
 	{
@@ -170,10 +334,31 @@ protected:
 		m_state->SetIDAvailable(id);
 	}
 
+	// vars passed to Insert() must be constructed in memory from AllocateVar(), i.e. new (AllocateVar()) Var(...)
+	void* AllocateVar()
+	{
+		return m_slab.Allocate();
+	}
+
+	// inserts a var which starts out temporary, it isn't saved until that changes so the generation is left alone
+	void InsertTemporary(UInt32 varID, Var* var)
+	{
+		m_state->Insert(varID, var);
+		m_state->MarkTemporary(varID, true);
+	}
+
 public:
-	VarMap()
+	struct CollectStats {
+		UInt32	numLive;
+		UInt32	numTemp;			// temporary vars awaiting collection
+		UInt32	totalFreed;
+		UInt32	lastFreed;			// by the most recent Collect() or Clean()
+		UInt32	lastMicroseconds;
+	};
+
+	VarMap() : m_totalFreed(0), m_lastFreed(0), m_lastMicroseconds(0), m_generation(0)
 	{
-		m_state = new State();
+		m_state = new State(&m_slab);
 		m_backupState = NULL;
 	}
 
@@ -195,27 +380,34 @@ public:
 
 	void Insert(UInt32 varID, Var* var)
 	{
+		m_generation++;
 		m_state->Insert(varID, var);
 	}
 
 	void	Delete(UInt32 varID)
 	{
+		if (!m_state->IsTemporary(varID))
+			m_generation++;
 		m_state->Delete(varID);
 	}
 
 	void Reset(OBSESerializationInterface* intfc)
 	{
+		m_generation++;
 		m_state->Reset();
 	}
 
 	void Preload()
 	{
+		m_generation++;
 		m_backupState = m_state;
-		m_state = new State();
+		m_state = new State(&m_slab);
 	}
 
 	void PostLoad(bool bLoadSucceeded)
 	{
+		m_generation++;
+
 		// there is a possibility loading a saved game will fail. If so, restore vars to previous state.
 		if (bLoadSucceeded) {
 			if (m_backupState) {
@@ -239,11 +431,88 @@ public:
 
 	void	MarkTemporary(UInt32 varID, bool bTemporary)
 	{
+		if (m_state->IsTemporary(varID) != bTemporary)
+			m_generation++;
 		m_state->MarkTemporary(varID, bTemporary);
 	}
 
+	// to be called when the contents of a var change. Changes to temporary vars, or vars being destroyed, don't count
+	void	MarkDirty(UInt32 varID)
+	{
+		if (m_state->Get(varID) && !m_state->IsTemporary(varID))
+			m_generation++;
+	}
+
+	// for vars which don't know their ID
+	void	MarkDirty()
+	{
+		m_generation++;
+	}
+
+	// compared between saves to tell whether the vars need to be written again
+	UInt32	GetGeneration() const
+	{
+		return m_generation;
+	}
+
 	bool IsTemporary(UInt32 varID)
 	{
 		return m_state->IsTemporary(varID);
 	}
-};
\ No newline at end of file
+
+	// deletes temporary vars until maxVars have been deleted or maxMicroseconds have passed, 0 meaning no limit.
+	// Deleting a var may queue more for deletion (arrays containing arrays), those are picked up by the same or a later call
+	UInt32 Collect(UInt32 maxVars, UInt32 maxMicroseconds)
+	{
+		if (!m_state)
+			return 0;
+
+		LARGE_INTEGER freq, start, now;
+		QueryPerformanceFrequency(&freq);
+		QueryPerformanceCounter(&start);
+
+		UInt32 numFreed = 0;
+		while (m_state->tempVars.size() && (!maxVars || numFreed < maxVars))
+		{
+			Delete(m_state->tempVars.back());
+			numFreed++;
+
+			if (maxMicroseconds)
+			{
+				QueryPerformanceCounter(&now);
+				if ((now.QuadPart - start.QuadPart) * 1000000 / freq.QuadPart >= maxMicroseconds)
+					break;
+			}
+		}
+
+		QueryPerformanceCounter(&now);
+
+		m_totalFreed += numFreed;
+		m_lastFreed = numFreed;
+		m_lastMicroseconds = (now.QuadPart - start.QuadPart) * 1000000 / freq.QuadPart;
+		return numFreed;
+	}
+
+	// deletes all temporary vars, i.e. before saving
+	void Clean()
+	{
+		Collect(0, 0);
+	}
+
+	void GetCollectStats(CollectStats& stats)
+	{
+		stats.numLive = m_state ? m_state->numLive : 0;
+		stats.numTemp = m_state ? m_state->tempVars.size() : 0;
+		stats.totalFreed = m_totalFreed;
+		stats.lastFreed = m_lastFreed;
+		stats.lastMicroseconds = m_lastMicroseconds;
+	}
+
+	void LogCollectStats(const char* name)
+	{
+		CollectStats stats;
+		GetCollectStats(stats);
+		_MESSAGE("%s: %d live, %d temporary awaiting collection, %d freed in total, last collection freed %d in %d us",
+			name, stats.numLive, stats.numTemp, stats.totalFreed, stats.lastFreed, stats.lastMicroseconds);
+	}
+};
@@ -5,6 +5,7 @@
 #include "Hooks_Memory.h"
 #include "Hooks_SaveLoad.h"
 #include "Hooks_Script.h"
+#include "ScriptTokens.h"
 #include "Commands_Math.h"
 #include "PluginManager.h"
 #include "InternalSerialization.h"
@@ -48,6 +49,7 @@ void OBSE_Initialize(void)
 //		Hook_Memory_Init();
 		Hook_SaveLoad_Init();
 		Hook_Script_Init();
+		Operator::InitDispatchTable();
 //		Hook_NetImmerse_Init();
 
 //		HavokReflection_Init();
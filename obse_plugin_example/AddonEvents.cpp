@@ -0,0 +1,147 @@
+#include "AddonEvents.h"
+
+#include <atomic>
+
+#include "EffectCache.h"
+#include "FrameTimers.h"
+
+using namespace reshade;
+
+// Per-runtime state, so several runtimes (one per swapchain) don't throw away each other's caches
+struct __declspec(uuid("3C1D7A5E-52B9-4E0F-9B7D-6F24A8C1D0E3")) runtime_data
+{
+	EffectCache        cache;
+	api::command_list* cmdlist = nullptr;
+	api::resource_view rtv = { 0 };
+	api::resource_view rtv_srgb = { 0 };
+	bool               validPass = false;
+};
+
+struct __declspec(uuid("7251932A-ADAF-4DFC-B5CB-9A4E8CD5D6EB")) device_data
+{
+	api::effect_runtime* main_runtime = nullptr;
+	api::resource_view   true_rtv = { 0 };
+};
+
+// Runtime the render hook publishes to, the first one created on the game's device
+std::atomic<api::effect_runtime*> m_runtime { nullptr };
+
+// Private data is only attached by the init events, so objects created before the add-on was
+// registered won't have any
+template <typename T>
+T* GetPrivateData(const api::api_object* object)
+{
+	uint64_t data = 0;
+	object->get_private_data(reinterpret_cast<const uint8_t*>(&__uuidof(T)), &data);
+	return reinterpret_cast<T*>(static_cast<uintptr_t>(data));
+}
+
+void on_init_device(api::device* device)
+{
+	device->create_private_data<device_data>();
+}
+
+void on_destroy_device(api::device* device)
+{
+	device->destroy_private_data<device_data>();
+}
+
+void on_init_effect_runtime(api::effect_runtime* runtime)
+{
+	runtime->create_private_data<runtime_data>();
+
+	if (device_data* device = GetPrivateData<device_data>(runtime->get_device())) {
+		if (!device->main_runtime) {
+			device->main_runtime = runtime;
+			m_runtime.store(runtime);
+		}
+	}
+}
+
+void on_destroy_effect_runtime(api::effect_runtime* runtime)
+{
+	if (device_data* device = GetPrivateData<device_data>(runtime->get_device())) {
+		if (device->main_runtime == runtime)
+			device->main_runtime = nullptr;
+	}
+
+	api::effect_runtime* expected = runtime;
+	m_runtime.compare_exchange_strong(expected, nullptr);
+
+	runtime->destroy_private_data<runtime_data>();
+}
+
+void on_reshade_begin_effects(api::effect_runtime* runtime, api::command_list* cmd_list, api::resource_view rtv, api::resource_view rtv_srgb)
+{
+	runtime_data* data = GetPrivateData<runtime_data>(runtime);
+	if (!data)
+		return;
+
+	data->cmdlist = cmd_list;
+	data->rtv = rtv;
+	data->rtv_srgb = rtv_srgb;
+	if (!data->validPass) {
+		// pre-UI techniques only run from the render hook
+		ScopedStageTimer timer(kStage_BeginEffects);
+		data->cache.DisableTechniques(runtime, UIStage::Pre);
+	}
+}
+
+void on_reshade_finish_effects(api::effect_runtime* runtime, api::command_list* cmd_list, api::resource_view rtv, api::resource_view rtv_srgb)
+{
+	runtime_data* data = GetPrivateData<runtime_data>(runtime);
+	if (!data)
+		return;
+
+	if (!data->validPass) {
+		ScopedStageTimer timer(kStage_FinishEffects);
+		data->cache.RestoreTechniques(runtime, UIStage::Pre);
+	}
+	else {
+		data->validPass = false;
+	}
+}
+
+void on_reshade_reloaded_effects(api::effect_runtime* runtime)
+{
+	if (runtime_data* data = GetPrivateData<runtime_data>(runtime))
+		data->cache.Invalidate();
+}
+
+void on_bind_render_targets_and_depth_stencil(api::command_list* cmd_list, uint32_t count, const api::resource_view* rtvs, api::resource_view dsv)
+{
+	if (device_data* device = GetPrivateData<device_data>(cmd_list->get_device()))
+		device->true_rtv = rtvs[0];
+}
+
+static void UpdateUniforms(api::effect_runtime* runtime, EffectCache& cache)
+{
+	ScopedStageTimer timer(kStage_UpdateUniforms);
+
+	GameState state;
+	ReadGameState(state);
+	cache.UpdateUniforms(runtime, state);
+}
+
+void RenderEffects()
+{
+	api::effect_runtime* runtime = m_runtime.load();
+	if (!runtime)
+		return;
+
+	runtime_data* data = GetPrivateData<runtime_data>(runtime);
+	device_data* device = GetPrivateData<device_data>(runtime->get_device());
+	if (data && device && data->cmdlist) {
+		UpdateUniforms(runtime, data->cache);
+
+		// skip the pass entirely when there is nothing to run before the UI
+		if (!data->cache.HasEnabledTechniques(runtime, UIStage::Pre))
+			return;
+
+		ScopedStageTimer timer(kStage_RenderEffects);
+		data->cache.DisableTechniques(runtime, UIStage::Post);
+		data->validPass = true;
+		runtime->render_effects(data->cmdlist, device->true_rtv);
+		data->cache.RestoreTechniques(runtime, UIStage::Post);
+	}
+}
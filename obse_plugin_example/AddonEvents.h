@@ -0,0 +1,24 @@
+#pragma once
+
+#include "ReShade/reshade_api.hpp"
+
+#include "UniformSources.h"
+
+// ReShade event callbacks and the pre-UI render pass. These only talk to ReShade through its API
+// and get game values through ReadGameState, so the host benchmark can drive them with a mock
+// runtime. main.cpp registers them and calls RenderEffects from the render hook.
+
+void on_init_device(reshade::api::device* device);
+void on_destroy_device(reshade::api::device* device);
+void on_init_effect_runtime(reshade::api::effect_runtime* runtime);
+void on_destroy_effect_runtime(reshade::api::effect_runtime* runtime);
+void on_reshade_begin_effects(reshade::api::effect_runtime* runtime, reshade::api::command_list* cmd_list, reshade::api::resource_view rtv, reshade::api::resource_view rtv_srgb);
+void on_reshade_finish_effects(reshade::api::effect_runtime* runtime, reshade::api::command_list* cmd_list, reshade::api::resource_view rtv, reshade::api::resource_view rtv_srgb);
+void on_reshade_reloaded_effects(reshade::api::effect_runtime* runtime);
+void on_bind_render_targets_and_depth_stencil(reshade::api::command_list* cmd_list, uint32_t count, const reshade::api::resource_view* rtvs, reshade::api::resource_view dsv);
+
+// renders the pre-UI techniques of the main runtime into the game's render target
+void RenderEffects();
+
+// fills in the values exposed to effects, defined in main.cpp from the running game
+void ReadGameState(GameState& state);
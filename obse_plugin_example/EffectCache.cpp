@@ -0,0 +1,104 @@
+#include "EffectCache.h"
+
+#include <cstring>
+
+using namespace reshade;
+
+void EffectCache::Clear()
+{
+	m_uniformBindings.clear();
+	for (TechniqueList& list : m_techniques) {
+		list.techniques.clear();
+		list.backup.clear();
+	}
+	m_runtime = nullptr;
+	m_dirty = true;
+}
+
+void EffectCache::Build(api::effect_runtime* runtime)
+{
+	m_uniformBindings.clear();
+	runtime->enumerate_uniform_variables(nullptr, [&](api::effect_runtime* runtime, api::effect_uniform_variable variable) {
+		char annotation_value[128];
+		if (runtime->get_annotation_string_from_uniform_variable(variable, "source", annotation_value)) {
+			if (const UniformSourceInfo* source = LookupUniformSource(annotation_value))
+				m_uniformBindings.push_back({ variable, TrackedUniform(source) });
+		}
+		});
+
+	for (TechniqueList& list : m_techniques)
+		list.techniques.clear();
+	runtime->enumerate_techniques(nullptr, [&](api::effect_runtime* runtime, api::effect_technique technique) {
+		char annotation_value[16];
+		UIStage stage = UIStage::Pre;
+		if (runtime->get_annotation_string_from_technique(technique, "ui_stage", annotation_value) && !strcmp(annotation_value, "post"))
+			stage = UIStage::Post;
+		m_techniques[(size_t)stage].techniques.push_back(technique);
+		});
+	for (TechniqueList& list : m_techniques)
+		list.backup.assign(list.techniques.size(), false);
+
+	m_runtime = runtime;
+	m_dirty = false;
+}
+
+void EffectCache::Update(api::effect_runtime* runtime)
+{
+	if (m_dirty || m_runtime != runtime)
+		Build(runtime);
+}
+
+void EffectCache::DisableTechniques(api::effect_runtime* runtime, UIStage stage)
+{
+	Update(runtime);
+	TechniqueList& list = m_techniques[(size_t)stage];
+	for (size_t i = 0; i < list.techniques.size(); i++) {
+		bool enabled = runtime->get_technique_state(list.techniques[i]);
+		list.backup[i] = enabled;
+		if (enabled)
+			runtime->set_technique_state(list.techniques[i], false);
+	}
+}
+
+void EffectCache::RestoreTechniques(api::effect_runtime* runtime, UIStage stage)
+{
+	// effects may have been reloaded since DisableTechniques, the rebuild then drops the backup along with the old handles
+	Update(runtime);
+	TechniqueList& list = m_techniques[(size_t)stage];
+	for (size_t i = 0; i < list.techniques.size(); i++) {
+		if (list.backup[i])
+			runtime->set_technique_state(list.techniques[i], true);
+	}
+}
+
+bool EffectCache::HasEnabledTechniques(api::effect_runtime* runtime, UIStage stage)
+{
+	Update(runtime);
+	for (api::effect_technique technique : m_techniques[(size_t)stage].techniques) {
+		if (runtime->get_technique_state(technique))
+			return true;
+	}
+	return false;
+}
+
+void EffectCache::UpdateUniforms(api::effect_runtime* runtime, const GameState& state)
+{
+	Update(runtime);
+	for (UniformBinding& binding : m_uniformBindings) {
+		UniformValue value;
+		if (!binding.tracked.Update(state, value))
+			continue;
+
+		switch (binding.tracked.source->type) {
+		case UniformType::Bool:
+			runtime->set_uniform_value_bool(binding.variable, value.b, binding.tracked.source->count);
+			break;
+		case UniformType::Int:
+			runtime->set_uniform_value_int(binding.variable, value.i, binding.tracked.source->count);
+			break;
+		case UniformType::Float:
+			runtime->set_uniform_value_float(binding.variable, value.f, binding.tracked.source->count);
+			break;
+		}
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+
+#include "ReShade/reshade_api.hpp"
+
+#include "UniformSources.h"
+
+// Where a technique runs, set through its ui_stage annotation. Techniques without one run before
+// the UI like they always have.
+enum class UIStage
+{
+	Pre = 0,
+	Post,
+
+	Max
+};
+
+// Uniform bindings and technique handles for one effect runtime, resolved once per effect reload
+// so the per-frame callbacks only walk pre-resolved handles. Only talks to the runtime through
+// reshade::api::effect_runtime and reads game values from a GameState, so it has no game or
+// Detours dependencies.
+class EffectCache
+{
+public:
+	EffectCache() : m_runtime(nullptr), m_dirty(true) { }
+
+	void Invalidate() { m_dirty = true; }
+	void Clear();
+
+	// rebuilds the cache if effects were reloaded or the runtime changed
+	void Update(reshade::api::effect_runtime* runtime);
+
+	// remembers which techniques of a stage are enabled and turns them off, RestoreTechniques turns them back on
+	// unless effects were reloaded in between
+	void DisableTechniques(reshade::api::effect_runtime* runtime, UIStage stage);
+	void RestoreTechniques(reshade::api::effect_runtime* runtime, UIStage stage);
+	bool HasEnabledTechniques(reshade::api::effect_runtime* runtime, UIStage stage);
+
+	void UpdateUniforms(reshade::api::effect_runtime* runtime, const GameState& state);
+
+private:
+	struct UniformBinding
+	{
+		reshade::api::effect_uniform_variable	variable;
+		TrackedUniform							tracked;
+	};
+
+	struct TechniqueList
+	{
+		std::vector<reshade::api::effect_technique>	techniques;
+		std::vector<bool>							backup;
+	};
+
+	void Build(reshade::api::effect_runtime* runtime);
+
+	std::vector<UniformBinding>					m_uniformBindings;
+	TechniqueList								m_techniques[(size_t)UIStage::Max];
+	reshade::api::effect_runtime*				m_runtime;
+	bool										m_dirty;
+};
@@ -0,0 +1,63 @@
+#include "FrameTimers.h"
+
+#include <algorithm>
+
+static const std::chrono::seconds kSummaryInterval(60);
+
+static const char* s_stageNames[kStage_Max] =
+{
+	"HDRRender",
+	"UpdateUniforms",
+	"RenderEffects",
+	"BeginEffects",
+	"FinishEffects",
+};
+
+StageTimings					FrameTimers::s_stages[kStage_Max];
+FrameTimers::Clock::time_point	FrameTimers::s_lastSummary = FrameTimers::Clock::now();
+
+uint32_t StageTimings::Copy(uint32_t* out) const
+{
+	uint32_t count = m_count.load(std::memory_order_acquire);
+	uint32_t numSamples = std::min<uint32_t>(count, kNumSamples);
+	for (uint32_t i = 0; i < numSamples; i++)
+		out[i] = m_samples[(count - numSamples + i) % kNumSamples];
+	return numSamples;
+}
+
+void FrameTimers::Summarize(FrameStage stage, StageSummary& summary)
+{
+	uint32_t samples[StageTimings::kNumSamples];
+	summary.numSamples = s_stages[stage].Copy(samples);
+	if (!summary.numSamples) {
+		summary.p50 = summary.p95 = summary.p99 = 0;
+		return;
+	}
+
+	std::sort(samples, samples + summary.numSamples);
+	auto percentile = [&](uint32_t p) {
+		return samples[(summary.numSamples - 1) * p / 100] / 1000.0f;
+	};
+	summary.p50 = percentile(50);
+	summary.p95 = percentile(95);
+	summary.p99 = percentile(99);
+}
+
+void FrameTimers::EndFrame()
+{
+	Clock::time_point now = Clock::now();
+	if (now - s_lastSummary >= kSummaryInterval) {
+		s_lastSummary = now;
+		Dump();
+	}
+}
+
+void FrameTimers::Dump()
+{
+	_MESSAGE("Frame timings (us, last %d samples):", StageTimings::kNumSamples);
+	for (uint32_t i = 0; i < kStage_Max; i++) {
+		StageSummary summary;
+		Summarize((FrameStage)i, summary);
+		_MESSAGE("    %-16s p50 %8.1f  p95 %8.1f  p99 %8.1f  (%d samples)", s_stageNames[i], summary.p50, summary.p95, summary.p99, summary.numSamples);
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+enum FrameStage
+{
+	kStage_HDRRender = 0,		// the game's own HDR pass
+	kStage_UpdateUniforms,
+	kStage_RenderEffects,		// pre-UI render_effects call
+	kStage_BeginEffects,		// technique toggling in on_reshade_begin_effects
+	kStage_FinishEffects,		// technique restore in on_reshade_finish_effects
+
+	kStage_Max
+};
+
+// Fixed-size ring of the most recent samples for one stage. Only the render thread writes to it,
+// readers copy it out and may see a sample being overwritten, which is fine for statistics.
+class StageTimings
+{
+public:
+	enum { kNumSamples = 512 };
+
+	StageTimings() : m_count(0) { }
+
+	void Record(uint32_t nanoseconds)
+	{
+		uint32_t count = m_count.load(std::memory_order_relaxed);
+		m_samples[count % kNumSamples] = nanoseconds;
+		m_count.store(count + 1, std::memory_order_release);
+	}
+
+	// copies up to kNumSamples of the most recent samples into out, returns the number copied
+	uint32_t Copy(uint32_t* out) const;
+
+private:
+	uint32_t				m_samples[kNumSamples];
+	std::atomic<uint32_t>	m_count;
+};
+
+struct StageSummary
+{
+	uint32_t	numSamples;
+	float		p50;		// microseconds
+	float		p95;
+	float		p99;
+};
+
+class FrameTimers
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	static void Record(FrameStage stage, Clock::time_point start)
+	{
+		auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+		s_stages[stage].Record(elapsed > UINT32_MAX ? UINT32_MAX : (uint32_t)elapsed);
+	}
+
+	static void Summarize(FrameStage stage, StageSummary& summary);
+
+	// called once per frame from the render hook, writes a summary to the log every kSummaryInterval
+	static void EndFrame();
+	static void Dump();
+
+private:
+	static StageTimings			s_stages[kStage_Max];
+	static Clock::time_point	s_lastSummary;
+};
+
+class ScopedStageTimer
+{
+public:
+	ScopedStageTimer(FrameStage stage) : m_stage(stage), m_start(FrameTimers::Clock::now()) { }
+	~ScopedStageTimer() { FrameTimers::Record(m_stage, m_start); }
+
+private:
+	FrameStage						m_stage;
+	FrameTimers::Clock::time_point	m_start;
+};
@@ -0,0 +1,108 @@
+#include "UniformSources.h"
+
+static bool Read_ModLoaded(const GameState& state, UniformValue& value)
+{
+	value.b[0] = true;
+	return true;
+}
+
+static bool Read_Weather(const GameState& state, UniformValue& value)
+{
+	if (!state.hasSky)
+		return false;
+
+	value.f[0] = state.currWeather;
+	value.f[1] = state.transWeather;
+	value.f[2] = state.weatherPercent;
+	value.f[3] = state.gameHour;
+	return true;
+}
+
+static bool Read_GameHour(const GameState& state, UniformValue& value)
+{
+	if (!state.hasSky)
+		return false;
+
+	value.f[0] = state.gameHour;
+	return true;
+}
+
+static bool Read_WorldspaceID(const GameState& state, UniformValue& value)
+{
+	value.i[0] = state.worldspaceID;
+	return true;
+}
+
+static bool Read_InteriorID(const GameState& state, UniformValue& value)
+{
+	value.i[0] = state.interiorID;
+	return true;
+}
+
+static bool Read_PlayerPosition(const GameState& state, UniformValue& value)
+{
+	if (!state.hasPlayer)
+		return false;
+
+	value.f[0] = state.playerPos[0];
+	value.f[1] = state.playerPos[1];
+	value.f[2] = state.playerPos[2];
+	return true;
+}
+
+static bool Read_CameraFOV(const GameState& state, UniformValue& value)
+{
+	if (!state.hasCamera)
+		return false;
+
+	value.f[0] = state.cameraFOV;
+	return true;
+}
+
+static bool Read_InCombat(const GameState& state, UniformValue& value)
+{
+	value.b[0] = state.hasPlayer && state.inCombat;
+	return true;
+}
+
+static bool Read_Underwater(const GameState& state, UniformValue& value)
+{
+	value.b[0] = state.hasPlayer && state.underwater;
+	return true;
+}
+
+// to expose a new value add a field to GameState, fill it in ReadGameState and register it here
+static const UniformSourceInfo s_uniformSources[] =
+{
+	{ "ModLoaded",		UniformType::Bool,	1,	Read_ModLoaded },
+	{ "Weather",		UniformType::Float,	4,	Read_Weather },
+	{ "GameHour",		UniformType::Float,	1,	Read_GameHour },
+	{ "WorldspaceID",	UniformType::Int,	1,	Read_WorldspaceID },
+	{ "InteriorID",		UniformType::Int,	1,	Read_InteriorID },
+	{ "PlayerPosition",	UniformType::Float,	3,	Read_PlayerPosition },
+	{ "CameraFOV",		UniformType::Float,	1,	Read_CameraFOV },
+	{ "InCombat",		UniformType::Bool,	1,	Read_InCombat },
+	{ "Underwater",		UniformType::Bool,	1,	Read_Underwater },
+};
+
+const UniformSourceInfo* LookupUniformSource(const char* name)
+{
+	for (const UniformSourceInfo& source : s_uniformSources) {
+		if (!strcmp(source.name, name))
+			return &source;
+	}
+	return nullptr;
+}
+
+bool TrackedUniform::Update(const GameState& state, UniformValue& value)
+{
+	if (!source->Read(state, value))
+		return false;
+
+	if (valid && value == last)
+		return false;
+
+	last = value;
+	valid = true;
+	return true;
+}
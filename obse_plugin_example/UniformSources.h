@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+// Snapshot of the game values exposed to effects, filled once per frame. The sources below only
+// read from this struct so they can be driven without a running game.
+struct GameState
+{
+	bool    hasSky;
+	float   currWeather;
+	float   transWeather;
+	float   weatherPercent;
+	float   gameHour;
+
+	bool    hasPlayer;
+	int32_t worldspaceID;
+	int32_t interiorID;
+	float   playerPos[3];
+	bool    inCombat;
+	bool    underwater;
+
+	bool    hasCamera;
+	float   cameraFOV;
+};
+
+enum class UniformType : uint8_t
+{
+	Bool,
+	Int,
+	Float,
+};
+
+// Up to four components of a uniform value, compared bytewise to detect changes
+struct UniformValue
+{
+	union {
+		bool    b[4];
+		int32_t i[4];
+		float   f[4];
+	};
+
+	UniformValue() : f() { }
+
+	bool operator==(const UniformValue& rhs) const { return memcmp(this, &rhs, sizeof(UniformValue)) == 0; }
+	bool operator!=(const UniformValue& rhs) const { return !(*this == rhs); }
+};
+
+struct UniformSourceInfo
+{
+	const char* name;		// value of the "source" annotation
+	UniformType type;
+	uint32_t    count;		// number of components pushed to the uniform
+
+	// returns false if the value is not available this frame, in which case the uniform is left alone
+	bool (*Read)(const GameState& state, UniformValue& value);
+};
+
+// Returns the registered source for an annotation value, or nullptr if there is none
+const UniformSourceInfo* LookupUniformSource(const char* name);
+
+// Remembers the last value pushed to a uniform so unchanged values aren't sent again
+struct TrackedUniform
+{
+	const UniformSourceInfo* source;
+	UniformValue             last;
+	bool                     valid;
+
+	TrackedUniform(const UniformSourceInfo* _source) : source(_source), valid(false) { }
+
+	// Reads the source into value and returns true if it must be pushed to the uniform
+	bool Update(const GameState& state, UniformValue& value);
+	void Invalidate() { valid = false; }
+};
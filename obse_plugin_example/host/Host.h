@@ -0,0 +1,20 @@
+#pragma once
+
+// The host benchmark and tests build the plugin's game-free sources (AddonEvents, EffectCache, UniformSources,
+// FrameTimers) without OBSE's prefix headers so they can be built on other platforms too. These stand in for what
+// those sources and the ReShade headers need from them
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#if !defined(_MSC_VER)
+#define __declspec(a)
+
+// each type gets its own zeroed GUID, MockEffectRuntime keys private data by the GUID's address
+template <typename T> struct HostUuid { static const uint8_t value[16]; };
+template <typename T> const uint8_t HostUuid<T>::value[16] = { };
+#define __uuidof(T)		HostUuid<T>::value
+#endif
+
+#define _MESSAGE(...)	(printf(__VA_ARGS__), printf("\n"))
@@ -0,0 +1,317 @@
+#include "MockEffectRuntime.h"
+
+#include <cstring>
+
+static const char* s_callNames[kMockCall_Max] =
+{
+	"get_device",
+	"private_data",
+	"enumerate",
+	"annotation",
+	"technique_name",
+	"get_technique_state",
+	"set_technique_state",
+	"uniform_value",
+	"render_effects",
+	"other",
+};
+
+uint64_t MockCallCounts::Total() const
+{
+	uint64_t total = 0;
+	for (uint64_t count : calls)
+		total += count;
+	return total;
+}
+
+const char* MockCallCounts::Name(MockCall call)
+{
+	return call < kMockCall_Max ? s_callNames[call] : "";
+}
+
+void MockPrivateData::Get(const uint8_t guid[16], uint64_t* data) const
+{
+	auto iter = m_data.find(guid);
+	*data = iter != m_data.end() ? iter->second : 0;
+}
+
+void MockPrivateData::Set(const uint8_t guid[16], uint64_t data)
+{
+	if (data)
+		m_data[guid] = data;
+	else
+		m_data.erase(guid);
+}
+
+void MockDevice::get_private_data(const uint8_t guid[16], uint64_t* data) const
+{
+	m_counts.calls[kMockCall_PrivateData]++;
+	m_privateData.Get(guid, data);
+}
+
+void MockDevice::set_private_data(const uint8_t guid[16], const uint64_t data)
+{
+	m_counts.calls[kMockCall_PrivateData]++;
+	m_privateData.Set(guid, data);
+}
+
+// copies a string the way ReShade's getters do: just the length if value is null, else truncated to *length
+static void CopyString(const std::string& str, char* value, size_t* length)
+{
+	if (!value) {
+		*length = str.size();
+	}
+	else if (*length) {
+		*length = str.copy(value, *length - 1);
+		value[*length] = '\0';
+	}
+}
+
+static const std::string* FindAnnotation(const std::vector<std::pair<std::string, std::string>>& annotations, const char* name)
+{
+	for (const auto& annotation : annotations) {
+		if (!strcmp(annotation.first.c_str(), name))
+			return &annotation.second;
+	}
+	return nullptr;
+}
+
+MockEffectRuntime::MockEffectRuntime(const MockEffectConfig& config)
+	: onBeginEffects(nullptr), onFinishEffects(nullptr), onReloadedEffects(nullptr), staleHandles(0),
+	m_device(counts), m_generation(1), m_commandList(0)
+{
+	char buf[64];
+	techniques.resize(config.numTechniques);
+	for (uint32_t i = 0; i < config.numTechniques; i++) {
+		Technique& technique = techniques[i];
+		snprintf(buf, sizeof(buf), "Technique%u", i);
+		technique.name = buf;
+		for (uint32_t j = 0; j < config.numAnnotations; j++) {
+			snprintf(buf, sizeof(buf), "ui_annotation%u", j);
+			technique.annotations.emplace_back(buf, technique.name);
+		}
+		if (i >= config.numTechniques - config.numPostTechniques)
+			technique.annotations.emplace_back("ui_stage", "post");
+		technique.enabled = config.enabledInterval && i % config.enabledInterval == 0;
+		technique.renders = 0;
+	}
+
+	uniforms.resize(config.numUniforms);
+	for (uint32_t i = 0; i < config.numUniforms; i++) {
+		Uniform& uniform = uniforms[i];
+		snprintf(buf, sizeof(buf), "Uniform%u", i);
+		uniform.name = buf;
+		for (uint32_t j = 0; j < config.numAnnotations; j++) {
+			snprintf(buf, sizeof(buf), "ui_annotation%u", j);
+			uniform.annotations.emplace_back(buf, uniform.name);
+		}
+		if (i < config.sources.size())
+			uniform.annotations.emplace_back("source", config.sources[i]);
+		memset(uniform.value, 0, sizeof(uniform.value));
+		uniform.sets = 0;
+	}
+}
+
+void MockEffectRuntime::Present()
+{
+	resource_view backBuffer = { 1 };
+	render_effects(CommandList(), backBuffer, backBuffer);
+}
+
+void MockEffectRuntime::Reload()
+{
+	m_generation++;
+	if (onReloadedEffects)
+		onReloadedEffects(this);
+}
+
+MockEffectRuntime::Technique* MockEffectRuntime::LookupTechnique(effect_technique technique) const
+{
+	if ((technique.handle >> 32) != m_generation || !(technique.handle & 0xFFFFFFFF) || (technique.handle & 0xFFFFFFFF) > techniques.size()) {
+		staleHandles++;
+		return nullptr;
+	}
+	return const_cast<Technique*>(&techniques[(technique.handle & 0xFFFFFFFF) - 1]);
+}
+
+MockEffectRuntime::Uniform* MockEffectRuntime::LookupUniform(effect_uniform_variable variable) const
+{
+	if ((variable.handle >> 32) != m_generation || !(variable.handle & 0xFFFFFFFF) || (variable.handle & 0xFFFFFFFF) > uniforms.size()) {
+		staleHandles++;
+		return nullptr;
+	}
+	return const_cast<Uniform*>(&uniforms[(variable.handle & 0xFFFFFFFF) - 1]);
+}
+
+void MockEffectRuntime::get_private_data(const uint8_t guid[16], uint64_t* data) const
+{
+	counts.calls[kMockCall_PrivateData]++;
+	m_privateData.Get(guid, data);
+}
+
+void MockEffectRuntime::set_private_data(const uint8_t guid[16], const uint64_t data)
+{
+	counts.calls[kMockCall_PrivateData]++;
+	m_privateData.Set(guid, data);
+}
+
+device* MockEffectRuntime::get_device()
+{
+	counts.calls[kMockCall_GetDevice]++;
+	return &m_device;
+}
+
+void MockEffectRuntime::render_effects(command_list* cmd_list, resource_view rtv, resource_view rtv_srgb)
+{
+	counts.calls[kMockCall_RenderEffects]++;
+	if (onBeginEffects)
+		onBeginEffects(this, cmd_list, rtv, rtv_srgb);
+	for (Technique& technique : techniques) {
+		if (technique.enabled)
+			technique.renders++;
+	}
+	if (onFinishEffects)
+		onFinishEffects(this, cmd_list, rtv, rtv_srgb);
+}
+
+void MockEffectRuntime::enumerate_uniform_variables(const char* effect_name, void(*callback)(effect_runtime* runtime, effect_uniform_variable variable, void* user_data), void* user_data)
+{
+	counts.calls[kMockCall_Enumerate]++;
+	for (size_t i = 0; i < uniforms.size(); i++)
+		callback(this, { MakeHandle(i) }, user_data);
+}
+
+void MockEffectRuntime::get_uniform_variable_name(effect_uniform_variable variable, char* name, size_t* length) const
+{
+	counts.calls[kMockCall_Other]++;
+	if (const Uniform* uniform = LookupUniform(variable))
+		CopyString(uniform->name, name, length);
+}
+
+bool MockEffectRuntime::get_annotation_string_from_uniform_variable(effect_uniform_variable variable, const char* name, char* value, size_t* length) const
+{
+	counts.calls[kMockCall_Annotation]++;
+	const Uniform* uniform = LookupUniform(variable);
+	const std::string* annotation = uniform ? FindAnnotation(uniform->annotations, name) : nullptr;
+	if (!annotation)
+		return false;
+
+	CopyString(*annotation, value, length);
+	return true;
+}
+
+void MockEffectRuntime::GetUniformValue(effect_uniform_variable variable, uint32_t* values, size_t count, size_t array_index) const
+{
+	counts.calls[kMockCall_UniformValue]++;
+	if (const Uniform* uniform = LookupUniform(variable)) {
+		for (size_t i = 0; i < count && array_index + i < 4; i++)
+			values[i] = uniform->value[array_index + i];
+	}
+}
+
+void MockEffectRuntime::SetUniformValue(effect_uniform_variable variable, const uint32_t* values, size_t count, size_t array_index)
+{
+	counts.calls[kMockCall_UniformValue]++;
+	if (Uniform* uniform = LookupUniform(variable)) {
+		for (size_t i = 0; i < count && array_index + i < 4; i++)
+			uniform->value[array_index + i] = values[i];
+		uniform->sets++;
+	}
+}
+
+void MockEffectRuntime::get_uniform_value_bool(effect_uniform_variable variable, bool* values, size_t count, size_t array_index) const
+{
+	uint32_t raw[4] = { };
+	GetUniformValue(variable, raw, count < 4 ? count : 4, array_index);
+	for (size_t i = 0; i < count && i < 4; i++)
+		values[i] = raw[i] != 0;
+}
+
+void MockEffectRuntime::get_uniform_value_float(effect_uniform_variable variable, float* values, size_t count, size_t array_index) const
+{
+	static_assert(sizeof(float) == sizeof(uint32_t), "uniform components are 32 bits");
+	GetUniformValue(variable, reinterpret_cast<uint32_t*>(values), count, array_index);
+}
+
+void MockEffectRuntime::get_uniform_value_int(effect_uniform_variable variable, int32_t* values, size_t count, size_t array_index) const
+{
+	GetUniformValue(variable, reinterpret_cast<uint32_t*>(values), count, array_index);
+}
+
+void MockEffectRuntime::get_uniform_value_uint(effect_uniform_variable variable, uint32_t* values, size_t count, size_t array_index) const
+{
+	GetUniformValue(variable, values, count, array_index);
+}
+
+void MockEffectRuntime::set_uniform_value_bool(effect_uniform_variable variable, const bool* values, size_t count, size_t array_index)
+{
+	uint32_t raw[4] = { };
+	for (size_t i = 0; i < count && i < 4; i++)
+		raw[i] = values[i];
+	SetUniformValue(variable, raw, count < 4 ? count : 4, array_index);
+}
+
+void MockEffectRuntime::set_uniform_value_float(effect_uniform_variable variable, const float* values, size_t count, size_t array_index)
+{
+	SetUniformValue(variable, reinterpret_cast<const uint32_t*>(values), count, array_index);
+}
+
+void MockEffectRuntime::set_uniform_value_int(effect_uniform_variable variable, const int32_t* values, size_t count, size_t array_index)
+{
+	SetUniformValue(variable, reinterpret_cast<const uint32_t*>(values), count, array_index);
+}
+
+void MockEffectRuntime::set_uniform_value_uint(effect_uniform_variable variable, const uint32_t* values, size_t count, size_t array_index)
+{
+	SetUniformValue(variable, values, count, array_index);
+}
+
+void MockEffectRuntime::enumerate_techniques(const char* effect_name, void(*callback)(effect_runtime* runtime, effect_technique technique, void* user_data), void* user_data)
+{
+	counts.calls[kMockCall_Enumerate]++;
+	for (size_t i = 0; i < techniques.size(); i++)
+		callback(this, { MakeHandle(i) }, user_data);
+}
+
+effect_technique MockEffectRuntime::find_technique(const char* effect_name, const char* technique_name)
+{
+	counts.calls[kMockCall_Other]++;
+	for (size_t i = 0; i < techniques.size(); i++) {
+		if (techniques[i].name == technique_name)
+			return { MakeHandle(i) };
+	}
+	return { 0 };
+}
+
+void MockEffectRuntime::get_technique_name(effect_technique technique, char* name, size_t* length) const
+{
+	counts.calls[kMockCall_TechniqueName]++;
+	if (const Technique* found = LookupTechnique(technique))
+		CopyString(found->name, name, length);
+}
+
+bool MockEffectRuntime::get_annotation_string_from_technique(effect_technique technique, const char* name, char* value, size_t* length) const
+{
+	counts.calls[kMockCall_Annotation]++;
+	const Technique* found = LookupTechnique(technique);
+	const std::string* annotation = found ? FindAnnotation(found->annotations, name) : nullptr;
+	if (!annotation)
+		return false;
+
+	CopyString(*annotation, value, length);
+	return true;
+}
+
+bool MockEffectRuntime::get_technique_state(effect_technique technique) const
+{
+	counts.calls[kMockCall_GetTechniqueState]++;
+	const Technique* found = LookupTechnique(technique);
+	return found && found->enabled;
+}
+
+void MockEffectRuntime::set_technique_state(effect_technique technique, bool enabled)
+{
+	counts.calls[kMockCall_SetTechniqueState]++;
+	if (Technique* found = LookupTechnique(technique))
+		found->enabled = enabled;
+}
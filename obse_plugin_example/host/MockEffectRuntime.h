@@ -0,0 +1,242 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ReShade/reshade_api.hpp"
+
+using namespace reshade::api;
+
+// Headless stand-ins for ReShade's device and effect runtime, so the add-on callbacks can be driven without
+// a game or a GPU. The runtime holds a configurable set of techniques and uniforms with annotations, looks
+// them up the way ReShade does and counts every virtual call made on it.
+
+enum MockCall
+{
+	kMockCall_GetDevice = 0,
+	kMockCall_PrivateData,
+	kMockCall_Enumerate,
+	kMockCall_Annotation,
+	kMockCall_TechniqueName,
+	kMockCall_GetTechniqueState,
+	kMockCall_SetTechniqueState,
+	kMockCall_UniformValue,
+	kMockCall_RenderEffects,
+	kMockCall_Other,			// anything the add-on isn't expected to call
+
+	kMockCall_Max
+};
+
+struct MockCallCounts
+{
+	uint64_t	calls[kMockCall_Max];
+
+	MockCallCounts() { Reset(); }
+
+	void		Reset() { for (uint64_t& count : calls) count = 0; }
+	uint64_t	Total() const;
+
+	static const char* Name(MockCall call);
+};
+
+struct MockEffectConfig
+{
+	uint32_t					numTechniques;
+	uint32_t					numPostTechniques;	// how many of them have ui_stage "post", taken from the end
+	uint32_t					enabledInterval;	// every nth technique starts enabled, 0 for none
+	uint32_t					numUniforms;
+	std::vector<std::string>	sources;			// "source" annotations, one each for the first uniforms
+	uint32_t					numAnnotations;		// unrelated annotations on every technique and uniform, searched first
+
+	MockEffectConfig() : numTechniques(100), numPostTechniques(0), enabledInterval(2), numUniforms(32), numAnnotations(4) { }
+};
+
+// api_object private data, keyed by the address of the GUID passed in
+class MockPrivateData
+{
+public:
+	void Get(const uint8_t guid[16], uint64_t* data) const;
+	void Set(const uint8_t guid[16], uint64_t data);
+
+private:
+	std::map<const uint8_t*, uint64_t>	m_data;
+};
+
+class MockDevice : public device
+{
+public:
+	MockDevice(MockCallCounts& counts) : m_counts(counts) { }
+
+	uint64_t get_native() const override { return Other<uint64_t>(); }
+	void get_private_data(const uint8_t guid[16], uint64_t* data) const override;
+	void set_private_data(const uint8_t guid[16], const uint64_t data) override;
+
+	// not used by the add-on
+	device_api get_api() const override { return Other<device_api>(); }
+	bool check_capability(device_caps capability) const override { return Other<bool>(); }
+	bool check_format_support(format format, resource_usage usage) const override { return Other<bool>(); }
+	bool create_sampler(const sampler_desc &desc, sampler *out_handle) override { return Other<bool>(); }
+	void destroy_sampler(sampler handle) override { return Other<void>(); }
+	bool create_resource(const resource_desc &desc, const subresource_data *initial_data, resource_usage initial_state, resource *out_handle, void **shared_handle) override { return Other<bool>(); }
+	void destroy_resource(resource handle) override { return Other<void>(); }
+	resource_desc get_resource_desc(resource resource) const override { return Other<resource_desc>(); }
+	bool create_resource_view(resource resource, resource_usage usage_type, const resource_view_desc &desc, resource_view *out_handle) override { return Other<bool>(); }
+	void destroy_resource_view(resource_view handle) override { return Other<void>(); }
+	resource get_resource_from_view(resource_view view) const override { return Other<resource>(); }
+	resource_view_desc get_resource_view_desc(resource_view view) const override { return Other<resource_view_desc>(); }
+	bool map_buffer_region(resource resource, uint64_t offset, uint64_t size, map_access access, void **out_data) override { return Other<bool>(); }
+	void unmap_buffer_region(resource resource) override { return Other<void>(); }
+	bool map_texture_region(resource resource, uint32_t subresource, const subresource_box *box, map_access access, subresource_data *out_data) override { return Other<bool>(); }
+	void unmap_texture_region(resource resource, uint32_t subresource) override { return Other<void>(); }
+	void update_buffer_region(const void *data, resource resource, uint64_t offset, uint64_t size) override { return Other<void>(); }
+	void update_texture_region(const subresource_data &data, resource resource, uint32_t subresource, const subresource_box *box) override { return Other<void>(); }
+	bool create_pipeline(pipeline_layout layout, uint32_t subobject_count, const pipeline_subobject *subobjects, pipeline *out_handle) override { return Other<bool>(); }
+	void destroy_pipeline(pipeline handle) override { return Other<void>(); }
+	bool create_pipeline_layout(uint32_t param_count, const pipeline_layout_param *params, pipeline_layout *out_handle) override { return Other<bool>(); }
+	void destroy_pipeline_layout(pipeline_layout handle) override { return Other<void>(); }
+	bool allocate_descriptor_sets(uint32_t count, pipeline_layout layout, uint32_t param, descriptor_set *out_handles) override { return Other<bool>(); }
+	void free_descriptor_sets(uint32_t count, const descriptor_set *handles) override { return Other<void>(); }
+	void get_descriptor_pool_offset(descriptor_set set, uint32_t binding, uint32_t array_offset, descriptor_pool *out_pool, uint32_t *out_offset) const override { return Other<void>(); }
+	void copy_descriptor_sets(uint32_t count, const descriptor_set_copy *copies) override { return Other<void>(); }
+	void update_descriptor_sets(uint32_t count, const descriptor_set_update *updates) override { return Other<void>(); }
+	bool create_query_pool(query_type type, uint32_t size, query_pool *out_handle) override { return Other<bool>(); }
+	void destroy_query_pool(query_pool handle) override { return Other<void>(); }
+	bool get_query_pool_results(query_pool pool, uint32_t first, uint32_t count, void *results, uint32_t stride) override { return Other<bool>(); }
+	void set_resource_name(resource handle, const char *name) override { return Other<void>(); }
+	void set_resource_view_name(resource_view handle, const char *name) override { return Other<void>(); }
+
+private:
+	template <typename T> T Other() const { m_counts.calls[kMockCall_Other]++; return T(); }
+
+	MockCallCounts&		m_counts;
+	MockPrivateData		m_privateData;
+};
+
+class MockEffectRuntime : public effect_runtime
+{
+public:
+	typedef void (*EffectsEvent)(effect_runtime* runtime, command_list* cmd_list, resource_view rtv, resource_view rtv_srgb);
+	typedef void (*ReloadedEvent)(effect_runtime* runtime);
+
+	struct Technique
+	{
+		std::string										name;
+		std::vector<std::pair<std::string, std::string>>	annotations;
+		bool											enabled;
+		uint32_t										renders;	// number of render_effects calls it was enabled in
+	};
+
+	struct Uniform
+	{
+		std::string										name;
+		std::vector<std::pair<std::string, std::string>>	annotations;
+		uint32_t										value[4];	// raw components as last set
+		uint32_t										sets;		// number of set_uniform_value_* calls
+	};
+
+	MockEffectRuntime(const MockEffectConfig& config);
+
+	// the add-on's event callbacks, invoked the way ReShade would
+	EffectsEvent	onBeginEffects;
+	EffectsEvent	onFinishEffects;
+	ReloadedEvent	onReloadedEffects;
+
+	// renders all enabled techniques into the back buffer, as ReShade does on present
+	void Present();
+	// gives every technique and uniform a new handle, as reloading effects does, and fires onReloadedEffects
+	void Reload();
+
+	// stand-in for the command list ReShade passes to the events, never dereferenced
+	command_list* CommandList() { return reinterpret_cast<command_list*>(&m_commandList); }
+
+	mutable MockCallCounts	counts;
+	std::vector<Technique>	techniques;
+	std::vector<Uniform>	uniforms;
+	mutable uint32_t		staleHandles;	// lookups with a handle from before the last Reload
+
+	uint64_t get_native() const override { return Other<uint64_t>(); }
+	void get_private_data(const uint8_t guid[16], uint64_t* data) const override;
+	void set_private_data(const uint8_t guid[16], const uint64_t data) override;
+	device* get_device() override;
+	void* get_hwnd() const override { return Other<void*>(); }
+	resource get_back_buffer(uint32_t index) override { return Other<resource>(); }
+	uint32_t get_back_buffer_count() const override { return Other<uint32_t>(); }
+	uint32_t get_current_back_buffer_index() const override { return Other<uint32_t>(); }
+
+	void render_effects(command_list* cmd_list, resource_view rtv, resource_view rtv_srgb) override;
+
+	void enumerate_uniform_variables(const char* effect_name, void(*callback)(effect_runtime* runtime, effect_uniform_variable variable, void* user_data), void* user_data) override;
+	void get_uniform_variable_name(effect_uniform_variable variable, char* name, size_t* length) const override;
+	bool get_annotation_string_from_uniform_variable(effect_uniform_variable variable, const char* name, char* value, size_t* length) const override;
+	void get_uniform_value_bool(effect_uniform_variable variable, bool* values, size_t count, size_t array_index) const override;
+	void get_uniform_value_float(effect_uniform_variable variable, float* values, size_t count, size_t array_index) const override;
+	void get_uniform_value_int(effect_uniform_variable variable, int32_t* values, size_t count, size_t array_index) const override;
+	void get_uniform_value_uint(effect_uniform_variable variable, uint32_t* values, size_t count, size_t array_index) const override;
+	void set_uniform_value_bool(effect_uniform_variable variable, const bool* values, size_t count, size_t array_index) override;
+	void set_uniform_value_float(effect_uniform_variable variable, const float* values, size_t count, size_t array_index) override;
+	void set_uniform_value_int(effect_uniform_variable variable, const int32_t* values, size_t count, size_t array_index) override;
+	void set_uniform_value_uint(effect_uniform_variable variable, const uint32_t* values, size_t count, size_t array_index) override;
+
+	void enumerate_techniques(const char* effect_name, void(*callback)(effect_runtime* runtime, effect_technique technique, void* user_data), void* user_data) override;
+	effect_technique find_technique(const char* effect_name, const char* technique_name) override;
+	void get_technique_name(effect_technique technique, char* name, size_t* length) const override;
+	bool get_annotation_string_from_technique(effect_technique technique, const char* name, char* value, size_t* length) const override;
+	bool get_technique_state(effect_technique technique) const override;
+	void set_technique_state(effect_technique technique, bool enabled) override;
+
+	// not used by the add-on
+	command_queue *get_command_queue() override { return Other<command_queue *>(); }
+	bool capture_screenshot(uint8_t *pixels) override { return Other<bool>(); }
+	void get_screenshot_width_and_height(uint32_t *out_width, uint32_t *out_height) const override { return Other<void>(); }
+	bool is_key_down(uint32_t keycode) const override { return Other<bool>(); }
+	bool is_key_pressed(uint32_t keycode) const override { return Other<bool>(); }
+	bool is_key_released(uint32_t keycode) const override { return Other<bool>(); }
+	bool is_mouse_button_down(uint32_t button) const override { return Other<bool>(); }
+	bool is_mouse_button_pressed(uint32_t button) const override { return Other<bool>(); }
+	bool is_mouse_button_released(uint32_t button) const override { return Other<bool>(); }
+	void get_mouse_cursor_position(uint32_t *out_x, uint32_t *out_y, int16_t *out_wheel_delta) const override { return Other<void>(); }
+	effect_uniform_variable find_uniform_variable(const char *effect_name, const char *variable_name) const override { return Other<effect_uniform_variable>(); }
+	void get_uniform_variable_type(effect_uniform_variable variable, format *out_base_type, uint32_t *out_rows, uint32_t *out_columns, uint32_t *out_array_length) const override { return Other<void>(); }
+	bool get_annotation_bool_from_uniform_variable(effect_uniform_variable variable, const char *name, bool *values, size_t count, size_t array_index) const override { return Other<bool>(); }
+	bool get_annotation_float_from_uniform_variable(effect_uniform_variable variable, const char *name, float *values, size_t count, size_t array_index) const override { return Other<bool>(); }
+	bool get_annotation_int_from_uniform_variable(effect_uniform_variable variable, const char *name, int32_t *values, size_t count, size_t array_index) const override { return Other<bool>(); }
+	bool get_annotation_uint_from_uniform_variable(effect_uniform_variable variable, const char *name, uint32_t *values, size_t count, size_t array_index) const override { return Other<bool>(); }
+	void enumerate_texture_variables(const char *effect_name, void(*callback)(effect_runtime *runtime, effect_texture_variable variable, void *user_data), void *user_data) override { return Other<void>(); }
+	effect_texture_variable find_texture_variable(const char *effect_name, const char *variable_name) const override { return Other<effect_texture_variable>(); }
+	void get_texture_variable_name(effect_texture_variable variable, char *name, size_t *length) const override { return Other<void>(); }
+	bool get_annotation_bool_from_texture_variable(effect_texture_variable variable, const char *name, bool *values, size_t count, size_t array_index) const override { return Other<bool>(); }
+	bool get_annotation_float_from_texture_variable(effect_texture_variable variable, const char *name, float *values, size_t count, size_t array_index) const override { return Other<bool>(); }
+	bool get_annotation_int_from_texture_variable(effect_texture_variable variable, const char *name, int32_t *values, size_t count, size_t array_index) const override { return Other<bool>(); }
+	bool get_annotation_uint_from_texture_variable(effect_texture_variable variable, const char *name, uint32_t *values, size_t count, size_t array_index) const override { return Other<bool>(); }
+	bool get_annotation_string_from_texture_variable(effect_texture_variable variable, const char *name, char *value, size_t *length) const override { return Other<bool>(); }
+	void update_texture(effect_texture_variable variable, const uint32_t width, const uint32_t height, const uint8_t *pixels) override { return Other<void>(); }
+	void get_texture_binding(effect_texture_variable variable, resource_view *out_srv, resource_view *out_srv_srgb) const override { return Other<void>(); }
+	void update_texture_bindings(const char *semantic, resource_view srv, resource_view srv_srgb) override { return Other<void>(); }
+	bool get_annotation_bool_from_technique(effect_technique technique, const char *name, bool *values, size_t count, size_t array_index) const override { return Other<bool>(); }
+	bool get_annotation_float_from_technique(effect_technique technique, const char *name, float *values, size_t count, size_t array_index) const override { return Other<bool>(); }
+	bool get_annotation_int_from_technique(effect_technique technique, const char *name, int32_t *values, size_t count, size_t array_index) const override { return Other<bool>(); }
+	bool get_annotation_uint_from_technique(effect_technique technique, const char *name, uint32_t *values, size_t count, size_t array_index) const override { return Other<bool>(); }
+	bool get_preprocessor_definition(const char *name, char *value, size_t *length) const override { return Other<bool>(); }
+	void set_preprocessor_definition(const char *name, const char *value) override { return Other<void>(); }
+	void render_technique(effect_technique technique, command_list *cmd_list, resource_view rtv, resource_view rtv_srgb) override { return Other<void>(); }
+	bool get_effects_state() const override { return Other<bool>(); }
+	void set_effects_state(bool enabled) override { return Other<void>(); }
+	void get_current_preset_path(char *path, size_t *length) const override { return Other<void>(); }
+	void set_current_preset_path(const char *path) override { return Other<void>(); }
+
+private:
+	template <typename T> T Other() const { counts.calls[kMockCall_Other]++; return T(); }
+
+	uint64_t	MakeHandle(size_t index) const { return ((uint64_t)m_generation << 32) | (index + 1); }
+	Technique*	LookupTechnique(effect_technique technique) const;
+	Uniform*	LookupUniform(effect_uniform_variable variable) const;
+	void		SetUniformValue(effect_uniform_variable variable, const uint32_t* values, size_t count, size_t array_index);
+	void		GetUniformValue(effect_uniform_variable variable, uint32_t* values, size_t count, size_t array_index) const;
+
+	MockDevice				m_device;
+	MockPrivateData			m_privateData;
+	uint32_t				m_generation;
+	int						m_commandList;
+};
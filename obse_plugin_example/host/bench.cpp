@@ -0,0 +1,205 @@
+// bench: drives the add-on callbacks against MockEffectRuntime and reports the cost per frame
+//
+//	bench [-n frames]
+//		-n	number of frames to simulate per run, default 10000
+//
+// "frames" runs whole frames through the add-on, "snapshot" times saving and restoring technique state alone
+// against the name-based snapshot the add-on used to take
+//
+// Built from this directory with e.g.
+//	g++ -std=c++17 -O2 -fpermissive -w -I.. -include Host.h bench.cpp MockEffectRuntime.cpp ../AddonEvents.cpp ../EffectCache.cpp ../UniformSources.cpp ../FrameTimers.cpp -o bench
+
+#include "Host.h"
+#include "MockEffectRuntime.h"
+#include "AddonEvents.h"
+#include "EffectCache.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+typedef std::chrono::steady_clock Clock;
+
+static const char* s_sourceNames[] =
+{
+	"ModLoaded", "Weather", "GameHour", "WorldspaceID", "InteriorID", "PlayerPosition", "CameraFOV", "InCombat", "Underwater",
+};
+
+static uint32_t s_frame = 0;
+
+// the player walks around outside while the clock runs, everything else stays put
+void ReadGameState(GameState& state)
+{
+	state = GameState();
+	state.hasSky = true;
+	state.currWeather = 0x38EEE;
+	state.weatherPercent = 1.0f;
+	state.gameHour = 12.0f + (s_frame / 600) * 0.01f;
+	state.hasPlayer = true;
+	state.worldspaceID = 0x3C;
+	state.playerPos[0] = 1000.0f + s_frame;
+	state.playerPos[1] = 2000.0f;
+	state.playerPos[2] = 500.0f;
+	state.hasCamera = true;
+	state.cameraFOV = 75.0f;
+}
+
+static MockEffectConfig MakeConfig(uint32_t numTechniques)
+{
+	MockEffectConfig config;
+	config.numTechniques = numTechniques;
+	config.numPostTechniques = numTechniques / 4;
+	config.enabledInterval = 2;
+	config.numUniforms = 32;
+	config.sources.assign(s_sourceNames, s_sourceNames + sizeof(s_sourceNames) / sizeof(s_sourceNames[0]));
+	return config;
+}
+
+// one frame as the game runs it: the render hook's pre-UI pass, then ReShade's own pass on present
+static void RunFrames(MockEffectRuntime& runtime, uint32_t numFrames, uint32_t reloadInterval)
+{
+	for (uint32_t i = 0; i < numFrames; i++, s_frame++) {
+		if (reloadInterval && i && i % reloadInterval == 0)
+			runtime.Reload();
+		RenderEffects();
+		runtime.Present();
+	}
+}
+
+// every enabled technique must run exactly once per frame, pre-UI ones from the first frame the hook had a command list
+static bool CheckRenders(const MockEffectRuntime& runtime, const MockEffectConfig& config, uint32_t numFrames)
+{
+	for (uint32_t i = 0; i < runtime.techniques.size(); i++) {
+		const MockEffectRuntime::Technique& technique = runtime.techniques[i];
+		bool post = i >= config.numTechniques - config.numPostTechniques;
+		uint32_t expected = technique.enabled ? (post ? numFrames : numFrames - 1) : 0;
+		if (technique.renders != expected) {
+			printf("  %s rendered %u times, expected %u\n", technique.name.c_str(), technique.renders, expected);
+			return false;
+		}
+	}
+	return runtime.staleHandles == 0;
+}
+
+static bool BenchFrames(uint32_t numTechniques, uint32_t numFrames, uint32_t reloadInterval)
+{
+	MockEffectConfig config = MakeConfig(numTechniques);
+	MockEffectRuntime runtime(config);
+	runtime.onBeginEffects = on_reshade_begin_effects;
+	runtime.onFinishEffects = on_reshade_finish_effects;
+	runtime.onReloadedEffects = on_reshade_reloaded_effects;
+
+	on_init_device(runtime.get_device());
+	on_init_effect_runtime(&runtime);
+	runtime.counts.Reset();
+
+	Clock::time_point start = Clock::now();
+	RunFrames(runtime, numFrames, reloadInterval);
+	double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+	bool ok = CheckRenders(runtime, config, numFrames);
+	printf("%6u techniques, reload %-6s %10.0f ns/frame %8.1f calls/frame%s\n", numTechniques,
+		reloadInterval ? std::to_string(reloadInterval).c_str() : "never", ns / numFrames,
+		(double)runtime.counts.Total() / numFrames, ok ? "" : "  RENDER MISMATCH");
+	for (uint32_t i = 0; i < kMockCall_Max; i++) {
+		if (runtime.counts.calls[i])
+			printf("        %-20s %8.1f\n", MockCallCounts::Name((MockCall)i), (double)runtime.counts.calls[i] / numFrames);
+	}
+
+	on_destroy_effect_runtime(&runtime);
+	on_destroy_device(runtime.get_device());
+	return ok;
+}
+
+// the snapshot as on_reshade_begin_effects and on_reshade_finish_effects used to take it, by technique name
+static std::vector<std::string> s_backupTechniques;
+
+static void DisableTechniquesByName(effect_runtime* runtime)
+{
+	s_backupTechniques.clear();
+	runtime->enumerate_techniques(nullptr, [&](effect_runtime* runtime, effect_technique technique) {
+		char buffer[256];
+		runtime->get_technique_name(technique, buffer);
+		std::string name = buffer;
+		if (runtime->get_technique_state(technique)) {
+			s_backupTechniques.push_back(name);
+			runtime->set_technique_state(technique, false);
+		}
+		});
+}
+
+static void RestoreTechniquesByName(effect_runtime* runtime)
+{
+	runtime->enumerate_techniques(nullptr, [&](effect_runtime* runtime, effect_technique technique) {
+		char buffer[256];
+		runtime->get_technique_name(technique, buffer);
+		std::string name = buffer;
+		runtime->set_technique_state(technique, std::find(s_backupTechniques.begin(), s_backupTechniques.end(), name) != s_backupTechniques.end());
+		});
+}
+
+template <typename Disable, typename Restore>
+static bool BenchSnapshot(const char* name, uint32_t numTechniques, uint32_t numFrames, Disable disable, Restore restore)
+{
+	// all techniques run before the UI so both snapshots cover the same set
+	MockEffectConfig config = MakeConfig(numTechniques);
+	config.numPostTechniques = 0;
+	MockEffectRuntime runtime(config);
+	std::vector<bool> enabled;
+	for (const MockEffectRuntime::Technique& technique : runtime.techniques)
+		enabled.push_back(technique.enabled);
+
+	Clock::time_point start = Clock::now();
+	for (uint32_t i = 0; i < numFrames; i++) {
+		disable(&runtime);
+		restore(&runtime);
+	}
+	double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+	bool ok = true;
+	for (uint32_t i = 0; i < numTechniques; i++)
+		ok &= runtime.techniques[i].enabled == enabled[i];
+	printf("%6u techniques, %-8s %10.0f ns/frame %8.1f calls/frame%s\n", numTechniques, name, ns / numFrames,
+		(double)runtime.counts.Total() / numFrames, ok ? "" : "  STATE NOT RESTORED");
+	return ok;
+}
+
+static bool BenchSnapshots(uint32_t numTechniques, uint32_t numFrames)
+{
+	// the old snapshot is quadratic, keep its runs short
+	uint32_t numNameFrames = std::max<uint32_t>(numFrames * 100 / numTechniques / numTechniques, 10);
+	bool ok = BenchSnapshot("by name", numTechniques, numNameFrames, DisableTechniquesByName, RestoreTechniquesByName);
+
+	EffectCache cache;
+	return ok & BenchSnapshot("cached", numTechniques, numFrames,
+		[&](effect_runtime* runtime) { cache.DisableTechniques(runtime, UIStage::Pre); },
+		[&](effect_runtime* runtime) { cache.RestoreTechniques(runtime, UIStage::Pre); });
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t numFrames = 10000;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-n") && i + 1 < argc)
+			numFrames = strtoul(argv[++i], NULL, 0);
+		else {
+			printf("usage: bench [-n frames]\n");
+			return 1;
+		}
+	}
+	if (numFrames < 2)
+		numFrames = 2;
+
+	bool ok = true;
+	printf("frames: begin_effects, RenderEffects and finish_effects over %u frames\n", numFrames);
+	for (uint32_t numTechniques : { 10, 100, 500, 2000 })
+		ok &= BenchFrames(numTechniques, numFrames, 0);
+	for (uint32_t numTechniques : { 100, 500 })
+		ok &= BenchFrames(numTechniques, numFrames, 100);
+
+	printf("\nsnapshot: saving and restoring technique state once per frame\n");
+	for (uint32_t numTechniques : { 500, 1000, 2000 })
+		ok &= BenchSnapshots(numTechniques, numFrames);
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,172 @@
+// tests: checks the uniform source registry and change tracking against fake game state
+//
+// Built from this directory with e.g.
+//	g++ -std=c++17 -O2 -fpermissive -w -I.. -include Host.h tests.cpp MockEffectRuntime.cpp ../EffectCache.cpp ../UniformSources.cpp -o tests
+
+#include "Host.h"
+#include "MockEffectRuntime.h"
+#include "EffectCache.h"
+#include <cstring>
+
+static uint32_t s_numChecks = 0;
+static uint32_t s_numFailed = 0;
+
+#define CHECK(a)	Check((a), #a, __FILE__, __LINE__)
+
+static void Check(bool passed, const char* expr, const char* file, int line)
+{
+	s_numChecks++;
+	if (!passed) {
+		s_numFailed++;
+		printf("%s(%d): failed: %s\n", file, line, expr);
+	}
+}
+
+static GameState MakeState()
+{
+	GameState state = GameState();
+	state.hasSky = true;
+	state.currWeather = 0x38EEE;
+	state.weatherPercent = 1.0f;
+	state.gameHour = 12.0f;
+	state.hasPlayer = true;
+	state.worldspaceID = 0x3C;
+	state.playerPos[0] = 1000.0f;
+	state.hasCamera = true;
+	state.cameraFOV = 75.0f;
+	return state;
+}
+
+static void TestLookup()
+{
+	static const struct
+	{
+		const char*	name;
+		UniformType	type;
+		uint32_t	count;
+	} kSources[] =
+	{
+		{ "ModLoaded",		UniformType::Bool,	1 },
+		{ "Weather",		UniformType::Float,	4 },
+		{ "GameHour",		UniformType::Float,	1 },
+		{ "WorldspaceID",	UniformType::Int,	1 },
+		{ "InteriorID",		UniformType::Int,	1 },
+		{ "PlayerPosition",	UniformType::Float,	3 },
+		{ "CameraFOV",		UniformType::Float,	1 },
+		{ "InCombat",		UniformType::Bool,	1 },
+		{ "Underwater",		UniformType::Bool,	1 },
+	};
+
+	for (const auto& expected : kSources) {
+		const UniformSourceInfo* source = LookupUniformSource(expected.name);
+		CHECK(source != nullptr);
+		if (source) {
+			CHECK(!strcmp(source->name, expected.name));
+			CHECK(source->type == expected.type);
+			CHECK(source->count == expected.count);
+		}
+	}
+
+	// annotation values are matched exactly
+	CHECK(LookupUniformSource("weather") == nullptr);
+	CHECK(LookupUniformSource("Weather ") == nullptr);
+	CHECK(LookupUniformSource("") == nullptr);
+	CHECK(LookupUniformSource("NotASource") == nullptr);
+}
+
+static void TestTracking()
+{
+	TrackedUniform tracked(LookupUniformSource("Weather"));
+	GameState state = MakeState();
+	UniformValue value;
+
+	// the first value is always pushed
+	CHECK(tracked.Update(state, value));
+	CHECK(value.f[0] == state.currWeather && value.f[3] == state.gameHour);
+
+	// unchanged values aren't
+	CHECK(!tracked.Update(state, value));
+	CHECK(!tracked.Update(state, value));
+
+	state.gameHour = 12.5f;
+	CHECK(tracked.Update(state, value));
+	CHECK(value.f[3] == 12.5f);
+	CHECK(!tracked.Update(state, value));
+
+	// an unavailable source leaves the uniform alone and doesn't forget the last value
+	state.hasSky = false;
+	CHECK(!tracked.Update(state, value));
+	state.hasSky = true;
+	CHECK(!tracked.Update(state, value));
+
+	tracked.Invalidate();
+	CHECK(tracked.Update(state, value));
+
+	// each tracked uniform keeps its own last value
+	TrackedUniform position(LookupUniformSource("PlayerPosition"));
+	CHECK(position.Update(state, value));
+	CHECK(!position.Update(state, value));
+	state.playerPos[2] = 10.0f;
+	CHECK(position.Update(state, value));
+	CHECK(value.f[2] == 10.0f);
+
+	// sources that are always available report a change when the game state behind them flips
+	TrackedUniform combat(LookupUniformSource("InCombat"));
+	CHECK(combat.Update(state, value));
+	CHECK(!value.b[0]);
+	state.inCombat = true;
+	CHECK(combat.Update(state, value));
+	CHECK(value.b[0]);
+	state.hasPlayer = false;
+	CHECK(combat.Update(state, value));
+	CHECK(!value.b[0]);
+}
+
+static void TestCachePushes()
+{
+	MockEffectConfig config;
+	config.numTechniques = 4;
+	config.numUniforms = 6;
+	config.sources = { "Weather", "WorldspaceID", "InCombat", "NotASource" };
+	MockEffectRuntime runtime(config);
+	MockEffectRuntime::Uniform& weather = runtime.uniforms[0];
+	MockEffectRuntime::Uniform& worldspace = runtime.uniforms[1];
+	MockEffectRuntime::Uniform& combat = runtime.uniforms[2];
+
+	EffectCache cache;
+	GameState state = MakeState();
+	cache.UpdateUniforms(&runtime, state);
+	CHECK(weather.sets == 1 && worldspace.sets == 1 && combat.sets == 1);
+	CHECK(runtime.uniforms[3].sets == 0 && runtime.uniforms[4].sets == 0);
+
+	float weatherValue[4];
+	memcpy(weatherValue, weather.value, sizeof(weatherValue));
+	CHECK(weatherValue[0] == state.currWeather && weatherValue[3] == state.gameHour);
+	CHECK((int32_t)worldspace.value[0] == state.worldspaceID);
+
+	for (int i = 0; i < 100; i++)
+		cache.UpdateUniforms(&runtime, state);
+	CHECK(weather.sets == 1 && worldspace.sets == 1 && combat.sets == 1);
+
+	state.worldspaceID = 0x10;
+	cache.UpdateUniforms(&runtime, state);
+	CHECK(weather.sets == 1 && worldspace.sets == 2 && combat.sets == 1);
+	CHECK((int32_t)worldspace.value[0] == 0x10);
+
+	// reloading effects resets uniforms to their defaults, so everything is pushed again
+	runtime.Reload();
+	cache.Invalidate();
+	cache.UpdateUniforms(&runtime, state);
+	CHECK(weather.sets == 2 && worldspace.sets == 3 && combat.sets == 2);
+	CHECK(runtime.staleHandles == 0);
+}
+
+int main(int argc, char** argv)
+{
+	TestLookup();
+	TestTracking();
+	TestCachePushes();
+
+	printf("%u checks, %u failed\n", s_numChecks, s_numFailed);
+	return s_numFailed ? 1 : 0;
+}
@@ -11,6 +11,8 @@
 #include "obse/ParamInfos.h"
 #include "obse/Script.h"
 #include "obse/GameObjects.h"
+#include "obse/NiAPI.h"
+#include "obse/NiObjects.h"
 #include "obse_common/SafeWrite.cpp"
 
 #include <string>
@@ -21,67 +23,30 @@
 #include "ReShade/reshade.hpp"
 #include "Detours/include/detours.h"
 
+#include "AddonEvents.h"
+#include "FrameTimers.h"
+
 using namespace reshade;
 
 extern HMODULE m_hModule = nullptr;
 
-api::effect_runtime* m_runtime = nullptr;
-api::command_list* m_cmdlist = nullptr;
-api::resource_view       m_rtv;
-api::resource_view       m_rtv_srgb;
-api::resource_view       true_rtv;
-bool                     validPass = false;
-std::vector<std::string> backupTechniques;
-
-struct __declspec(uuid("7251932A-ADAF-4DFC-B5CB-9A4E8CD5D6EB")) device_data
-{
-	api::effect_runtime* main_runtime = nullptr;
-};
-
-void on_reshade_begin_effects(api::effect_runtime* runtime, api::command_list* cmd_list, api::resource_view rtv, api::resource_view rtv_srgb)
+// Shift+F11 writes the current frame timings to the log
+void on_reshade_present(api::effect_runtime* runtime)
 {
-	m_runtime = runtime;
-	m_cmdlist = cmd_list;
-	m_rtv = rtv;
-	m_rtv_srgb = rtv_srgb;
-	backupTechniques.clear();
-	if (!validPass) {
-		m_runtime->enumerate_techniques(nullptr, [&](api::effect_runtime* runtime, api::effect_technique technique) {
-			char buffer[256];
-			runtime->get_technique_name(technique, buffer);
-			std::string name = buffer;
-			if (runtime->get_technique_state(technique)) {
-				backupTechniques.push_back(name);
-				runtime->set_technique_state(technique, false);
-			}
-			});
-	}
-}
-
-void on_reshade_finish_effects(api::effect_runtime* runtime, api::command_list* cmd_list, api::resource_view rtv, api::resource_view rtv_srgb)
-{
-	if (!validPass) {
-		m_runtime->enumerate_techniques(nullptr, [&](api::effect_runtime* runtime, api::effect_technique technique) {
-			char buffer[256];
-			runtime->get_technique_name(technique, buffer);
-			std::string name = buffer;
-			runtime->set_technique_state(technique, std::find(backupTechniques.begin(), backupTechniques.end(), name) != backupTechniques.end());
-			});
-	}
-	else {
-		validPass = false;
-	}
-}
-
-void on_bind_render_targets_and_depth_stencil(api::command_list* cmd_list, uint32_t count, const api::resource_view* rtvs, api::resource_view dsv)
-{
-	true_rtv = rtvs[0];
+	if (runtime->is_key_down(VK_SHIFT) && runtime->is_key_pressed(VK_F11))
+		FrameTimers::Dump();
 }
 
 void register_addon_events()
 {
+	register_event<addon_event::init_device>(on_init_device);
+	register_event<addon_event::destroy_device>(on_destroy_device);
+	register_event<addon_event::init_effect_runtime>(on_init_effect_runtime);
+	register_event<addon_event::destroy_effect_runtime>(on_destroy_effect_runtime);
 	register_event<addon_event::reshade_begin_effects>(on_reshade_begin_effects);
 	register_event<addon_event::reshade_finish_effects>(on_reshade_finish_effects);
+	register_event<addon_event::reshade_present>(on_reshade_present);
+	register_event<addon_event::reshade_reloaded_effects>(on_reshade_reloaded_effects);
 	register_event<addon_event::bind_render_targets_and_depth_stencil>(on_bind_render_targets_and_depth_stencil);
 }
 
@@ -100,59 +65,43 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD fdwReason, LPVOID)
 	return TRUE;
 }
 
-float GetWorldspaceID()
+void ReadGameState(GameState& state)
 {
-	if (auto player = *g_thePlayer) {
-		if (player->parentCell && player->parentCell->worldSpace) {
-			return player->parentCell->worldSpace->refID & 0x00FFFFFF;
-		}
+	state = GameState();
+
+	if (auto sky = Sky::GetSingleton()) {
+		state.hasSky = true;
+		state.currWeather = sky->currWeather ? (float)(sky->currWeather->refID & 0x00FFFFFF) : 0;
+		state.transWeather = sky->transWeather ? (float)(sky->transWeather->refID & 0x00FFFFFF) : 0;
+		state.weatherPercent = sky->weatherPercent;
+		state.gameHour = sky->gameHour;
 	}
-	return 0;
-}
 
-float GetInteriorID()
-{
 	if (auto player = *g_thePlayer) {
-		if (player->parentCell && player->parentCell->IsInterior()) {
-			return player->parentCell->refID & 0x00FFFFFF;
+		state.hasPlayer = true;
+		state.playerPos[0] = player->posX;
+		state.playerPos[1] = player->posY;
+		state.playerPos[2] = player->posZ;
+		state.inCombat = player->IsInCombat(false);
+
+		if (TESObjectCELL* cell = player->parentCell) {
+			if (cell->IsInterior())
+				state.interiorID = cell->refID & 0x00FFFFFF;
+			else if (cell->worldSpace)
+				state.worldspaceID = cell->worldSpace->refID & 0x00FFFFFF;
+
+			// same test as IsUnderWater
+			if (cell->HasWater()) {
+				bool swimming = player->process && (player->process->GetMovementFlags() & BaseProcess::kMovementFlag_Swimming);
+				float height = player->GetScale() * 128.0 * (swimming ? .9 : .73);
+				state.underwater = player->posZ + height < cell->GetWaterHeight();
+			}
 		}
 	}
-	return 0;
-}
-
-void RenderEffects()
-{
-	if (m_runtime) {
-		m_runtime->enumerate_uniform_variables(nullptr, [&](api::effect_runtime* runtime, api::effect_uniform_variable variable) {
-			char annotation_value[128];
-			if (runtime->get_annotation_string_from_uniform_variable(variable, "source", annotation_value)) {
-				std::string annotation = annotation_value;
-
-				if (annotation == "ModLoaded") {
-					runtime->set_uniform_value_bool(variable, true);
-				}
-
-				if (annotation == "Weather") {
-					if (auto sky = Sky::GetSingleton()) {
-						runtime->set_uniform_value_float(variable,
-							(float)(sky->currWeather->refID & 0x00FFFFFF),
-							(float)(sky->transWeather->refID & 0x00FFFFFF),
-							sky->weatherPercent,
-							sky->gameHour);
-					}
-				}
-
-				if (annotation == "WorldspaceID") {
-					runtime->set_uniform_value_int(variable, GetWorldspaceID());
-				}
-				else if (annotation == "InteriorID") {
-					runtime->set_uniform_value_int(variable, GetInteriorID());
-				}
-			}
-			});
 
-		validPass = true;
-		m_runtime->render_effects(m_cmdlist, true_rtv);
+	if (*g_worldSceneGraph) {
+		state.hasCamera = true;
+		state.cameraFOV = (*g_worldSceneGraph)->cameraFOV;
 	}
 }
 
@@ -173,8 +122,12 @@ class BSRenderedTexture;
 void(__thiscall* HDRRender)(HDRShader*, NiScreenElements*, BSRenderedTexture**, BSRenderedTexture**, UInt8) = (void(__thiscall*)(HDRShader*, NiScreenElements*, BSRenderedTexture**, BSRenderedTexture**, UInt8))0x007BDFC0;
 void __fastcall HDRRenderHook(HDRShader* This, UInt32 edx, NiScreenElements* ScreenElements, BSRenderedTexture** RenderedTexture1, BSRenderedTexture** RenderedTexture2, UInt8 Arg4)
 {
-	(HDRRender)(This, ScreenElements, RenderedTexture1, RenderedTexture2, Arg4);
+	{
+		ScopedStageTimer timer(kStage_HDRRender);
+		(HDRRender)(This, ScreenElements, RenderedTexture1, RenderedTexture2, Arg4);
+	}
 	RenderEffects();
+	FrameTimers::EndFrame();
 }
 
 void Load()